@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <mlfe/utils/db/simple_db.hpp>
@@ -5,17 +6,59 @@
 #include <mlfe/flatbuffers/tensor_blob_fb_generated.h>
 #include <mlfe/core/tensor_blob.hpp>
 #include <mlfe/math/blas.hpp>
+#include <mlfe/operators/fusion.hpp>
+#include <mlfe/operators/db_reader.hpp>
+#include <mlfe/utils/parallel.hpp>
+#include <mlfe/utils/affinity.hpp>
+#include <mlfe/utils/core_balancer.hpp>
+#include <mlfe/utils/profiler.hpp>
+#include <mlfe/utils/assert.hpp>
 #include <opencv2/opencv.hpp>
 #include "net_builder.hpp"
 
-NetBuilder::NetBuilder(){}
+namespace{
+/*
+ * each view in an arena starts at a multiple of this many elements.
+ */
+const int arena_alignment = 16;
+
+/*
+ * updates outputs[0] with the optimizer, reading its gradient inputs.
+ * the optimizer step must have begun before.
+ */
+class UpdateVariableOp : public OperatorBase{
+public:
+    UpdateVariableOp(OperatorIO &opio, ItemHolder *ih, std::shared_ptr<Optimizer<float>> optimizer)
+    : OperatorBase(opio, ih), optimizer(optimizer){
+        var = ih->GetItem<TensorBlob<CPUContext>>(opio.outputs[0]);
+    }
+    
+    void Compute() override{
+        optimizer->UpdateVariable(var);
+    }
+    
+private:
+    std::shared_ptr<Optimizer<float>> optimizer;
+    TensorBlob<CPUContext> *var;
+};
+} /* namespace */
+
+NetBuilder::NetBuilder() : stop_gradient_pos(-1), num_threads(0), use_arena(false),
+    serial_execution(false), overlap_update(false), min_loaders(1), max_loaders(1),
+    profile_first(1), profile_steps(0){
+    async_forward = std::make_shared<AsyncForward>(&ih, [this](){
+        NumThreadsScope scope(num_threads);
+        RunLayers();
+    });
+}
 
 OperatorIO NetBuilder::AddDBReader(
                                      std::string name,
                                      std::string db_path,
                                      std::string db_type,
                                      std::vector<int> input_dim,
-                                     bool has_label
+                                     bool has_label,
+                                     std::string layout
                                      ){
     OperatorIO opio;
     opio.type = "DBReader";
@@ -27,6 +70,8 @@ OperatorIO NetBuilder::AddDBReader(
     opio.param.Add("HasLabel", has_label);
     opio.param.Add("DataShape", input_dim);
     opio.param.Add("LabelShape", std::vector<int>{input_dim[0], 1});
+    opio.param.Add("Layout", layout);
+    opio.param.Add("MaxLoaders", max_loaders);
     
     layers.push_back(std::make_pair(name, CreateOperator(opio, &ih)));
     
@@ -87,10 +132,10 @@ OperatorIO NetBuilder::AddOneHot(std::string name, std::string x, int dim){
 }
 
 OperatorIO NetBuilder::AddConv(std::string name, std::string x, int filters,
-                                 std::vector<int> kernel, std::vector<int> stride, int padding){
+                                 std::vector<int> kernel, std::vector<int> stride, int padding, int group){
     OperatorIO opio, init_w, init_b;
     opio.type = "Conv";
-    opio.accelerator = "Eigen";
+    opio.accelerator = "Auto";
     opio.inputs.push_back(x);
     opio.inputs.push_back(name + "_w");
     opio.inputs.push_back(name + "_b");
@@ -99,6 +144,7 @@ OperatorIO NetBuilder::AddConv(std::string name, std::string x, int filters,
     opio.param.Add("Kernel", kernel);
     opio.param.Add("Stride", stride);
     opio.param.Add("Padding", padding);
+    opio.param.Add("Group", group);
     
     layers.push_back(std::make_pair(name, CreateOperator(opio, &ih)));
     
@@ -211,6 +257,99 @@ OperatorIO NetBuilder::AddSoftmaxXent(std::string name, std::string x, std::stri
     return opio;
 }
 
+OperatorIO NetBuilder::AddSparseSoftmaxXent(std::string name, std::string x, std::string label){
+    OperatorIO opio;
+    opio.type = "SparseSoftmaxXentWithLabel";
+    opio.inputs.push_back(x);
+    opio.inputs.push_back(label);
+    opio.outputs.push_back(name + "_prob");
+    opio.outputs.push_back(name + "_loss");
+    
+    layers.push_back(std::make_pair(name, CreateOperator(opio, &ih)));
+    
+    std::cout<<"- Add Sparse Softmax Xent With Label Operator"<<std::endl;
+    std::cout<<"    "<<"Input : ";
+    std::cout<<opio.inputs[0]<<", ";
+    std::cout<<opio.inputs[1]<<std::endl;
+    std::cout<<"    "<<"Output : ";
+    std::cout<<opio.outputs[0]<<", ";
+    std::cout<<opio.outputs[1]<<std::endl;
+    return opio;
+}
+
+OperatorIO NetBuilder::AddSampledSoftmaxXent(std::string name, std::string x, std::string label,
+                                             int classes, int sampled, std::string sampler){
+    OperatorIO opio, init_w, init_b;
+    opio.type = "SampledSoftmaxXent";
+    opio.inputs.push_back(x);
+    opio.inputs.push_back(name + "_w");
+    opio.inputs.push_back(name + "_b");
+    opio.inputs.push_back(label);
+    opio.outputs.push_back(name + "_prob");
+    opio.outputs.push_back(name + "_loss");
+    opio.outputs.push_back(name + "_sampled");
+    opio.param.Add("Units", classes);
+    opio.param.Add("Sampled", sampled);
+    opio.param.Add("Sampler", sampler);
+    
+    layers.push_back(std::make_pair(name, CreateOperator(opio, &ih)));
+    
+    init_w.type = "XavierFill";
+    init_w.outputs.push_back(name + "_w");
+    init_layers.push_back(std::make_pair(name + "_init_w", CreateOperator(init_w, &ih)));
+    init_b.type = "ConstantFill";
+    init_b.outputs.push_back(name + "_b");
+    init_b.param.Add("Value", static_cast<float>(0));
+    init_layers.push_back(std::make_pair(name + "_init_b", CreateOperator(init_b, &ih)));
+    
+    trainable_var.push_back(name + "_w");
+    trainable_var.push_back(name + "_b");
+    sparse_var.push_back(name + "_w");
+    sparse_var.push_back(name + "_b");
+    
+    std::cout<<"- Add Sampled Softmax Xent Operator"<<std::endl;
+    std::cout<<"    "<<"Input : ";
+    std::cout<<opio.inputs[0]<<", ";
+    std::cout<<opio.inputs[1]<<", ";
+    std::cout<<opio.inputs[2]<<", ";
+    std::cout<<opio.inputs[3]<<std::endl;
+    std::cout<<"    "<<"Output : ";
+    std::cout<<opio.outputs[0]<<", ";
+    std::cout<<opio.outputs[1]<<", ";
+    std::cout<<opio.outputs[2]<<std::endl;
+    return opio;
+}
+
+OperatorIO NetBuilder::AddEmbedding(std::string name, std::string ids, int rows, int dim, std::string mode){
+    OperatorIO opio, init_w;
+    opio.type = mode.empty() ? "Embedding" : "EmbeddingBag";
+    opio.inputs.push_back(ids);
+    opio.inputs.push_back(name + "_w");
+    opio.outputs.push_back(name + "_y");
+    opio.param.Add("Rows", rows);
+    opio.param.Add("Dim", dim);
+    if(!mode.empty()){
+        opio.param.Add("Mode", mode);
+    }
+    
+    layers.push_back(std::make_pair(name, CreateOperator(opio, &ih)));
+    
+    init_w.type = "XavierFill";
+    init_w.outputs.push_back(name + "_w");
+    init_layers.push_back(std::make_pair(name + "_init_w", CreateOperator(init_w, &ih)));
+    
+    trainable_var.push_back(name + "_w");
+    sparse_var.push_back(name + "_w");
+    
+    std::cout<<"- Add "<<opio.type<<" Operator"<<std::endl;
+    std::cout<<"    "<<"Input : ";
+    std::cout<<opio.inputs[0]<<", ";
+    std::cout<<opio.inputs[1]<<std::endl;
+    std::cout<<"    "<<"Output : ";
+    std::cout<<opio.outputs[0]<<std::endl;
+    return opio;
+}
+
 OperatorIO NetBuilder::AddFlatten(std::string name, std::string x, int axis){
     OperatorIO opio;
     opio.type = "Flatten";
@@ -231,6 +370,35 @@ void NetBuilder::StopGradient(){
     stop_gradient_pos = layers.size() - 1;
 }
 
+void NetBuilder::FuseOperators(){
+    std::vector<OperatorIO> opios;
+    for(auto &layer : layers){
+        opios.push_back(layer.second->GetOperatorIO());
+    }
+    auto fusions = FindOperatorFusions(opios);
+    /*
+     * erasing a consumer only shifts the layers after it,
+     * so the fusions are applied from the last consumer.
+     */
+    std::sort(fusions.begin(), fusions.end(),
+              [](const OperatorFusion &a, const OperatorFusion &b){
+                  return a.consumer > b.consumer;
+              });
+    for(auto &fusion : fusions){
+        auto &producer = layers[fusion.producer];
+        auto &consumer = layers[fusion.consumer];
+        std::cout<<"- Fuse "<<producer.first<<" + "<<consumer.first<<std::endl;
+        std::cout<<"    "<<"Input : "<<fusion.fused.inputs[0]<<std::endl;
+        std::cout<<"    "<<"Output : "<<fusion.fused.outputs[0]<<std::endl;
+        producer = std::make_pair(producer.first + "_" + consumer.first,
+                                  CreateOperator(fusion.fused, &ih));
+        layers.erase(layers.begin() + fusion.consumer);
+        if(fusion.consumer <= stop_gradient_pos){
+            --stop_gradient_pos;
+        }
+    }
+}
+
 void NetBuilder::AddAllGradientOp(){
     std::vector<std::pair<std::string,
     std::shared_ptr<OperatorBase>>> gradients;
@@ -248,13 +416,120 @@ void NetBuilder::AddAllGradientOp(){
 }
 
 void NetBuilder::Train(int iter, float lr){
+    Synchronize();
+    NumThreadsScope scope(num_threads);
     float loss_sum = 0.f;
     auto loss = ih.template GetItem<TensorBlob<CPUContext>>("softmax_xent_loss");
+    /*
+     * the shared pool places its workers when it is created.
+     */
+    GetSharedThreadPool();
+    std::cout<<AffinityReport();
+    FuseOperators();
     InitAllTrainableVariables();
     AddAllGradientOp();
+    if(optimizer == nullptr){
+        SetOptimizer("SGD");
+    }
+    if(use_arena){
+        BuildArenas();
+        optimizer->AddVariable(GetParameterArena(), GetGradientArena());
+    }
+    for(auto &var_name : trainable_var){
+        auto var = ih.template GetItem<TensorBlob<CPUContext>>(var_name);
+        auto grad = ih.template GetItem<TensorBlob<CPUContext>>(var_name + "_grad");
+        if(std::find(sparse_var.begin(), sparse_var.end(), var_name) != sparse_var.end()){
+            optimizer->AddSparseVariable(var, grad,
+                                         ih.template GetItem<TensorBlob<CPUContext>>(var_name + "_grad_rows"));
+        }
+        else if(!use_arena){
+            optimizer->AddVariable(var, grad);
+        }
+    }
+    /*
+     * with overlapped updates, the layers and the updates run on one executor,
+     * which starts an update when the last operator touching its variable has finished.
+     */
+    std::shared_ptr<GraphExecutor> train_executor;
+    if(overlap_update){
+        AddAllUpdateOp();
+        std::vector<std::shared_ptr<OperatorBase>> train_ops;
+        for(auto &layer : layers){
+            train_ops.push_back(layer.second);
+        }
+        for(auto &layer : update_layers){
+            train_ops.push_back(layer.second);
+        }
+        NameOperators();
+        train_executor = std::make_shared<GraphExecutor>(train_ops);
+        if(serial_execution){
+            train_executor->SetSerial(true);
+        }
+    }
+    /*
+     * the threads of the net are split between the loaders and the operators.
+     */
+    std::vector<DBReaderOp<unsigned char, CPUContext> *> readers;
+    std::shared_ptr<CoreBalancer> balancer;
+    for(auto &layer : layers){
+        auto reader = dynamic_cast<DBReaderOp<unsigned char, CPUContext> *>(layer.second.get());
+        if(reader != nullptr){
+            readers.push_back(reader);
+        }
+    }
+    if(max_loaders > min_loaders && !readers.empty()){
+        if(GetNumThreads() > min_loaders){
+            balancer = std::make_shared<CoreBalancer>(GetNumThreads(), min_loaders, max_loaders);
+            for(auto reader : readers){
+                reader->SetLoaders(balancer->Loaders());
+            }
+        }
+        else{
+            std::cout<<"Adaptive loading is off, no thread is left to compute."<<std::endl;
+        }
+    }
     for(int i = 1; i <= iter; ++i){
-        Forward();
-        UpdateAllTrainableVariables(lr);
+        NumThreadsScope step_scope(balancer != nullptr ? balancer->ComputeThreads() : GetNumThreads());
+        if(profile_steps > 0 && i == profile_first){
+            ClearProfile();
+            SetProfiling(true);
+        }
+        if(train_executor != nullptr){
+            optimizer->SetLearningRate(lr);
+            optimizer->BeginStep();
+            train_executor->Run();
+        }
+        else{
+            Forward();
+            UpdateAllTrainableVariables(lr);
+        }
+        if(balancer != nullptr){
+            double stall_ms = 0.;
+            double occupancy = 1.;
+            for(auto reader : readers){
+                stall_ms = std::max(stall_ms, reader->LastStall());
+                occupancy = std::min(occupancy, reader->LastOccupancy());
+            }
+            if(balancer->Step(stall_ms, occupancy)){
+                for(auto reader : readers){
+                    reader->SetLoaders(balancer->Loaders());
+                }
+                std::cout<<"Loaders : "<<balancer->Loaders()<<", ";
+                std::cout<<"compute threads : "<<balancer->ComputeThreads()<<std::endl;
+            }
+        }
+        /*
+         * the window ends early with the training.
+         */
+        const int profile_last = std::min(profile_first + profile_steps - 1, iter);
+        if(profile_steps > 0 && i == profile_last && i >= profile_first){
+            SetProfiling(false);
+            std::cout<<"Profile of steps "<<profile_first<<" to "<<i<<std::endl;
+            std::cout<<ProfileSummary();
+            if(!trace_path.empty()){
+                SaveChromeTrace(trace_path);
+            }
+        }
         if (i % 100 == 0) {
             std::cout << i << " : " << loss_sum / 100.f << std::endl;
             loss_sum = 0.f;
@@ -264,21 +539,180 @@ void NetBuilder::Train(int iter, float lr){
 }
 
 void NetBuilder::Forward(){
-    for(int n = 0; n < layers.size(); ++n){
-        layers[n].second->Compute();
+    Synchronize();
+    NumThreadsScope scope(num_threads);
+    RunLayers();
+}
+
+void NetBuilder::BindInput(std::string name){
+    async_forward->BindInput(name);
+}
+
+void NetBuilder::BindOutput(std::string name){
+    async_forward->BindOutput(name);
+}
+
+TensorBlob<CPUContext> *NetBuilder::NextInput(std::string name){
+    return async_forward->NextInput(name);
+}
+
+std::future<void> NetBuilder::ForwardAsync(std::function<void (int)> callback){
+    return async_forward->Queue(callback);
+}
+
+TensorBlob<CPUContext> *NetBuilder::GetOutput(std::string name, int step){
+    return async_forward->GetOutput(name, step);
+}
+
+void NetBuilder::Synchronize(){
+    async_forward->Synchronize();
+}
+
+void NetBuilder::RunLayers(){
+    std::vector<std::shared_ptr<OperatorBase>> ops;
+    for(auto &layer : layers){
+        ops.push_back(layer.second);
+    }
+    if(executor == nullptr || executor->Operators() != ops){
+        NameOperators();
+        executor = std::make_shared<GraphExecutor>(ops);
+        if(serial_execution){
+            executor->SetSerial(true);
+        }
     }
+    executor->Run();
 }
 
-void NetBuilder::UpdateAllTrainableVariables(float lr){
-    for(auto &var_name : trainable_var){
-        auto var = ih.template GetItem<TensorBlob<CPUContext>>(var_name);
-        auto var_grad = ih.template GetItem<TensorBlob<CPUContext>>(var_name + "_grad");
-        math::axpy<float, CPUContext>(var->Size(), -lr, var_grad->GetPtrConst<float>(), var->GetPtrMutable<float>());
+void NetBuilder::SetOptimizer(std::string type, ParamDef param){
+    optimizer = std::make_shared<Optimizer<float>>(type, param);
+}
+
+void NetBuilder::SetNumThreads(int num){
+    num_threads = num;
+}
+
+void NetBuilder::SetSerialExecution(bool serial){
+    serial_execution = serial;
+    if(executor != nullptr){
+        executor->SetSerial(serial);
+    }
+}
+
+void NetBuilder::SetOverlapUpdate(bool overlap){
+    overlap_update = overlap;
+}
+
+void NetBuilder::SetProfileSteps(int first, int steps, std::string trace_path){
+    runtime_assert(first >= 1 && steps >= 0, "[Net Builder] first >= 1, steps >= 0.");
+    profile_first = first;
+    profile_steps = steps;
+    this->trace_path = trace_path;
+}
+
+void NetBuilder::SetAdaptiveLoading(int min_loaders, int max_loaders){
+    runtime_assert(min_loaders >= 1 && max_loaders >= min_loaders,
+                   "[Net Builder] 1 <= min_loaders <= max_loaders.");
+    this->min_loaders = min_loaders;
+    this->max_loaders = max_loaders;
+}
+
+void NetBuilder::SetUseArena(bool use){
+    use_arena = use;
+}
+
+TensorBlob<CPUContext> *NetBuilder::GetParameterArena(){
+    if(!ih.HasItem("parameter_arena")){
+        return nullptr;
+    }
+    return ih.template GetItem<TensorBlob<CPUContext>>("parameter_arena");
+}
+
+TensorBlob<CPUContext> *NetBuilder::GetGradientArena(){
+    if(!ih.HasItem("gradient_arena")){
+        return nullptr;
     }
+    return ih.template GetItem<TensorBlob<CPUContext>>("gradient_arena");
+}
+
+void NetBuilder::UpdateAllTrainableVariables(float lr){
+    optimizer->SetLearningRate(lr);
+    optimizer->Update();
 }
 
 void NetBuilder::InitAllTrainableVariables(){
     for(auto &op : init_layers){
-        op.second->Compute();
+        op.second->Run();
+    }
+}
+
+void NetBuilder::NameOperators(){
+    for(auto group : {&init_layers, &layers, &update_layers}){
+        for(auto &layer : *group){
+            if(layer.second->GetOperatorIO().name.empty()){
+                layer.second->GetOperatorIO().name = layer.first;
+            }
+        }
+    }
+}
+
+void NetBuilder::AddAllUpdateOp(){
+    update_layers.clear();
+    for(auto &var_name : trainable_var){
+        OperatorIO opio;
+        opio.type = "UpdateVariable";
+        opio.inputs.push_back(var_name + "_grad");
+        if(std::find(sparse_var.begin(), sparse_var.end(), var_name) != sparse_var.end()){
+            opio.inputs.push_back(var_name + "_grad_rows");
+        }
+        opio.outputs.push_back(var_name);
+        update_layers.push_back(std::make_pair(var_name + "_update",
+                                               std::make_shared<UpdateVariableOp>(opio, &ih, optimizer)));
+    }
+    std::cout<<"- Overlap "<<update_layers.size()<<" variable updates with the gradients"<<std::endl;
+}
+
+void NetBuilder::BuildArenas(){
+    std::vector<std::string> dense_var;
+    std::vector<int> offsets;
+    int total_size = 0;
+    for(auto &var_name : trainable_var){
+        if(std::find(sparse_var.begin(), sparse_var.end(), var_name) == sparse_var.end()){
+            dense_var.push_back(var_name);
+        }
+    }
+    for(auto &var_name : dense_var){
+        auto var = ih.template GetItem<TensorBlob<CPUContext>>(var_name);
+        offsets.push_back(total_size);
+        total_size += (var->Size() + arena_alignment - 1) / arena_alignment * arena_alignment;
+    }
+    ih.AddItem<TensorBlob<CPUContext>>("parameter_arena");
+    ih.AddItem<TensorBlob<CPUContext>>("gradient_arena");
+    auto params = GetParameterArena();
+    auto grads = GetGradientArena();
+    params->Resize<float>({total_size});
+    grads->Resize<float>({total_size});
+    params->SetByConst<float>(0.f);
+    grads->SetByConst<float>(0.f);
+    
+    /*
+     * the current values are moved into the arena,
+     * the operators keep their blobs which now point into it.
+     */
+    for(int n = 0; n < dense_var.size(); ++n){
+        auto var = ih.template GetItem<TensorBlob<CPUContext>>(dense_var[n]);
+        auto grad = ih.template GetItem<TensorBlob<CPUContext>>(dense_var[n] + "_grad");
+        for(auto pair : {std::make_pair(var, params), std::make_pair(grad, grads)}){
+            auto tb = pair.first;
+            auto arena = pair.second;
+            std::vector<int> dims;
+            for(int i = 0; i < tb->Dims(); ++i){
+                dims.push_back(tb->Dim(i));
+            }
+            std::copy(tb->GetPtrConst<float>(), tb->GetPtrConst<float>() + tb->Size(),
+                      arena->GetPtrMutable<float>() + offsets[n]);
+            tb->ShareFrom<float>(*arena, offsets[n], dims);
+        }
     }
+    std::cout<<"- Arena : "<<dense_var.size()<<" variables, ";
+    std::cout<<total_size<<" elements"<<std::endl;
 }
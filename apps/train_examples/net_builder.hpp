@@ -2,9 +2,15 @@
 #define __NET_BUILDER_HPP__
 
 #include <vector>
+#include <map>
 #include <memory>
+#include <future>
+#include <functional>
 #include <mlfe/operators/operator.hpp>
+#include <mlfe/operators/graph_executor.hpp>
+#include <mlfe/operators/async_forward.hpp>
 #include <mlfe/core/item_holder.hpp>
+#include <mlfe/optimizers/optimizer.hpp>
 
 using namespace mlfe;
 
@@ -17,7 +23,8 @@ public:
                            std::string db_path,
                            std::string db_type,
                            std::vector<int> input_dim,
-                           bool has_label
+                           bool has_label,
+                           std::string layout = "NCHW"
                            );
     
     OperatorIO AddScale(std::string name, std::string input, float scaler);
@@ -27,7 +34,7 @@ public:
     OperatorIO AddOneHot(std::string name, std::string input, int dim);
     
     OperatorIO AddConv(std::string name, std::string input, int filters,
-                         std::vector<int> kernel, std::vector<int> stride, int padding);
+                         std::vector<int> kernel, std::vector<int> stride, int padding, int group = 1);
     
     OperatorIO AddMaxPool(std::string name, std::string input,
                             std::vector<int> kernel, std::vector<int> stride);
@@ -38,28 +45,172 @@ public:
     
     OperatorIO AddSoftmaxXent(std::string name, std::string input, std::string label);
     
+    /*
+     * label holds class indices, like the label output of DBReader.
+     */
+    OperatorIO AddSparseSoftmaxXent(std::string name, std::string input, std::string label);
+    
+    /*
+     * trains the projection of input to the classes, with weights laid out like FC,
+     * against the label and the given number of sampled classes.
+     * sampler is "Uniform" or "LogUniform".
+     */
+    OperatorIO AddSampledSoftmaxXent(std::string name, std::string input, std::string label,
+                                     int classes, int sampled, std::string sampler = "Uniform");
+    
+    /*
+     * looks up rows of a {rows, dim} table by ids.
+     * mode "Sum" or "Mean" pools the ids of each sample as EmbeddingBag.
+     * the table gets a row sparse gradient, and only touched rows are updated.
+     */
+    OperatorIO AddEmbedding(std::string name, std::string ids, int rows, int dim, std::string mode = "");
+    
     OperatorIO AddFlatten(std::string name, std::string input, int axis);
     
     void StopGradient();
     
+    /*
+     * replaces operator chains in layers with fused operators.
+     * it must run before AddAllGradientOp, Train calls it.
+     */
+    void FuseOperators();
+    
     void AddAllGradientOp();
     
+    /*
+     * type and params of Optimizer, Train uses plain SGD when it is not set.
+     * the learning rate is given by Train.
+     */
+    void SetOptimizer(std::string type, ParamDef param = ParamDef());
+    
+    /*
+     * places all trainable variables, and separately all their gradients,
+     * into one contiguous arena each, and turns the variables into views of it.
+     * it must be set before Train, the optimizer then updates the arena at once.
+     */
+    void SetUseArena(bool use);
+    
+    /*
+     * returns nullptr until Train builds the arenas.
+     */
+    TensorBlob<CPUContext> *GetParameterArena();
+    
+    TensorBlob<CPUContext> *GetGradientArena();
+    
+    /*
+     * number of threads of the operators of this net,
+     * 0 (default) uses the global setting of SetNumThreads in mlfe/utils/parallel.hpp.
+     */
+    void SetNumThreads(int num);
+    
+    /*
+     * Forward runs independent operators concurrently,
+     * serial runs them one by one in the order they were added, for debugging.
+     */
+    void SetSerialExecution(bool serial);
+    
+    /*
+     * Train updates each variable as soon as its gradient is final,
+     * while the gradients of the earlier layers are still computed.
+     * it must be set before Train.
+     */
+    void SetOverlapUpdate(bool overlap);
+    
+    /*
+     * Train moves threads between decoding the DBReader batches and the operators,
+     * from the input stalls and the prefetched batches of every step,
+     * so that the operators never wait with the fewest loaders.
+     * min_loaders to max_loaders decode, and the rest of the threads of the net compute.
+     * it must be set before AddDBReader, 1 and 1 (default) keeps a single loader.
+     */
+    void SetAdaptiveLoading(int min_loaders, int max_loaders);
+    
+    /*
+     * Train profiles the operators of steps first to first + steps - 1,
+     * prints the summary after them, and writes the Chrome trace to trace_path,
+     * when it is given. other windows are profiled by SetProfiling of mlfe/utils/profiler.hpp.
+     */
+    void SetProfileSteps(int first, int steps, std::string trace_path = "");
+    
     void Train(int iter, float lr);
     
     void Forward();
     
+    /*
+     * blobs fed by the caller, and read back after every ForwardAsync step,
+     * by the AsyncForward of mlfe/operators/async_forward.hpp.
+     * they must be bound before the first ForwardAsync.
+     */
+    void BindInput(std::string name);
+    
+    void BindOutput(std::string name);
+    
+    TensorBlob<CPUContext> *NextInput(std::string name);
+    
+    /*
+     * queues a Forward step, see AsyncForward::Queue.
+     */
+    std::future<void> ForwardAsync(std::function<void (int)> callback = nullptr);
+    
+    TensorBlob<CPUContext> *GetOutput(std::string name, int step);
+    
+    /*
+     * waits for every queued step.
+     */
+    void Synchronize();
+    
 protected:
     void UpdateAllTrainableVariables(float lr);
     
     void InitAllTrainableVariables();
     
+    void BuildArenas();
+    
+    /*
+     * operators are named by their layer, to be told apart in a profile.
+     */
+    void NameOperators();
+    
+    /*
+     * operators updating one variable each, run by the training executor after the layers.
+     */
+    void AddAllUpdateOp();
+    
+    /*
+     * runs the layers on the executor, built again when the layers have changed.
+     */
+    void RunLayers();
+    
 private:
     std::vector<std::pair<std::string, std::shared_ptr<OperatorBase>>> init_layers;
     std::vector<std::pair<std::string, std::shared_ptr<OperatorBase>>> layers;
     std::vector<std::pair<std::string, std::shared_ptr<OperatorBase>>> layers_for_test;
+    std::vector<std::pair<std::string, std::shared_ptr<OperatorBase>>> update_layers;
     std::vector<std::string> trainable_var;
+    /*
+     * trainable variables with a row sparse gradient, they are kept out of the arenas.
+     */
+    std::vector<std::string> sparse_var;
+    std::shared_ptr<Optimizer<float>> optimizer;
+    /*
+     * built by Forward, and again when the layers have changed.
+     */
+    std::shared_ptr<GraphExecutor> executor;
     ItemHolder ih;
     int stop_gradient_pos;
+    int num_threads;
+    bool use_arena;
+    bool serial_execution;
+    bool overlap_update;
+    int min_loaders;
+    int max_loaders;
+    int profile_first;
+    int profile_steps;
+    std::string trace_path;
+    /*
+     * declared last, so that the queued steps finish before the net is destroyed.
+     */
+    std::shared_ptr<AsyncForward> async_forward;
 };
 
 
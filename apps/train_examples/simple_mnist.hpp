@@ -16,13 +16,12 @@ public:
                                                      true
                                                      );
         std::string data = builder.AddCast("cast_data", db_reader.outputs[0], "float").outputs[0];
-        std::string label = builder.AddCast("cast_label", db_reader.outputs[1], "float").outputs[0];
-        std::string label_one_hot = builder.AddOneHot("onehot", label, 10).outputs[0];
+        std::string label = db_reader.outputs[1];
         std::string prev_layer = data;
         builder.StopGradient();
         prev_layer = builder.AddScale("scale", prev_layer, 1.f / 256.f).outputs[0];
         prev_layer = builder.AddFC("fc1", prev_layer, 10).outputs[0];
-        prev_layer = builder.AddSoftmaxXent("softmax_xent", prev_layer, label_one_hot).outputs[0];
+        prev_layer = builder.AddSparseSoftmaxXent("softmax_xent", prev_layer, label).outputs[0];
     }
     
     void Train(int iter, float lr){
@@ -0,0 +1,32 @@
+#ifndef __DATA_LAYOUT_HPP__
+#define __DATA_LAYOUT_HPP__
+#include <string>
+
+namespace mlfe{
+
+/*
+ * memory order of 4-d image tensors.
+ * NCHW : {batch, channel, height, width}
+ * NHWC : {batch, height, width, channel}
+ */
+enum class DataLayout{
+    NCHW,
+    NHWC
+};
+
+inline DataLayout LayoutFromString(std::string layout){
+    if(!layout.compare("NCHW")){
+        return DataLayout::NCHW;
+    }
+    else if(!layout.compare("NHWC")){
+        return DataLayout::NHWC;
+    }
+    throw std::string("Wrong Layout -> ") + layout;
+}
+
+inline std::string LayoutToString(DataLayout layout){
+    return layout == DataLayout::NHWC ? "NHWC" : "NCHW";
+}
+
+} /* namespace mlfe */
+#endif /* __DATA_LAYOUT_HPP__ */
@@ -19,7 +19,7 @@ struct ParamValueContainer : public ParamContainerBase {
 class ParamDef {
 public:
     bool HasParam(std::string name){
-        return params.at(name).use_count() > 0 ? true : false;
+        return params.count(name) > 0 ? true : false;
     }
     
     /*
@@ -5,6 +5,7 @@
 #include <memory>
 #include "../device_context/context.hpp"
 #include "../utils/type_holder.hpp"
+#include "data_layout.hpp"
 
 namespace mlfe{
 
@@ -13,7 +14,7 @@ class = typename std::enable_if<std::is_base_of<Context, DeviceContext>::value,
 >
 class TensorBlob{
 public:
-    TensorBlob() : size(0), context(std::make_shared<DeviceContext>()){}
+    TensorBlob() : size(0), layout(DataLayout::NCHW), context(std::make_shared<DeviceContext>()){}
     
     ~TensorBlob() { Clear(); }
     
@@ -22,6 +23,7 @@ public:
     TensorBlob& operator=(const TensorBlob &tb){
         dims = tb.dims;
         size = tb.size;
+        layout = tb.layout;
         context = tb.context;
         type = tb.type;
         return *this;
@@ -43,6 +45,7 @@ public:
     
     void Reshape(const TensorBlob<DeviceContext> &tb){
         Reshape(tb.dims);
+        layout = tb.layout;
     }
     
     /*
@@ -79,6 +82,32 @@ public:
             new_size.push_back(tb.dims[i]);
         }
         Resize<T>(new_size);
+        layout = tb.layout;
+    }
+    
+    /*
+     * @brief makes this tensor a view of tb's elements, starting at offset.
+     * the data and its modification count are shared with tb,
+     * until this tensor is resized over the shared size.
+     * tb can not be resized over its size while views of it are alive,
+     * the new memory would leave them pointing to the freed one, so Resize throws.
+     */
+    template <typename T,
+    class = typename std::enable_if<std::is_fundamental<T>::value, T>::type
+    >
+    void ShareFrom(const TensorBlob<DeviceContext> &tb, const int offset, const std::vector<int> new_dims){
+        int new_size = 1;
+        
+        for(int n = 0; n < new_dims.size(); ++n){
+            new_size *= new_dims[n];
+        }
+        if(offset < 0 || offset + new_size > tb.size){
+            throw std::string("shared range is out of the tensor.");
+        }
+        context->ShareFrom<T>(tb.context, offset, new_size);
+        dims = new_dims;
+        size = new_size;
+        type.Set<T>();
     }
     
     /*
@@ -97,6 +126,19 @@ public:
         return true;
     }
     
+    /*
+     * @brief returns true when the device memory of the tensors overlaps,
+     * like a tensor and its in place output, or two views of one arena.
+     */
+    bool SharesMemoryWith(const TensorBlob<DeviceContext> &tb) const{
+        const char *begin = static_cast<const char *>(context->GetDevicePtr());
+        const char *tb_begin = static_cast<const char *>(tb.context->GetDevicePtr());
+        if(begin == nullptr || tb_begin == nullptr){
+            return false;
+        }
+        return begin < tb_begin + tb.context->Size() && tb_begin < begin + context->Size();
+    }
+    
     /*
      * @brief check empty.
      */
@@ -133,6 +175,21 @@ public:
         return dims[idx];
     }
     
+    /*
+     * @brief returns memory order of the dimensions.
+     */
+    DataLayout Layout() const {
+        return layout;
+    }
+    
+    /*
+     * @brief set memory order of the dimensions.
+     * it does not move data, only tags how the dims are interpreted.
+     */
+    void SetLayout(const DataLayout new_layout){
+        layout = new_layout;
+    }
+    
     /*
      * @brief returns const tensor data address.
      */
@@ -145,14 +202,24 @@ public:
     
     /*
      * @brief returns tensor data address.
+     * requesting mutable address marks the data as modified.
      */
     template <typename T,
     typename = typename std::enable_if<std::is_fundamental<T>::value, T>::type
     >
     T * GetPtrMutable() const{
+        context->IncreaseVersion();
         return static_cast<T *>(context->GetDevicePtr());
     }
     
+    /*
+     * @brief returns modification count of the tensor data.
+     * tensors sharing the same data share the count.
+     */
+    unsigned int Version() const {
+        return context->Version();
+    }
+    
     /*
      * @brief copy data from device to host.
      */
@@ -178,6 +245,7 @@ public:
                       const unsigned int end,
                       const T *host_mem
                       ){
+        context->IncreaseVersion();
         context->CopyToDevice<T>(start, end, host_mem);
     }
     
@@ -193,7 +261,7 @@ public:
     typename = typename std::enable_if<std::is_fundamental<T>::value, T>::type
     >
     void SetByConst(const T val){
-        T * data_ptr = static_cast<T *>(context->GetDevicePtr());
+        T * data_ptr = GetPtrMutable<T>();
         for(int i = 0; i < size; ++i){
             data_ptr[i] = val;
         }
@@ -202,6 +270,7 @@ public:
 private:
     std::vector<int> dims;
     int size;
+    DataLayout layout;
     std::shared_ptr<Context> context;
     TypeHolder type;
 };
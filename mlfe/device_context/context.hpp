@@ -1,5 +1,6 @@
 #ifndef __CONTEXT_HPP__
 #define __CONTEXT_HPP__
+#include <atomic>
 #include <memory>
 #include <type_traits>
 #include <string>
@@ -13,19 +14,54 @@ public:
     /*
      * @brief Allocate device memory.
      * The inherit classes of Context should hold allocated memory.
+     * It throws while other contexts share this memory,
+     * since they would keep pointing to the freed memory.
      */
     template <typename T,
     typename = typename std::enable_if<std::is_fundamental<T>::value, T>::type
     >
     void Allocate(const int size) {
+        if (views.use_count() > 1) {
+            throw std::string("Context::Allocate() : the memory is shared by live views.");
+        }
         try {
             Allocator(size, sizeof(T));
+            viewed = nullptr;
+            /*
+             * new memory is not shared anymore with a former owner.
+             */
+            if (version.use_count() > 1) {
+                version = std::make_shared<std::atomic<unsigned int>>(version->load());
+            }
+            IncreaseVersion();
         }
         catch (std::string &e) {
             throw e;
         }
     }
     
+    /*
+     * @brief Share size elements of base memory, starting at offset.
+     * The memory and its modification count are shared with base,
+     * and base memory is kept alive while it is shared.
+     */
+    template <typename T,
+    typename = typename std::enable_if<std::is_fundamental<T>::value, T>::type
+    >
+    void ShareFrom(
+                   const std::shared_ptr<Context> &base,
+                   const unsigned int offset,
+                   const unsigned int size
+                   ){
+        if (views.use_count() > 1) {
+            throw std::string("Context::ShareFrom() : the memory is shared by live views.");
+        }
+        Sharer(base, offset * sizeof(T), size * sizeof(T));
+        viewed = base->views;
+        version = base->version;
+        IncreaseVersion();
+    }
+    
     /*
      * @brief Copy from host to device.
      */
@@ -64,6 +100,22 @@ public:
      */
     virtual void * GetDevicePtr() const = 0;
     
+    /*
+     * @brief Return modification count of the device memory.
+     * Operators can compare it to skip work derived from unchanged data.
+     * The count is atomic, since operators writing views of one memory may run concurrently.
+     */
+    unsigned int Version() const {
+        return *version;
+    }
+    
+    /*
+     * @brief Mark the device memory as modified.
+     */
+    void IncreaseVersion() {
+        ++(*version);
+    }
+    
     struct ComputePrecision {
         using Single = float;
         using Double = double;
@@ -74,7 +126,8 @@ protected:
      * @brief Do not allow to instantiate Context class.
      * This class is only for polymorphism design.
      */
-    Context() {}
+    Context() : version(std::make_shared<std::atomic<unsigned int>>(0)),
+                views(std::make_shared<char>(0)) {}
     
     /*
      * @brief Device specific memory allocator.
@@ -85,6 +138,16 @@ protected:
                            const unsigned int block_size
                            ) = 0;
     
+    /*
+     * @brief Device specific memory sharing, offset and size are in bytes.
+     * This must be implemented in the inherit class.
+     */
+    virtual void Sharer(
+                        const std::shared_ptr<Context> &base,
+                        const unsigned int offset,
+                        const unsigned int size
+                        ) = 0;
+    
     /*
      * @brief Copy from host memory to device memory.
      * This must be implemented in the inherit class.
@@ -107,6 +170,14 @@ protected:
                         void *to
                         ) = 0;
     
+private:
+    std::shared_ptr<std::atomic<unsigned int>> version;
+    /*
+     * every view of this memory holds a copy of views in viewed,
+     * so views.use_count() - 1 is the number of live views.
+     */
+    std::shared_ptr<char> views;
+    std::shared_ptr<char> viewed;
 };/* class Context */
 
 } /* namespace mlfe */
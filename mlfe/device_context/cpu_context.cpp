@@ -23,6 +23,7 @@ void CPUContext::Clear() {
     size_ = 0;
     ptr_ = nullptr;
     destructor_ = nullptr;
+    owner_ = nullptr;
 }
 
 int CPUContext::Size() const {
@@ -44,6 +45,20 @@ void CPUContext::Allocator(
     }
 }
 
+void CPUContext::Sharer(
+                        const std::shared_ptr<Context> &base,
+                        const unsigned int offset,
+                        const unsigned int size
+                        ){
+    if(offset + size > base->Size()){
+        throw std::string("Shared size is bigger than allocated device memory.");
+    }
+    Clear();
+    size_ = size;
+    ptr_ = static_cast<void *>(static_cast<char *>(base->GetDevicePtr()) + offset);
+    owner_ = base;
+}
+
 void CPUContext::CopyTo(
                         const unsigned int offset,
                         const unsigned int size,
@@ -4,9 +4,18 @@
 #include "context.hpp"
 
 namespace mlfe {
+
+class CPUStream;
+class CPUEvent;
     
 class CPUContext final : public Context {
 public:
+    /*
+     * asynchronous work on the cpu and its completion points, in cpu_stream.hpp.
+     */
+    using Stream = CPUStream;
+    using Event = CPUEvent;
+    
     CPUContext();
     
     ~CPUContext() override;
@@ -23,6 +32,12 @@ protected:
                    const unsigned int block_size
                    ) override;
     
+    void Sharer(
+                const std::shared_ptr<Context> &base,
+                const unsigned int offset,
+                const unsigned int size
+                ) override;
+    
     void CopyTo(
                 const unsigned int offset,
                 const unsigned int size,
@@ -46,6 +61,7 @@ private:
     int size_;
     void *ptr_;
     std::function<void(void *)> destructor_;
+    std::shared_ptr<Context> owner_;
 };/* class CPUContext */
     
 } /* namespace mlfe */
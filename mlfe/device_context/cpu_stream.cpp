@@ -0,0 +1,197 @@
+#include <chrono>
+#include "cpu_stream.hpp"
+#include "../utils/parallel.hpp"
+
+namespace mlfe {
+
+namespace {
+/*
+ * waits on cv until done, a worker of pool runs queued tasks meanwhile,
+ * since the work it waits for may be queued behind it.
+ */
+template <class Done>
+void WaitHelping(ThreadPool *pool, std::mutex &m, std::condition_variable &cv, Done done) {
+    const bool in_worker = pool != nullptr && pool->InWorker();
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            if (done()) {
+                return;
+            }
+            if (!in_worker) {
+                cv.wait(lock, done);
+                return;
+            }
+        }
+        if (!pool->RunPendingTask()) {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait_for(lock, std::chrono::milliseconds(1), done);
+        }
+    }
+}
+} /* namespace */
+
+CPUEvent::CPUEvent() {}
+
+bool CPUEvent::Query() const {
+    if (state == nullptr) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(state->m);
+    return state->done;
+}
+
+void CPUEvent::Synchronize() const {
+    if (state == nullptr) {
+        return;
+    }
+    State *s = state.get();
+    WaitHelping(s->pool, s->m, s->cv, [s]() { return s->done; });
+    if (s->error) {
+        std::rethrow_exception(s->error);
+    }
+}
+
+void CPUEvent::Then(std::function<void ()> callback) const {
+    if (state != nullptr) {
+        std::unique_lock<std::mutex> lock(state->m);
+        if (!state->done) {
+            state->callbacks.push_back(callback);
+            return;
+        }
+    }
+    callback();
+}
+
+void CPUEvent::Complete(const std::shared_ptr<State> &state, std::exception_ptr error) {
+    std::vector<std::function<void ()>> callbacks;
+    {
+        std::unique_lock<std::mutex> lock(state->m);
+        state->done = true;
+        state->error = error;
+        std::swap(callbacks, state->callbacks);
+    }
+    state->cv.notify_all();
+    for (auto &callback : callbacks) {
+        callback();
+    }
+}
+
+CPUStream::CPUStream(ThreadPool *pool) : state(std::make_shared<State>()) {
+    state->running = false;
+    state->pool = pool != nullptr ? pool : GetSharedThreadPool();
+}
+
+CPUStream::~CPUStream() {
+    State *s = state.get();
+    WaitHelping(s->pool, s->m, s->idle_cv, [s]() { return s->items.empty() && !s->running; });
+}
+
+void CPUStream::Enqueue(std::function<void ()> task) {
+    Item item;
+    item.task = task;
+    Push(state, item);
+}
+
+CPUEvent CPUStream::Record() {
+    CPUEvent event;
+    event.state = std::make_shared<CPUEvent::State>();
+    event.state->done = false;
+    event.state->pool = state->pool;
+    Item item;
+    item.record = event.state;
+    Push(state, item);
+    return event;
+}
+
+void CPUStream::Wait(const CPUEvent &event) {
+    if (event.state == nullptr) {
+        return;
+    }
+    Item item;
+    item.wait = event.state;
+    Push(state, item);
+}
+
+void CPUStream::Synchronize() {
+    State *s = state.get();
+    WaitHelping(s->pool, s->m, s->idle_cv, [s]() { return s->items.empty() && !s->running; });
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(s->m);
+        error = s->error;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void CPUStream::ResetError() {
+    std::unique_lock<std::mutex> lock(state->m);
+    state->error = nullptr;
+}
+
+bool CPUStream::Query() {
+    std::unique_lock<std::mutex> lock(state->m);
+    return state->items.empty() && !state->running;
+}
+
+void CPUStream::Push(const std::shared_ptr<State> &state, Item item) {
+    {
+        std::unique_lock<std::mutex> lock(state->m);
+        state->items.push_back(std::move(item));
+        if (state->running) {
+            return;
+        }
+        state->running = true;
+    }
+    std::shared_ptr<State> s = state;
+    state->pool->Submit([s]() { Drain(s); });
+}
+
+void CPUStream::Drain(const std::shared_ptr<State> &state) {
+    while (true) {
+        Item item;
+        std::exception_ptr error;
+        {
+            std::unique_lock<std::mutex> lock(state->m);
+            if (state->items.empty()) {
+                state->running = false;
+                state->idle_cv.notify_all();
+                return;
+            }
+            item = state->items.front();
+            error = state->error;
+        }
+        /*
+         * the stream stays running while it waits, and the event resumes it.
+         */
+        if (item.wait != nullptr) {
+            std::unique_lock<std::mutex> event_lock(item.wait->m);
+            if (!item.wait->done) {
+                std::shared_ptr<State> s = state;
+                item.wait->callbacks.push_back([s]() {
+                    s->pool->Submit([s]() { Drain(s); });
+                });
+                return;
+            }
+            error = error ? error : item.wait->error;
+        }
+        else if (item.task && !error) {
+            try {
+                item.task();
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+        }
+        else if (item.record != nullptr) {
+            CPUEvent::Complete(item.record, error);
+        }
+        std::unique_lock<std::mutex> lock(state->m);
+        state->items.pop_front();
+        state->error = error;
+    }
+}
+
+} /* namespace mlfe */
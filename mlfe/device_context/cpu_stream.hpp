@@ -0,0 +1,136 @@
+#ifndef __CPU_STREAM_HPP__
+#define __CPU_STREAM_HPP__
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "../utils/thread_pool.hpp"
+
+namespace mlfe {
+
+/*
+ * A point in a stream, complete when the work enqueued before it has run.
+ * A default constructed event is complete.
+ * Copies refer to the same point.
+ */
+class CPUEvent {
+public:
+    CPUEvent();
+    
+    /*
+     * true when the event is complete.
+     */
+    bool Query() const;
+    
+    /*
+     * waits for the event, and rethrows the first exception of the work before it.
+     */
+    void Synchronize() const;
+    
+    /*
+     * runs callback once the event is complete, on the thread completing it,
+     * or right away on the calling thread when it already is.
+     */
+    void Then(std::function<void ()> callback) const;
+
+private:
+    friend class CPUStream;
+    
+    struct State {
+        std::mutex m;
+        std::condition_variable cv;
+        bool done;
+        std::exception_ptr error;
+        std::vector<std::function<void ()>> callbacks;
+        ThreadPool *pool;
+    };
+    
+    static void Complete(const std::shared_ptr<State> &state, std::exception_ptr error);
+    
+    std::shared_ptr<State> state;
+};/* class CPUEvent */
+
+/*
+ * Work that runs in the order it is enqueued, asynchronously to the caller.
+ * Streams run on the shared pool concurrently with each other,
+ * Record marks a point of a stream, and Wait makes a stream hold its later work
+ * until a point of another stream is reached, without blocking a pool thread.
+ *
+ * After a task throws, the later tasks of the stream are skipped,
+ * and the exception is rethrown by every Synchronize and by the events recorded after it,
+ * until ResetError is called.
+ * The destructor waits for the enqueued work.
+ */
+class CPUStream {
+public:
+    /*
+     * nullptr runs on the shared pool of mlfe/utils/parallel.hpp.
+     */
+    explicit CPUStream(ThreadPool *pool = nullptr);
+    
+    ~CPUStream();
+    
+    CPUStream(const CPUStream &) = delete;
+    
+    CPUStream &operator=(const CPUStream &) = delete;
+    
+    void Enqueue(std::function<void ()> task);
+    
+    /*
+     * an event that completes after the work enqueued so far.
+     */
+    CPUEvent Record();
+    
+    /*
+     * the work enqueued after this waits for event.
+     */
+    void Wait(const CPUEvent &event);
+    
+    /*
+     * waits for all enqueued work, and rethrows the first exception of it.
+     * the exception stays, so every later call rethrows it as well.
+     */
+    void Synchronize();
+    
+    /*
+     * forgets the exception, so the work enqueued after this runs again.
+     * the work skipped before is not run.
+     */
+    void ResetError();
+    
+    /*
+     * true when all enqueued work has run.
+     */
+    bool Query();
+
+private:
+    struct Item {
+        std::function<void ()> task;
+        std::shared_ptr<CPUEvent::State> record;
+        std::shared_ptr<CPUEvent::State> wait;
+    };
+    
+    struct State {
+        std::mutex m;
+        std::condition_variable idle_cv;
+        std::deque<Item> items;
+        bool running;
+        std::exception_ptr error;
+        ThreadPool *pool;
+    };
+    
+    static void Push(const std::shared_ptr<State> &state, Item item);
+    
+    /*
+     * runs the items until the queue is empty, or the first item waits for an event.
+     */
+    static void Drain(const std::shared_ptr<State> &state);
+    
+    std::shared_ptr<State> state;
+};/* class CPUStream */
+
+} /* namespace mlfe */
+#endif /*__CPU_STREAM_HPP__*/
@@ -9,7 +9,7 @@ namespace mlfe {
 cublasHandle_t CUDAContext::handler = nullptr;
 int CUDAContext::static_shared_counter = 0;
 
-CUDAContext::CUDAContext() {
+CUDAContext::CUDAContext() : ptr_(nullptr), size_(0) {
   if (handler == nullptr) {
     if (cublasCreate(&handler) != cudaSuccess) {
       throw std::string("CUDAContext::CUDAContext() : can not create handler.");
@@ -19,6 +19,7 @@ CUDAContext::CUDAContext() {
 }
 CUDAContext::~CUDAContext() {
   Clear();
+  --static_shared_counter;
 }
 
 void * CUDAContext::GetDevicePtr() const {
@@ -29,14 +30,18 @@ cublasHandle_t CUDAContext::GetHandler() {
   return handler;
 }
 
+/*
+ * frees the memory allocated by this context, a shared memory is only released.
+ */
 void CUDAContext::Clear() {
-  --static_shared_counter;
-  if (static_shared_counter == 0) {
+  if (ptr_ != nullptr && owner_ == nullptr) {
     if (cudaFree(ptr_) != cudaSuccess) {
       throw std::string("CUDAContext::Clear() : cuda free memory failed.");
     }
-    ptr_ = nullptr;
   }
+  size_ = 0;
+  ptr_ = nullptr;
+  owner_ = nullptr;
 }
 
 int CUDAContext::Size() const {
@@ -47,12 +52,27 @@ void CUDAContext::Allocator(
                             const unsigned int size,
                             const unsigned int block_size
                             ){
+  Clear();
   size_ = size * block_size;
   if (cudaMalloc((void**)&ptr_, size_) != cudaSuccess) {
   throw std::string("CUDAContext::Allocator() : device memory allocation failed.");
   }
 }
 
+void CUDAContext::Sharer(
+                          const std::shared_ptr<Context> &base,
+                          const unsigned int offset,
+                          const unsigned int size
+                          ){
+  if (offset + size > base->Size()) {
+  throw std::string("Shared size is bigger than allocated device memory.");
+  }
+  Clear();
+  size_ = size;
+  ptr_ = static_cast<void *>(static_cast<char *>(base->GetDevicePtr()) + offset);
+  owner_ = base;
+}
+
 void CUDAContext::CopyTo(
                           const unsigned int offset,
                           const unsigned int size,
@@ -40,6 +40,12 @@ protected:
                   const unsigned int block_size
                   ) override;
 
+	void Sharer(
+              const std::shared_ptr<Context> &base,
+              const unsigned int offset,
+              const unsigned int size
+              ) override;
+
 	void CopyTo(
               const unsigned int offset,
               const unsigned int size,
@@ -57,6 +63,7 @@ protected:
 private:
 	void *ptr_;
 	int size_;
+	std::shared_ptr<Context> owner_;
 	static int static_shared_counter;
 	static cublasHandle_t handler;
 };/* class CUDAContext */
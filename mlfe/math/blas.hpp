@@ -3,6 +3,45 @@
 
 namespace mlfe{ namespace math{
 
+/*
+ * element-wise work done on the output of gemm while it is still in cache,
+ * c = scale * act(alpha * op(a) * op(b) + beta * c + row_bias + col_bias + residual).
+ * row_bias{m} is added along each row, col_bias{n} along each column,
+ * and residual{m, n} element-wise. act is relu when relu is true.
+ * null pointers, relu = false and scale = 1 are skipped.
+ */
+template <class DataType>
+struct GemmEpilogue{
+    GemmEpilogue() : row_bias(nullptr), col_bias(nullptr), residual(nullptr),
+    relu(false), scale(DataType(1)){}
+    
+    bool IsEmpty() const{
+        return row_bias == nullptr && col_bias == nullptr &&
+        residual == nullptr && !relu && scale == DataType(1);
+    }
+    
+    const DataType *row_bias;
+    const DataType *col_bias;
+    const DataType *residual;
+    bool relu;
+    DataType scale;
+};
+
+template<class DataType, class DeviceContext>
+void gemm(
+          const bool trans_a, const bool trans_b,
+          const int m, const int n, const int k,
+          const DataType alpha,
+          const DataType *a, const int lda,
+          const DataType *b, const int ldb,
+          const DataType beta,
+          DataType *c, const int ldc,
+          DeviceContext *context
+          );
+
+/*
+ * gemm followed by the epilogue, so the output is written only once.
+ */
 template<class DataType, class DeviceContext>
 void gemm(
           const bool trans_a, const bool trans_b,
@@ -12,6 +51,7 @@ void gemm(
           const DataType *b, const int ldb,
           const DataType beta,
           DataType *c, const int ldc,
+          const GemmEpilogue<DataType> &epilogue,
           DeviceContext *context
           );
 
@@ -34,6 +74,28 @@ void rowwise_max(
                  DataType *b_ptr
                  );
     
+/*
+ * b{m} = beta * b + sum of each row of a{m, n}.
+ */
+template <class DataType, class DeviceContext>
+void rowwise_sum(
+                 const int m, const int n,
+                 const DataType *a_ptr,
+                 const DataType beta,
+                 DataType *b_ptr
+                 );
+    
+/*
+ * b{n} = beta * b + sum of each column of a{m, n}.
+ */
+template <class DataType, class DeviceContext>
+void colwise_sum(
+                 const int m, const int n,
+                 const DataType *a_ptr,
+                 const DataType beta,
+                 DataType *b_ptr
+                 );
+    
 template <class DataType, class DeviceContext>
 void rowwise_normalize(
                        const int m, const int n,
@@ -57,6 +119,29 @@ void cross_entropy_gradients(
                              DataType *dx_ptr
                              );
     
+/*
+ * loss{m} = -log(prob) at the label index of each row.
+ * label{m} holds class indices, the rest of prob is not read.
+ */
+template <class DataType, class LabelType, class DeviceContext>
+void sparse_cross_entropy(
+                          const int m, const int n,
+                          const DataType *prob_ptr,
+                          const LabelType *label_ptr,
+                          DataType *loss_ptr
+                          );
+    
+/*
+ * dx{m, n} = prob, with 1 subtracted at the label index of each row.
+ */
+template <class DataType, class LabelType, class DeviceContext>
+void sparse_cross_entropy_gradients(
+                                    const int m, const int n,
+                                    const DataType *prob_ptr,
+                                    const LabelType *label_ptr,
+                                    DataType *dx_ptr
+                                    );
+    
 template<class DataType, class DeviceContext>
 void exp(
          const int size,
@@ -1,9 +1,87 @@
+#include <algorithm>
+#include <string>
 #include <Eigen/Dense>
 #include "blas.hpp"
 #include "../device_context/cpu_context.hpp"
+#include "../utils/parallel.hpp"
 
 namespace mlfe{ namespace math{
 
+template <class DataType, class Panel>
+void gemm_epilogue_panel(const int row_from, const int n,
+                         const GemmEpilogue<DataType> &epilogue,
+                         Panel &c_panel
+                         ){
+    using Array = Eigen::Array<DataType, Eigen::Dynamic, 1>;
+    for(int i = 0; i < c_panel.cols(); ++i){
+        const int row = row_from + i;
+        auto c_row = c_panel.col(i).array();
+        if(epilogue.row_bias != nullptr){
+            c_row += epilogue.row_bias[row];
+        }
+        if(epilogue.col_bias != nullptr){
+            c_row += Eigen::Map<const Array>(epilogue.col_bias, n);
+        }
+        if(epilogue.residual != nullptr){
+            c_row += Eigen::Map<const Array>(epilogue.residual + row * n, n);
+        }
+        if(epilogue.relu){
+            c_row = c_row.max(DataType(0));
+        }
+        if(epilogue.scale != DataType(1)){
+            c_row *= epilogue.scale;
+        }
+    }
+}
+
+/*
+ * c is row major {m, n}, which eigen sees as column major {n, m},
+ * so c = a * b is computed as c^T = b^T * a^T.
+ * the product is one gemm over all of c, which packs b once,
+ * and the epilogue then runs over chunks of rows, each in a single pass.
+ */
+template <class DataType>
+void gemm_impl(const bool trans_a, const bool trans_b,
+               const int m, const int n, const int k,
+               const DataType alpha,
+               const DataType *a_ptr,
+               const DataType *b_ptr,
+               const DataType beta,
+               DataType *c_ptr,
+               const GemmEpilogue<DataType> *epilogue
+               ){
+    using Matrix = Eigen::Matrix<DataType, Eigen::Dynamic, Eigen::Dynamic>;
+    Eigen::Map<Matrix> c(c_ptr, n, m);
+    if(beta == DataType(0)){
+        c.setZero();
+    }
+    else{
+        c *= beta;
+    }
+    if(!trans_a && !trans_b){
+        c.noalias() += alpha * (Eigen::Map<const Matrix>(b_ptr, n, k) *
+                                Eigen::Map<const Matrix>(a_ptr, k, m));
+    }
+    else if(trans_a && !trans_b){
+        c.noalias() += alpha * (Eigen::Map<const Matrix>(b_ptr, n, k) *
+                                Eigen::Map<const Matrix>(a_ptr, m, k).transpose());
+    }
+    else if(!trans_a && trans_b){
+        c.noalias() += alpha * (Eigen::Map<const Matrix>(b_ptr, k, n).transpose() *
+                                Eigen::Map<const Matrix>(a_ptr, k, m));
+    }
+    else{
+        c.noalias() += alpha * (Eigen::Map<const Matrix>(b_ptr, k, n).transpose() *
+                                Eigen::Map<const Matrix>(a_ptr, m, k).transpose());
+    }
+    if(epilogue != nullptr && !epilogue->IsEmpty()){
+        parallel_for(0, m, parallel_grain_of(n), [&](int from, int to){
+            auto c_panel = c.middleCols(from, to - from);
+            gemm_epilogue_panel<DataType>(from, n, *epilogue, c_panel);
+        });
+    }
+}
+
 template<>
 void gemm<float, CPUContext>(
                              const bool trans_a,
@@ -21,33 +99,7 @@ void gemm<float, CPUContext>(
                              const int ldc,
                              CPUContext *context
                              ){
-    Eigen::Map<Eigen::MatrixXf> c(c_ptr, n, m);
-    if(beta == 0.f){
-        c.setZero();
-    }
-    else{
-        c *= beta;
-    }
-    if(!trans_a && !trans_b){
-        c.noalias() += alpha * (
-                                 Eigen::Map<const Eigen::MatrixXf>(b_ptr, n, k) *
-                                 Eigen::Map<const Eigen::MatrixXf>(a_ptr, k, m));
-    }
-    else if(trans_a && !trans_b){
-        c.noalias() += alpha * (
-                                 Eigen::Map<const Eigen::MatrixXf>(b_ptr, n, k) *
-                                 Eigen::Map<const Eigen::MatrixXf>(a_ptr, m, k).transpose());
-    }
-    else if(!trans_a && trans_b){
-        c.noalias() += alpha * (
-                                 Eigen::Map<const Eigen::MatrixXf>(b_ptr, k, n).transpose() *
-                                 Eigen::Map<const Eigen::MatrixXf>(a_ptr, k, m));
-    }
-    else{
-        c.noalias() += alpha * (
-                                 Eigen::Map<const Eigen::MatrixXf>(b_ptr, k, n).transpose() *
-                                 Eigen::Map<const Eigen::MatrixXf>(a_ptr, m, k).transpose());
-    }
+    gemm_impl<float>(trans_a, trans_b, m, n, k, alpha, a_ptr, b_ptr, beta, c_ptr, nullptr);
 }
 
 template<>
@@ -67,33 +119,49 @@ void gemm<double, CPUContext>(
                               const int ldc,
                               CPUContext *context
                               ){
-    Eigen::Map<Eigen::MatrixXd> c(c_ptr, n, m);
-    if(beta == 0.){
-        c.setZero();
-    }
-    else{
-        c *= beta;
-    }
-    if(!trans_a && !trans_b){
-        c.noalias() += alpha * (
-                                Eigen::Map<const Eigen::MatrixXd>(b_ptr, n, k) *
-                                Eigen::Map<const Eigen::MatrixXd>(a_ptr, k, m));
-    }
-    else if(trans_a && !trans_b){
-        c.noalias() += alpha * (
-                                Eigen::Map<const Eigen::MatrixXd>(b_ptr, n, k) *
-                                Eigen::Map<const Eigen::MatrixXd>(a_ptr, m, k).transpose());
-    }
-    else if(!trans_a && trans_b){
-        c.noalias() += alpha * (
-                                Eigen::Map<const Eigen::MatrixXd>(b_ptr, k, n).transpose() *
-                                Eigen::Map<const Eigen::MatrixXd>(a_ptr, k, m));
-    }
-    else{
-        c.noalias() += alpha * (
-                                Eigen::Map<const Eigen::MatrixXd>(b_ptr, k, n).transpose() *
-                                Eigen::Map<const Eigen::MatrixXd>(a_ptr, m, k).transpose());
-    }
+    gemm_impl<double>(trans_a, trans_b, m, n, k, alpha, a_ptr, b_ptr, beta, c_ptr, nullptr);
+}
+
+template<>
+void gemm<float, CPUContext>(
+                             const bool trans_a,
+                             const bool trans_b,
+                             const int m,
+                             const int n,
+                             const int k,
+                             const float alpha,
+                             const float *a_ptr,
+                             const int lda,
+                             const float *b_ptr,
+                             const int ldb,
+                             const float beta,
+                             float *c_ptr,
+                             const int ldc,
+                             const GemmEpilogue<float> &epilogue,
+                             CPUContext *context
+                             ){
+    gemm_impl<float>(trans_a, trans_b, m, n, k, alpha, a_ptr, b_ptr, beta, c_ptr, &epilogue);
+}
+
+template<>
+void gemm<double, CPUContext>(
+                              const bool trans_a,
+                              const bool trans_b,
+                              const int m,
+                              const int n,
+                              const int k,
+                              const double alpha,
+                              const double *a_ptr,
+                              const int lda,
+                              const double *b_ptr,
+                              const int ldb,
+                              const double beta,
+                              double *c_ptr,
+                              const int ldc,
+                              const GemmEpilogue<double> &epilogue,
+                              CPUContext *context
+                              ){
+    gemm_impl<double>(trans_a, trans_b, m, n, k, alpha, a_ptr, b_ptr, beta, c_ptr, &epilogue);
 }
 
 template <>
@@ -272,6 +340,121 @@ void cross_entropy_gradients<double, CPUContext>(
     }
 }
 
+template <class DataType, class LabelType>
+void sparse_cross_entropy_impl(
+                               const int m, const int n,
+                               const DataType *prob_ptr,
+                               const LabelType *label_ptr,
+                               DataType *loss_ptr
+                               ){
+    for(int i = 0; i < m; ++i){
+        const int label = static_cast<int>(label_ptr[i]);
+        if(label < 0 || label >= n){
+            throw std::string("sparse_cross_entropy() : label is out of the classes.");
+        }
+        loss_ptr[i] = -std::log(std::max(prob_ptr[i * n + label], DataType(1e-20)));
+    }
+}
+
+template <class DataType, class LabelType>
+void sparse_cross_entropy_gradients_impl(
+                                         const int m, const int n,
+                                         const DataType *prob_ptr,
+                                         const LabelType *label_ptr,
+                                         DataType *dx_ptr
+                                         ){
+    if(dx_ptr != prob_ptr){
+        std::copy(prob_ptr, prob_ptr + m * n, dx_ptr);
+    }
+    for(int i = 0; i < m; ++i){
+        const int label = static_cast<int>(label_ptr[i]);
+        if(label < 0 || label >= n){
+            throw std::string("sparse_cross_entropy_gradients() : label is out of the classes.");
+        }
+        dx_ptr[i * n + label] -= DataType(1);
+    }
+}
+
+template <>
+void sparse_cross_entropy<float, unsigned char, CPUContext>(
+                                                            const int m, const int n,
+                                                            const float *prob_ptr,
+                                                            const unsigned char *label_ptr,
+                                                            float *loss_ptr
+                                                            ){
+    sparse_cross_entropy_impl<float, unsigned char>(m, n, prob_ptr, label_ptr, loss_ptr);
+}
+
+template <>
+void sparse_cross_entropy_gradients<float, unsigned char, CPUContext>(
+                                                                      const int m, const int n,
+                                                                      const float *prob_ptr,
+                                                                      const unsigned char *label_ptr,
+                                                                      float *dx_ptr
+                                                                      ){
+    sparse_cross_entropy_gradients_impl<float, unsigned char>(m, n, prob_ptr, label_ptr, dx_ptr);
+}
+
+template <>
+void sparse_cross_entropy<float, int, CPUContext>(
+                                                  const int m, const int n,
+                                                  const float *prob_ptr,
+                                                  const int *label_ptr,
+                                                  float *loss_ptr
+                                                  ){
+    sparse_cross_entropy_impl<float, int>(m, n, prob_ptr, label_ptr, loss_ptr);
+}
+
+template <>
+void sparse_cross_entropy_gradients<float, int, CPUContext>(
+                                                            const int m, const int n,
+                                                            const float *prob_ptr,
+                                                            const int *label_ptr,
+                                                            float *dx_ptr
+                                                            ){
+    sparse_cross_entropy_gradients_impl<float, int>(m, n, prob_ptr, label_ptr, dx_ptr);
+}
+
+template <>
+void sparse_cross_entropy<double, unsigned char, CPUContext>(
+                                                             const int m, const int n,
+                                                             const double *prob_ptr,
+                                                             const unsigned char *label_ptr,
+                                                             double *loss_ptr
+                                                             ){
+    sparse_cross_entropy_impl<double, unsigned char>(m, n, prob_ptr, label_ptr, loss_ptr);
+}
+
+template <>
+void sparse_cross_entropy_gradients<double, unsigned char, CPUContext>(
+                                                                       const int m, const int n,
+                                                                       const double *prob_ptr,
+                                                                       const unsigned char *label_ptr,
+                                                                       double *dx_ptr
+                                                                       ){
+    sparse_cross_entropy_gradients_impl<double, unsigned char>(m, n, prob_ptr, label_ptr, dx_ptr);
+}
+
+template <>
+void sparse_cross_entropy<double, int, CPUContext>(
+                                                   const int m, const int n,
+                                                   const double *prob_ptr,
+                                                   const int *label_ptr,
+                                                   double *loss_ptr
+                                                   ){
+    sparse_cross_entropy_impl<double, int>(m, n, prob_ptr, label_ptr, loss_ptr);
+}
+
+template <>
+void sparse_cross_entropy_gradients<double, int, CPUContext>(
+                                                             const int m, const int n,
+                                                             const double *prob_ptr,
+                                                             const int *label_ptr,
+                                                             double *dx_ptr
+                                                             ){
+    sparse_cross_entropy_gradients_impl<double, int>(m, n, prob_ptr, label_ptr, dx_ptr);
+}
+
 template<>
 void exp<float, CPUContext>(
                             const int size,
@@ -332,12 +515,25 @@ void scal<double, CPUContext>(const int size,
     }
 }
 
+/*
+ * the sum is reduced by parallel_reduce, so it is the same for any thread count.
+ */
+template <class DataType>
+void sum_impl(const int size, const DataType *x_ptr, DataType *y_ptr){
+    using Vector = Eigen::Matrix<DataType, Eigen::Dynamic, 1>;
+    y_ptr[0] = parallel_reduce<DataType>(0, size, parallel_grain, DataType(0),
+                                         [x_ptr](int from, int to){
+                                             return Eigen::Map<const Vector>(x_ptr + from, to - from).sum();
+                                         },
+                                         [](DataType a, DataType b){ return a + b; });
+}
+
 template <>
 void sum<float, CPUContext>(
     const int size,
     const float *x_ptr,
     float *y_ptr) {
-    y_ptr[0] = Eigen::Map<const Eigen::VectorXf>(x_ptr, size).sum();
+    sum_impl<float>(size, x_ptr, y_ptr);
 }
 
 template <>
@@ -345,7 +541,85 @@ void sum<double, CPUContext>(
     const int size,
     const double *x_ptr,
     double *y_ptr) {
-    y_ptr[0] = Eigen::Map<const Eigen::VectorXd>(x_ptr, size).sum();
+    sum_impl<double>(size, x_ptr, y_ptr);
+}
+
+template <>
+void rowwise_sum<float, CPUContext>(
+                                    const int m, const int n,
+                                    const float *a_ptr,
+                                    const float beta,
+                                    float *b_ptr
+                                    ){
+    Eigen::Map<Eigen::VectorXf> b(b_ptr, m);
+    if(beta == 0){
+        b = Eigen::Map<const Eigen::MatrixXf>(a_ptr, n, m).colwise().sum().transpose();
+    }
+    else{
+        b = beta * b + Eigen::Map<const Eigen::MatrixXf>(a_ptr, n, m).colwise().sum().transpose();
+    }
+}
+
+template <>
+void rowwise_sum<double, CPUContext>(
+                                     const int m, const int n,
+                                     const double *a_ptr,
+                                     const double beta,
+                                     double *b_ptr
+                                     ){
+    Eigen::Map<Eigen::VectorXd> b(b_ptr, m);
+    if(beta == 0){
+        b = Eigen::Map<const Eigen::MatrixXd>(a_ptr, n, m).colwise().sum().transpose();
+    }
+    else{
+        b = beta * b + Eigen::Map<const Eigen::MatrixXd>(a_ptr, n, m).colwise().sum().transpose();
+    }
+}
+
+/*
+ * every chunk of rows makes a partial sum of the columns,
+ * and the partial sums are added in the order of the chunks.
+ */
+template <class DataType>
+void colwise_sum_impl(const int m, const int n,
+                      const DataType *a_ptr,
+                      const DataType beta,
+                      DataType *b_ptr
+                      ){
+    using Vector = Eigen::Matrix<DataType, Eigen::Dynamic, 1>;
+    using Matrix = Eigen::Matrix<DataType, Eigen::Dynamic, Eigen::Dynamic>;
+    const Vector sums = parallel_reduce<Vector>(0, m, parallel_grain_of(n), Vector::Zero(n),
+                                                [a_ptr, n](int from, int to){
+                                                    return Vector(Eigen::Map<const Matrix>(a_ptr + from * n, n, to - from).rowwise().sum());
+                                                },
+                                                [](Vector a, Vector b){ return Vector(a + b); });
+    Eigen::Map<Vector> b(b_ptr, n);
+    if(beta == 0){
+        b = sums;
+    }
+    else{
+        b = beta * b + sums;
+    }
+}
+
+template <>
+void colwise_sum<float, CPUContext>(
+                                    const int m, const int n,
+                                    const float *a_ptr,
+                                    const float beta,
+                                    float *b_ptr
+                                    ){
+    colwise_sum_impl<float>(m, n, a_ptr, beta, b_ptr);
+}
+
+template <>
+void colwise_sum<double, CPUContext>(
+                                     const int m, const int n,
+                                     const double *a_ptr,
+                                     const double beta,
+                                     double *b_ptr
+                                     ){
+    colwise_sum_impl<double>(m, n, a_ptr, beta, b_ptr);
 }
 
 } /* math */
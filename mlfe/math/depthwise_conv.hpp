@@ -0,0 +1,71 @@
+#ifndef __DEPTHWISE_CONV_HPP__
+#define __DEPTHWISE_CONV_HPP__
+
+namespace mlfe{ namespace math{
+
+/*
+ * depthwise convolution, which is a grouped convolution with group == channels.
+ * every input channel c makes multiplier output channels c * multiplier + m.
+ * x{N, C, H, W}, w{C * multiplier, kernel_h, kernel_w}, b{C * multiplier},
+ * y{N, C * multiplier, out_h, out_w}.
+ * when relu is true, y is clamped at zero while each output row is still in cache.
+ */
+template <class DataType, class DeviceContext>
+void depthwise_conv_nchw(const int batch, const int channels, const int multiplier,
+                         const int height, const int width,
+                         const int kernel_h, const int kernel_w,
+                         const int stride_h, const int stride_w,
+                         const int pad_h, const int pad_w,
+                         const bool relu,
+                         const DataType *x, const DataType *w, const DataType *b,
+                         DataType *y
+                         );
+
+/*
+ * gradient of depthwise_conv_nchw.
+ * dw, db and dx are accumulated, not cleared.
+ */
+template <class DataType, class DeviceContext>
+void depthwise_conv_nchw_gradient(const int batch, const int channels, const int multiplier,
+                                  const int height, const int width,
+                                  const int kernel_h, const int kernel_w,
+                                  const int stride_h, const int stride_w,
+                                  const int pad_h, const int pad_w,
+                                  const DataType *x, const DataType *w, const DataType *dy,
+                                  DataType *dw, DataType *db, DataType *dx
+                                  );
+
+/*
+ * NHWC version of depthwise_conv_nchw.
+ * x{N, H, W, C}, y{N, out_h, out_w, C * multiplier},
+ * and the weight is {kernel_h, kernel_w, C * multiplier},
+ * so that a kernel position is a contiguous vector over the channels.
+ */
+template <class DataType, class DeviceContext>
+void depthwise_conv_nhwc(const int batch, const int channels, const int multiplier,
+                         const int height, const int width,
+                         const int kernel_h, const int kernel_w,
+                         const int stride_h, const int stride_w,
+                         const int pad_h, const int pad_w,
+                         const bool relu,
+                         const DataType *x, const DataType *w, const DataType *b,
+                         DataType *y
+                         );
+
+/*
+ * gradient of depthwise_conv_nhwc.
+ * dw is {kernel_h, kernel_w, C * multiplier}, dw, db and dx are accumulated.
+ */
+template <class DataType, class DeviceContext>
+void depthwise_conv_nhwc_gradient(const int batch, const int channels, const int multiplier,
+                                  const int height, const int width,
+                                  const int kernel_h, const int kernel_w,
+                                  const int stride_h, const int stride_w,
+                                  const int pad_h, const int pad_w,
+                                  const DataType *x, const DataType *w, const DataType *dy,
+                                  DataType *dw, DataType *db, DataType *dx
+                                  );
+
+} /* namespace math */
+} /* namespace mlfe */
+#endif /* __DEPTHWISE_CONV_HPP__ */
@@ -0,0 +1,416 @@
+#include <Eigen/Core>
+#include "depthwise_conv.hpp"
+#include "transform.hpp"
+#include "../device_context/cpu_context.hpp"
+#include "../utils/parallel.hpp"
+
+namespace mlfe{ namespace math{
+
+/*
+ * forward of one input channel over the batch.
+ * every output row is accumulated from the valid part of the input rows,
+ * so the inner loop is a vectorized axpy along the width.
+ * channels never share any output, so the loop over channels can run in parallel.
+ */
+template <class DataType>
+void depthwise_nchw_channel(const int c, const int batch, const int channels, const int multiplier,
+                            const int height, const int width,
+                            const int kernel_h, const int kernel_w,
+                            const int stride_h, const int stride_w,
+                            const int pad_h, const int pad_w,
+                            const int out_h, const int out_w,
+                            const bool relu,
+                            const DataType *x, const DataType *w, const DataType *b,
+                            DataType *y
+                            ){
+    using Array = Eigen::Array<DataType, Eigen::Dynamic, 1>;
+    using StridedMap = Eigen::Map<const Array, 0, Eigen::InnerStride<>>;
+    const int filters = channels * multiplier;
+    for(int n = 0; n < batch; ++n){
+        const DataType *x_ptr = x + (n * channels + c) * height * width;
+        for(int m = 0; m < multiplier; ++m){
+            const int f = c * multiplier + m;
+            const DataType *w_ptr = w + f * kernel_h * kernel_w;
+            DataType *y_ptr = y + (n * filters + f) * out_h * out_w;
+            for(int oh = 0; oh < out_h; ++oh){
+                Eigen::Map<Array> y_row(y_ptr + oh * out_w, out_w);
+                y_row.setConstant(b[f]);
+                for(int kh = 0; kh < kernel_h; ++kh){
+                    const int ih = oh * stride_h - pad_h + kh;
+                    if(ih < 0 || ih >= height){
+                        continue;
+                    }
+                    for(int kw = 0; kw < kernel_w; ++kw){
+                        int lo, hi;
+                        valid_range(out_w, width, kw, stride_w, pad_w, lo, hi);
+                        if(lo >= hi){
+                            continue;
+                        }
+                        const DataType *from = x_ptr + ih * width + lo * stride_w - pad_w + kw;
+                        const DataType val = w_ptr[kh * kernel_w + kw];
+                        if(stride_w == 1){
+                            y_row.segment(lo, hi - lo) += val * Eigen::Map<const Array>(from, hi - lo);
+                        }
+                        else{
+                            y_row.segment(lo, hi - lo) += val *
+                            StridedMap(from, hi - lo, Eigen::InnerStride<>(stride_w));
+                        }
+                    }
+                }
+                if(relu){
+                    y_row = y_row.max(DataType(0));
+                }
+            }
+        }
+    }
+}
+
+/*
+ * gradient of one input channel over the batch.
+ * dw and db of the channel's filters and the channel's dx plane are
+ * only touched here, so channels can run in parallel without any reduction.
+ */
+template <class DataType>
+void depthwise_nchw_gradient_channel(const int c, const int batch, const int channels, const int multiplier,
+                                     const int height, const int width,
+                                     const int kernel_h, const int kernel_w,
+                                     const int stride_h, const int stride_w,
+                                     const int pad_h, const int pad_w,
+                                     const int out_h, const int out_w,
+                                     const DataType *x, const DataType *w, const DataType *dy,
+                                     DataType *dw, DataType *db, DataType *dx
+                                     ){
+    using Array = Eigen::Array<DataType, Eigen::Dynamic, 1>;
+    using StridedMap = Eigen::Map<const Array, 0, Eigen::InnerStride<>>;
+    using MutableStridedMap = Eigen::Map<Array, 0, Eigen::InnerStride<>>;
+    const int filters = channels * multiplier;
+    for(int n = 0; n < batch; ++n){
+        const DataType *x_ptr = x + (n * channels + c) * height * width;
+        DataType *dx_ptr = dx + (n * channels + c) * height * width;
+        for(int m = 0; m < multiplier; ++m){
+            const int f = c * multiplier + m;
+            const DataType *w_ptr = w + f * kernel_h * kernel_w;
+            DataType *dw_ptr = dw + f * kernel_h * kernel_w;
+            const DataType *dy_ptr = dy + (n * filters + f) * out_h * out_w;
+            db[f] += Eigen::Map<const Array>(dy_ptr, out_h * out_w).sum();
+            for(int oh = 0; oh < out_h; ++oh){
+                Eigen::Map<const Array> dy_row(dy_ptr + oh * out_w, out_w);
+                for(int kh = 0; kh < kernel_h; ++kh){
+                    const int ih = oh * stride_h - pad_h + kh;
+                    if(ih < 0 || ih >= height){
+                        continue;
+                    }
+                    for(int kw = 0; kw < kernel_w; ++kw){
+                        int lo, hi;
+                        valid_range(out_w, width, kw, stride_w, pad_w, lo, hi);
+                        if(lo >= hi){
+                            continue;
+                        }
+                        const int offset = ih * width + lo * stride_w - pad_w + kw;
+                        const DataType val = w_ptr[kh * kernel_w + kw];
+                        if(stride_w == 1){
+                            dw_ptr[kh * kernel_w + kw] += (dy_row.segment(lo, hi - lo) *
+                                                           Eigen::Map<const Array>(x_ptr + offset, hi - lo)).sum();
+                            Eigen::Map<Array>(dx_ptr + offset, hi - lo) += val * dy_row.segment(lo, hi - lo);
+                        }
+                        else{
+                            dw_ptr[kh * kernel_w + kw] += (dy_row.segment(lo, hi - lo) *
+                                                           StridedMap(x_ptr + offset, hi - lo,
+                                                                      Eigen::InnerStride<>(stride_w))).sum();
+                            MutableStridedMap(dx_ptr + offset, hi - lo,
+                                              Eigen::InnerStride<>(stride_w)) += val * dy_row.segment(lo, hi - lo);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <class DataType>
+void depthwise_conv_nchw_impl(const int batch, const int channels, const int multiplier,
+                              const int height, const int width,
+                              const int kernel_h, const int kernel_w,
+                              const int stride_h, const int stride_w,
+                              const int pad_h, const int pad_w,
+                              const bool relu,
+                              const DataType *x, const DataType *w, const DataType *b,
+                              DataType *y
+                              ){
+    const int out_h = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+    const int out_w = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+    const int channel_work = batch * multiplier * out_h * out_w * kernel_h * kernel_w;
+    parallel_for(0, channels, parallel_grain_of(channel_work), [=](int from, int to){
+        for(int c = from; c < to; ++c){
+            depthwise_nchw_channel<DataType>(c, batch, channels, multiplier, height, width,
+                                             kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+                                             out_h, out_w, relu, x, w, b, y);
+        }
+    });
+}
+
+template <class DataType>
+void depthwise_conv_nchw_gradient_impl(const int batch, const int channels, const int multiplier,
+                                       const int height, const int width,
+                                       const int kernel_h, const int kernel_w,
+                                       const int stride_h, const int stride_w,
+                                       const int pad_h, const int pad_w,
+                                       const DataType *x, const DataType *w, const DataType *dy,
+                                       DataType *dw, DataType *db, DataType *dx
+                                       ){
+    const int out_h = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+    const int out_w = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+    const int channel_work = batch * multiplier * out_h * out_w * kernel_h * kernel_w;
+    parallel_for(0, channels, parallel_grain_of(channel_work), [=](int from, int to){
+        for(int c = from; c < to; ++c){
+            depthwise_nchw_gradient_channel<DataType>(c, batch, channels, multiplier, height, width,
+                                                      kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+                                                      out_h, out_w, x, w, dy, dw, db, dx);
+        }
+    });
+}
+
+/*
+ * on NHWC, one output position is a vector over the channels,
+ * which is accumulated from the input vectors under the kernel.
+ */
+template <class DataType>
+void depthwise_conv_nhwc_impl(const int batch, const int channels, const int multiplier,
+                              const int height, const int width,
+                              const int kernel_h, const int kernel_w,
+                              const int stride_h, const int stride_w,
+                              const int pad_h, const int pad_w,
+                              const bool relu,
+                              const DataType *x, const DataType *w, const DataType *b,
+                              DataType *y
+                              ){
+    using Array = Eigen::Array<DataType, Eigen::Dynamic, 1>;
+    using Matrix = Eigen::Array<DataType, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    const int out_h = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+    const int out_w = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+    const int filters = channels * multiplier;
+    Eigen::Map<const Array> b_vec(b, filters);
+    /*
+     * the output rows of all images are independent.
+     */
+    const int row_work = out_w * filters * kernel_h * kernel_w;
+    parallel_for(0, batch * out_h, parallel_grain_of(row_work), [=](int row_from, int row_to){
+        for(int row = row_from; row < row_to; ++row){
+            const int n = row / out_h;
+            const int oh = row % out_h;
+            for(int ow = 0; ow < out_w; ++ow){
+                DataType *y_ptr = y + ((n * out_h + oh) * out_w + ow) * filters;
+                Eigen::Map<Array>(y_ptr, filters) = b_vec;
+                for(int kh = 0; kh < kernel_h; ++kh){
+                    const int ih = oh * stride_h - pad_h + kh;
+                    if(ih < 0 || ih >= height){
+                        continue;
+                    }
+                    for(int kw = 0; kw < kernel_w; ++kw){
+                        const int iw = ow * stride_w - pad_w + kw;
+                        if(iw < 0 || iw >= width){
+                            continue;
+                        }
+                        const DataType *x_ptr = x + ((n * height + ih) * width + iw) * channels;
+                        const DataType *w_ptr = w + (kh * kernel_w + kw) * filters;
+                        if(multiplier == 1){
+                            Eigen::Map<Array>(y_ptr, filters) +=
+                            Eigen::Map<const Array>(x_ptr, channels) * Eigen::Map<const Array>(w_ptr, filters);
+                        }
+                        else{
+                            Eigen::Map<Matrix>(y_ptr, channels, multiplier) +=
+                            Eigen::Map<const Matrix>(w_ptr, channels, multiplier) *
+                            Eigen::Map<const Array>(x_ptr, channels).replicate(1, multiplier);
+                        }
+                    }
+                }
+                if(relu){
+                    Eigen::Map<Array> y_vec(y_ptr, filters);
+                    y_vec = y_vec.max(DataType(0));
+                }
+            }
+        }
+    });
+}
+
+/*
+ * the channels are split into ranges, a range owns its part of every vector
+ * of dw, db and dx, so the ranges run in parallel without any reduction.
+ */
+template <class DataType>
+void depthwise_conv_nhwc_gradient_impl(const int batch, const int channels, const int multiplier,
+                                       const int height, const int width,
+                                       const int kernel_h, const int kernel_w,
+                                       const int stride_h, const int stride_w,
+                                       const int pad_h, const int pad_w,
+                                       const DataType *x, const DataType *w, const DataType *dy,
+                                       DataType *dw, DataType *db, DataType *dx
+                                       ){
+    using Array = Eigen::Array<DataType, Eigen::Dynamic, 1>;
+    using Matrix = Eigen::Array<DataType, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    const int out_h = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+    const int out_w = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+    const int filters = channels * multiplier;
+    const int channel_work = batch * multiplier * out_h * out_w * kernel_h * kernel_w;
+    parallel_for(0, channels, parallel_grain_of(channel_work), [=](int c_from, int c_to){
+        const int c_size = c_to - c_from;
+        const int f_from = c_from * multiplier;
+        const int f_size = c_size * multiplier;
+        Eigen::Map<Array> db_vec(db + f_from, f_size);
+        for(int n = 0; n < batch; ++n){
+            for(int oh = 0; oh < out_h; ++oh){
+                for(int ow = 0; ow < out_w; ++ow){
+                    const DataType *dy_ptr = dy + ((n * out_h + oh) * out_w + ow) * filters + f_from;
+                    db_vec += Eigen::Map<const Array>(dy_ptr, f_size);
+                    for(int kh = 0; kh < kernel_h; ++kh){
+                        const int ih = oh * stride_h - pad_h + kh;
+                        if(ih < 0 || ih >= height){
+                            continue;
+                        }
+                        for(int kw = 0; kw < kernel_w; ++kw){
+                            const int iw = ow * stride_w - pad_w + kw;
+                            if(iw < 0 || iw >= width){
+                                continue;
+                            }
+                            const int x_offset = ((n * height + ih) * width + iw) * channels + c_from;
+                            const int w_offset = (kh * kernel_w + kw) * filters + f_from;
+                            if(multiplier == 1){
+                                Eigen::Map<const Array> dy_vec(dy_ptr, f_size);
+                                Eigen::Map<Array>(dw + w_offset, f_size) +=
+                                dy_vec * Eigen::Map<const Array>(x + x_offset, c_size);
+                                Eigen::Map<Array>(dx + x_offset, c_size) +=
+                                dy_vec * Eigen::Map<const Array>(w + w_offset, f_size);
+                            }
+                            else{
+                                Eigen::Map<const Matrix> dy_mat(dy_ptr, c_size, multiplier);
+                                Eigen::Map<Matrix>(dw + w_offset, c_size, multiplier) +=
+                                dy_mat * Eigen::Map<const Array>(x + x_offset, c_size).replicate(1, multiplier);
+                                Eigen::Map<Array>(dx + x_offset, c_size) +=
+                                (dy_mat * Eigen::Map<const Matrix>(w + w_offset, c_size, multiplier)).rowwise().sum();
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+template <>
+void depthwise_conv_nchw<float, CPUContext>(const int batch, const int channels, const int multiplier,
+                                            const int height, const int width,
+                                            const int kernel_h, const int kernel_w,
+                                            const int stride_h, const int stride_w,
+                                            const int pad_h, const int pad_w,
+                                            const bool relu,
+                                            const float *x, const float *w, const float *b,
+                                            float *y
+                                            ){
+    depthwise_conv_nchw_impl<float>(batch, channels, multiplier, height, width,
+                                    kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+                                    relu, x, w, b, y);
+}
+
+template <>
+void depthwise_conv_nchw<double, CPUContext>(const int batch, const int channels, const int multiplier,
+                                             const int height, const int width,
+                                             const int kernel_h, const int kernel_w,
+                                             const int stride_h, const int stride_w,
+                                             const int pad_h, const int pad_w,
+                                             const bool relu,
+                                             const double *x, const double *w, const double *b,
+                                             double *y
+                                             ){
+    depthwise_conv_nchw_impl<double>(batch, channels, multiplier, height, width,
+                                     kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+                                     relu, x, w, b, y);
+}
+
+template <>
+void depthwise_conv_nchw_gradient<float, CPUContext>(const int batch, const int channels, const int multiplier,
+                                                     const int height, const int width,
+                                                     const int kernel_h, const int kernel_w,
+                                                     const int stride_h, const int stride_w,
+                                                     const int pad_h, const int pad_w,
+                                                     const float *x, const float *w, const float *dy,
+                                                     float *dw, float *db, float *dx
+                                                     ){
+    depthwise_conv_nchw_gradient_impl<float>(batch, channels, multiplier, height, width,
+                                             kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+                                             x, w, dy, dw, db, dx);
+}
+
+template <>
+void depthwise_conv_nchw_gradient<double, CPUContext>(const int batch, const int channels, const int multiplier,
+                                                      const int height, const int width,
+                                                      const int kernel_h, const int kernel_w,
+                                                      const int stride_h, const int stride_w,
+                                                      const int pad_h, const int pad_w,
+                                                      const double *x, const double *w, const double *dy,
+                                                      double *dw, double *db, double *dx
+                                                      ){
+    depthwise_conv_nchw_gradient_impl<double>(batch, channels, multiplier, height, width,
+                                              kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+                                              x, w, dy, dw, db, dx);
+}
+
+template <>
+void depthwise_conv_nhwc<float, CPUContext>(const int batch, const int channels, const int multiplier,
+                                            const int height, const int width,
+                                            const int kernel_h, const int kernel_w,
+                                            const int stride_h, const int stride_w,
+                                            const int pad_h, const int pad_w,
+                                            const bool relu,
+                                            const float *x, const float *w, const float *b,
+                                            float *y
+                                            ){
+    depthwise_conv_nhwc_impl<float>(batch, channels, multiplier, height, width,
+                                    kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+                                    relu, x, w, b, y);
+}
+
+template <>
+void depthwise_conv_nhwc<double, CPUContext>(const int batch, const int channels, const int multiplier,
+                                             const int height, const int width,
+                                             const int kernel_h, const int kernel_w,
+                                             const int stride_h, const int stride_w,
+                                             const int pad_h, const int pad_w,
+                                             const bool relu,
+                                             const double *x, const double *w, const double *b,
+                                             double *y
+                                             ){
+    depthwise_conv_nhwc_impl<double>(batch, channels, multiplier, height, width,
+                                     kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+                                     relu, x, w, b, y);
+}
+
+template <>
+void depthwise_conv_nhwc_gradient<float, CPUContext>(const int batch, const int channels, const int multiplier,
+                                                     const int height, const int width,
+                                                     const int kernel_h, const int kernel_w,
+                                                     const int stride_h, const int stride_w,
+                                                     const int pad_h, const int pad_w,
+                                                     const float *x, const float *w, const float *dy,
+                                                     float *dw, float *db, float *dx
+                                                     ){
+    depthwise_conv_nhwc_gradient_impl<float>(batch, channels, multiplier, height, width,
+                                             kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+                                             x, w, dy, dw, db, dx);
+}
+
+template <>
+void depthwise_conv_nhwc_gradient<double, CPUContext>(const int batch, const int channels, const int multiplier,
+                                                      const int height, const int width,
+                                                      const int kernel_h, const int kernel_w,
+                                                      const int stride_h, const int stride_w,
+                                                      const int pad_h, const int pad_w,
+                                                      const double *x, const double *w, const double *dy,
+                                                      double *dw, double *db, double *dx
+                                                      ){
+    depthwise_conv_nhwc_gradient_impl<double>(batch, channels, multiplier, height, width,
+                                              kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w,
+                                              x, w, dy, dw, db, dx);
+}
+
+} /* namespace math */
+} /* namespace mlfe */
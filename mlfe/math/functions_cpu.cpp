@@ -3,18 +3,35 @@
 #include <random>
 #include "functions.hpp"
 #include "../device_context/cpu_context.hpp"
+#include "../utils/parallel.hpp"
 
 namespace mlfe { namespace math {
 
+template <class DataType>
+void ReluFunction_impl(const int size, const DataType *x, DataType *y){
+    parallel_for(0, size, parallel_grain, [=](int from, int to){
+        for (int i = from; i < to; ++i) {
+            y[i] = x[i] > 0 ? x[i] : 0;
+        }
+    });
+}
+
+template <class DataType>
+void ReluGradientFunction_impl(const int size, const DataType *y, const DataType *dy, DataType *dx){
+    parallel_for(0, size, parallel_grain, [=](int from, int to){
+        for (int i = from; i < to; ++i) {
+            dx[i] = y[i] > 0 ? dy[i] : 0;
+        }
+    });
+}
+
 template <>
 void ReluFunction<float, CPUContext>(
                                      const int size,
                                      const float *x,
                                      float *y
                                      ){
-    for (int i = 0; i < size; ++i) {
-        y[i] = x[i] > 0 ? x[i] : 0;
-    }
+    ReluFunction_impl<float>(size, x, y);
 }
 
 template <>
@@ -23,9 +40,7 @@ void ReluFunction<double, CPUContext>(
     const double *x,
     double *y
     ) {
-    for (int i = 0; i < size; ++i) {
-        y[i] = x[i] > 0 ? x[i] : 0;
-    }
+    ReluFunction_impl<double>(size, x, y);
 }
 
 template <>
@@ -35,9 +50,7 @@ void ReluGradientFunction<float, CPUContext>(
                                              const float *dy,
                                              float *dx
                                              ){
-    for (int i = 0; i < size; ++i) {
-        dx[i] = y[i] > 0 ? dy[i] : 0;
-    }
+    ReluGradientFunction_impl<float>(size, y, dy, dx);
 }
 
 template <>
@@ -47,9 +60,7 @@ void ReluGradientFunction<double, CPUContext>(
     const double *dy,
     double *dx
     ) {
-    for (int i = 0; i < size; ++i) {
-        dx[i] = y[i] > 0 ? dy[i] : 0;
-    }
+    ReluGradientFunction_impl<double>(size, y, dy, dx);
 }
 
 unsigned int GetRandomSeed(){
@@ -0,0 +1,55 @@
+#ifndef __POOLING_HPP__
+#define __POOLING_HPP__
+#include <cstdint>
+
+namespace mlfe{ namespace math{
+
+/*
+ * max pooling without padding on planes of {height, width}.
+ * planes = N * C, out_h = (height - kernel_h) / stride_h + 1.
+ * idx holds the argmax as the offset inside of the window, kh * kernel_w + kw,
+ * so the window must not be larger than 256 elements.
+ * when relu is true, y is clamped at zero, which is the same as pooling relu(x),
+ * and idx is left as it is, so the gradient must mask dy by y > 0.
+ */
+template <class DataType, class DeviceContext>
+void max_pool_nchw(const int planes, const int height, const int width,
+                   const int kernel_h, const int kernel_w,
+                   const int stride_h, const int stride_w, const bool relu,
+                   const DataType *x, DataType *y, uint8_t *idx
+                   );
+
+/*
+ * scatters dy into dx through the window offsets of max_pool_nchw.
+ * dx is overwritten.
+ */
+template <class DataType, class DeviceContext>
+void max_pool_nchw_gradient(const int planes, const int height, const int width,
+                            const int kernel_h, const int kernel_w,
+                            const int stride_h, const int stride_w,
+                            const DataType *dy, const uint8_t *idx, DataType *dx
+                            );
+
+/*
+ * NHWC version of max_pool_nchw.
+ */
+template <class DataType, class DeviceContext>
+void max_pool_nhwc(const int batch, const int channels, const int height, const int width,
+                   const int kernel_h, const int kernel_w,
+                   const int stride_h, const int stride_w, const bool relu,
+                   const DataType *x, DataType *y, uint8_t *idx
+                   );
+
+/*
+ * NHWC version of max_pool_nchw_gradient.
+ */
+template <class DataType, class DeviceContext>
+void max_pool_nhwc_gradient(const int batch, const int channels, const int height, const int width,
+                            const int kernel_h, const int kernel_w,
+                            const int stride_h, const int stride_w,
+                            const DataType *dy, const uint8_t *idx, DataType *dx
+                            );
+
+} /* namespace math */
+} /* namespace mlfe */
+#endif /* __POOLING_HPP__ */
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include "pooling.hpp"
+#include "../device_context/cpu_context.hpp"
+#include "../utils/parallel.hpp"
+
+namespace mlfe{ namespace math{
+
+/*
+ * max pooling of one plane.
+ * a row of outputs starts from the first element of each window,
+ * and then every other window offset is compared over the whole row,
+ * which is a branchless select loop that the compiler vectorizes across columns.
+ * when the template arguments are not zero, the window and stride are
+ * compile time constants, and the offset loops are fully unrolled.
+ */
+template <class DataType, int KH, int KW, int SH, int SW>
+void max_pool_plane(const int width, const int out_h, const int out_w,
+                    const int kernel_h, const int kernel_w,
+                    const int stride_h, const int stride_w, const bool relu,
+                    const DataType *x, DataType *y, uint8_t *idx
+                    ){
+    const int kh_size = KH > 0 ? KH : kernel_h;
+    const int kw_size = KW > 0 ? KW : kernel_w;
+    const int sh = SH > 0 ? SH : stride_h;
+    const int sw = SW > 0 ? SW : stride_w;
+    for(int oh = 0; oh < out_h; ++oh){
+        const DataType *x_row = x + oh * sh * width;
+        DataType *y_row = y + oh * out_w;
+        uint8_t *idx_row = idx + oh * out_w;
+        for(int ow = 0; ow < out_w; ++ow){
+            y_row[ow] = x_row[ow * sw];
+            idx_row[ow] = 0;
+        }
+        for(int kh = 0; kh < kh_size; ++kh){
+            for(int kw = 0; kw < kw_size; ++kw){
+                if(kh == 0 && kw == 0){
+                    continue;
+                }
+                const DataType *from = x_row + kh * width + kw;
+                const uint8_t offset = static_cast<uint8_t>(kh * kw_size + kw);
+                for(int ow = 0; ow < out_w; ++ow){
+                    const DataType val = from[ow * sw];
+                    const bool greater = val > y_row[ow];
+                    y_row[ow] = greater ? val : y_row[ow];
+                    idx_row[ow] = greater ? offset : idx_row[ow];
+                }
+            }
+        }
+        if(relu){
+            for(int ow = 0; ow < out_w; ++ow){
+                y_row[ow] = y_row[ow] > DataType(0) ? y_row[ow] : DataType(0);
+            }
+        }
+    }
+}
+
+template <class DataType, int KW, int SH, int SW>
+void max_pool_plane_gradient(const int height, const int width,
+                             const int out_h, const int out_w,
+                             const int kernel_w,
+                             const int stride_h, const int stride_w,
+                             const DataType *dy, const uint8_t *idx, DataType *dx
+                             ){
+    const int kw_size = KW > 0 ? KW : kernel_w;
+    const int sh = SH > 0 ? SH : stride_h;
+    const int sw = SW > 0 ? SW : stride_w;
+    std::fill(dx, dx + height * width, DataType(0));
+    for(int oh = 0; oh < out_h; ++oh){
+        DataType *dx_row = dx + oh * sh * width;
+        for(int ow = 0; ow < out_w; ++ow){
+            const int offset = idx[oh * out_w + ow];
+            dx_row[(offset / kw_size) * width + ow * sw + offset % kw_size] += dy[oh * out_w + ow];
+        }
+    }
+}
+
+template <class DataType>
+void max_pool_nchw_impl(const int planes, const int height, const int width,
+                        const int kernel_h, const int kernel_w,
+                        const int stride_h, const int stride_w, const bool relu,
+                        const DataType *x, DataType *y, uint8_t *idx
+                        ){
+    const int out_h = (height - kernel_h) / stride_h + 1;
+    const int out_w = (width - kernel_w) / stride_w + 1;
+    auto plane = &max_pool_plane<DataType, 0, 0, 0, 0>;
+    if(kernel_h == 2 && kernel_w == 2 && stride_h == 2 && stride_w == 2){
+        plane = &max_pool_plane<DataType, 2, 2, 2, 2>;
+    }
+    else if(kernel_h == 3 && kernel_w == 3 && stride_h == 2 && stride_w == 2){
+        plane = &max_pool_plane<DataType, 3, 3, 2, 2>;
+    }
+    parallel_for(0, planes, parallel_grain_of(height * width), [=](int from, int to){
+        for(int p = from; p < to; ++p){
+            plane(width, out_h, out_w, kernel_h, kernel_w, stride_h, stride_w, relu,
+                  x + p * height * width, y + p * out_h * out_w, idx + p * out_h * out_w);
+        }
+    });
+}
+
+template <class DataType>
+void max_pool_nchw_gradient_impl(const int planes, const int height, const int width,
+                                 const int kernel_h, const int kernel_w,
+                                 const int stride_h, const int stride_w,
+                                 const DataType *dy, const uint8_t *idx, DataType *dx
+                                 ){
+    const int out_h = (height - kernel_h) / stride_h + 1;
+    const int out_w = (width - kernel_w) / stride_w + 1;
+    auto plane = &max_pool_plane_gradient<DataType, 0, 0, 0>;
+    if(kernel_w == 2 && stride_h == 2 && stride_w == 2){
+        plane = &max_pool_plane_gradient<DataType, 2, 2, 2>;
+    }
+    else if(kernel_w == 3 && stride_h == 2 && stride_w == 2){
+        plane = &max_pool_plane_gradient<DataType, 3, 2, 2>;
+    }
+    parallel_for(0, planes, parallel_grain_of(height * width), [=](int from, int to){
+        for(int p = from; p < to; ++p){
+            plane(height, width, out_h, out_w, kernel_w, stride_h, stride_w,
+                  dy + p * out_h * out_w, idx + p * out_h * out_w, dx + p * height * width);
+        }
+    });
+}
+
+/*
+ * on NHWC, an output pixel is a vector over the channels,
+ * so the select loop runs across the channels.
+ */
+template <class DataType>
+void max_pool_nhwc_impl(const int batch, const int channels, const int height, const int width,
+                        const int kernel_h, const int kernel_w,
+                        const int stride_h, const int stride_w, const bool relu,
+                        const DataType *x, DataType *y, uint8_t *idx
+                        ){
+    const int out_h = (height - kernel_h) / stride_h + 1;
+    const int out_w = (width - kernel_w) / stride_w + 1;
+    /*
+     * the output rows of all images are independent.
+     */
+    parallel_for(0, batch * out_h, parallel_grain_of(out_w * channels * kernel_h * kernel_w), [=](int row_from, int row_to){
+        for(int row = row_from; row < row_to; ++row){
+            const int n = row / out_h;
+            const int oh = row % out_h;
+            for(int ow = 0; ow < out_w; ++ow){
+                const DataType *x_pix = x + ((n * height + oh * stride_h) * width + ow * stride_w) * channels;
+                DataType *y_pix = y + ((n * out_h + oh) * out_w + ow) * channels;
+                uint8_t *idx_pix = idx + ((n * out_h + oh) * out_w + ow) * channels;
+                std::copy(x_pix, x_pix + channels, y_pix);
+                std::fill(idx_pix, idx_pix + channels, uint8_t(0));
+                for(int kh = 0; kh < kernel_h; ++kh){
+                    for(int kw = 0; kw < kernel_w; ++kw){
+                        if(kh == 0 && kw == 0){
+                            continue;
+                        }
+                        const DataType *from = x_pix + (kh * width + kw) * channels;
+                        const uint8_t offset = static_cast<uint8_t>(kh * kernel_w + kw);
+                        for(int c = 0; c < channels; ++c){
+                            const bool greater = from[c] > y_pix[c];
+                            y_pix[c] = greater ? from[c] : y_pix[c];
+                            idx_pix[c] = greater ? offset : idx_pix[c];
+                        }
+                    }
+                }
+                if(relu){
+                    for(int c = 0; c < channels; ++c){
+                        y_pix[c] = y_pix[c] > DataType(0) ? y_pix[c] : DataType(0);
+                    }
+                }
+            }
+        }
+    });
+}
+
+template <class DataType>
+void max_pool_nhwc_gradient_impl(const int batch, const int channels, const int height, const int width,
+                                 const int kernel_h, const int kernel_w,
+                                 const int stride_h, const int stride_w,
+                                 const DataType *dy, const uint8_t *idx, DataType *dx
+                                 ){
+    const int out_h = (height - kernel_h) / stride_h + 1;
+    const int out_w = (width - kernel_w) / stride_w + 1;
+    /*
+     * the windows of an image overlap, so the images are split over threads.
+     */
+    parallel_for(0, batch, parallel_grain_of(height * width * channels), [=](int from, int to){
+        std::fill(dx + from * height * width * channels, dx + to * height * width * channels, DataType(0));
+        for(int n = from; n < to; ++n){
+            for(int oh = 0; oh < out_h; ++oh){
+                for(int ow = 0; ow < out_w; ++ow){
+                    const int out_index = ((n * out_h + oh) * out_w + ow) * channels;
+                    DataType *dx_pix = dx + ((n * height + oh * stride_h) * width + ow * stride_w) * channels;
+                    for(int c = 0; c < channels; ++c){
+                        const int offset = idx[out_index + c];
+                        dx_pix[((offset / kernel_w) * width + offset % kernel_w) * channels + c] += dy[out_index + c];
+                    }
+                }
+            }
+        }
+    });
+}
+
+template <>
+void max_pool_nchw<float, CPUContext>(const int planes, const int height, const int width,
+                                      const int kernel_h, const int kernel_w,
+                                      const int stride_h, const int stride_w, const bool relu,
+                                      const float *x, float *y, uint8_t *idx
+                                      ){
+    max_pool_nchw_impl<float>(planes, height, width, kernel_h, kernel_w,
+                              stride_h, stride_w, relu, x, y, idx);
+}
+
+template <>
+void max_pool_nchw<double, CPUContext>(const int planes, const int height, const int width,
+                                       const int kernel_h, const int kernel_w,
+                                       const int stride_h, const int stride_w, const bool relu,
+                                       const double *x, double *y, uint8_t *idx
+                                       ){
+    max_pool_nchw_impl<double>(planes, height, width, kernel_h, kernel_w,
+                               stride_h, stride_w, relu, x, y, idx);
+}
+
+template <>
+void max_pool_nchw_gradient<float, CPUContext>(const int planes, const int height, const int width,
+                                               const int kernel_h, const int kernel_w,
+                                               const int stride_h, const int stride_w,
+                                               const float *dy, const uint8_t *idx, float *dx
+                                               ){
+    max_pool_nchw_gradient_impl<float>(planes, height, width, kernel_h, kernel_w,
+                                       stride_h, stride_w, dy, idx, dx);
+}
+
+template <>
+void max_pool_nchw_gradient<double, CPUContext>(const int planes, const int height, const int width,
+                                                const int kernel_h, const int kernel_w,
+                                                const int stride_h, const int stride_w,
+                                                const double *dy, const uint8_t *idx, double *dx
+                                                ){
+    max_pool_nchw_gradient_impl<double>(planes, height, width, kernel_h, kernel_w,
+                                        stride_h, stride_w, dy, idx, dx);
+}
+
+template <>
+void max_pool_nhwc<float, CPUContext>(const int batch, const int channels, const int height, const int width,
+                                      const int kernel_h, const int kernel_w,
+                                      const int stride_h, const int stride_w, const bool relu,
+                                      const float *x, float *y, uint8_t *idx
+                                      ){
+    max_pool_nhwc_impl<float>(batch, channels, height, width, kernel_h, kernel_w,
+                              stride_h, stride_w, relu, x, y, idx);
+}
+
+template <>
+void max_pool_nhwc<double, CPUContext>(const int batch, const int channels, const int height, const int width,
+                                       const int kernel_h, const int kernel_w,
+                                       const int stride_h, const int stride_w, const bool relu,
+                                       const double *x, double *y, uint8_t *idx
+                                       ){
+    max_pool_nhwc_impl<double>(batch, channels, height, width, kernel_h, kernel_w,
+                               stride_h, stride_w, relu, x, y, idx);
+}
+
+template <>
+void max_pool_nhwc_gradient<float, CPUContext>(const int batch, const int channels, const int height, const int width,
+                                               const int kernel_h, const int kernel_w,
+                                               const int stride_h, const int stride_w,
+                                               const float *dy, const uint8_t *idx, float *dx
+                                               ){
+    max_pool_nhwc_gradient_impl<float>(batch, channels, height, width, kernel_h, kernel_w,
+                                       stride_h, stride_w, dy, idx, dx);
+}
+
+template <>
+void max_pool_nhwc_gradient<double, CPUContext>(const int batch, const int channels, const int height, const int width,
+                                                const int kernel_h, const int kernel_w,
+                                                const int stride_h, const int stride_w,
+                                                const double *dy, const uint8_t *idx, double *dx
+                                                ){
+    max_pool_nhwc_gradient_impl<double>(batch, channels, height, width, kernel_h, kernel_w,
+                                        stride_h, stride_w, dy, idx, dx);
+}
+
+} /* namespace math */
+} /* namespace mlfe */
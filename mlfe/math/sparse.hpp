@@ -0,0 +1,68 @@
+#ifndef __MATH_SPARSE_HPP__
+#define __MATH_SPARSE_HPP__
+
+namespace mlfe{ namespace math{
+
+/*
+ * y{m, n} = x{m, k} * w{k, n} + b{n}, for the rows [row_from, row_to) of x and y.
+ * x is CSR, the row i of x has the column indices and values
+ * in [indptr[i], indptr[i + 1]) of indices and values.
+ * w is stored as {k, n}, so an active column of x reads one contiguous row of w.
+ * b may be null.
+ */
+template <class DataType, class DeviceContext>
+void csr_fc(const int row_from, const int row_to,
+            const int n, const int k,
+            const int *indptr, const int *indices, const DataType *values,
+            const DataType *w, const DataType *b,
+            DataType *y
+            );
+
+/*
+ * dw{k, n} += alpha * x{m, k}^T * dy{m, n}, for the columns [unit_from, unit_to) of dw.
+ * x is CSR like csr_fc, and only the rows of dw active in x are written.
+ */
+template <class DataType, class DeviceContext>
+void csr_fc_gradient_w(const int unit_from, const int unit_to,
+                       const int m, const int n, const int k,
+                       const int *indptr, const int *indices, const DataType *values,
+                       const DataType alpha, const DataType *dy,
+                       DataType *dw
+                       );
+
+/*
+ * BCSR w{n, k} is made of block_rows x block_cols blocks, and the block row r owns
+ * the blocks [indptr[r], indptr[r + 1]), indices holds the block column of each block,
+ * and values the elements of each block in row major order.
+ * the last block row and column are zero padded, when n and k are not multiples of the block.
+ */
+
+/*
+ * y{m, n} = x{m, k} * w{n, k}^T + b{n}, for the rows [row_from, row_to) of x and y.
+ * w is BCSR, b may be null. 1x4 and 4x4 blocks have vectorized kernels.
+ */
+template <class DataType, class DeviceContext>
+void bcsr_fc(const int row_from, const int row_to,
+             const int n, const int k,
+             const int block_rows, const int block_cols,
+             const int *indptr, const int *indices, const DataType *values,
+             const DataType *x, const DataType *b,
+             DataType *y
+             );
+
+/*
+ * y{n, p} = w{n, k} * x{k, p} + b{n} on every column, for the block rows [block_from, block_to) of w.
+ * w is BCSR, b may be null.
+ */
+template <class DataType, class DeviceContext>
+void bcsr_gemm(const int block_from, const int block_to,
+               const int n, const int k, const int p,
+               const int block_rows, const int block_cols,
+               const int *indptr, const int *indices, const DataType *values,
+               const DataType *x, const DataType *b,
+               DataType *y
+               );
+
+} /* namespace math */
+} /* namespace mlfe */
+#endif /* __MATH_SPARSE_HPP__ */
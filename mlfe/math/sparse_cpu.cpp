@@ -0,0 +1,254 @@
+#include <vector>
+#include <algorithm>
+#include <Eigen/Core>
+#include "sparse.hpp"
+#include "../device_context/cpu_context.hpp"
+
+namespace mlfe{ namespace math{
+
+/*
+ * every active column of a row scales the contiguous row of w into the row of y.
+ */
+template <class DataType>
+void csr_fc_impl(const int row_from, const int row_to,
+                 const int n, const int k,
+                 const int *indptr, const int *indices, const DataType *values,
+                 const DataType *w, const DataType *b,
+                 DataType *y
+                 ){
+    using Array = Eigen::Array<DataType, Eigen::Dynamic, 1>;
+    for(int i = row_from; i < row_to; ++i){
+        Eigen::Map<Array> y_row(y + i * n, n);
+        if(b != nullptr){
+            y_row = Eigen::Map<const Array>(b, n);
+        }
+        else{
+            y_row.setZero();
+        }
+        for(int p = indptr[i]; p < indptr[i + 1]; ++p){
+            y_row += values[p] * Eigen::Map<const Array>(w + indices[p] * n, n);
+        }
+    }
+}
+
+/*
+ * every active column of a row adds the scaled row of dy to its row of dw,
+ * over the units [unit_from, unit_to) only.
+ */
+template <class DataType>
+void csr_fc_gradient_w_impl(const int unit_from, const int unit_to,
+                            const int m, const int n, const int k,
+                            const int *indptr, const int *indices, const DataType *values,
+                            const DataType alpha, const DataType *dy,
+                            DataType *dw
+                            ){
+    using Array = Eigen::Array<DataType, Eigen::Dynamic, 1>;
+    const int units = unit_to - unit_from;
+    for(int i = 0; i < m; ++i){
+        Eigen::Map<const Array> dy_row(dy + i * n + unit_from, units);
+        for(int p = indptr[i]; p < indptr[i + 1]; ++p){
+            Eigen::Map<Array>(dw + indices[p] * n + unit_from, units) += (alpha * values[p]) * dy_row;
+        }
+    }
+}
+
+/*
+ * the block size is known at compile time,
+ * so a block times a slice of x is one fixed size product of eigen.
+ */
+template <class DataType, int BlockRows, int BlockCols>
+void bcsr_fc_fixed_impl(const int row_from, const int row_to,
+                        const int n, const int k,
+                        const int *indptr, const int *indices, const DataType *values,
+                        const DataType *x, const DataType *b,
+                        DataType *y
+                        ){
+    using Block = Eigen::Matrix<DataType, BlockRows, BlockCols, Eigen::RowMajor>;
+    using Slice = Eigen::Matrix<DataType, BlockCols, 1>;
+    using Acc = Eigen::Matrix<DataType, BlockRows, 1>;
+    const int block_n = (n + BlockRows - 1) / BlockRows;
+    const int padded_k = (k + BlockCols - 1) / BlockCols * BlockCols;
+    /*
+     * the last block column reads past a row of x, when k is not a multiple of the block.
+     */
+    std::vector<DataType> x_pad(padded_k == k ? 0 : padded_k, DataType(0));
+    for(int i = row_from; i < row_to; ++i){
+        const DataType *x_row = x + i * k;
+        if(padded_k != k){
+            std::copy(x_row, x_row + k, x_pad.begin());
+            x_row = x_pad.data();
+        }
+        DataType *y_row = y + i * n;
+        for(int r = 0; r < block_n; ++r){
+            Acc acc = Acc::Zero();
+            for(int q = indptr[r]; q < indptr[r + 1]; ++q){
+                acc.noalias() += Eigen::Map<const Block>(values + q * BlockRows * BlockCols) *
+                Eigen::Map<const Slice>(x_row + indices[q] * BlockCols);
+            }
+            const int rows = std::min(BlockRows, n - r * BlockRows);
+            for(int t = 0; t < rows; ++t){
+                y_row[r * BlockRows + t] = acc(t) + (b != nullptr ? b[r * BlockRows + t] : DataType(0));
+            }
+        }
+    }
+}
+
+template <class DataType>
+void bcsr_fc_impl(const int row_from, const int row_to,
+                  const int n, const int k,
+                  const int block_rows, const int block_cols,
+                  const int *indptr, const int *indices, const DataType *values,
+                  const DataType *x, const DataType *b,
+                  DataType *y
+                  ){
+    if(block_rows == 1 && block_cols == 4){
+        bcsr_fc_fixed_impl<DataType, 1, 4>(row_from, row_to, n, k, indptr, indices, values, x, b, y);
+        return;
+    }
+    if(block_rows == 4 && block_cols == 4){
+        bcsr_fc_fixed_impl<DataType, 4, 4>(row_from, row_to, n, k, indptr, indices, values, x, b, y);
+        return;
+    }
+    const int block_n = (n + block_rows - 1) / block_rows;
+    for(int i = row_from; i < row_to; ++i){
+        const DataType *x_row = x + i * k;
+        DataType *y_row = y + i * n;
+        for(int r = 0; r < block_n; ++r){
+            const int rows = std::min(block_rows, n - r * block_rows);
+            for(int t = 0; t < rows; ++t){
+                DataType acc = b != nullptr ? b[r * block_rows + t] : DataType(0);
+                for(int q = indptr[r]; q < indptr[r + 1]; ++q){
+                    const DataType *v = values + (q * block_rows + t) * block_cols;
+                    const int c0 = indices[q] * block_cols;
+                    const int cols = std::min(block_cols, k - c0);
+                    for(int c = 0; c < cols; ++c){
+                        acc += v[c] * x_row[c0 + c];
+                    }
+                }
+                y_row[r * block_rows + t] = acc;
+            }
+        }
+    }
+}
+
+/*
+ * every element of a block scales a whole row of x into a row of y,
+ * and those rows are vectorized.
+ */
+template <class DataType>
+void bcsr_gemm_impl(const int block_from, const int block_to,
+                    const int n, const int k, const int p,
+                    const int block_rows, const int block_cols,
+                    const int *indptr, const int *indices, const DataType *values,
+                    const DataType *x, const DataType *b,
+                    DataType *y
+                    ){
+    using Array = Eigen::Array<DataType, 1, Eigen::Dynamic>;
+    for(int r = block_from; r < block_to; ++r){
+        const int rows = std::min(block_rows, n - r * block_rows);
+        for(int t = 0; t < rows; ++t){
+            Eigen::Map<Array>(y + (r * block_rows + t) * p, p).setConstant(
+                b != nullptr ? b[r * block_rows + t] : DataType(0));
+        }
+        for(int q = indptr[r]; q < indptr[r + 1]; ++q){
+            const int c0 = indices[q] * block_cols;
+            const int cols = std::min(block_cols, k - c0);
+            for(int t = 0; t < rows; ++t){
+                const DataType *v = values + (q * block_rows + t) * block_cols;
+                Eigen::Map<Array> y_row(y + (r * block_rows + t) * p, p);
+                for(int c = 0; c < cols; ++c){
+                    if(v[c] != DataType(0)){
+                        y_row += v[c] * Eigen::Map<const Array>(x + (c0 + c) * p, p);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <>
+void csr_fc<float, CPUContext>(const int row_from, const int row_to,
+                               const int n, const int k,
+                               const int *indptr, const int *indices, const float *values,
+                               const float *w, const float *b,
+                               float *y
+                               ){
+    csr_fc_impl<float>(row_from, row_to, n, k, indptr, indices, values, w, b, y);
+}
+
+template <>
+void csr_fc<double, CPUContext>(const int row_from, const int row_to,
+                                const int n, const int k,
+                                const int *indptr, const int *indices, const double *values,
+                                const double *w, const double *b,
+                                double *y
+                                ){
+    csr_fc_impl<double>(row_from, row_to, n, k, indptr, indices, values, w, b, y);
+}
+
+template <>
+void csr_fc_gradient_w<float, CPUContext>(const int unit_from, const int unit_to,
+                                          const int m, const int n, const int k,
+                                          const int *indptr, const int *indices, const float *values,
+                                          const float alpha, const float *dy,
+                                          float *dw
+                                          ){
+    csr_fc_gradient_w_impl<float>(unit_from, unit_to, m, n, k, indptr, indices, values, alpha, dy, dw);
+}
+
+template <>
+void csr_fc_gradient_w<double, CPUContext>(const int unit_from, const int unit_to,
+                                           const int m, const int n, const int k,
+                                           const int *indptr, const int *indices, const double *values,
+                                           const double alpha, const double *dy,
+                                           double *dw
+                                           ){
+    csr_fc_gradient_w_impl<double>(unit_from, unit_to, m, n, k, indptr, indices, values, alpha, dy, dw);
+}
+
+template <>
+void bcsr_fc<float, CPUContext>(const int row_from, const int row_to,
+                                const int n, const int k,
+                                const int block_rows, const int block_cols,
+                                const int *indptr, const int *indices, const float *values,
+                                const float *x, const float *b,
+                                float *y
+                                ){
+    bcsr_fc_impl<float>(row_from, row_to, n, k, block_rows, block_cols, indptr, indices, values, x, b, y);
+}
+
+template <>
+void bcsr_fc<double, CPUContext>(const int row_from, const int row_to,
+                                 const int n, const int k,
+                                 const int block_rows, const int block_cols,
+                                 const int *indptr, const int *indices, const double *values,
+                                 const double *x, const double *b,
+                                 double *y
+                                 ){
+    bcsr_fc_impl<double>(row_from, row_to, n, k, block_rows, block_cols, indptr, indices, values, x, b, y);
+}
+
+template <>
+void bcsr_gemm<float, CPUContext>(const int block_from, const int block_to,
+                                  const int n, const int k, const int p,
+                                  const int block_rows, const int block_cols,
+                                  const int *indptr, const int *indices, const float *values,
+                                  const float *x, const float *b,
+                                  float *y
+                                  ){
+    bcsr_gemm_impl<float>(block_from, block_to, n, k, p, block_rows, block_cols, indptr, indices, values, x, b, y);
+}
+
+template <>
+void bcsr_gemm<double, CPUContext>(const int block_from, const int block_to,
+                                   const int n, const int k, const int p,
+                                   const int block_rows, const int block_cols,
+                                   const int *indptr, const int *indices, const double *values,
+                                   const double *x, const double *b,
+                                   double *y
+                                   ){
+    bcsr_gemm_impl<double>(block_from, block_to, n, k, p, block_rows, block_cols, indptr, indices, values, x, b, y);
+}
+
+} /* namespace math */
+} /* namespace mlfe */
@@ -1,155 +1,397 @@
+#include <algorithm>
+#include <cstring>
+#include <Eigen/Core>
 #include "transform.hpp"
 #include "../device_context/cpu_context.hpp"
+#include "../utils/parallel.hpp"
 
 namespace mlfe{ namespace math{
 
-template <>
-void im2col<float, CPUContext>(const int channel,
-                               const int height,
-                               const int width,
-                               const int kernel_h,
-                               const int kernel_w,
-                               const int stride,
-                               const int padding,
-                               const float *im_ptr,
-                               float *col_ptr
-                               ){
-    const int channels_col = channel * kernel_w * kernel_h;
-    const int out_height = (height + 2 * padding - kernel_h) / stride + 1;
-    const int out_width = (width + 2 * padding - kernel_w) / stride + 1;
-    
-    for (int c = 0; c < channels_col; ++c) {
-        int w_offset = c % kernel_w;
-        int h_offset = (c / kernel_w) % kernel_h;
-        int c_im = c / kernel_h / kernel_w;
-        for (int h = 0; h < out_height; ++h) {
-            for (int w = 0; w < out_width; ++w) {
-                int im_row = h_offset + h * stride;
-                int im_col = w_offset + w * stride;
-                int col_index = (c * out_height + h) * out_width + w;
-                im_row -= padding;
-                im_col -= padding;
-                if(im_row < 0 || im_col < 0 || im_row >= height || im_col >= width){
-                    col_ptr[col_index] = 0;
+/*
+ * im2col of one channel.
+ * every (kernel_h, kernel_w) offset makes one col row of out_h x out_w,
+ * which is filled row by row from the image.
+ * the zero padding is written only on the border part of the row,
+ * and the interior part is copied without bounds check.
+ */
+template <class DataType>
+void im2col_channel(const int height,
+                    const int width,
+                    const int kernel_h,
+                    const int kernel_w,
+                    const int stride_h,
+                    const int stride_w,
+                    const int pad_h,
+                    const int pad_w,
+                    const int out_h,
+                    const int out_w,
+                    const DataType *im_ptr,
+                    DataType *col_ptr
+                    ){
+    for (int kh = 0; kh < kernel_h; ++kh) {
+        int h_lo, h_hi;
+        valid_range(out_h, height, kh, stride_h, pad_h, h_lo, h_hi);
+        for (int kw = 0; kw < kernel_w; ++kw) {
+            int w_lo, w_hi;
+            valid_range(out_w, width, kw, stride_w, pad_w, w_lo, w_hi);
+            const int copy_w = w_hi - w_lo;
+            
+            std::fill(col_ptr, col_ptr + h_lo * out_w, DataType(0));
+            for (int h = h_lo; h < h_hi; ++h) {
+                const DataType *from = im_ptr +
+                    (h * stride_h - pad_h + kh) * width + w_lo * stride_w - pad_w + kw;
+                DataType *to = col_ptr + h * out_w;
+                std::fill(to, to + w_lo, DataType(0));
+                if(stride_w == 1){
+                    std::memcpy(to + w_lo, from, copy_w * sizeof(DataType));
                 }
                 else{
-                    col_ptr[col_index] = im_ptr[im_col + width * (im_row + height * c_im)];
+                    for (int w = 0; w < copy_w; ++w) {
+                        to[w_lo + w] = from[w * stride_w];
+                    }
                 }
+                std::fill(to + w_hi, to + out_w, DataType(0));
             }
+            std::fill(col_ptr + h_hi * out_w, col_ptr + out_h * out_w, DataType(0));
+            col_ptr += out_h * out_w;
         }
     }
 }
 
-template <>
-void im2col<double, CPUContext>(const int channel,
-                                const int height,
-                                const int width,
-                                const int kernel_h,
-                                const int kernel_w,
-                                const int stride,
-                                const int padding,
-                                const double *im_ptr,
-                                double *col_ptr
-                                ){
-    const int channels_col = channel * kernel_w * kernel_h;
-    const int out_height = (height + 2 * padding - kernel_h) / stride + 1;
-    const int out_width = (width + 2 * padding - kernel_w) / stride + 1;
-    
-    for (int c = 0; c < channels_col; ++c) {
-        int w_offset = c % kernel_w;
-        int h_offset = (c / kernel_w) % kernel_h;
-        int c_im = c / kernel_h / kernel_w;
-        for (int h = 0; h < out_height; ++h) {
-            for (int w = 0; w < out_width; ++w) {
-                int im_row = h_offset + h * stride;
-                int im_col = w_offset + w * stride;
-                int col_index = (c * out_height + h) * out_width + w;
-                im_row -= padding;
-                im_col -= padding;
-                if(im_row < 0 || im_col < 0 || im_row >= height || im_col >= width){
-                    col_ptr[col_index] = 0;
+/*
+ * col2im of one channel, the reverse of im2col_channel.
+ * padding parts of the col are skipped.
+ */
+template <class DataType>
+void col2im_channel(const int height,
+                    const int width,
+                    const int kernel_h,
+                    const int kernel_w,
+                    const int stride_h,
+                    const int stride_w,
+                    const int pad_h,
+                    const int pad_w,
+                    const int out_h,
+                    const int out_w,
+                    const DataType *col_ptr,
+                    DataType *im_ptr
+                    ){
+    using Vector = Eigen::Matrix<DataType, Eigen::Dynamic, 1>;
+    for (int kh = 0; kh < kernel_h; ++kh) {
+        int h_lo, h_hi;
+        valid_range(out_h, height, kh, stride_h, pad_h, h_lo, h_hi);
+        for (int kw = 0; kw < kernel_w; ++kw) {
+            int w_lo, w_hi;
+            valid_range(out_w, width, kw, stride_w, pad_w, w_lo, w_hi);
+            const int copy_w = w_hi - w_lo;
+            
+            for (int h = h_lo; h < h_hi && copy_w > 0; ++h) {
+                const DataType *from = col_ptr + h * out_w + w_lo;
+                DataType *to = im_ptr +
+                    (h * stride_h - pad_h + kh) * width + w_lo * stride_w - pad_w + kw;
+                if(stride_w == 1){
+                    Eigen::Map<Vector>(to, copy_w) += Eigen::Map<const Vector>(from, copy_w);
                 }
                 else{
-                    col_ptr[col_index] = im_ptr[im_col + width * (im_row + height * c_im)];
+                    for (int w = 0; w < copy_w; ++w) {
+                        to[w * stride_w] += from[w];
+                    }
                 }
             }
+            col_ptr += out_h * out_w;
         }
     }
 }
 
 template <class DataType>
-void col2im_add_pixel(DataType *im, int height, int width, int channels,
-                      int row, int col, int channel, int pad, DataType val){
-    row -= pad;
-    col -= pad;
+void im2col_impl(const int channel,
+                 const int height,
+                 const int width,
+                 const int kernel_h,
+                 const int kernel_w,
+                 const int stride_h,
+                 const int stride_w,
+                 const int pad_h,
+                 const int pad_w,
+                 const DataType *im_ptr,
+                 DataType *col_ptr
+                 ){
+    const int out_h = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+    const int out_w = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+    const int im_size = height * width;
+    const int col_size = kernel_h * kernel_w * out_h * out_w;
     
-    if (row < 0 || col < 0 ||
-        row >= height || col >= width) return;
-    im[col + width*(row + height*channel)] += val;
+    parallel_for(0, channel, parallel_grain_of(col_size), [=](int from, int to){
+        for (int c = from; c < to; ++c) {
+            im2col_channel<DataType>(height, width, kernel_h, kernel_w,
+                                     stride_h, stride_w, pad_h, pad_w,
+                                     out_h, out_w,
+                                     im_ptr + c * im_size, col_ptr + c * col_size);
+        }
+    });
 }
 
-template <>
-void col2im<float, CPUContext>(float* data_col,
-                               int channels,
-                               int height,
-                               int width,
-                               int ksize,
-                               int stride,
-                               int pad,
-                               float* data_im
-                               ){
-    int c,h,w;
-    int height_col = (height + 2*pad - ksize) / stride + 1;
-    int width_col = (width + 2*pad - ksize) / stride + 1;
+template <class DataType>
+void col2im_impl(const DataType *data_col,
+                 const int channels,
+                 const int height,
+                 const int width,
+                 const int kernel_h,
+                 const int kernel_w,
+                 const int stride_h,
+                 const int stride_w,
+                 const int pad_h,
+                 const int pad_w,
+                 DataType *data_im
+                 ){
+    const int out_h = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+    const int out_w = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+    const int im_size = height * width;
+    const int col_size = kernel_h * kernel_w * out_h * out_w;
+    
+    /*
+     * each channel writes its own image plane only.
+     */
+    parallel_for(0, channels, parallel_grain_of(col_size), [=](int from, int to){
+        for (int c = from; c < to; ++c) {
+            col2im_channel<DataType>(height, width, kernel_h, kernel_w,
+                                     stride_h, stride_w, pad_h, pad_w,
+                                     out_h, out_w,
+                                     data_col + c * col_size, data_im + c * im_size);
+        }
+    });
+}
+
+template <class DataType>
+void im2col_nhwc_impl(const int channel,
+                      const int height,
+                      const int width,
+                      const int kernel_h,
+                      const int kernel_w,
+                      const int stride_h,
+                      const int stride_w,
+                      const int pad_h,
+                      const int pad_w,
+                      const DataType *im_ptr,
+                      DataType *col_ptr
+                      ){
+    const int out_height = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+    const int out_width = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+    
+    const int row_size = out_width * kernel_h * kernel_w * channel;
     
-    int channels_col = channels * ksize * ksize;
-    for (c = 0; c < channels_col; ++c) {
-        int w_offset = c % ksize;
-        int h_offset = (c / ksize) % ksize;
-        int c_im = c / ksize / ksize;
-        for (h = 0; h < height_col; ++h) {
-            for (w = 0; w < width_col; ++w) {
-                int im_row = h_offset + h * stride;
-                int im_col = w_offset + w * stride;
-                int col_index = (c * height_col + h) * width_col + w;
-                float val = data_col[col_index];
-                col2im_add_pixel<float>(data_im, height, width, channels,
-                                        im_row, im_col, c_im, pad, val);
+    /*
+     * every output row fills its own rows of col.
+     */
+    parallel_for(0, out_height, parallel_grain_of(row_size), [=](int from, int to){
+        DataType *col_row = col_ptr + from * row_size;
+        for (int h = from; h < to; ++h) {
+            for (int w = 0; w < out_width; ++w) {
+                for (int kh = 0; kh < kernel_h; ++kh) {
+                    const int im_row = h * stride_h - pad_h + kh;
+                    if(im_row < 0 || im_row >= height){
+                        std::fill(col_row, col_row + kernel_w * channel, DataType(0));
+                        col_row += kernel_w * channel;
+                        continue;
+                    }
+                    for (int kw = 0; kw < kernel_w; ++kw) {
+                        const int im_col = w * stride_w - pad_w + kw;
+                        if(im_col < 0 || im_col >= width){
+                            std::fill(col_row, col_row + channel, DataType(0));
+                        }
+                        else{
+                            const DataType *from_pix = im_ptr + (im_row * width + im_col) * channel;
+                            std::memcpy(col_row, from_pix, channel * sizeof(DataType));
+                        }
+                        col_row += channel;
+                    }
+                }
             }
         }
-    }
+    });
 }
 
-template <>
-void col2im<double, CPUContext>(double* data_col,
-                                int channels,
-                                int height,
-                                int width,
-                                int ksize,
-                                int stride,
-                                int pad,
-                                double* data_im
-                                ){
-    int c,h,w;
-    int height_col = (height + 2*pad - ksize) / stride + 1;
-    int width_col = (width + 2*pad - ksize) / stride + 1;
+template <class DataType>
+void col2im_nhwc_impl(const DataType *data_col,
+                      const int channels,
+                      const int height,
+                      const int width,
+                      const int kernel_h,
+                      const int kernel_w,
+                      const int stride_h,
+                      const int stride_w,
+                      const int pad_h,
+                      const int pad_w,
+                      DataType *data_im
+                      ){
+    using Vector = Eigen::Matrix<DataType, Eigen::Dynamic, 1>;
+    const int height_col = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+    const int width_col = (width + 2 * pad_w - kernel_w) / stride_w + 1;
     
-    int channels_col = channels * ksize * ksize;
-    for (c = 0; c < channels_col; ++c) {
-        int w_offset = c % ksize;
-        int h_offset = (c / ksize) % ksize;
-        int c_im = c / ksize / ksize;
-        for (h = 0; h < height_col; ++h) {
-            for (w = 0; w < width_col; ++w) {
-                int im_row = h_offset + h * stride;
-                int im_col = w_offset + w * stride;
-                int col_index = (c * height_col + h) * width_col + w;
-                float val = data_col[col_index];
-                col2im_add_pixel<double>(data_im, height, width, channels,
-                                         im_row, im_col, c_im, pad, val);
+    /*
+     * the windows overlap on the image, so the threads split the channels instead,
+     * and every thread adds its own slice of each pixel.
+     */
+    parallel_for(0, channels, parallel_grain_of(height_col * width_col * kernel_h * kernel_w),
+                 [=](int c_from, int c_to){
+        const int slice = c_to - c_from;
+        const DataType *col = data_col + c_from;
+        for (int h = 0; h < height_col; ++h) {
+            for (int w = 0; w < width_col; ++w) {
+                for (int kh = 0; kh < kernel_h; ++kh) {
+                    const int im_row = h * stride_h - pad_h + kh;
+                    if(im_row < 0 || im_row >= height){
+                        col += kernel_w * channels;
+                        continue;
+                    }
+                    for (int kw = 0; kw < kernel_w; ++kw) {
+                        const int im_col = w * stride_w - pad_w + kw;
+                        if(im_col >= 0 && im_col < width){
+                            DataType *to = data_im + (im_row * width + im_col) * channels + c_from;
+                            Eigen::Map<Vector>(to, slice) += Eigen::Map<const Vector>(col, slice);
+                        }
+                        col += channels;
+                    }
+                }
             }
         }
-    }
+    });
+}
+
+template <>
+void im2col<float, CPUContext>(const int channel,
+                               const int height,
+                               const int width,
+                               const int kernel_h,
+                               const int kernel_w,
+                               const int stride_h,
+                               const int stride_w,
+                               const int pad_h,
+                               const int pad_w,
+                               const float *im_ptr,
+                               float *col_ptr
+                               ){
+    im2col_impl<float>(channel, height, width, kernel_h, kernel_w,
+                       stride_h, stride_w, pad_h, pad_w, im_ptr, col_ptr);
+}
+
+template <>
+void im2col<double, CPUContext>(const int channel,
+                                const int height,
+                                const int width,
+                                const int kernel_h,
+                                const int kernel_w,
+                                const int stride_h,
+                                const int stride_w,
+                                const int pad_h,
+                                const int pad_w,
+                                const double *im_ptr,
+                                double *col_ptr
+                                ){
+    im2col_impl<double>(channel, height, width, kernel_h, kernel_w,
+                        stride_h, stride_w, pad_h, pad_w, im_ptr, col_ptr);
+}
+
+template <>
+void col2im<float, CPUContext>(const float *data_col,
+                               const int channels,
+                               const int height,
+                               const int width,
+                               const int kernel_h,
+                               const int kernel_w,
+                               const int stride_h,
+                               const int stride_w,
+                               const int pad_h,
+                               const int pad_w,
+                               float *data_im
+                               ){
+    col2im_impl<float>(data_col, channels, height, width, kernel_h, kernel_w,
+                       stride_h, stride_w, pad_h, pad_w, data_im);
+}
+
+template <>
+void col2im<double, CPUContext>(const double *data_col,
+                                const int channels,
+                                const int height,
+                                const int width,
+                                const int kernel_h,
+                                const int kernel_w,
+                                const int stride_h,
+                                const int stride_w,
+                                const int pad_h,
+                                const int pad_w,
+                                double *data_im
+                                ){
+    col2im_impl<double>(data_col, channels, height, width, kernel_h, kernel_w,
+                        stride_h, stride_w, pad_h, pad_w, data_im);
+}
+
+template <>
+void im2col_nhwc<float, CPUContext>(const int channel,
+                                    const int height,
+                                    const int width,
+                                    const int kernel_h,
+                                    const int kernel_w,
+                                    const int stride_h,
+                                    const int stride_w,
+                                    const int pad_h,
+                                    const int pad_w,
+                                    const float *im_ptr,
+                                    float *col_ptr
+                                    ){
+    im2col_nhwc_impl<float>(channel, height, width, kernel_h, kernel_w,
+                            stride_h, stride_w, pad_h, pad_w, im_ptr, col_ptr);
+}
+
+template <>
+void im2col_nhwc<double, CPUContext>(const int channel,
+                                     const int height,
+                                     const int width,
+                                     const int kernel_h,
+                                     const int kernel_w,
+                                     const int stride_h,
+                                     const int stride_w,
+                                     const int pad_h,
+                                     const int pad_w,
+                                     const double *im_ptr,
+                                     double *col_ptr
+                                     ){
+    im2col_nhwc_impl<double>(channel, height, width, kernel_h, kernel_w,
+                             stride_h, stride_w, pad_h, pad_w, im_ptr, col_ptr);
+}
+
+template <>
+void col2im_nhwc<float, CPUContext>(const float *data_col,
+                                    const int channels,
+                                    const int height,
+                                    const int width,
+                                    const int kernel_h,
+                                    const int kernel_w,
+                                    const int stride_h,
+                                    const int stride_w,
+                                    const int pad_h,
+                                    const int pad_w,
+                                    float *data_im
+                                    ){
+    col2im_nhwc_impl<float>(data_col, channels, height, width, kernel_h, kernel_w,
+                            stride_h, stride_w, pad_h, pad_w, data_im);
+}
+
+template <>
+void col2im_nhwc<double, CPUContext>(const double *data_col,
+                                     const int channels,
+                                     const int height,
+                                     const int width,
+                                     const int kernel_h,
+                                     const int kernel_w,
+                                     const int stride_h,
+                                     const int stride_w,
+                                     const int pad_h,
+                                     const int pad_w,
+                                     double *data_im
+                                     ){
+    col2im_nhwc_impl<double>(data_col, channels, height, width, kernel_h, kernel_w,
+                             stride_h, stride_w, pad_h, pad_w, data_im);
 }
 
 } /* math */
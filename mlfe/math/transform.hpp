@@ -1,22 +1,82 @@
 #ifndef __TRANSFORM_HPP__
 #define __TRANSFORM_HPP__
+#include <algorithm>
 
 namespace mlfe{ namespace math{
 
+/*
+ * returns [lo, hi) range of output positions o,
+ * whose input position o * stride - pad + offset is in [0, in_size).
+ * outside of the range, the input position falls on the padding.
+ */
+inline void valid_range(const int out_size,
+                        const int in_size,
+                        const int offset,
+                        const int stride,
+                        const int pad,
+                        int &lo,
+                        int &hi
+                        ){
+    const int first = pad - offset;
+    const int last = in_size + pad - offset;
+    lo = first > 0 ? (first + stride - 1) / stride : 0;
+    hi = last > 0 ? (last + stride - 1) / stride : 0;
+    hi = std::min<int>(hi, out_size);
+    lo = std::min<int>(lo, hi);
+}
+
+/*
+ * col is {im_c * kernel_h * kernel_w, out_h * out_w}.
+ * out_h = (im_h + 2 * pad_h - kernel_h) / stride_h + 1
+ * out_w = (im_w + 2 * pad_w - kernel_w) / stride_w + 1
+ */
 template <class DataType, class DeviceContext>
 void im2col(const int im_c, const int im_h, const int im_w,
             const int kernel_h, const int kernel_w,
-            const int stride, const int padding,
+            const int stride_h, const int stride_w,
+            const int pad_h, const int pad_w,
             const DataType *_im, DataType *_col
             );
 
+/*
+ * accumulates col of im2col layout into data_im.
+ * data_im is not cleared.
+ */
 template <class DataType, class DeviceContext>
-void col2im(DataType* data_col,
-            int channels, int height, int width,
-            int ksize, int stride, int pad,
+void col2im(const DataType* data_col,
+            const int channels, const int height, const int width,
+            const int kernel_h, const int kernel_w,
+            const int stride_h, const int stride_w,
+            const int pad_h, const int pad_w,
             DataType* data_im
             );
 
+/*
+ * NHWC version of im2col.
+ * col is {out_h * out_w, kernel_h * kernel_w * im_c},
+ * each row holds one receptive field in {kernel_h, kernel_w, im_c} order.
+ */
+template <class DataType, class DeviceContext>
+void im2col_nhwc(const int im_c, const int im_h, const int im_w,
+                 const int kernel_h, const int kernel_w,
+                 const int stride_h, const int stride_w,
+                 const int pad_h, const int pad_w,
+                 const DataType *_im, DataType *_col
+                 );
+
+/*
+ * NHWC version of col2im.
+ * accumulates col of im2col_nhwc layout into data_im.
+ */
+template <class DataType, class DeviceContext>
+void col2im_nhwc(const DataType* data_col,
+                 const int channels, const int height, const int width,
+                 const int kernel_h, const int kernel_w,
+                 const int stride_h, const int stride_w,
+                 const int pad_h, const int pad_w,
+                 DataType* data_im
+                 );
+
 } /* namespace math */
 } /* namespace mlfe */
 #endif /* __TRANSFORM_HPP__ */
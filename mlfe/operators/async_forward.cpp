@@ -0,0 +1,139 @@
+#include <string>
+#include "async_forward.hpp"
+#include "../utils/assert.hpp"
+
+namespace mlfe{
+
+namespace{
+template <class T>
+bool ResizeAs(TensorBlob<CPUContext> *tb, TensorBlob<CPUContext> *buffer){
+    if(!tb->MatchType<T>()){
+        return false;
+    }
+    buffer->Resize<T>(*tb);
+    buffer->SetLayout(tb->Layout());
+    return true;
+}
+
+template <class T>
+bool CopyAs(TensorBlob<CPUContext> *from, TensorBlob<CPUContext> *to){
+    if(!from->MatchType<T>()){
+        return false;
+    }
+    to->CopyToDevice<T>(0, from->Size(), from->GetPtrConst<T>());
+    return true;
+}
+
+/*
+ * the element types of the blobs, that can be bound.
+ */
+void ResizeLike(TensorBlob<CPUContext> *tb, TensorBlob<CPUContext> *buffer){
+    if(!ResizeAs<float>(tb, buffer) && !ResizeAs<double>(tb, buffer) &&
+       !ResizeAs<int>(tb, buffer) && !ResizeAs<unsigned char>(tb, buffer)){
+        throw std::string("[AsyncForward] not supported type of a bound blob.");
+    }
+}
+
+void CopyBlob(TensorBlob<CPUContext> *from, TensorBlob<CPUContext> *to){
+    runtime_assert(from->Size() == to->Size(), "[AsyncForward] a bound blob has changed its size.");
+    if(!CopyAs<float>(from, to) && !CopyAs<double>(from, to) &&
+       !CopyAs<int>(from, to) && !CopyAs<unsigned char>(from, to)){
+        throw std::string("[AsyncForward] not supported type of a bound blob.");
+    }
+}
+} /* namespace */
+
+AsyncForward::AsyncForward(ItemHolder *ih, std::function<void ()> run)
+    : ih(ih), run(run), next_step(0){}
+
+void AsyncForward::BindInput(std::string name){
+    Bind(input_buffers, name);
+}
+
+void AsyncForward::BindOutput(std::string name){
+    Bind(output_buffers, name);
+}
+
+TensorBlob<CPUContext> *AsyncForward::NextInput(std::string name){
+    auto buffers = input_buffers.find(name);
+    if(buffers == input_buffers.end()){
+        throw std::string("[AsyncForward] not a bound input -> ") + name;
+    }
+    CPUEvent before;
+    int step;
+    {
+        std::unique_lock<std::mutex> lock(m);
+        step = next_step;
+        before = step_done[step % 2];
+    }
+    before.Synchronize();
+    return buffers->second[step % 2].get();
+}
+
+std::future<void> AsyncForward::Queue(std::function<void (int)> callback){
+    CPUEvent before;
+    int step;
+    {
+        std::unique_lock<std::mutex> lock(m);
+        step = next_step++;
+        before = step_done[step % 2];
+    }
+    before.Synchronize();
+    auto promise = std::make_shared<std::promise<void>>();
+    /*
+     * the step may run, and its callback queue the next, before Record returns,
+     * so the event is stored under the lock, which the callback waits for.
+     */
+    std::unique_lock<std::mutex> lock(m);
+    stream.Enqueue([this, step, promise, callback](){
+        try{
+            RunStep(step, callback);
+            promise->set_value();
+        }
+        catch(...){
+            promise->set_exception(std::current_exception());
+        }
+    });
+    step_done[step % 2] = stream.Record();
+    return promise->get_future();
+}
+
+TensorBlob<CPUContext> *AsyncForward::GetOutput(std::string name, int step){
+    auto buffers = output_buffers.find(name);
+    if(buffers == output_buffers.end()){
+        throw std::string("[AsyncForward] not a bound output -> ") + name;
+    }
+    return buffers->second[step % 2].get();
+}
+
+void AsyncForward::Synchronize(){
+    stream.Synchronize();
+}
+
+void AsyncForward::Bind(Buffers &buffers, std::string name){
+    auto tb = ih->GetItem<TensorBlob<CPUContext>>(name);
+    if(tb == nullptr || tb->IsEmpty()){
+        throw std::string("[AsyncForward] can not bind an unknown or empty blob -> ") + name;
+    }
+    for(int n = 0; n < 2; ++n){
+        auto buffer = std::make_shared<TensorBlob<CPUContext>>();
+        ResizeLike(tb, buffer.get());
+        buffers[name].push_back(buffer);
+    }
+}
+
+void AsyncForward::RunStep(int step, std::function<void (int)> callback){
+    const int parity = step % 2;
+    for(auto &input : input_buffers){
+        CopyBlob(input.second[parity].get(), ih->GetItem<TensorBlob<CPUContext>>(input.first));
+    }
+    run();
+    for(auto &output : output_buffers){
+        CopyBlob(ih->GetItem<TensorBlob<CPUContext>>(output.first), output.second[parity].get());
+    }
+    if(callback){
+        callback(step);
+    }
+}
+
+} /* namespace mlfe */
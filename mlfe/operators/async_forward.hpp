@@ -0,0 +1,89 @@
+#ifndef __ASYNC_FORWARD_HPP__
+#define __ASYNC_FORWARD_HPP__
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../core/item_holder.hpp"
+#include "../core/tensor_blob.hpp"
+#include "../device_context/cpu_context.hpp"
+#include "../device_context/cpu_stream.hpp"
+
+namespace mlfe{
+
+/*
+ * Queues forward steps of a net on a CPUStream, so the caller prepares the next step
+ * while the current one runs.
+ * A step copies the bound inputs into the blobs of the net, runs it,
+ * and copies the bound outputs out of them. Every binding has two buffers,
+ * a step uses those of its parity, so at most two steps are in flight.
+ *
+ * Queue and NextInput are called from one thread at a time,
+ * the caller's or a callback, which may queue the next step.
+ */
+class AsyncForward{
+public:
+    /*
+     * run computes the net on the blobs of ih.
+     */
+    AsyncForward(ItemHolder *ih, std::function<void ()> run);
+    
+    /*
+     * the blobs must be allocated, and bound before the first step is queued.
+     */
+    void BindInput(std::string name);
+    
+    void BindOutput(std::string name);
+    
+    /*
+     * the input buffer of the next step,
+     * it waits for the step two before, that used the same buffer.
+     */
+    TensorBlob<CPUContext> *NextInput(std::string name);
+    
+    /*
+     * queues a step, and calls callback with its number after it.
+     * the call waits for the step two before.
+     * the future holds the exception of the step or of callback.
+     */
+    std::future<void> Queue(std::function<void (int)> callback = nullptr);
+    
+    /*
+     * an output of a finished step, valid until Queue is called two more times.
+     */
+    TensorBlob<CPUContext> *GetOutput(std::string name, int step);
+    
+    /*
+     * waits for every queued step.
+     */
+    void Synchronize();
+
+protected:
+    using Buffers = std::map<std::string, std::vector<std::shared_ptr<TensorBlob<CPUContext>>>>;
+    
+    void Bind(Buffers &buffers, std::string name);
+    
+    void RunStep(int step, std::function<void (int)> callback);
+
+private:
+    ItemHolder *ih;
+    std::function<void ()> run;
+    Buffers input_buffers;
+    Buffers output_buffers;
+    /*
+     * guards the step counter and the events, not held while waiting.
+     */
+    std::mutex m;
+    CPUEvent step_done[2];
+    int next_step;
+    /*
+     * declared last, so that the queued steps finish before the buffers are destroyed.
+     */
+    CPUStream stream;
+};
+
+} /* namespace mlfe */
+#endif /* __ASYNC_FORWARD_HPP__ */
@@ -0,0 +1,286 @@
+#include <cstdlib>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <stdexcept>
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "autotuner.hpp"
+
+namespace mlfe{
+
+namespace{
+/*
+ * number of timed Compute calls per accelerator, after one warm up call.
+ */
+const int bench_iters = 5;
+
+void FillConst(TensorBlob<CPUContext> *tb, std::string data_type){
+    if(!data_type.compare("double")){
+        tb->SetByConst<double>(0.5);
+    }
+    else{
+        tb->SetByConst<float>(0.5f);
+    }
+}
+
+/*
+ * $XDG_CACHE_HOME/mlfe/autotune, or $HOME/.cache/mlfe/autotune,
+ * empty if neither is set.
+ */
+std::string DefaultCachePath(){
+    const char *xdg_cache = std::getenv("XDG_CACHE_HOME");
+    if(xdg_cache != nullptr && xdg_cache[0] != '\0'){
+        return std::string(xdg_cache) + "/mlfe/autotune";
+    }
+    const char *home = std::getenv("HOME");
+    if(home != nullptr && home[0] != '\0'){
+        return std::string(home) + "/.cache/mlfe/autotune";
+    }
+    return "";
+}
+
+/*
+ * creates the missing directories of the file path, the existing ones are left as they are.
+ */
+void MakeParentDirectories(std::string path){
+    for(auto pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)){
+        const std::string dir = path.substr(0, pos);
+#if defined(_WIN32)
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+    }
+}
+} /* namespace */
+
+Autotuner *Autotuner::Get(){
+    static Autotuner tuner;
+    return &tuner;
+}
+
+Autotuner::Autotuner() : loaded(false){
+    /*
+     * an empty $MLFE_AUTOTUNE_CACHE keeps the choices in memory only.
+     */
+    const char *env_path = std::getenv("MLFE_AUTOTUNE_CACHE");
+    cache_path = env_path != nullptr ? std::string(env_path) : DefaultCachePath();
+    
+    cpu_model = "unknown";
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while(std::getline(cpuinfo, line)){
+        if(line.compare(0, 10, "model name") == 0){
+            auto pos = line.find(':');
+            if(pos != std::string::npos && pos + 2 <= line.size()){
+                cpu_model = line.substr(pos + 2);
+            }
+            break;
+        }
+    }
+}
+
+std::string Autotuner::Select(OperatorIO &opio, ItemHolder *ih){
+    if(opio.type.compare("Conv")){
+        throw std::string("[Autotuner] Not supported operator -> ") + opio.type;
+    }
+    auto candidates = Accelerators(opio.type, opio.data_type);
+    if(candidates.empty()){
+        throw std::string("[Autotuner] No accelerator is registered for ") +
+        opio.type + "_" + opio.data_type;
+    }
+    if(candidates.size() == 1){
+        return candidates[0];
+    }
+    
+    /*
+     * the shape is unknown yet, so nothing can be measured.
+     */
+    Item *x_item = ih->GetItem(opio.inputs[0]);
+    if(x_item == nullptr ||
+       x_item->Get<TensorBlob<CPUContext>>()->IsEmpty() ||
+       !opio.param.HasParam("Filters") ||
+       !opio.param.HasParam("Kernel")){
+        return candidates[0];
+    }
+    auto x = x_item->Get<TensorBlob<CPUContext>>();
+    auto key = MakeKey(opio, x);
+    
+    {
+        std::unique_lock<std::mutex> lock(m);
+        if(!loaded){
+            LoadCache();
+        }
+        auto cached = cache.find(key);
+        if(cached != cache.end() &&
+           OperatorCPU()->Has(opio.type + "_" + opio.data_type + "_" + cached->second)){
+            return cached->second;
+        }
+    }
+    
+    std::string best;
+    double best_time = std::numeric_limits<double>::max();
+    for(auto &accel : candidates){
+        double time;
+        try{
+            time = Benchmark(opio, accel, x);
+        }
+        /*
+         * an accelerator which can not handle this shape is skipped.
+         */
+        catch(std::string &e){
+            continue;
+        }
+        catch(const std::exception &e){
+            continue;
+        }
+        if(time < best_time){
+            best_time = time;
+            best = accel;
+        }
+    }
+    if(best.empty()){
+        throw std::string("[Autotuner] No accelerator can run ") + key;
+    }
+    /*
+     * the benchmark runs unlocked, another thread may have tuned the shape meanwhile.
+     */
+    std::unique_lock<std::mutex> lock(m);
+    auto cached = cache.find(key);
+    if(cached != cache.end()){
+        return cached->second;
+    }
+    SaveCache(key, best);
+    return best;
+}
+
+std::vector<std::string> Autotuner::Accelerators(std::string type, std::string data_type){
+    std::vector<std::string> accels;
+    const std::string prefix = type + "_" + data_type + "_";
+    for(auto &key : OperatorCPU()->Keys()){
+        if(key.compare(0, prefix.size(), prefix) != 0){
+            continue;
+        }
+        auto accel = key.substr(prefix.size());
+        if(accel.empty() || !accel.compare("Gradient")){
+            continue;
+        }
+        accels.push_back(accel);
+    }
+    return accels;
+}
+
+void Autotuner::SetCachePath(std::string path){
+    std::unique_lock<std::mutex> lock(m);
+    cache_path = path;
+    cache.clear();
+    loaded = false;
+}
+
+std::string Autotuner::GetCachePath(){
+    std::unique_lock<std::mutex> lock(m);
+    return cache_path;
+}
+
+std::string Autotuner::GetCPUModel(){
+    return cpu_model;
+}
+
+std::string Autotuner::MakeKey(OperatorIO &opio, TensorBlob<CPUContext> *x){
+    std::ostringstream key;
+    auto kernel = opio.param.GetParam<std::vector<int>>("Kernel");
+    auto stride = opio.param.GetParam<std::vector<int>>("Stride");
+    auto layout = x->Layout();
+    if(opio.param.HasParam("Layout")){
+        layout = LayoutFromString(opio.param.GetParam<std::string>("Layout"));
+    }
+    key << opio.type << "_" << opio.data_type << " " << LayoutToString(layout);
+    key << " x=";
+    for(int n = 0; n < x->Dims(); ++n){
+        key << (n > 0 ? "," : "") << x->Dim(n);
+    }
+    key << " f=" << opio.param.GetParam<int>("Filters");
+    key << " k=" << kernel[0] << "," << kernel[1];
+    key << " s=" << stride[0] << "," << stride[1];
+    key << " p=" << opio.param.GetParam<int>("Padding");
+    if(opio.param.HasParam("Group")){
+        key << " g=" << opio.param.GetParam<int>("Group");
+    }
+    return key.str();
+}
+
+double Autotuner::Benchmark(OperatorIO opio, std::string accelerator, TensorBlob<CPUContext> *x){
+    /*
+     * the operator runs on a scratch item holder,
+     * so tensors of the real network are never touched.
+     */
+    ItemHolder scratch;
+    opio.accelerator = accelerator;
+    scratch.AddItem<TensorBlob<CPUContext>>(opio.inputs[0]);
+    auto x_bench = scratch.GetItem(opio.inputs[0])->Get<TensorBlob<CPUContext>>();
+    if(!opio.data_type.compare("double")){
+        x_bench->Resize<double>(*x);
+    }
+    else{
+        x_bench->Resize<float>(*x);
+    }
+    FillConst(x_bench, opio.data_type);
+    
+    auto op = OperatorCPU()->Create(opio.type + "_" + opio.data_type + "_" + accelerator, opio, &scratch);
+    for(size_t n = 1; n < opio.inputs.size(); ++n){
+        FillConst(scratch.GetItem(opio.inputs[n])->Get<TensorBlob<CPUContext>>(), opio.data_type);
+    }
+    
+    op->Compute();
+    auto begin = std::chrono::steady_clock::now();
+    for(int n = 0; n < bench_iters; ++n){
+        op->Compute();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count() / bench_iters;
+}
+
+/*
+ * each line of the cache file is "cpu model \t shape key \t accelerator".
+ * lines of other cpu models are ignored.
+ */
+void Autotuner::LoadCache(){
+    loaded = true;
+    if(cache_path.empty()){
+        return;
+    }
+    std::ifstream file(cache_path);
+    std::string line;
+    while(std::getline(file, line)){
+        std::istringstream fields(line);
+        std::string cpu, key, accel;
+        if(std::getline(fields, cpu, '\t') &&
+           std::getline(fields, key, '\t') &&
+           std::getline(fields, accel) &&
+           !cpu.compare(cpu_model)){
+            cache[key] = accel;
+        }
+    }
+}
+
+void Autotuner::SaveCache(std::string key, std::string accelerator){
+    cache[key] = accelerator;
+    if(cache_path.empty()){
+        return;
+    }
+    /*
+     * a read only cache file or directory only disables the persistence.
+     */
+    MakeParentDirectories(cache_path);
+    std::ofstream file(cache_path, std::ios::app);
+    if(file.is_open()){
+        file << cpu_model << '\t' << key << '\t' << accelerator << std::endl;
+    }
+}
+
+} /* namespace mlfe */
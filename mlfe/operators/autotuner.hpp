@@ -0,0 +1,78 @@
+#ifndef __AUTOTUNER_HPP__
+#define __AUTOTUNER_HPP__
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include "operator.hpp"
+#include "../device_context/cpu_context.hpp"
+
+namespace mlfe{
+
+/*
+ * Chooses the fastest registered accelerator of an operator for its shape.
+ * The operator is created with accelerator "Auto",
+ * then every registered "Type_DataType_Accelerator" key is benchmarked
+ * on a scratch workspace, and the winner is cached in memory
+ * keyed by the shape and the cpu model.
+ *
+ * The choices are kept in a per user file, $XDG_CACHE_HOME/mlfe/autotune
+ * or $HOME/.cache/mlfe/autotune, and the next runs on the same machine
+ * read them from it. $MLFE_AUTOTUNE_CACHE or SetCachePath override the path.
+ * Select may be called from several threads, two of them tuning the same shape
+ * both measure it, and the first result is kept.
+ * Only Conv is supported now.
+ */
+class Autotuner{
+public:
+    static Autotuner *Get();
+    
+    /*
+     * returns the accelerator name to be used for opio.
+     */
+    std::string Select(OperatorIO &opio, ItemHolder *ih);
+    
+    /*
+     * returns registered accelerators of the type and the data type.
+     */
+    static std::vector<std::string> Accelerators(std::string type, std::string data_type);
+    
+    /*
+     * an empty path, also given by an empty $MLFE_AUTOTUNE_CACHE, keeps the choices in memory only.
+     */
+    void SetCachePath(std::string path);
+    
+    std::string GetCachePath();
+    
+    std::string GetCPUModel();
+
+protected:
+    Autotuner();
+    
+    std::string MakeKey(OperatorIO &opio, TensorBlob<CPUContext> *x);
+    
+    /*
+     * returns average milliseconds of one Compute call.
+     */
+    double Benchmark(OperatorIO opio, std::string accelerator, TensorBlob<CPUContext> *x);
+    
+    /*
+     * both are called with m locked.
+     */
+    void LoadCache();
+    
+    void SaveCache(std::string key, std::string accelerator);
+
+private:
+    /*
+     * guards cache, cache_path and loaded.
+     */
+    std::mutex m;
+    std::map<std::string, std::string> cache;
+    std::string cache_path;
+    std::string cpu_model;
+    bool loaded;
+};
+
+} /* namespace mlfe */
+#endif /* __AUTOTUNER_HPP__ */
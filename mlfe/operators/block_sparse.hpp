@@ -0,0 +1,100 @@
+#ifndef __BLOCK_SPARSE_OP_HPP__
+#define __BLOCK_SPARSE_OP_HPP__
+#include "operator.hpp"
+#include "../device_context/cpu_context.hpp"
+
+namespace mlfe{
+
+/*
+ * Converts a pruned w into BCSR of block_rows x block_cols blocks, for the block sparse ops.
+ * w{n, ...} is seen as {n, k}, so both the w of FC and the w of a 1x1 Conv are converted.
+ * elements with |w| <= threshold are pruned, and a block is kept when any element is left.
+ *   indptr int{block rows + 1}, the block row r owns the blocks [indptr[r], indptr[r + 1]),
+ *   indices int{blocks}, block column of each block,
+ *   values {blocks, block_rows, block_cols}, elements of each block.
+ * returns the density, kept blocks / all blocks.
+ */
+template <class DataType>
+double ConvertToBlockSparse(TensorBlob<CPUContext> *w,
+                            const int block_rows, const int block_cols,
+                            const DataType threshold,
+                            TensorBlob<CPUContext> *indptr,
+                            TensorBlob<CPUContext> *indices,
+                            TensorBlob<CPUContext> *values);
+
+/*
+ * inference ops over a weight given in BCSR by ConvertToBlockSparse.
+ * the inputs are {x, w_indptr, w_indices, w_values, b}, and b gives the number of units.
+ * when the density of w is over DenseAbove, the blocks are expanded once
+ * into a dense weight, and the dense gemm is used.
+ *
+ * Params :
+ *   BlockRows (1), BlockCols (4), the block of ConvertToBlockSparse.
+ *   DenseAbove (0.3), float.
+ */
+template <class DataType, class DeviceContext>
+class BlockSparseBaseOp : public Operator<DeviceContext>{
+public:
+    void Compute() override = 0;
+    
+protected:
+    explicit BlockSparseBaseOp(OperatorIO &opio, ItemHolder *ih);
+    
+    /*
+     * checks the BCSR against w{n, k}, and chooses the sparse or the dense kernel.
+     */
+    void Setup(const int n, const int k);
+    
+    /*
+     * returns w{n, k}, expanded again only when the blocks have been modified.
+     */
+    const DataType *DenseWeight();
+    
+    enum InputSchema{x, w_indptr, w_indices, w_values, b};
+    enum OutputSchema{y};
+    TensorBlob<CPUContext> w_dense;
+    unsigned int w_dense_version;
+    bool w_dense_cached;
+    bool dense;
+    double density;
+    double dense_above;
+    int block_rows;
+    int block_cols;
+    int n;
+    int k;
+};
+
+/*
+ * y{m, units} = x{m, k} * w^T + b.
+ */
+template <class DataType, class DeviceContext>
+class BlockSparseFullyConnectedOp final : public BlockSparseBaseOp<DataType, DeviceContext>{
+public:
+    explicit BlockSparseFullyConnectedOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+    
+private:
+    int m;
+};
+
+/*
+ * 1x1 convolution of stride 1, without padding.
+ * w is {filters, C, 1, 1} in NCHW and {filters, 1, 1, C} in NHWC, both are {filters, C}.
+ * the layout follows x, unless it is given by Layout param.
+ */
+template <class DataType, class DeviceContext>
+class BlockSparseConvolutionOp final : public BlockSparseBaseOp<DataType, DeviceContext>{
+public:
+    explicit BlockSparseConvolutionOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+    
+private:
+    DataLayout layout;
+    int batch;
+    int plane;
+};
+
+} /* namespace mlfe */
+#endif /* __BLOCK_SPARSE_OP_HPP__ */
@@ -0,0 +1,354 @@
+#include <cmath>
+#include <algorithm>
+#include "block_sparse.hpp"
+#include "../math/blas.hpp"
+#include "../math/sparse.hpp"
+#include "../utils/assert.hpp"
+#include "../utils/parallel.hpp"
+
+namespace mlfe{
+
+template <class DataType>
+double ConvertToBlockSparse(TensorBlob<CPUContext> *w,
+                            const int block_rows, const int block_cols,
+                            const DataType threshold,
+                            TensorBlob<CPUContext> *indptr,
+                            TensorBlob<CPUContext> *indices,
+                            TensorBlob<CPUContext> *values){
+    runtime_assert(block_rows > 0 && block_cols > 0,
+                   "[Block Sparse] block size must be positive.");
+    runtime_assert(w->template MatchType<DataType>() && w->Dims() >= 2,
+                   "[Block Sparse] w must be a matrix of the data type.");
+    const int n = w->Dim(0);
+    const int k = w->Size() / n;
+    const int block_n = (n + block_rows - 1) / block_rows;
+    const int block_k = (k + block_cols - 1) / block_cols;
+    const DataType *w_ptr = w->template GetPtrConst<DataType>();
+    std::vector<int> kept_indptr(1, 0), kept_indices;
+    std::vector<DataType> kept_values;
+    
+    for(int r = 0; r < block_n; ++r){
+        const int rows = std::min(block_rows, n - r * block_rows);
+        for(int c = 0; c < block_k; ++c){
+            const int cols = std::min(block_cols, k - c * block_cols);
+            bool kept = false;
+            for(int t = 0; t < rows && !kept; ++t){
+                for(int s = 0; s < cols; ++s){
+                    if(std::abs(w_ptr[(r * block_rows + t) * k + c * block_cols + s]) > threshold){
+                        kept = true;
+                        break;
+                    }
+                }
+            }
+            if(!kept){
+                continue;
+            }
+            kept_indices.push_back(c);
+            for(int t = 0; t < block_rows; ++t){
+                for(int s = 0; s < block_cols; ++s){
+                    DataType val = DataType(0);
+                    if(t < rows && s < cols){
+                        val = w_ptr[(r * block_rows + t) * k + c * block_cols + s];
+                        val = std::abs(val) > threshold ? val : DataType(0);
+                    }
+                    kept_values.push_back(val);
+                }
+            }
+        }
+        kept_indptr.push_back(kept_indices.size());
+    }
+    
+    /*
+     * a fully pruned w still keeps one element, so the blobs are never empty.
+     */
+    indptr->template Resize<int>({block_n + 1});
+    indices->template Resize<int>({std::max<int>(kept_indices.size(), 1)});
+    values->template Resize<DataType>({std::max<int>(kept_indices.size(), 1), block_rows, block_cols});
+    indices->template SetByConst<int>(0);
+    values->template SetByConst<DataType>(DataType(0));
+    std::copy(kept_indptr.begin(), kept_indptr.end(), indptr->template GetPtrMutable<int>());
+    std::copy(kept_indices.begin(), kept_indices.end(), indices->template GetPtrMutable<int>());
+    std::copy(kept_values.begin(), kept_values.end(), values->template GetPtrMutable<DataType>());
+    return static_cast<double>(kept_indices.size()) / (static_cast<double>(block_n) * block_k);
+}
+
+template double ConvertToBlockSparse<float>(TensorBlob<CPUContext> *, const int, const int, const float,
+                                            TensorBlob<CPUContext> *, TensorBlob<CPUContext> *,
+                                            TensorBlob<CPUContext> *);
+template double ConvertToBlockSparse<double>(TensorBlob<CPUContext> *, const int, const int, const double,
+                                             TensorBlob<CPUContext> *, TensorBlob<CPUContext> *,
+                                             TensorBlob<CPUContext> *);
+
+template <class DT, class DC>
+BlockSparseBaseOp<DT, DC>::BlockSparseBaseOp(
+                                             OperatorIO &opio,
+                                             ItemHolder *ih
+                                             ) : Operator<DC>(opio, ih) {
+    runtime_assert(this->inputs.size() == 5,
+                   "[Block Sparse Op] inputs.size() == 5.");
+    runtime_assert(this->outputs.size() == 1,
+                   "[Block Sparse Op] outputs.size() == 1.");
+    block_rows = opio.param.HasParam("BlockRows") ? opio.param.GetParam<int>("BlockRows") : 1;
+    block_cols = opio.param.HasParam("BlockCols") ? opio.param.GetParam<int>("BlockCols") : 4;
+    dense_above = opio.param.HasParam("DenseAbove") ? opio.param.GetParam<float>("DenseAbove") : 0.3;
+    w_dense_cached = false;
+    w_dense_version = 0;
+    dense = false;
+}
+
+template <class DT, class DC>
+void BlockSparseBaseOp<DT, DC>::Setup(const int n, const int k){
+    const auto indptr = this->inputs[InputSchema::w_indptr];
+    const auto indices = this->inputs[InputSchema::w_indices];
+    const auto values = this->inputs[InputSchema::w_values];
+    const int block_n = (n + block_rows - 1) / block_rows;
+    const int block_k = (k + block_cols - 1) / block_cols;
+    this->n = n;
+    this->k = k;
+    
+    runtime_assert(indptr->template MatchType<int>() && indices->template MatchType<int>(),
+                   "[Block Sparse Op] indptr and indices type must be int.");
+    runtime_assert(indptr->Size() == block_n + 1,
+                   "[Block Sparse Op] indptr->Size() == block rows of w + 1.");
+    const int *indptr_ptr = indptr->template GetPtrConst<int>();
+    const int *indices_ptr = indices->template GetPtrConst<int>();
+    const int blocks = indptr_ptr[block_n];
+    runtime_assert(indptr_ptr[0] == 0 && blocks <= indices->Size() &&
+                   blocks * block_rows * block_cols <= values->Size(),
+                   "[Block Sparse Op] indptr is out of the blocks.");
+    for(int r = 0; r < block_n; ++r){
+        runtime_assert(indptr_ptr[r] <= indptr_ptr[r + 1],
+                       "[Block Sparse Op] indptr must be non decreasing.");
+    }
+    for(int q = 0; q < blocks; ++q){
+        runtime_assert(indices_ptr[q] >= 0 && indices_ptr[q] < block_k,
+                       "[Block Sparse Op] block column is out of w.");
+    }
+    
+    /*
+     * the sparse kernel reads an index per block, and can not tile like gemm,
+     * so it only pays off when most of the blocks are pruned.
+     */
+    density = static_cast<double>(blocks) / (static_cast<double>(block_n) * block_k);
+    dense = density > dense_above;
+    if(dense){
+        w_dense.template Resize<DT>({n, k});
+    }
+}
+
+template <class DT, class DC>
+const DT *BlockSparseBaseOp<DT, DC>::DenseWeight(){
+    const auto values = this->inputs[InputSchema::w_values];
+    if(w_dense_cached && w_dense_version == values->Version()){
+        return w_dense.template GetPtrConst<DT>();
+    }
+    const int *indptr_ptr = this->inputs[InputSchema::w_indptr]->template GetPtrConst<int>();
+    const int *indices_ptr = this->inputs[InputSchema::w_indices]->template GetPtrConst<int>();
+    const DT *values_ptr = values->template GetPtrConst<DT>();
+    DT *w_ptr = w_dense.template GetPtrMutable<DT>();
+    const int block_n = (n + block_rows - 1) / block_rows;
+    
+    std::fill(w_ptr, w_ptr + n * k, DT(0));
+    for(int r = 0; r < block_n; ++r){
+        const int rows = std::min(block_rows, n - r * block_rows);
+        for(int q = indptr_ptr[r]; q < indptr_ptr[r + 1]; ++q){
+            const int c0 = indices_ptr[q] * block_cols;
+            const int cols = std::min(block_cols, k - c0);
+            for(int t = 0; t < rows; ++t){
+                std::copy(values_ptr + (q * block_rows + t) * block_cols,
+                          values_ptr + (q * block_rows + t) * block_cols + cols,
+                          w_ptr + (r * block_rows + t) * k + c0);
+            }
+        }
+    }
+    w_dense_version = values->Version();
+    w_dense_cached = true;
+    return w_dense.template GetPtrConst<DT>();
+}
+
+template <class DT, class DC>
+BlockSparseFullyConnectedOp<DT, DC>::BlockSparseFullyConnectedOp(
+                                                                 OperatorIO &opio,
+                                                                 ItemHolder *ih
+                                                                 ) : BlockSparseBaseOp<DT, DC>(opio, ih) {
+    using Base = BlockSparseBaseOp<DT, DC>;
+    const auto x = this->inputs[Base::InputSchema::x];
+    const auto b = this->inputs[Base::InputSchema::b];
+    auto y = this->outputs[Base::OutputSchema::y];
+    
+    runtime_assert(!x->IsEmpty(),
+                   "[Block Sparse FC Op] x must not be empty.");
+    m = x->Dim(0);
+    this->Setup(b->Size(), x->Size() / m);
+    if(y->IsEmpty()){
+        y->template Resize<DT>({m, this->n});
+    }
+    else{
+        runtime_assert(y->Size() == m * this->n,
+                       "[Block Sparse FC Op] y->Size() == m * units.");
+    }
+}
+
+template <class DT, class DC>
+void BlockSparseFullyConnectedOp<DT, DC>::Compute(){
+    using Base = BlockSparseBaseOp<DT, DC>;
+    const DT *x_ptr = this->inputs[Base::InputSchema::x]->template GetPtrConst<DT>();
+    const DT *b_ptr = this->inputs[Base::InputSchema::b]->template GetPtrConst<DT>();
+    DT *y_ptr = this->outputs[Base::OutputSchema::y]->template GetPtrMutable<DT>();
+    
+    if(this->dense){
+        math::GemmEpilogue<DT> epilogue;
+        epilogue.col_bias = b_ptr;
+        math::gemm<DT, DC>(false, true,
+                           m, this->n, this->k,
+                           DT(1), x_ptr, this->k,
+                           this->DenseWeight(), this->k,
+                           DT(0), y_ptr, this->n,
+                           epilogue, nullptr);
+        return;
+    }
+    const int *indptr_ptr = this->inputs[Base::InputSchema::w_indptr]->template GetPtrConst<int>();
+    const int *indices_ptr = this->inputs[Base::InputSchema::w_indices]->template GetPtrConst<int>();
+    const DT *values_ptr = this->inputs[Base::InputSchema::w_values]->template GetPtrConst<DT>();
+    const int block_size = this->block_rows * this->block_cols;
+    const int block_n = this->inputs[Base::InputSchema::w_indptr]->Size() - 1;
+    parallel_for(0, m, parallel_grain_of(indptr_ptr[block_n] * block_size), [&](int from, int to){
+        math::bcsr_fc<DT, DC>(from, to, this->n, this->k,
+                              this->block_rows, this->block_cols,
+                              indptr_ptr, indices_ptr, values_ptr,
+                              x_ptr, b_ptr, y_ptr);
+    });
+}
+
+REGIST_OPERATOR_CPU(BlockSparseFC_float, BlockSparseFullyConnectedOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(BlockSparseFC_double, BlockSparseFullyConnectedOp<double, CPUContext>)
+
+template <class DT, class DC>
+BlockSparseConvolutionOp<DT, DC>::BlockSparseConvolutionOp(
+                                                           OperatorIO &opio,
+                                                           ItemHolder *ih
+                                                           ) : BlockSparseBaseOp<DT, DC>(opio, ih) {
+    using Base = BlockSparseBaseOp<DT, DC>;
+    const auto x = this->inputs[Base::InputSchema::x];
+    const auto b = this->inputs[Base::InputSchema::b];
+    auto y = this->outputs[Base::OutputSchema::y];
+    
+    if(opio.param.HasParam("Kernel")){
+        const auto kernel = opio.param.GetParam<std::vector<int>>("Kernel");
+        runtime_assert(kernel.size() == 2 && kernel[0] == 1 && kernel[1] == 1,
+                       "[Block Sparse Conv Op] only 1x1 kernel is supported.");
+    }
+    if(opio.param.HasParam("Stride")){
+        const auto stride = opio.param.GetParam<std::vector<int>>("Stride");
+        runtime_assert(stride.size() == 2 && stride[0] == 1 && stride[1] == 1,
+                       "[Block Sparse Conv Op] only stride 1 is supported.");
+    }
+    runtime_assert(!opio.param.HasParam("Padding") || opio.param.GetParam<int>("Padding") == 0,
+                   "[Block Sparse Conv Op] padding is not supported.");
+    runtime_assert(x->Dims() == 4,
+                   "[Block Sparse Conv Op] x->Dims() == 4.");
+    layout = x->Layout();
+    if(opio.param.HasParam("Layout")){
+        layout = LayoutFromString(opio.param.GetParam<std::string>("Layout"));
+    }
+    const int filters = b->Size();
+    batch = x->Dim(0);
+    if(layout == DataLayout::NHWC){
+        plane = x->Dim(1) * x->Dim(2);
+        this->Setup(filters, x->Dim(3));
+    }
+    else{
+        plane = x->Dim(2) * x->Dim(3);
+        this->Setup(filters, x->Dim(1));
+    }
+    if(y->IsEmpty()){
+        if(layout == DataLayout::NHWC){
+            y->template Resize<DT>({batch, x->Dim(1), x->Dim(2), filters});
+        }
+        else{
+            y->template Resize<DT>({batch, filters, x->Dim(2), x->Dim(3)});
+        }
+        y->SetLayout(layout);
+    }
+    else{
+        runtime_assert(y->Size() == batch * plane * filters,
+                       "[Block Sparse Conv Op] y->Size() == N * H * W * filters.");
+    }
+}
+
+template <class DT, class DC>
+void BlockSparseConvolutionOp<DT, DC>::Compute(){
+    using Base = BlockSparseBaseOp<DT, DC>;
+    const DT *x_ptr = this->inputs[Base::InputSchema::x]->template GetPtrConst<DT>();
+    const DT *b_ptr = this->inputs[Base::InputSchema::b]->template GetPtrConst<DT>();
+    const int *indptr_ptr = this->inputs[Base::InputSchema::w_indptr]->template GetPtrConst<int>();
+    const int *indices_ptr = this->inputs[Base::InputSchema::w_indices]->template GetPtrConst<int>();
+    const DT *values_ptr = this->inputs[Base::InputSchema::w_values]->template GetPtrConst<DT>();
+    DT *y_ptr = this->outputs[Base::OutputSchema::y]->template GetPtrMutable<DT>();
+    const int n = this->n;
+    const int k = this->k;
+    const int block_n = (n + this->block_rows - 1) / this->block_rows;
+    /*
+     * multiply-adds of all the blocks, for one pixel.
+     */
+    const int block_work = indptr_ptr[block_n] * this->block_rows * this->block_cols;
+    
+    /*
+     * NHWC is FC over every pixel, x{N * H * W, C} * w{filters, C}^T.
+     */
+    if(layout == DataLayout::NHWC){
+        if(this->dense){
+            math::GemmEpilogue<DT> epilogue;
+            epilogue.col_bias = b_ptr;
+            math::gemm<DT, DC>(false, true,
+                               batch * plane, n, k,
+                               DT(1), x_ptr, k,
+                               this->DenseWeight(), k,
+                               DT(0), y_ptr, n,
+                               epilogue, nullptr);
+        }
+        else{
+            parallel_for(0, batch * plane, parallel_grain_of(block_work), [&](int from, int to){
+                math::bcsr_fc<DT, DC>(from, to, n, k,
+                                      this->block_rows, this->block_cols,
+                                      indptr_ptr, indices_ptr, values_ptr,
+                                      x_ptr, b_ptr, y_ptr);
+            });
+        }
+        return;
+    }
+    /*
+     * NCHW is w{filters, C} * x{C, H * W} for every image.
+     */
+    math::GemmEpilogue<DT> epilogue;
+    epilogue.row_bias = b_ptr;
+    const DT *w_ptr = this->dense ? this->DenseWeight() : nullptr;
+    for(int i = 0; i < batch; ++i){
+        if(this->dense){
+            math::gemm<DT, DC>(false, false,
+                               n, plane, k,
+                               DT(1), w_ptr, k,
+                               x_ptr + i * k * plane, plane,
+                               DT(0), y_ptr + i * n * plane, plane,
+                               epilogue, nullptr);
+        }
+        else{
+            /*
+             * the block rows write their own rows of y.
+             */
+            parallel_for(0, block_n, parallel_grain_of(block_work / block_n * plane), [&](int from, int to){
+                math::bcsr_gemm<DT, DC>(from, to,
+                                        n, k, plane,
+                                        this->block_rows, this->block_cols,
+                                        indptr_ptr, indices_ptr, values_ptr,
+                                        x_ptr + i * k * plane, b_ptr,
+                                        y_ptr + i * n * plane);
+            });
+        }
+    }
+}
+
+REGIST_OPERATOR_CPU(BlockSparseConv_float, BlockSparseConvolutionOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(BlockSparseConv_double, BlockSparseConvolutionOp<double, CPUContext>)
+
+} /* namespace mlfe */
@@ -1,6 +1,7 @@
 #ifndef __CAST_OP_HPP__
 #define __CAST_OP_HPP__
 #include "operator.hpp"
+#include "../utils/parallel.hpp"
 
 namespace mlfe{
 
@@ -22,13 +23,14 @@ protected:
     struct TypeCaster<TypeLists<FirstType, Types...>, To...>{
         static void Run(
                         TensorBlob<DeviceContext> *from,
-                        TensorBlob<DeviceContext> *to
+                        TensorBlob<DeviceContext> *to,
+                        const double scale
                         ){
             if(from->template MatchType<FirstType>()){
-                TypeCast<FirstType, To...>(from, to);
+                TypeCast<FirstType, To...>(from, to, scale);
             }
             else{
-                TypeCaster<TypeLists<Types...>, To...>::Run(from, to);
+                TypeCaster<TypeLists<Types...>, To...>::Run(from, to, scale);
             }
         }
     };
@@ -37,28 +39,45 @@ protected:
     struct TypeCaster<TypeLists<>, To...>{
         static void Run(
                         TensorBlob<DeviceContext> *from,
-                        TensorBlob<DeviceContext> *to
+                        TensorBlob<DeviceContext> *to,
+                        const double scale
                         ){
             throw std::string("No Type");
         }
     };
     
+    /*
+     * the scale is multiplied in the same pass,
+     * so a fused cast + scale reads and writes the data only once.
+     */
     template <class From, class To>
     static void TypeCast(
                   TensorBlob<DeviceContext> *from,
-                  TensorBlob<DeviceContext> *to
+                  TensorBlob<DeviceContext> *to,
+                  const double scale
                   ){
         const From *from_ptr = from->template GetPtrConst<From>();
         To *to_ptr = to->template GetPtrMutable<To>();
-        for(int n = 0; n < from->Size(); ++n){
-            to_ptr[n] = static_cast<To>(from_ptr[n]);
-        }
+        parallel_for(0, from->Size(), parallel_grain, [=](int begin, int end){
+            if(scale == 1.){
+                for(int n = begin; n < end; ++n){
+                    to_ptr[n] = static_cast<To>(from_ptr[n]);
+                }
+            }
+            else{
+                const To s = static_cast<To>(scale);
+                for(int n = begin; n < end; ++n){
+                    to_ptr[n] = static_cast<To>(from_ptr[n]) * s;
+                }
+            }
+        });
     }
     
 private:
     enum InputSchema{x};
     enum OutputSchema{y};
     std::string cast;
+    double scale;
 };
 
 } /* namespace mlfe */
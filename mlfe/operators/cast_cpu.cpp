@@ -18,10 +18,26 @@ CastOp<CPUContext>::CastOp(
     auto y = outputs[OutputSchema::y];
     runtime_assert(opio.param.HasParam("Cast"),
                    "[Cast Op] Not found Cast param.");
+    cast = opio.param.GetParam<std::string>("Cast");
+    /*
+     * Scale param is set by the fusion pass, when a scale op is merged into the cast.
+     * it is read in the casted type as the scale op does.
+     */
+    scale = 1.;
+    if(opio.param.HasParam("Scale")){
+        if(!cast.compare("float")){
+            scale = opio.param.GetParam<float>("Scale");
+        }
+        else if(!cast.compare("double")){
+            scale = opio.param.GetParam<double>("Scale");
+        }
+        else{
+            throw std::string("[Cast Op] Scale param needs float or double.");
+        }
+    }
     if(y->IsEmpty() &&
        !x->IsEmpty()
        ){
-        cast = opio.param.GetParam<std::string>("Cast");
         if(!cast.compare("char")){
             y->Resize<char>(*x);
         }
@@ -49,16 +65,16 @@ void CastOp<CPUContext>::Compute(){
     const auto x = inputs[InputSchema::x];
     auto y = outputs[OutputSchema::y];
     if(!cast.compare("char")){
-        TypeCaster<TypeLists<char, unsigned char, int, float, double>, char>::Run(x, y);
+        TypeCaster<TypeLists<char, unsigned char, int, float, double>, char>::Run(x, y, scale);
     }
     else if(!cast.compare("int")){
-        TypeCaster<TypeLists<char, unsigned char, int, float, double>, int>::Run(x, y);
+        TypeCaster<TypeLists<char, unsigned char, int, float, double>, int>::Run(x, y, scale);
     }
     else if(!cast.compare("float")){
-        TypeCaster<TypeLists<char, unsigned char, int, float, double>, float>::Run(x, y);
+        TypeCaster<TypeLists<char, unsigned char, int, float, double>, float>::Run(x, y, scale);
     }
     else if(!cast.compare("double")){
-        TypeCaster<TypeLists<char, unsigned char, int, float, double>, double>::Run(x, y);
+        TypeCaster<TypeLists<char, unsigned char, int, float, double>, double>::Run(x, y, scale);
     }
     else{
         throw std::string("Wrong Type.");
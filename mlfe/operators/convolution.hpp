@@ -21,15 +21,65 @@ protected:
                            "[Convolution With Eigen Op] Not Found : Padding Param.");
             stride = opio.param.GetParam<std::vector<int>>("Stride");
             padding = opio.param.GetParam<int>("Padding");
+            group = 1;
+            if(opio.param.HasParam("Group")){
+                group = opio.param.GetParam<int>("Group");
+            }
+            if(opio.param.HasParam("Filters")){
+                filters = opio.param.GetParam<int>("Filters");
+            }
+            if(opio.param.HasParam("Kernel")){
+                kernel_size = opio.param.GetParam<std::vector<int>>("Kernel");
+            }
+            /*
+             * Activation param is set by the fusion pass,
+             * when a relu right after the convolution is merged into it.
+             */
+            fuse_relu = false;
+            if(opio.param.HasParam("Activation")){
+                runtime_assert(!opio.param.GetParam<std::string>("Activation").compare("Relu"),
+                               "[Convolution Op] Activation param only supports Relu.");
+                fuse_relu = true;
+            }
+            /*
+             * the layout follows the input tensor,
+             * unless it is given explicitly by Layout param.
+             */
+            layout = this->inputs[0]->Layout();
+            if(opio.param.HasParam("Layout")){
+                layout = LayoutFromString(opio.param.GetParam<std::string>("Layout"));
+            }
         }
     
+    int HeightAxis(){
+        return layout == DataLayout::NHWC ? 1 : 2;
+    }
+    
+    int WidthAxis(){
+        return layout == DataLayout::NHWC ? 2 : 3;
+    }
+    
+    int ChannelAxis(){
+        return layout == DataLayout::NHWC ? 3 : 1;
+    }
+    
+    /*
+     * true when every input channel is its own group,
+     * each channel makes filters / group outputs.
+     */
+    bool IsDepthwise(){
+        return group > 1 &&
+        group == this->inputs[0]->Dim(ChannelAxis()) &&
+        filters % group == 0;
+    }
+    
     int OutHeightSize(){
-        int height = this->inputs[0]->Dim(2);
+        int height = this->inputs[0]->Dim(HeightAxis());
         return (height + 2 * padding - kernel_size[0]) / stride[0] + 1;
     }
     
     int OutWidthSize(){
-        int width = this->inputs[0]->Dim(3);
+        int width = this->inputs[0]->Dim(WidthAxis());
         return (width + 2 * padding - kernel_size[1]) / stride[1] + 1;
     }
     
@@ -37,6 +87,20 @@ protected:
     std::vector<int> stride;
     int filters;
     int padding;
+    /*
+     * channels and filters are split into group parts,
+     * and a filter only sees the channels of its part.
+     */
+    int group;
+    /*
+     * y = max(conv(x) + b, 0), and the gradient takes y to mask dy.
+     */
+    bool fuse_relu;
+    /*
+     * NCHW : x{N, C, H, W}, w{filters, C / group, kernel_h, kernel_w}, y{N, filters, out_h, out_w}
+     * NHWC : x{N, H, W, C}, w{filters, kernel_h, kernel_w, C / group}, y{N, out_h, out_w, filters}
+     */
+    DataLayout layout;
 };
 
 } /* namespace mlfe */
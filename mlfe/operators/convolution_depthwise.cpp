@@ -0,0 +1,136 @@
+#ifndef __CONVOLUTION_DEPTHWISE_OP_HPP__
+#define __CONVOLUTION_DEPTHWISE_OP_HPP__
+#include <Eigen/Core>
+#include "../device_context/cpu_context.hpp"
+#include "../math/depthwise_conv.hpp"
+#include "../core/tensor_blob.hpp"
+#include "../core/param_def.hpp"
+#include "convolution.hpp"
+
+namespace mlfe{
+
+/*
+ * convolution with Group == input channels.
+ * it runs the dedicated depthwise kernels instead of a dense conv per channel,
+ * and its gradient is handled by Conv's gradient operator.
+ */
+template <class DataType>
+class ConvolutionDepthwiseOp : public ConvolutionBaseOp<CPUContext>{
+public:
+    explicit ConvolutionDepthwiseOp(
+                                    OperatorIO &opio,
+                                    ItemHolder *ih
+                                    ) : ConvolutionBaseOp<CPUContext>(opio, ih){
+        runtime_assert(inputs.size() == 3,
+                       "[Convolution Depthwise Op] inputs.size() == 3");
+        runtime_assert(outputs.size() == 1,
+                       "[Convolution Depthwise Op] outputs.size() == 1");
+        const auto x = inputs[InputSchema::x];
+        const auto w = inputs[InputSchema::w];
+        const auto b = inputs[InputSchema::b];
+        auto y = outputs[OutputSchema::y];
+        
+        if(opio.param.HasParam("Filters") &&
+           opio.param.HasParam("Kernel") &&
+           w->IsEmpty() &&
+           b->IsEmpty() &&
+           y->IsEmpty() &&
+           !x->IsEmpty() &&
+           x->Dims() == 4){
+            runtime_assert(IsDepthwise(),
+                           "[Convolution Depthwise Op] Group must be the number of input channels.");
+            if(layout == DataLayout::NHWC){
+                w->template Resize<DataType>({filters, kernel_size[0], kernel_size[1], 1});
+                y->template Resize<DataType>({x->Dim(0), OutHeightSize(), OutWidthSize(), filters});
+            }
+            else{
+                w->template Resize<DataType>({filters, 1, kernel_size[0], kernel_size[1]});
+                y->template Resize<DataType>({x->Dim(0), filters, OutHeightSize(), OutWidthSize()});
+            }
+            b->template Resize<DataType>({filters});
+            y->SetLayout(layout);
+        }
+        else{
+            runtime_assert(x->Dims() == 4,
+                           "[Convolution Depthwise Op] x->Dims() == 4");
+            runtime_assert(kernel_size.size() == 2,
+                           "[Convolution Depthwise Op] : kernel.size() == 2");
+            runtime_assert(w->Dim(0) == b->Size(),
+                           "[Convolution Depthwise Op] : filter->Dim(0) == bias->Size()");
+        }
+        
+        if(layout == DataLayout::NHWC){
+            kernel_buf.Resize<DataType, CPUContext>({kernel_size[0], kernel_size[1], filters});
+        }
+        kernel_cached = false;
+        kernel_version = 0;
+    }
+    
+    void Compute() override{
+        const auto x = inputs[InputSchema::x];
+        const auto w = inputs[InputSchema::w];
+        const auto b = inputs[InputSchema::b];
+        auto y = outputs[OutputSchema::y];
+        const int channels = x->Dim(ChannelAxis());
+        
+        if(layout == DataLayout::NHWC){
+            UpdateKernelBuffer();
+            math::depthwise_conv_nhwc<DataType, CPUContext>(
+                                                            x->Dim(0), channels, filters / channels,
+                                                            x->Dim(1), x->Dim(2),
+                                                            kernel_size[0], kernel_size[1],
+                                                            stride[0], stride[1],
+                                                            padding, padding,
+                                                            fuse_relu,
+                                                            x->template GetPtrConst<DataType>(),
+                                                            kernel_buf.template GetPtrConst<DataType>(),
+                                                            b->template GetPtrConst<DataType>(),
+                                                            y->template GetPtrMutable<DataType>()
+                                                            );
+        }
+        else{
+            math::depthwise_conv_nchw<DataType, CPUContext>(
+                                                            x->Dim(0), channels, filters / channels,
+                                                            x->Dim(2), x->Dim(3),
+                                                            kernel_size[0], kernel_size[1],
+                                                            stride[0], stride[1],
+                                                            padding, padding,
+                                                            fuse_relu,
+                                                            x->template GetPtrConst<DataType>(),
+                                                            w->template GetPtrConst<DataType>(),
+                                                            b->template GetPtrConst<DataType>(),
+                                                            y->template GetPtrMutable<DataType>()
+                                                            );
+        }
+    }
+
+private:
+    /*
+     * reorder w{filters, kernel_h, kernel_w, 1} into kernel_buf{kernel_h, kernel_w, filters},
+     * only when the weights have been modified since the last reorder.
+     */
+    void UpdateKernelBuffer(){
+        using Matrix = Eigen::Matrix<DataType, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+        const auto w = inputs[InputSchema::w];
+        const int kernel_area = kernel_size[0] * kernel_size[1];
+        if(kernel_cached && kernel_version == w->Version()){
+            return;
+        }
+        Eigen::Map<Matrix>(kernel_buf.template GetPtrMutable<DataType>(), kernel_area, filters) =
+        Eigen::Map<const Matrix>(w->template GetPtrConst<DataType>(), filters, kernel_area).transpose();
+        kernel_version = w->Version();
+        kernel_cached = true;
+    }
+    
+    enum InputSchema{x, w, b};
+    enum OutputSchema{y};
+    TensorBlob<CPUContext> kernel_buf;
+    bool kernel_cached;
+    unsigned int kernel_version;
+};
+
+REGIST_OPERATOR_CPU(Conv_float_Depthwise, ConvolutionDepthwiseOp<float>)
+REGIST_OPERATOR_CPU(Conv_double_Depthwise, ConvolutionDepthwiseOp<double>)
+
+} /* namespace mlfe */
+#endif /* __CONVOLUTION_DEPTHWISE_OP_HPP__ */
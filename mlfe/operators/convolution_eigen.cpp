@@ -4,6 +4,8 @@
 #include "../device_context/cpu_context.hpp"
 #include "../math/blas.hpp"
 #include "../math/transform.hpp"
+#include "../math/depthwise_conv.hpp"
+#include "../math/functions.hpp"
 #include "../core/tensor_blob.hpp"
 #include "../core/param_def.hpp"
 #include "convolution.hpp"
@@ -25,6 +27,8 @@ public:
         const auto w = inputs[InputSchema::w];
         const auto b = inputs[InputSchema::b];
         auto y = outputs[OutputSchema::y];
+        runtime_assert(group == 1,
+                       "[Convolution With Eigen Op] Group param is not supported.");
         
         if(opio.param.HasParam("Filters") &&
            opio.param.HasParam("Kernel") &&
@@ -33,13 +37,18 @@ public:
            y->IsEmpty() &&
            !x->IsEmpty() &&
            x->Dims() == 4){
-            filters = opio.param.GetParam<int>("Filters");
-            kernel_size = opio.param.GetParam<std::vector<int>>("Kernel");
             out_h = OutHeightSize();
             out_w = OutWidthSize();
-            w->template Resize<DataType>({filters, x->Dim(1), kernel_size[0], kernel_size[1]});
+            if(layout == DataLayout::NHWC){
+                w->template Resize<DataType>({filters, kernel_size[0], kernel_size[1], x->Dim(3)});
+                y->template Resize<DataType>({x->Dim(0), out_h, out_w, filters});
+            }
+            else{
+                w->template Resize<DataType>({filters, x->Dim(1), kernel_size[0], kernel_size[1]});
+                y->template Resize<DataType>({x->Dim(0), filters, out_h, out_w});
+            }
             b->template Resize<DataType>({filters});
-            y->template Resize<DataType>({x->Dim(0), filters, out_h, out_w});
+            y->SetLayout(layout);
         }
         else{
             runtime_assert(x->Dims() == 4,
@@ -49,72 +58,356 @@ public:
             runtime_assert(w->Dim(0) == b->Size(),
                            "[Convolution With Eigen Op] : filter->Dim(0) == bias->Size()");
         }
+        
+        /*
+         * NCHW needs staging buffers in NHWC order, and NHWC a buffer of the patches.
+         * they are allocated once here and reused by every Compute call.
+         */
+        if(layout == DataLayout::NCHW){
+            x_buf.Resize<DataType, CPUContext>({x->Dim(0), x->Dim(2), x->Dim(3), x->Dim(1)});
+            kernel_buf.Resize<DataType, CPUContext>({w->Dim(2), w->Dim(3), w->Dim(1), w->Dim(0)});
+            y_buf.Resize<DataType, CPUContext>({y->Dim(0), y->Dim(2), y->Dim(3), y->Dim(1)});
+        }
+        else{
+            col_buf.Resize<DataType, CPUContext>({y->Size() / y->Dim(3), w->Size() / w->Dim(0)});
+        }
+        kernel_cached = false;
+        kernel_version = 0;
     }
     
     void Compute() override{
+        if(layout == DataLayout::NHWC){
+            ComputeNHWC();
+        }
+        else{
+            ComputeNCHW();
+        }
+    }
+    
+private:
+    /*
+     * reorder w{filters, C, kernel_h, kernel_w} into kernel_buf{kernel_h, kernel_w, C, filters},
+     * only when the weights have been modified since the last reorder.
+     */
+    void UpdateKernelBuffer(){
+        using namespace Eigen;
+        const auto w = inputs[InputSchema::w];
+        if(kernel_cached && kernel_version == w->Version()){
+            return;
+        }
+        TensorMap<Tensor<DataType, 4, RowMajor>>(
+                                                 kernel_buf.template GetPtrMutable<DataType>(),
+                                                 w->Dim(2),
+                                                 w->Dim(3),
+                                                 w->Dim(1),
+                                                 w->Dim(0)
+                                                 ) = TensorMap<Tensor<const DataType, 4, RowMajor>>(
+                                                                                                    w->template GetPtrConst<DataType>(),
+                                                                                                    w->Dim(0),
+                                                                                                    w->Dim(1),
+                                                                                                    w->Dim(2),
+                                                                                                    w->Dim(3)
+                                                                                                    ).shuffle(Eigen::array<int, 4>{{2, 3, 1, 0}});
+        kernel_version = w->Version();
+        kernel_cached = true;
+    }
+    
+    void ComputeNCHW(){
         using namespace Eigen;
         const auto x = inputs[InputSchema::x];
         const auto w = inputs[InputSchema::w];
         const auto b = inputs[InputSchema::b];
         auto y = outputs[OutputSchema::y];
+        const int kernel_area = w->Size() / w->Dim(0);
+        
+        UpdateKernelBuffer();
+        
+        TensorMap<Tensor<DataType, 4, RowMajor>> x_t(
+                                                     x_buf.template GetPtrMutable<DataType>(),
+                                                     x->Dim(0),
+                                                     x->Dim(2),
+                                                     x->Dim(3),
+                                                     x->Dim(1)
+                                                     );
+        
+        TensorMap<Tensor<const DataType, 2, RowMajor>> kernel_t(
+                                                                kernel_buf.template GetPtrConst<DataType>(),
+                                                                kernel_area,
+                                                                w->Dim(0)
+                                                                );
         
-        Tensor<DataType, 4, RowMajor> x_t = TensorMap<Tensor<DataType, 4, RowMajor>>(
-                                                                                     x->template GetPtrMutable<DataType>(),
-                                                                                     x->Dim(0),
-                                                                                     x->Dim(1),
-                                                                                     x->Dim(2),
-                                                                                     x->Dim(3)
-                                                                                     ).shuffle(Eigen::array<int, 4>{{0, 2, 3, 1}});
+        TensorMap<Tensor<DataType, 4, RowMajor>> y_t(
+                                                     y_buf.template GetPtrMutable<DataType>(),
+                                                     y->Dim(0),
+                                                     y->Dim(2),
+                                                     y->Dim(3),
+                                                     y->Dim(1)
+                                                     );
         
-        Tensor<DataType, 4, RowMajor> kernel_t = TensorMap<Tensor<DataType, 4, RowMajor>>(
-                                                                                          w->template GetPtrMutable<DataType>(),
-                                                                                          w->Dim(0),
-                                                                                          w->Dim(1),
-                                                                                          w->Dim(2),
-                                                                                          w->Dim(3)
-                                                                                          ).shuffle(Eigen::array<int, 4>{{2, 3, 1, 0}});
+        TensorMap<Tensor<const DataType, 4, RowMajor>> b_t(
+                                                           b->template GetPtrConst<DataType>(),
+                                                           1, b->Size(), 1, 1
+                                                           );
         
-        Tensor<DataType, 4, RowMajor> y_t(y->Dim(0), y->Dim(2), y->Dim(3), y->Dim(1));
+        x_t = TensorMap<Tensor<const DataType, 4, RowMajor>>(
+                                                             x->template GetPtrConst<DataType>(),
+                                                             x->Dim(0),
+                                                             x->Dim(1),
+                                                             x->Dim(2),
+                                                             x->Dim(3)
+                                                             ).shuffle(Eigen::array<int, 4>{{0, 2, 3, 1}});
         
+        /*
+         * on row major tensors, eigen's patch rows run along the width axis.
+         */
         y_t = x_t.extract_image_patches(
-                                        w->Dim(2),
                                         w->Dim(3),
-                                        stride[0], stride[1],
+                                        w->Dim(2),
+                                        stride[1], stride[0],
                                         1, 1,
                                         1, 1,
                                         padding, padding,
                                         padding, padding,
                                         0)
-        .reshape(Eigen::array<int, 2>{{y->Size() / y->Dim(1), w->Size() / w->Dim(0)}})
+        .reshape(Eigen::array<int, 2>{{y->Size() / y->Dim(1), kernel_area}})
         .contract(
-                  kernel_t.reshape(Eigen::array<int, 2>{{w->Size() / w->Dim(0), w->Dim(0)}}),
+                  kernel_t,
                   Eigen::array<IndexPair<int>, 1>{{IndexPair<int>(1, 0)}}
                   )
         .reshape(y_t.dimensions());
         
-        Map<Array<DataType, Dynamic, Dynamic, RowMajor>> y_arr(y_t.data(), y->Dim(1), y->Size() / y->Dim(1));
-        Map<Array<DataType, Dynamic, 1>> b_arr(b->template GetPtrMutable<DataType>(), b->Size(), 1);
-        y_arr = y_arr.colwise() + b_arr;
+        /*
+         * the bias and the fused relu are applied while shuffling back to the output.
+         */
+        TensorMap<Tensor<DataType, 4, RowMajor>> y_out(
+                                                       y->template GetPtrMutable<DataType>(),
+                                                       y->Dim(0),
+                                                       y->Dim(1),
+                                                       y->Dim(2),
+                                                       y->Dim(3)
+                                                       );
+        auto y_biased = y_t.shuffle(Eigen::array<int, 4>{{0, 3, 1, 2}}) +
+        b_t.broadcast(Eigen::array<int, 4>{{y->Dim(0), 1, y->Dim(2), y->Dim(3)}});
+        if(fuse_relu){
+            y_out = y_biased.cwiseMax(DataType(0));
+        }
+        else{
+            y_out = y_biased;
+        }
+    }
+    
+    /*
+     * x, w and y are already in the order which the patch gemm needs,
+     * so it runs directly on the tensor blobs without any shuffle.
+     * the patches are gathered into col_buf, and the gemm adds the bias
+     * and the fused relu while it writes y.
+     */
+    void ComputeNHWC(){
+        using namespace Eigen;
+        const auto x = inputs[InputSchema::x];
+        const auto w = inputs[InputSchema::w];
+        const auto b = inputs[InputSchema::b];
+        auto y = outputs[OutputSchema::y];
+        const int kernel_area = w->Size() / w->Dim(0);
+        const int rows = y->Size() / y->Dim(3);
         
-        TensorMap<Tensor<DataType, 4, RowMajor>>(
-                                                 y->template GetPtrMutable<DataType>(),
-                                                 y->Dim(0),
-                                                 y->Dim(1),
-                                                 y->Dim(2),
-                                                 y->Dim(3)
-                                                 ) = y_t.shuffle(Eigen::array<int, 4>{{0, 3, 1, 2}});
+        TensorMap<Tensor<const DataType, 4, RowMajor>> x_t(
+                                                           x->template GetPtrConst<DataType>(),
+                                                           x->Dim(0),
+                                                           x->Dim(1),
+                                                           x->Dim(2),
+                                                           x->Dim(3)
+                                                           );
+        
+        TensorMap<Tensor<DataType, 2, RowMajor>> col_t(
+                                                       col_buf.template GetPtrMutable<DataType>(),
+                                                       rows,
+                                                       kernel_area
+                                                       );
+        
+        col_t = x_t.extract_image_patches(
+                                          w->Dim(2),
+                                          w->Dim(1),
+                                          stride[1], stride[0],
+                                          1, 1,
+                                          1, 1,
+                                          padding, padding,
+                                          padding, padding,
+                                          0)
+        .reshape(Eigen::array<int, 2>{{rows, kernel_area}});
+        
+        /*
+         * col({rows, kernel_area}) * w({filters, kernel_area})^T
+         *  + b({filters}) on every row = y({rows, filters})
+         */
+        math::GemmEpilogue<DataType> epilogue;
+        epilogue.col_bias = b->template GetPtrConst<DataType>();
+        epilogue.relu = fuse_relu;
+        math::gemm<DataType, CPUContext>(
+                                         false, true, rows, w->Dim(0), kernel_area,
+                                         DataType(1), col_buf.template GetPtrConst<DataType>(), kernel_area,
+                                         w->template GetPtrConst<DataType>(), kernel_area,
+                                         DataType(0), y->template GetPtrMutable<DataType>(), w->Dim(0),
+                                         epilogue, nullptr
+                                         );
     }
     
-private:
     enum InputSchema{x, w, b};
     enum OutputSchema{y};
     int out_h;
     int out_w;
+    TensorBlob<CPUContext> x_buf;
+    TensorBlob<CPUContext> kernel_buf;
+    TensorBlob<CPUContext> y_buf;
+    /*
+     * image patches of NHWC, {N * out_h * out_w, kernel_h * kernel_w * C}.
+     */
+    TensorBlob<CPUContext> col_buf;
+    bool kernel_cached;
+    unsigned int kernel_version;
 };
 
 REGIST_OPERATOR_CPU(Conv_float_Eigen, ConvolutionWithEigenOp<float>)
 REGIST_OPERATOR_CPU(Conv_double_Eigen, ConvolutionWithEigenOp<double>)
 
+/*
+ * im2col + gemm forward, per sample.
+ * it works on the tensor blobs in both layouts without any reorder,
+ * so it is often faster than eigen's patch contraction on small inputs.
+ */
+template <class DataType>
+class ConvolutionIm2ColOp : public ConvolutionBaseOp<CPUContext>{
+public:
+    explicit ConvolutionIm2ColOp(
+                                 OperatorIO &opio,
+                                 ItemHolder *ih
+                                 ) : ConvolutionBaseOp<CPUContext>(opio, ih){
+        runtime_assert(inputs.size() == 3,
+                       "[Convolution Im2Col Op] inputs.size() == 3");
+        runtime_assert(outputs.size() == 1,
+                       "[Convolution Im2Col Op] outputs.size() == 1");
+        const auto x = inputs[InputSchema::x];
+        const auto w = inputs[InputSchema::w];
+        const auto b = inputs[InputSchema::b];
+        auto y = outputs[OutputSchema::y];
+        runtime_assert(group == 1 || layout == DataLayout::NCHW,
+                       "[Convolution Im2Col Op] Group param is only supported on NCHW.");
+        
+        if(opio.param.HasParam("Filters") &&
+           opio.param.HasParam("Kernel") &&
+           w->IsEmpty() &&
+           b->IsEmpty() &&
+           y->IsEmpty() &&
+           !x->IsEmpty() &&
+           x->Dims() == 4){
+            runtime_assert(x->Dim(ChannelAxis()) % group == 0 && filters % group == 0,
+                           "[Convolution Im2Col Op] channels and filters must be divisible by group.");
+            if(layout == DataLayout::NHWC){
+                w->template Resize<DataType>({filters, kernel_size[0], kernel_size[1], x->Dim(3)});
+                y->template Resize<DataType>({x->Dim(0), OutHeightSize(), OutWidthSize(), filters});
+            }
+            else{
+                w->template Resize<DataType>({filters, x->Dim(1) / group, kernel_size[0], kernel_size[1]});
+                y->template Resize<DataType>({x->Dim(0), filters, OutHeightSize(), OutWidthSize()});
+            }
+            b->template Resize<DataType>({filters});
+            y->SetLayout(layout);
+        }
+        else{
+            runtime_assert(x->Dims() == 4,
+                           "[Convolution Im2Col Op] x->Dims() == 4");
+            runtime_assert(kernel_size.size() == 2,
+                           "[Convolution Im2Col Op] : kernel.size() == 2");
+            runtime_assert(w->Dim(0) == b->Size(),
+                           "[Convolution Im2Col Op] : filter->Dim(0) == bias->Size()");
+        }
+        
+        m = filters / group;
+        n = OutHeightSize() * OutWidthSize();
+        k = kernel_size[0] * kernel_size[1] * x->Dim(ChannelAxis()) / group;
+        
+        col_buf.Resize<DataType, CPUContext>({k * group, n});
+    }
+    
+    void Compute() override{
+        const auto x = inputs[InputSchema::x];
+        const auto w = inputs[InputSchema::w];
+        const auto b = inputs[InputSchema::b];
+        auto y = outputs[OutputSchema::y];
+        const DataType *x_ptr = x->template GetPtrConst<DataType>();
+        const DataType *w_ptr = w->template GetPtrConst<DataType>();
+        const DataType *b_ptr = b->template GetPtrConst<DataType>();
+        DataType *col_ptr = col_buf.template GetPtrMutable<DataType>();
+        DataType *y_ptr = y->template GetPtrMutable<DataType>();
+        math::GemmEpilogue<DataType> epilogue;
+        epilogue.relu = fuse_relu;
+        
+        for(int i = 0; i < x->Dim(0); ++i){
+            if(layout == DataLayout::NHWC){
+                math::im2col_nhwc<DataType, CPUContext>(
+                                                        x->Dim(3), x->Dim(1), x->Dim(2),
+                                                        kernel_size[0], kernel_size[1],
+                                                        stride[0], stride[1],
+                                                        padding, padding,
+                                                        x_ptr, col_ptr
+                                                        );
+                /*
+                 * col({out_size, kernel_size}) * w({filters, kernel_size})^T
+                 *  + b({filters}) on every row = y({out_size, filters})
+                 */
+                epilogue.col_bias = b_ptr;
+                math::gemm<DataType, CPUContext>(
+                                                 false, true, n, m, k,
+                                                 DataType(1), col_ptr, k,
+                                                 w_ptr, k,
+                                                 DataType(0), y_ptr, m,
+                                                 epilogue, nullptr
+                                                 );
+            }
+            else{
+                math::im2col<DataType, CPUContext>(
+                                                   x->Dim(1), x->Dim(2), x->Dim(3),
+                                                   kernel_size[0], kernel_size[1],
+                                                   stride[0], stride[1],
+                                                   padding, padding,
+                                                   x_ptr, col_ptr
+                                                   );
+                /*
+                 * w({filters, kernel_size}) * col({kernel_size, out_size})
+                 *  + b({filters}) on every column = y({filters, out_size})
+                 * each group multiplies its own rows of w, col, b and y.
+                 */
+                for(int g = 0; g < group; ++g){
+                    epilogue.row_bias = b_ptr + g * m;
+                    math::gemm<DataType, CPUContext>(
+                                                     false, false, m, n, k,
+                                                     DataType(1), w_ptr + g * m * k, k,
+                                                     col_ptr + g * k * n, n,
+                                                     DataType(0), y_ptr + g * m * n, n,
+                                                     epilogue, nullptr
+                                                     );
+                }
+            }
+            x_ptr += x->Size() / x->Dim(0);
+            y_ptr += filters * n;
+        }
+    }
+    
+private:
+    enum InputSchema{x, w, b};
+    enum OutputSchema{y};
+    TensorBlob<CPUContext> col_buf;
+    /*
+     * Variables for GEMM.
+     */
+    int m;
+    int n;
+    int k;
+};
+
+REGIST_OPERATOR_CPU(Conv_float_Im2Col, ConvolutionIm2ColOp<float>)
+REGIST_OPERATOR_CPU(Conv_double_Im2Col, ConvolutionIm2ColOp<double>)
+
 template <class DataType>
 class ConvolutionGradientOp : public ConvolutionBaseOp<CPUContext>{
 public:
@@ -122,8 +415,8 @@ public:
                                    OperatorIO &opio,
                                    ItemHolder *ih
                                    ) : ConvolutionBaseOp<CPUContext>(opio, ih){
-        runtime_assert(inputs.size() == 3,
-                       "[Convolution Gradient Op] inputs.size() == 3");
+        runtime_assert(inputs.size() == (fuse_relu ? 4 : 3),
+                       "[Convolution Gradient Op] inputs.size() == 3, or 4 with fused relu.");
         runtime_assert(outputs.size() == 3,
                        "[Convolution Gradient Op] outputs.size() == 3");
         const auto x = inputs[InputSchema::x];
@@ -142,8 +435,8 @@ public:
            !w->IsEmpty() &&
            !dy->IsEmpty()
            ){
-            filters = opio.param.GetParam<int>("Filters");
-            kernel_size = opio.param.GetParam<std::vector<int>>("Kernel");
+            runtime_assert(group == 1 || layout == DataLayout::NCHW || IsDepthwise(),
+                           "[Convolution Gradient Op] Group param on NHWC is only supported for depthwise.");
             dw->template Resize<DataType>(*w);
             db->template Resize<DataType>({filters});
             dx->template Resize<DataType>(*x);
@@ -157,28 +450,31 @@ public:
                            "[Convolution Gradient Op] : w->Size() == dw->Size()");
         }
         
-        m = filters;
+        m = filters / group;
         n = OutHeightSize() * OutWidthSize();
-        k = kernel_size[0] * kernel_size[1] * x->Dim(1);
-        
-        bias_multiplier.Resize<DataType, CPUContext>({n});
-        bias_multiplier.SetByConst<DataType>(DataType(1));
+        k = kernel_size[0] * kernel_size[1] * x->Dim(ChannelAxis()) / group;
         
-        col_buf.Resize<DataType, CPUContext>({k, n});
+        if(IsDepthwise()){
+            if(layout == DataLayout::NHWC){
+                kernel_buf.Resize<DataType, CPUContext>({kernel_size[0], kernel_size[1], filters});
+                dw_buf.Resize<DataType, CPUContext>({kernel_size[0], kernel_size[1], filters});
+            }
+        }
+        else{
+            col_buf.Resize<DataType, CPUContext>({k * group, n});
+        }
+        if(fuse_relu){
+            dy_buf.Resize<DataType>(*dy);
+        }
+        kernel_cached = false;
+        kernel_version = 0;
     }
     
     void Compute() override{
-        const auto x = inputs[InputSchema::x];
-        const auto w = inputs[InputSchema::w];
-        const auto dy = inputs[InputSchema::dy];
-        auto dw = outputs[OutputSchema::dw];
-        auto db = outputs[OutputSchema::db];
-        auto dx = outputs[OutputSchema::dx];
-        int batch_size = x->Dim(0);
-        const DataType *x_ptr = x->template GetPtrConst<DataType>();
-        const DataType *dy_ptr = dy->template GetPtrMutable<DataType>();
-        DataType *col_ptr = col_buf.template GetPtrMutable<DataType>();
-        DataType *dx_ptr = dx->template GetPtrMutable<DataType>();
+        const auto dw = outputs[OutputSchema::dw];
+        const auto db = outputs[OutputSchema::db];
+        const auto dx = outputs[OutputSchema::dx];
+        const int batch_size = inputs[InputSchema::x]->Dim(0);
         
         math::scal<DataType, CPUContext>(
                                          dx->Size(), DataType(0),
@@ -196,85 +492,265 @@ public:
                                          db->template GetPtrMutable<DataType>()
                                          );
         
+        /*
+         * the fused relu passes dy only where y > 0.
+         */
+        if(fuse_relu){
+            const auto y = inputs[InputSchema::y];
+            const auto dy = inputs[InputSchema::dy];
+            math::ReluGradientFunction<DataType, CPUContext>(
+                                                             dy->Size(),
+                                                             y->template GetPtrConst<DataType>(),
+                                                             dy->template GetPtrConst<DataType>(),
+                                                             dy_buf.template GetPtrMutable<DataType>()
+                                                             );
+        }
+        
+        if(IsDepthwise()){
+            ComputeDepthwise();
+        }
+        else if(layout == DataLayout::NHWC){
+            ComputeNHWC();
+        }
+        else{
+            ComputeNCHW();
+        }
+        
+        math::scal<DataType, CPUContext>(
+                                         db->Size(),
+                                         DataType(1) / static_cast<DataType>(batch_size),
+                                         db->template GetPtrConst<DataType>(),
+                                         db->template GetPtrMutable<DataType>()
+                                         );
+        
+        math::scal<DataType, CPUContext>(
+                                         dw->Size(),
+                                         DataType(1) / static_cast<DataType>(batch_size),
+                                         dw->template GetPtrConst<DataType>(),
+                                         dw->template GetPtrMutable<DataType>()
+                                         );
+    }
+    
+private:
+    const DataType *DyPtr(){
+        if(fuse_relu){
+            return dy_buf.template GetPtrConst<DataType>();
+        }
+        return inputs[InputSchema::dy]->template GetPtrConst<DataType>();
+    }
+    
+    void ComputeNCHW(){
+        const auto x = inputs[InputSchema::x];
+        const auto w = inputs[InputSchema::w];
+        auto dw = outputs[OutputSchema::dw];
+        auto db = outputs[OutputSchema::db];
+        auto dx = outputs[OutputSchema::dx];
+        int batch_size = x->Dim(0);
+        const DataType *x_ptr = x->template GetPtrConst<DataType>();
+        const DataType *dy_ptr = DyPtr();
+        DataType *col_ptr = col_buf.template GetPtrMutable<DataType>();
+        DataType *dx_ptr = dx->template GetPtrMutable<DataType>();
+        
         for(int i = 0; i < batch_size; ++i){
             /*
              * gradient w.r.t. bias.
              */
-            math::gemv<DataType, CPUContext>(
-                                             false, m, n,
-                                             DataType(1), dy_ptr, n,
-                                             bias_multiplier.template GetPtrConst<DataType>(), DataType(1),
-                                             db->template GetPtrMutable<DataType>(), DataType(1), nullptr
-                                             );
+            math::rowwise_sum<DataType, CPUContext>(
+                                                    filters, n, dy_ptr, DataType(1),
+                                                    db->template GetPtrMutable<DataType>()
+                                                    );
             
             math::im2col<DataType, CPUContext>(
                                                x->Dim(1), x->Dim(2), x->Dim(3),
                                                kernel_size[0], kernel_size[1],
-                                               stride[0], padding,
+                                               stride[0], stride[1],
+                                               padding, padding,
                                                x_ptr, col_ptr
                                                );
             
+            for(int g = 0; g < group; ++g){
+                /*
+                 * Calculate gradients of weights.
+                 * kernel_size = {kernel_h, kernel_w, channel_of_x / group} = k
+                 * filters / group = {number of feature map channel in a group} = m
+                 * out_size = {y_h, y_w} = n
+                 * dy({filters, out_size}) * col({kernel_size, out_size})^T
+                 *  = dw({filters, kernel_size})
+                 */
+                math::gemm<DataType, CPUContext>(
+                                                 false, true, m, k, n,
+                                                 DataType(1), dy_ptr + g * m * n, n,
+                                                 col_ptr + g * k * n, n,
+                                                 DataType(1), dw->template GetPtrMutable<DataType>() + g * m * k, k, nullptr
+                                                 );
+                
+                /*
+                 * Calculate loss to propagate through bottom.
+                 * w({filters, kernel_size})^T * dy({filters, out_size})
+                 *  = col({kernel_size, out_size})
+                 */
+                math::gemm<DataType, CPUContext>(
+                                                 true, false, k, n, m,
+                                                 DataType(1), w->template GetPtrConst<DataType>() + g * m * k, k,
+                                                 dy_ptr + g * m * n, n,
+                                                 DataType(0), col_ptr + g * k * n, n, nullptr
+                                                 );
+            }
+            
+            math::col2im<DataType, CPUContext>(
+                                               col_ptr,
+                                               x->Dim(1), x->Dim(2), x->Dim(3),
+                                               kernel_size[0], kernel_size[1],
+                                               stride[0], stride[1],
+                                               padding, padding,
+                                               dx_ptr
+                                               );
+            
             /*
-             * Calculate gradients of weights.
-             * kernel_size = {kernel_h, kernel_w, channel_of_x} = k
-             * filters = {number of feature map channel} = m
-             * out_size = {y_h, y_w} = n
-             * dy({filters, out_size}) * col({kernel_size, out_size})^T
+             * next batch.
+             */
+            x_ptr += x->Size() / x->Dim(0);
+            dx_ptr += dx->Size() / dx->Dim(0);
+            dy_ptr += n * filters;
+        }
+    }
+    
+    /*
+     * same as NCHW, but col is {out_size, kernel_size} and dy is {out_size, filters},
+     * so the gemm operands are transposed.
+     */
+    void ComputeNHWC(){
+        const auto x = inputs[InputSchema::x];
+        const auto w = inputs[InputSchema::w];
+        auto dw = outputs[OutputSchema::dw];
+        auto db = outputs[OutputSchema::db];
+        auto dx = outputs[OutputSchema::dx];
+        int batch_size = x->Dim(0);
+        const DataType *x_ptr = x->template GetPtrConst<DataType>();
+        const DataType *dy_ptr = DyPtr();
+        DataType *col_ptr = col_buf.template GetPtrMutable<DataType>();
+        DataType *dx_ptr = dx->template GetPtrMutable<DataType>();
+        
+        /*
+         * gradient w.r.t. bias, dy is {batch * out_size, filters}.
+         */
+        math::colwise_sum<DataType, CPUContext>(
+                                                batch_size * n, m, dy_ptr, DataType(1),
+                                                db->template GetPtrMutable<DataType>()
+                                                );
+        
+        for(int i = 0; i < batch_size; ++i){
+            math::im2col_nhwc<DataType, CPUContext>(
+                                                    x->Dim(3), x->Dim(1), x->Dim(2),
+                                                    kernel_size[0], kernel_size[1],
+                                                    stride[0], stride[1],
+                                                    padding, padding,
+                                                    x_ptr, col_ptr
+                                                    );
+            
+            /*
+             * dy({out_size, filters})^T * col({out_size, kernel_size})
              *  = dw({filters, kernel_size})
              */
             math::gemm<DataType, CPUContext>(
-                                             false, true, m, k, n,
-                                             DataType(1), dy_ptr, n,
-                                             col_ptr, n,
+                                             true, false, m, k, n,
+                                             DataType(1), dy_ptr, m,
+                                             col_ptr, k,
                                              DataType(1), dw->template GetPtrMutable<DataType>(), k, nullptr
                                              );
             
             /*
-             * Calculate loss to propagate through bottom.
-             * w({filters, kernel_size})^T * dy({filters, out_size})
-             *  = col({kernel_size, out_size})
+             * dy({out_size, filters}) * w({filters, kernel_size})
+             *  = col({out_size, kernel_size})
              */
             math::gemm<DataType, CPUContext>(
-                                             true, false, k, n, m,
-                                             DataType(1), w->template GetPtrConst<DataType>(), k,
-                                             dy_ptr, n,
-                                             DataType(0), col_ptr, n, nullptr
+                                             false, false, n, k, m,
+                                             DataType(1), dy_ptr, m,
+                                             w->template GetPtrConst<DataType>(), k,
+                                             DataType(0), col_ptr, k, nullptr
                                              );
             
-            math::col2im<DataType, CPUContext>(
-                                               col_ptr,
-                                               x->Dim(1), x->Dim(2), x->Dim(3),
-                                               kernel_size[1], stride[0], padding,
-                                               dx_ptr
-                                               );
+            math::col2im_nhwc<DataType, CPUContext>(
+                                                    col_ptr,
+                                                    x->Dim(3), x->Dim(1), x->Dim(2),
+                                                    kernel_size[0], kernel_size[1],
+                                                    stride[0], stride[1],
+                                                    padding, padding,
+                                                    dx_ptr
+                                                    );
             
-            /*
-             * next batch.
-             */
             x_ptr += x->Size() / x->Dim(0);
             dx_ptr += dx->Size() / dx->Dim(0);
             dy_ptr += n * m;
         }
+    }
+    
+    /*
+     * depthwise kernels run on the whole batch at once.
+     * on NHWC, they take w and dw in {kernel_h, kernel_w, filters} order.
+     */
+    void ComputeDepthwise(){
+        using Matrix = Eigen::Matrix<DataType, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+        const auto x = inputs[InputSchema::x];
+        const auto w = inputs[InputSchema::w];
+        auto dw = outputs[OutputSchema::dw];
+        auto db = outputs[OutputSchema::db];
+        auto dx = outputs[OutputSchema::dx];
+        const int channels = x->Dim(ChannelAxis());
+        const int kernel_area = kernel_size[0] * kernel_size[1];
         
-        math::scal<DataType, CPUContext>(
-                                         db->Size(),
-                                         DataType(1) / static_cast<DataType>(batch_size),
-                                         db->template GetPtrConst<DataType>(),
-                                         db->template GetPtrMutable<DataType>()
-                                         );
-        
-        math::scal<DataType, CPUContext>(
-                                         dw->Size(),
-                                         DataType(1) / static_cast<DataType>(batch_size),
-                                         dw->template GetPtrConst<DataType>(),
-                                         dw->template GetPtrMutable<DataType>()
-                                         );
+        if(layout == DataLayout::NHWC){
+            /*
+             * w is transposed again only when it has been modified since.
+             */
+            if(!kernel_cached || kernel_version != w->Version()){
+                Eigen::Map<Matrix>(kernel_buf.template GetPtrMutable<DataType>(), kernel_area, filters) =
+                Eigen::Map<const Matrix>(w->template GetPtrConst<DataType>(), filters, kernel_area).transpose();
+                kernel_version = w->Version();
+                kernel_cached = true;
+            }
+            dw_buf.SetByConst<DataType>(DataType(0));
+            math::depthwise_conv_nhwc_gradient<DataType, CPUContext>(
+                                                                     x->Dim(0), channels, filters / channels,
+                                                                     x->Dim(1), x->Dim(2),
+                                                                     kernel_size[0], kernel_size[1],
+                                                                     stride[0], stride[1],
+                                                                     padding, padding,
+                                                                     x->template GetPtrConst<DataType>(),
+                                                                     kernel_buf.template GetPtrConst<DataType>(),
+                                                                     DyPtr(),
+                                                                     dw_buf.template GetPtrMutable<DataType>(),
+                                                                     db->template GetPtrMutable<DataType>(),
+                                                                     dx->template GetPtrMutable<DataType>()
+                                                                     );
+            Eigen::Map<Matrix>(dw->template GetPtrMutable<DataType>(), filters, kernel_area) =
+            Eigen::Map<const Matrix>(dw_buf.template GetPtrConst<DataType>(), kernel_area, filters).transpose();
+        }
+        else{
+            math::depthwise_conv_nchw_gradient<DataType, CPUContext>(
+                                                                     x->Dim(0), channels, filters / channels,
+                                                                     x->Dim(2), x->Dim(3),
+                                                                     kernel_size[0], kernel_size[1],
+                                                                     stride[0], stride[1],
+                                                                     padding, padding,
+                                                                     x->template GetPtrConst<DataType>(),
+                                                                     w->template GetPtrConst<DataType>(),
+                                                                     DyPtr(),
+                                                                     dw->template GetPtrMutable<DataType>(),
+                                                                     db->template GetPtrMutable<DataType>(),
+                                                                     dx->template GetPtrMutable<DataType>()
+                                                                     );
+        }
     }
-private:
-    enum InputSchema{x, w, dy};
+    
+    enum InputSchema{x, w, dy, y};
     enum OutputSchema{dw, db, dx};
+    TensorBlob<CPUContext> dy_buf;
+    TensorBlob<CPUContext> kernel_buf;
+    TensorBlob<CPUContext> dw_buf;
     TensorBlob<CPUContext> col_buf;
-    TensorBlob<CPUContext> bias_multiplier;
+    bool kernel_cached;
+    unsigned int kernel_version;
     /*
      * Variables for GEMM.
      */
@@ -294,6 +770,9 @@ struct ConvolutionGradientIO : public GradientIO{
         opio_grad.inputs.push_back(opio.inputs[0]);
         opio_grad.inputs.push_back(opio.inputs[1]);
         opio_grad.inputs.push_back(opio.outputs[0] + "_grad");
+        if(opio.param.HasParam("Activation")){
+            opio_grad.inputs.push_back(opio.outputs[0]);
+        }
         opio_grad.outputs.push_back(opio.inputs[1] + "_grad");
         opio_grad.outputs.push_back(opio.inputs[2] + "_grad");
         opio_grad.outputs.push_back(opio.inputs[0] + "_grad");
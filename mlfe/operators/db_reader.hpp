@@ -1,9 +1,11 @@
 #ifndef __DB_READER_OP_HPP__
 #define __DB_READER_OP_HPP__
-#include <queue>
-#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include "operator.hpp"
 #include "../utils/thread_pool.hpp"
+#include "../utils/ring_buffer.hpp"
 #include "../utils/db/data_base.hpp"
 #include "../utils/db/simple_db.hpp"
 #include "../utils/assert.hpp"
@@ -11,6 +13,12 @@
 
 namespace mlfe{
 
+/*
+ * Reads batches of a database, a loader thread keeps Prefetch (2) batches ready ahead.
+ * The records of a batch are decoded by up to MaxLoaders (1) threads,
+ * of which SetLoaders decides how many take part, while training runs.
+ * With Layout NHWC, the NCHW records are transposed into an NHWC data output.
+ */
 template <class DataType, class DeviceContext>
 class DBReaderOp final : public Operator<DeviceContext>{
 public:
@@ -23,6 +31,37 @@ public:
     
     void Compute() override;
     
+    /*
+     * threads decoding the next batches, from 1 to MaxLoaders.
+     */
+    void SetLoaders(int loaders){
+        runtime_assert(loaders >= 1 && loaders <= max_loaders,
+                       "[DB Reader Op] 1 <= loaders <= MaxLoaders.");
+        active_loaders = loaders;
+    }
+    
+    int Loaders() const{
+        return active_loaders;
+    }
+    
+    int MaxLoaders() const{
+        return max_loaders;
+    }
+    
+    /*
+     * milliseconds the last Compute waited for its batch.
+     */
+    double LastStall() const{
+        return last_stall_ms;
+    }
+    
+    /*
+     * the part of the prefetched batches, that was ready when the last Compute began.
+     */
+    double LastOccupancy() const{
+        return last_occupancy;
+    }
+    
 protected:
     void OpenDB(std::string path, std::string type){
         if(!type.compare("SimpleDB")){
@@ -36,40 +75,87 @@ protected:
         db->MoveToFirst();
     }
     
-    void FillBuffer(){
-        if(!wanna_fill.empty()){
-            flatbuffers::FlatBufferBuilder builder;
-            auto tbs = wanna_fill.front();
-            wanna_fill.pop();
-            for(int b = 0; b < batch_size; ++b){
-                const serializable::TensorBlobs * serialized_tb;
-                std::string serialized_data;
-                unsigned int data_size = (tbs[0]->Size() / tbs[0]->Dim(0));
-                db->Get(serialized_data);
-                builder.PushFlatBuffer(reinterpret_cast<const unsigned char *>(serialized_data.data()), serialized_data.size());
-                serialized_tb = serializable::GetTensorBlobs(builder.GetBufferPointer());
-                
-                tbs[0]->CopyToDevice(
-                                     b * data_size,
-                                     data_size,
-                                     static_cast<const unsigned char *>(serialized_tb->tensors()->Get(0)->data()->data())
-                                     );
-                
-                if(has_label){
-                    data_size = 1;
-                    
-                    tbs[1]->CopyToDevice(
-                                         b * data_size,
-                                         data_size,
+    struct Batch{
+        TensorBlob<DeviceContext> data;
+        TensorBlob<DeviceContext> label;
+    };
+    
+    /*
+     * the records are read in order by the loader thread, since the cursor is not shared,
+     * and decoded in parts by the active loaders.
+     */
+    void FillBatch(Batch &batch){
+        for(int b = 0; b < batch_size; ++b){
+            db->Get(records[b]);
+            if(!db->MoveToNext()){
+                db->MoveToFirst();
+            }
+        }
+        const int loaders = active_loaders;
+        const int part = (batch_size + loaders - 1) / loaders;
+        TaskGroup group(&background_worker);
+        for(int from = part; from < batch_size; from += part){
+            const int to = std::min(from + part, batch_size);
+            group.Run([this, &batch, from, to](){ Decode(batch, from, to); });
+        }
+        Decode(batch, 0, std::min(part, batch_size));
+        group.Wait();
+    }
+    
+    void Decode(Batch &batch, const int from, const int to){
+        flatbuffers::FlatBufferBuilder builder;
+        const unsigned int data_size = (batch.data.Size() / batch.data.Dim(0));
+        for(int b = from; b < to; ++b){
+            const serializable::TensorBlobs * serialized_tb;
+            builder.PushFlatBuffer(reinterpret_cast<const unsigned char *>(records[b].data()), records[b].size());
+            serialized_tb = serializable::GetTensorBlobs(builder.GetBufferPointer());
+            
+            const unsigned char *record_data =
+                static_cast<const unsigned char *>(serialized_tb->tensors()->Get(0)->data()->data());
+            if(channels_last){
+                /*
+                 * records are stored as CHW, and written out as HWC.
+                 */
+                const int spatial = data_size / channels;
+                unsigned char *dst = batch.data.template GetPtrMutable<unsigned char>() + b * data_size;
+                for(int c = 0; c < channels; ++c){
+                    for(int p = 0; p < spatial; ++p){
+                        dst[p * channels + c] = record_data[c * spatial + p];
+                    }
+                }
+            }
+            else{
+                batch.data.CopyToDevice(b * data_size, data_size, record_data);
+            }
+            
+            if(has_label){
+                batch.label.CopyToDevice(
+                                         b,
+                                         1,
                                          static_cast<const unsigned char *>(serialized_tb->tensors()->Get(1)->data()->data())
                                          );
-                }
-                builder.Clear();
-                if(!db->MoveToNext()){
-                    db->MoveToFirst();
-                }
             }
-            wanna_consume.push(tbs);
+            builder.Clear();
+        }
+    }
+    
+    /*
+     * runs on the loader thread until the ring is closed,
+     * and fills every slot as soon as Compute gives it back.
+     */
+    void LoadBatches(){
+        try{
+            while(Batch *batch = batches->BeginWrite()){
+                FillBatch(*batch);
+                batches->EndWrite();
+            }
+        }
+        catch(...){
+            /*
+             * Compute sees the closed ring, and rethrows from loading.
+             */
+            batches->Close();
+            throw;
         }
     }
     
@@ -77,9 +163,31 @@ private:
     enum OutputSchema{y, label};
     int batch_size;
     bool has_label;
+    /*
+     * the data output is NHWC, of channels channels.
+     */
+    bool channels_last;
+    int channels;
+    int max_loaders;
+    std::atomic<int> active_loaders;
+    double last_stall_ms;
+    double last_occupancy;
+    /*
+     * serialized records of the batch being filled.
+     */
+    std::vector<std::string> records;
+    /*
+     * the loader thread and the decoding threads.
+     */
     ThreadPool background_worker;
-    std::queue<std::vector<std::shared_ptr<TensorBlob<DeviceContext>>>> wanna_consume;
-    std::queue<std::vector<std::shared_ptr<TensorBlob<DeviceContext>>>> wanna_fill;
+    /*
+     * preallocated batches, passed between the loader and Compute.
+     */
+    std::unique_ptr<SPSCRing<Batch>> batches;
+    /*
+     * LoadBatches, which ends when the ring is closed or the database fails.
+     */
+    std::future<void> loading;
     std::shared_ptr<DataBase> db;
 };
 
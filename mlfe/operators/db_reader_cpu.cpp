@@ -1,7 +1,9 @@
+#include <chrono>
 #include "db_reader.hpp"
 #include "../device_context/cpu_context.hpp"
 #include "../utils/db/simple_db.hpp"
 #include "../utils/assert.hpp"
+#include "../utils/affinity.hpp"
 #include "../flatbuffers/tensor_blob_fb_generated.h"
 
 namespace mlfe{
@@ -11,11 +13,12 @@ DBReaderOp<unsigned char, CPUContext>
 ::DBReaderOp(
              OperatorIO &opio,
              ItemHolder *ih
-             ) : Operator<CPUContext>(opio, ih), background_worker(1){
+             ) : Operator<CPUContext>(opio, ih),
+                 max_loaders(opio.param.HasParam("MaxLoaders") ? opio.param.GetParam<int>("MaxLoaders") : 1),
+                 background_worker(std::max(max_loaders, 1), [](int index){ PinCurrentThread(ThreadRole::Loader, index); }){
     std::string db_path, db_type;
     std::vector<int> data_dim, label_dim;
-    std::vector<std::shared_ptr<TensorBlob<CPUContext>>> tbs;
-    std::shared_ptr<TensorBlob<CPUContext>> buffer_data, buffer_label;
+    int prefetch = 2;
     has_label = false;
     
     runtime_assert(opio.param.HasParam("DatabasePath"),
@@ -41,55 +44,81 @@ DBReaderOp<unsigned char, CPUContext>
         runtime_assert(Outputs() == 1,
                        "[DB Reader Op] Outputs() == 1");
     }
+    if(opio.param.HasParam("Prefetch")){
+        prefetch = opio.param.GetParam<int>("Prefetch");
+        runtime_assert(prefetch > 0, "[DB Reader Op] Prefetch > 0.");
+    }
+    runtime_assert(max_loaders > 0, "[DB Reader Op] MaxLoaders > 0.");
     batch_size = data_dim[0];
+    active_loaders = 1;
+    last_stall_ms = 0.;
+    last_occupancy = 1.;
+    records.resize(batch_size);
+    
+    channels_last = false;
+    channels = 1;
+    if(opio.param.HasParam("Layout")){
+        channels_last = LayoutFromString(opio.param.GetParam<std::string>("Layout")) == DataLayout::NHWC;
+    }
     
     OpenDB(db_path, db_type);
-    buffer_data = std::make_shared<TensorBlob<CPUContext>>();
-    buffer_label = std::make_shared<TensorBlob<CPUContext>>();
-    outputs[0]->Resize<unsigned char>(data_dim);
+    /*
+     * DataShape is the NCHW shape of the records, an NHWC output is transposed while decoding.
+     */
+    if(channels_last){
+        runtime_assert(data_dim.size() == 4, "[DB Reader Op] NHWC needs a DataShape of 4 dims.");
+        channels = data_dim[1];
+        outputs[0]->Resize<unsigned char>({data_dim[0], data_dim[2], data_dim[3], data_dim[1]});
+        outputs[0]->SetLayout(DataLayout::NHWC);
+    }
+    else{
+        outputs[0]->Resize<unsigned char>(data_dim);
+    }
     outputs[1]->Resize<unsigned char>(label_dim);
-    buffer_data->Resize<unsigned char>(*outputs[0]);
-    buffer_label->Resize<unsigned char>(*outputs[1]);
-    tbs.push_back(buffer_data);
-    tbs.push_back(buffer_label);
-    wanna_fill.push(tbs);
-    background_worker.AddTask(std::bind(&DBReaderOp<unsigned char, CPUContext>::FillBuffer, this), 0);
+    batches.reset(new SPSCRing<Batch>(prefetch));
+    for(int n = 0; n < prefetch; ++n){
+        batches->Slot(n).data.Resize<unsigned char>(*outputs[0]);
+        batches->Slot(n).label.Resize<unsigned char>(*outputs[1]);
+    }
+    loading = background_worker.Submit(std::bind(&DBReaderOp<unsigned char, CPUContext>::LoadBatches, this));
 }
 
 template <>
 DBReaderOp<unsigned char, CPUContext>::~DBReaderOp(){
+    /*
+     * the loader still reads the database, until it sees the closed ring.
+     */
+    batches->Close();
+    background_worker.Shutdown();
     if(db->IsOpen()){
         db->Close();
     }
-    background_worker.Wait(0);
 }
 
 template <>
 void DBReaderOp<unsigned char, CPUContext>::Compute(){
-    if(wanna_consume.empty()){
-        if(!background_worker.IsFinished(0)){
-            background_worker.Wait(0);
-        }
+    last_occupancy = static_cast<double>(batches->Size()) / batches->Capacity();
+    const auto wait_begin = std::chrono::steady_clock::now();
+    Batch *batch = batches->BeginRead();
+    last_stall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wait_begin).count();
+    if(batch == nullptr){
+        loading.get();
+        throw std::string("[DB Reader Op] the loader has stopped.");
     }
-    
-    auto vec_of_tb = wanna_consume.front();
-    wanna_consume.pop();
     outputs[0]->CopyToDevice(
                              0,
-                             vec_of_tb[0]->Size(),
-                             vec_of_tb[0]->GetPtrConst<unsigned char>()
+                             batch->data.Size(),
+                             batch->data.GetPtrConst<unsigned char>()
                              );
     
     if(has_label){
         outputs[1]->CopyToDevice(
                                  0,
-                                 vec_of_tb[1]->Size(),
-                                 vec_of_tb[1]->GetPtrConst<unsigned char>()
+                                 batch->label.Size(),
+                                 batch->label.GetPtrConst<unsigned char>()
                                  );
     }
-    
-    wanna_fill.push(vec_of_tb);
-    background_worker.AddTask(std::bind(&DBReaderOp::FillBuffer, this), 0);
+    batches->EndRead();
 }
 
 REGIST_OPERATOR_CPU(DBReader_uchar, DBReaderOp<unsigned char, CPUContext>)
@@ -0,0 +1,68 @@
+#ifndef __EMBEDDING_OP_HPP__
+#define __EMBEDDING_OP_HPP__
+#include <unordered_map>
+#include "operator.hpp"
+
+namespace mlfe{
+
+/*
+ * gathers rows of the table w{rows, dim} by the unsigned char or int indices of ids.
+ * Embedding : y has the dims of ids followed by dim.
+ * EmbeddingBag : ids is {m, n}, and the n rows of each sample are pooled into y{m, dim}.
+ *
+ * Params :
+ *   Rows, Dim, to create w.
+ *   Mode, "Sum" (default) or "Mean", pooling of EmbeddingBag.
+ */
+template <class DataType, class DeviceContext>
+class EmbeddingOp final : public Operator<DeviceContext>{
+public:
+    explicit EmbeddingOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+    
+private:
+    enum InputSchema{ids, w};
+    enum OutputSchema{y};
+    
+    template <class IdType>
+    void Gather(const IdType *ids_ptr);
+    
+    bool bag;
+    bool mean;
+    int m;
+    int n;
+    int rows;
+    int dim;
+};
+
+/*
+ * the gradient of w is row sparse, dw{capacity, dim} holds the touched rows,
+ * and dw_rows{capacity} their indices in w, followed by -1 for unused entries.
+ * like FC, the gradient is divided by the batch size.
+ */
+template <class DataType, class DeviceContext>
+class EmbeddingGradientOp final : public Operator<DeviceContext>{
+public:
+    explicit EmbeddingGradientOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+    
+private:
+    enum InputSchema{ids, w, dy};
+    enum OutputSchema{dw, dw_rows};
+    
+    template <class IdType>
+    void Scatter(const IdType *ids_ptr);
+    
+    std::unordered_map<int, int> slot_of_row;
+    bool bag;
+    bool mean;
+    int m;
+    int n;
+    int rows;
+    int dim;
+};
+
+} /* namespace mlfe */
+#endif /* __EMBEDDING_OP_HPP__ */
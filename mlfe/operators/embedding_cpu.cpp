@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <Eigen/Core>
+#include "embedding.hpp"
+#include "../device_context/cpu_context.hpp"
+#include "../utils/assert.hpp"
+
+namespace mlfe{
+
+template <class DT, class DC>
+EmbeddingOp<DT, DC>::EmbeddingOp(
+                                 OperatorIO &opio,
+                                 ItemHolder *ih
+                                 ) : Operator<DC>(opio, ih) {
+    runtime_assert(this->inputs.size() == 2,
+                   "[Embedding Op] inputs.size() == 2.");
+    runtime_assert(this->outputs.size() == 1,
+                   "[Embedding Op] outputs.size() == 1.");
+    bag = !opio.type.compare("EmbeddingBag");
+    mean = false;
+    if(opio.param.HasParam("Mode")){
+        const auto mode = opio.param.GetParam<std::string>("Mode");
+        runtime_assert(!mode.compare("Sum") || !mode.compare("Mean"),
+                       "[Embedding Op] Mode is Sum or Mean.");
+        mean = !mode.compare("Mean");
+    }
+    
+    const auto ids = this->inputs[InputSchema::ids];
+    const auto w = this->inputs[InputSchema::w];
+    auto y = this->outputs[OutputSchema::y];
+    
+    runtime_assert(ids->template MatchType<unsigned char>() || ids->template MatchType<int>(),
+                   "[Embedding Op] ids type must be unsigned char or int.");
+    runtime_assert(!bag || ids->Dims() == 2,
+                   "[Embedding Op] ids->Dims() == 2 for EmbeddingBag.");
+    if(opio.param.HasParam("Rows") && opio.param.HasParam("Dim") && w->IsEmpty()){
+        w->template Resize<DT>({opio.param.GetParam<int>("Rows"), opio.param.GetParam<int>("Dim")});
+    }
+    runtime_assert(w->Dims() == 2,
+                   "[Embedding Op] w->Dims() == 2.");
+    
+    /*
+     * batch size, and number of ids of a sample.
+     */
+    m = ids->Dim(0);
+    n = ids->Size() / m;
+    rows = w->Dim(0);
+    dim = w->Dim(1);
+    
+    std::vector<int> y_dims = {m, dim};
+    if(!bag){
+        y_dims.clear();
+        for(int i = 0; i < ids->Dims(); ++i){
+            y_dims.push_back(ids->Dim(i));
+        }
+        y_dims.push_back(dim);
+    }
+    if(y->IsEmpty()){
+        y->template Resize<DT>(y_dims);
+    }
+    else{
+        runtime_assert(y->Size() == (bag ? m : m * n) * dim,
+                       "[Embedding Op] y->Size() matches ids and w.");
+    }
+}
+
+template <class DT, class DC>
+template <class IdType>
+void EmbeddingOp<DT, DC>::Gather(const IdType *ids_ptr){
+    using Array = Eigen::Array<DT, Eigen::Dynamic, 1>;
+    const DT *w_ptr = this->inputs[InputSchema::w]->template GetPtrConst<DT>();
+    DT *y_ptr = this->outputs[OutputSchema::y]->template GetPtrMutable<DT>();
+    for(int p = 0; p < m * n; ++p){
+        const int row = static_cast<int>(ids_ptr[p]);
+        runtime_assert(row >= 0 && row < rows, "[Embedding Op] id is out of the table.");
+    }
+    if(!bag){
+        for(int p = 0; p < m * n; ++p){
+            std::copy(w_ptr + ids_ptr[p] * dim, w_ptr + (ids_ptr[p] + 1) * dim, y_ptr + p * dim);
+        }
+        return;
+    }
+    for(int i = 0; i < m; ++i){
+        Eigen::Map<Array> y_row(y_ptr + i * dim, dim);
+        y_row.setZero();
+        for(int j = 0; j < n; ++j){
+            y_row += Eigen::Map<const Array>(w_ptr + ids_ptr[i * n + j] * dim, dim);
+        }
+        if(mean){
+            y_row /= static_cast<DT>(n);
+        }
+    }
+}
+
+template <class DT, class DC>
+void EmbeddingOp<DT, DC>::Compute(){
+    const auto ids = this->inputs[InputSchema::ids];
+    if(ids->template MatchType<unsigned char>()){
+        Gather<unsigned char>(ids->template GetPtrConst<unsigned char>());
+    }
+    else{
+        Gather<int>(ids->template GetPtrConst<int>());
+    }
+}
+
+REGIST_OPERATOR_CPU(Embedding_float, EmbeddingOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(Embedding_double, EmbeddingOp<double, CPUContext>)
+REGIST_OPERATOR_CPU(EmbeddingBag_float, EmbeddingOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(EmbeddingBag_double, EmbeddingOp<double, CPUContext>)
+
+template <class DT, class DC>
+EmbeddingGradientOp<DT, DC>::EmbeddingGradientOp(
+                                                 OperatorIO &opio,
+                                                 ItemHolder *ih
+                                                 ) : Operator<DC>(opio, ih) {
+    runtime_assert(this->inputs.size() == 3,
+                   "[Embedding Gradient Op] inputs.size() == 3.");
+    runtime_assert(this->outputs.size() == 2,
+                   "[Embedding Gradient Op] outputs.size() == 2.");
+    bag = opio.type.find("EmbeddingBag") == 0;
+    mean = opio.param.HasParam("Mode") && !opio.param.GetParam<std::string>("Mode").compare("Mean");
+    
+    const auto ids = this->inputs[InputSchema::ids];
+    const auto w = this->inputs[InputSchema::w];
+    auto dw = this->outputs[OutputSchema::dw];
+    auto dw_rows = this->outputs[OutputSchema::dw_rows];
+    
+    m = ids->Dim(0);
+    n = ids->Size() / m;
+    rows = w->Dim(0);
+    dim = w->Dim(1);
+    /*
+     * a step touches at most all ids, or all rows.
+     */
+    const int capacity = std::min(m * n, rows);
+    if(dw->IsEmpty() && dw_rows->IsEmpty()){
+        dw->template Resize<DT>({capacity, dim});
+        dw_rows->template Resize<int>({capacity});
+    }
+    else{
+        runtime_assert(dw->Dim(0) == capacity && dw->Dim(1) == dim,
+                       "[Embedding Gradient Op] dw->Dims() == {capacity, dim}.");
+        runtime_assert(dw_rows->Size() == capacity,
+                       "[Embedding Gradient Op] dw_rows->Size() == capacity.");
+    }
+    dw_rows->template SetByConst<int>(-1);
+    slot_of_row.reserve(capacity);
+}
+
+template <class DT, class DC>
+template <class IdType>
+void EmbeddingGradientOp<DT, DC>::Scatter(const IdType *ids_ptr){
+    using Array = Eigen::Array<DT, Eigen::Dynamic, 1>;
+    const DT *dy_ptr = this->inputs[InputSchema::dy]->template GetPtrConst<DT>();
+    auto dw = this->outputs[OutputSchema::dw];
+    auto dw_rows = this->outputs[OutputSchema::dw_rows];
+    DT *dw_ptr = dw->template GetPtrMutable<DT>();
+    int *rows_ptr = dw_rows->template GetPtrMutable<int>();
+    const DT scale = (mean ? DT(1) / static_cast<DT>(n) : DT(1)) / static_cast<DT>(m);
+    
+    slot_of_row.clear();
+    for(int p = 0; p < m * n; ++p){
+        const int row = static_cast<int>(ids_ptr[p]);
+        auto it = slot_of_row.find(row);
+        int slot;
+        if(it == slot_of_row.end()){
+            slot = slot_of_row.size();
+            slot_of_row[row] = slot;
+            rows_ptr[slot] = row;
+            Eigen::Map<Array>(dw_ptr + slot * dim, dim).setZero();
+        }
+        else{
+            slot = it->second;
+        }
+        const int dy_row = bag ? p / n : p;
+        Eigen::Map<Array>(dw_ptr + slot * dim, dim) += scale * Eigen::Map<const Array>(dy_ptr + dy_row * dim, dim);
+    }
+    std::fill(rows_ptr + slot_of_row.size(), rows_ptr + dw_rows->Size(), -1);
+}
+
+template <class DT, class DC>
+void EmbeddingGradientOp<DT, DC>::Compute(){
+    const auto ids = this->inputs[InputSchema::ids];
+    if(ids->template MatchType<unsigned char>()){
+        Scatter<unsigned char>(ids->template GetPtrConst<unsigned char>());
+    }
+    else{
+        Scatter<int>(ids->template GetPtrConst<int>());
+    }
+}
+
+REGIST_OPERATOR_CPU(Embedding_float_Gradient, EmbeddingGradientOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(Embedding_double_Gradient, EmbeddingGradientOp<double, CPUContext>)
+REGIST_OPERATOR_CPU(EmbeddingBag_float_Gradient, EmbeddingGradientOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(EmbeddingBag_double_Gradient, EmbeddingGradientOp<double, CPUContext>)
+
+struct EmbeddingGradientIO : public GradientIO{
+    OperatorIO GetGradientIO(OperatorIO opio) override{
+        OperatorIO opio_grad;
+        opio_grad.type = opio.type + "_" + opio.data_type + "_Gradient";
+        opio_grad.data_type = opio.data_type;
+        opio_grad.inputs.push_back(opio.inputs[0]);
+        opio_grad.inputs.push_back(opio.inputs[1]);
+        opio_grad.inputs.push_back(opio.outputs[0] + "_grad");
+        opio_grad.outputs.push_back(opio.inputs[1] + "_grad");
+        opio_grad.outputs.push_back(opio.inputs[1] + "_grad_rows");
+        opio_grad.param = opio.param;
+        
+        return opio_grad;
+    }
+};
+
+REGIST_OPERATOR_GRADIENT_IO(Embedding, EmbeddingGradientIO);
+REGIST_OPERATOR_GRADIENT_IO(EmbeddingBag, EmbeddingGradientIO);
+
+} /* namespace mlfe */
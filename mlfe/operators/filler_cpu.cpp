@@ -1,8 +1,10 @@
+#include <algorithm>
 #include "filler.hpp"
 #include "../device_context/cpu_context.hpp"
 #include "../math/blas.hpp"
 #include "../math/functions.hpp"
 #include "../utils/assert.hpp"
+#include "../utils/parallel.hpp"
 
 namespace mlfe{
 
@@ -38,9 +40,10 @@ template <class DT, class DC>
 void ConstantFillOp<DT, DC>::Compute(){
     auto y = this->outputs[OutputSchema::y];
     DT *ptr = y->template GetPtrMutable<DT>();
-    for(int n = 0; n < y->Size(); ++n){
-        ptr[n] = val;
-    }
+    const DT val = this->val;
+    parallel_for(0, y->Size(), parallel_grain, [=](int from, int to){
+        std::fill(ptr + from, ptr + to, val);
+    });
 }
 
 REGIST_OPERATOR_CPU(ConstantFill_float, ConstantFillOp<float, CPUContext>)
@@ -63,9 +66,22 @@ template <class DT, class DC>
 void XavierFillOp<DT, DC>::Compute(){
     auto y = this->outputs[OutputSchema::y];
     DT *ptr = y->template GetPtrMutable<DT>();
-    for(int n = 0; n < y->Size(); ++n){
-        ptr[n] = uniform(this->rng);
-    }
+    const int size = y->Size();
+    /*
+     * every block of parallel_grain elements draws from its own engine,
+     * seeded by the op's engine and the block, so the values do not depend on the threads.
+     */
+    const unsigned int seed = this->rng();
+    parallel_for(0, (size + parallel_grain - 1) / parallel_grain, 1, [&](int from, int to){
+        for(int block = from; block < to; ++block){
+            std::seed_seq seeder{seed, static_cast<unsigned int>(block)};
+            std::mt19937 engine(seeder);
+            std::uniform_real_distribution<DT> dist(uniform.param());
+            for(int n = block * parallel_grain; n < std::min(size, (block + 1) * parallel_grain); ++n){
+                ptr[n] = dist(engine);
+            }
+        }
+    });
 }
 
 REGIST_OPERATOR_CPU(XavierFill_float, XavierFillOp<float, CPUContext>)
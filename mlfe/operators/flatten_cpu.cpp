@@ -25,6 +25,10 @@ FlattenOp<DT, DC>::FlattenOp(
         int flat_from = 1;
         int flat_to = 1;
         axis = opio.param.GetParam<int>("Axis");
+        /*
+         * NHWC input is flattened in {h, w, c} order as it lies in memory,
+         * so both layouts share the data without any transpose.
+         */
         *y = *x;
         for(int n = 0; n < axis; ++n){
             flat_from *= x->Dim(n);
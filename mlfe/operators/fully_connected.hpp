@@ -19,7 +19,10 @@ public:
 private:
     enum InputSchema{x, w, b};
     enum OutputSchema{y};
-    TensorBlob<DeviceContext> bias_multiplier;
+    /*
+     * y = max(x * w^T + b, 0), set by the fusion pass through Activation param.
+     */
+    bool fuse_relu;
     int m;
     int n;
     int k;
@@ -33,9 +36,13 @@ public:
     void Compute() override;
     
 private:
-    enum InputSchema{x, w, dy};
+    enum InputSchema{x, w, dy, y};
     enum OutputSchema{dw, db, dx};
-    TensorBlob<DeviceContext> bias_multiplier;
+    /*
+     * with the fused relu, dy is masked by y > 0 into dy_buf.
+     */
+    TensorBlob<DeviceContext> dy_buf;
+    bool fuse_relu;
     int m;
     int n;
     int k;
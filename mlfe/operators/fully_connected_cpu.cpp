@@ -1,5 +1,6 @@
 #include "fully_connected.hpp"
 #include "../device_context/cpu_context.hpp"
+#include "../math/functions.hpp"
 
 namespace mlfe{
 
@@ -12,6 +13,12 @@ FullyConnectedOp<DT, DC>::FullyConnectedOp(
                    "[Fully Connected Op] inputs.size() == 3.");
     runtime_assert(this->outputs.size() == 1,
                    "[Fully Connected Op] outputs.size() == 1.");
+    fuse_relu = false;
+    if(opio.param.HasParam("Activation")){
+        runtime_assert(!opio.param.GetParam<std::string>("Activation").compare("Relu"),
+                       "[Fully Connected Op] Activation param only supports Relu.");
+        fuse_relu = true;
+    }
     
     const auto x = this->inputs[InputSchema::x];
     const auto w = this->inputs[InputSchema::w];
@@ -41,9 +48,6 @@ FullyConnectedOp<DT, DC>::FullyConnectedOp(
                        "[Fully Connected Op] y->Dim(1) == w->Dim(0).");
     }
     
-    bias_multiplier.template Resize<DT, DC>({x->Dim(0)});
-    bias_multiplier.template SetByConst<DT>(DT(1));
-    
     /*
      * batch size.
      */
@@ -64,30 +68,22 @@ void FullyConnectedOp<DT, DC>::Compute(){
     const auto w = this->inputs[InputSchema::w];
     const auto b = this->inputs[InputSchema::b];
     auto y = this->outputs[OutputSchema::y];
+    math::GemmEpilogue<DT> epilogue;
     /*
      * Forward computation.
-     * x(batch_size x input_size) * w(output_size x input_size)^T
+     * x(batch_size x input_size) * w(output_size x input_size)^T + b
      *  = y(batch_size x output_size)
+     * the bias, and the fused relu, are applied by the gemm epilogue.
      */
+    epilogue.col_bias = b->template GetPtrConst<DT>();
+    epilogue.relu = fuse_relu;
     math::gemm<DT, DC>(
                                   false, true,
                                   m, n, k,
                                   DT(1), x->template GetPtrConst<DT>(), k,
                                   w->template GetPtrConst<DT>(), k,
-                                  DT(0), y->template GetPtrMutable<DT>(), n, nullptr
-                                  );
-    
-    /*
-     * Add the bias term.
-     * y = y + b;
-     */
-    
-    math::gemm<DT, DC>(
-                                  false, false,
-                                  m, n, 1,
-                                  DT(1), bias_multiplier.template GetPtrConst<DT>(), 1
-                                  , b->template GetPtrConst<DT>(), n,
-                                  DT(1), y->template GetPtrMutable<DT>(), n, nullptr
+                                  DT(0), y->template GetPtrMutable<DT>(), n,
+                                  epilogue, nullptr
                                   );
 }
 
@@ -99,8 +95,9 @@ FullyConnectedGradientOp<DT, DC>::FullyConnectedGradientOp(
                                                                       OperatorIO &opio,
                                                                       ItemHolder *ih
                                                                       ) : Operator<DC>(opio, ih){
-    runtime_assert(this->inputs.size() == 3,
-                   "[Fully Connected Gradient Op] inputs.size() == 3.");
+    fuse_relu = opio.param.HasParam("Activation");
+    runtime_assert(this->inputs.size() == (fuse_relu ? 4 : 3),
+                   "[Fully Connected Gradient Op] inputs.size() == 3, or 4 with fused relu.");
     runtime_assert(this->outputs.size() == 3,
                    "[Fully Connected Gradient Op] outputs.size() == 3.");
     
@@ -135,8 +132,9 @@ FullyConnectedGradientOp<DT, DC>::FullyConnectedGradientOp(
                        "[Fully Connected Gradient Op] dx->CompareSizeWith(x).");
     }
     
-    bias_multiplier.template Resize<DT, DC>({x->Dim(0)});
-    bias_multiplier.template SetByConst<DT>(DT(1));
+    if(fuse_relu){
+        dy_buf.template Resize<DT>(*dy);
+    }
     
     /*
      * batch size.
@@ -156,17 +154,30 @@ template <class DT, class DC>
 void FullyConnectedGradientOp<DT, DC>::Compute(){
     const auto x = this->inputs[InputSchema::x];
     const auto w = this->inputs[InputSchema::w];
-    const auto dy = this->inputs[InputSchema::dy];
+    auto dy = this->inputs[InputSchema::dy];
     auto dw = this->outputs[OutputSchema::dw];
     auto db = this->outputs[OutputSchema::db];
     auto dx = this->outputs[OutputSchema::dx];
+    
+    /*
+     * the fused relu passes dy only where y > 0.
+     */
+    if(fuse_relu){
+        const auto y = this->inputs[InputSchema::y];
+        math::ReluGradientFunction<DT, DC>(
+                                           dy->Size(),
+                                           y->template GetPtrConst<DT>(),
+                                           dy->template GetPtrConst<DT>(),
+                                           dy_buf.template GetPtrMutable<DT>()
+                                           );
+        dy = &dy_buf;
+    }
     /*
-     * db = dy.
+     * db = sum of dy over the batch.
      */
-    math::gemv<DT, DC>(true, m, n, DT(1),
-                                  dy->template GetPtrConst<DT>(), n,
-                                  bias_multiplier.template GetPtrConst<DT>(), DT(0),
-                                  db->template GetPtrMutable<DT>(), n, nullptr);
+    math::colwise_sum<DT, DC>(m, n,
+                              dy->template GetPtrConst<DT>(), DT(0),
+                              db->template GetPtrMutable<DT>());
     
     /*
      * Calculate gradients of weights.
@@ -217,6 +228,9 @@ struct FCGradientIO : public GradientIO{
         opio_grad.inputs.push_back(opio.inputs[0]);
         opio_grad.inputs.push_back(opio.inputs[1]);
         opio_grad.inputs.push_back(opio.outputs[0] + "_grad");
+        if(opio.param.HasParam("Activation")){
+            opio_grad.inputs.push_back(opio.outputs[0]);
+        }
         opio_grad.outputs.push_back(opio.inputs[1] + "_grad");
         opio_grad.outputs.push_back(opio.inputs[2] + "_grad");
         opio_grad.outputs.push_back(opio.inputs[0] + "_grad");
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include "fusion.hpp"
+
+namespace mlfe{
+
+namespace{
+bool Contains(const std::vector<std::string> &names, const std::string &name){
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+/*
+ * returns true and fills fused, when producer -> consumer is a known chain.
+ * the caller has checked that the consumer reads the producer's only output.
+ */
+bool MatchFusion(OperatorIO producer, OperatorIO consumer, OperatorIO &fused){
+    if(consumer.inputs.size() != 1){
+        return false;
+    }
+    if(!producer.type.compare("Cast") &&
+       !consumer.type.compare("Scale") &&
+       !producer.param.HasParam("Scale")
+       ){
+        const std::string cast = producer.param.GetParam<std::string>("Cast");
+        if(cast.compare(consumer.data_type)){
+            return false;
+        }
+        fused = producer;
+        fused.outputs = consumer.outputs;
+        if(!cast.compare("float")){
+            fused.param.Add("Scale", consumer.param.GetParam<float>("Scale"));
+        }
+        else if(!cast.compare("double")){
+            fused.param.Add("Scale", consumer.param.GetParam<double>("Scale"));
+        }
+        else{
+            return false;
+        }
+    }
+    else if((!producer.type.compare("Conv") || !producer.type.compare("FC")) &&
+            !consumer.type.compare("Relu") &&
+            !producer.data_type.compare(consumer.data_type) &&
+            !producer.param.HasParam("Activation")
+            ){
+        fused = producer;
+        fused.outputs = consumer.outputs;
+        fused.param.Add("Activation", std::string("Relu"));
+    }
+    else if(!producer.type.compare("Relu") &&
+            !consumer.type.compare("MaxPool") &&
+            !producer.data_type.compare(consumer.data_type) &&
+            !consumer.param.HasParam("Activation")
+            ){
+        fused = consumer;
+        fused.inputs = producer.inputs;
+        fused.param.Add("Activation", std::string("Relu"));
+    }
+    else{
+        return false;
+    }
+    return true;
+}
+} /* namespace */
+
+std::vector<OperatorFusion> FindOperatorFusions(std::vector<OperatorIO> ops){
+    std::vector<OperatorFusion> fusions;
+    std::vector<bool> fused_already(ops.size(), false);
+    
+    for(int p = 0; p < static_cast<int>(ops.size()); ++p){
+        if(fused_already[p] || ops[p].outputs.size() != 1){
+            continue;
+        }
+        const std::string act = ops[p].outputs[0];
+        /*
+         * the activation must have exactly one reader.
+         */
+        int consumer = -1;
+        int readers = 0;
+        for(int n = 0; n < static_cast<int>(ops.size()); ++n){
+            if(n != p && Contains(ops[n].inputs, act)){
+                consumer = n;
+                ++readers;
+            }
+        }
+        if(readers != 1 || consumer < p || fused_already[consumer]){
+            continue;
+        }
+        
+        OperatorFusion fusion;
+        if(!MatchFusion(ops[p], ops[consumer], fusion.fused)){
+            continue;
+        }
+        
+        /*
+         * the consumer's work moves up to the producer's position,
+         * so nothing in between may touch its outputs or overwrite the producer's inputs.
+         */
+        bool movable = true;
+        for(int n = p + 1; n < consumer && movable; ++n){
+            for(auto &out : ops[consumer].outputs){
+                if(Contains(ops[n].inputs, out) || Contains(ops[n].outputs, out)){
+                    movable = false;
+                }
+            }
+            for(auto &in : ops[p].inputs){
+                if(Contains(ops[n].outputs, in)){
+                    movable = false;
+                }
+            }
+        }
+        if(!movable){
+            continue;
+        }
+        
+        fusion.producer = p;
+        fusion.consumer = consumer;
+        fused_already[p] = true;
+        fused_already[consumer] = true;
+        fusions.push_back(fusion);
+    }
+    return fusions;
+}
+
+} /* namespace mlfe */
@@ -0,0 +1,38 @@
+#ifndef __FUSION_HPP__
+#define __FUSION_HPP__
+#include <string>
+#include <vector>
+#include "operator.hpp"
+
+namespace mlfe{
+
+/*
+ * ops[producer] and ops[consumer] are replaced by fused,
+ * which runs at the producer's position.
+ */
+struct OperatorFusion{
+    int producer;
+    int consumer;
+    OperatorIO fused;
+};
+
+/*
+ * Finds operator chains that can run as one operator,
+ * so that the activation between them is not written and read again.
+ * ops are operators in execution order, and a chain is fused only when
+ * the producer's output is read by the consumer alone.
+ * The fused operator reads the producer's inputs and writes the consumer's outputs,
+ * so the operators after them, and their gradients, see the same blob names.
+ *
+ * Cast + Scale -> Cast with Scale param.
+ * Conv + Relu, FC + Relu -> Conv, FC with Activation param.
+ * Relu + MaxPool -> MaxPool with Activation param.
+ * The fused relu is applied while the output is written, by the gemm epilogue
+ * of FC and Conv, or inside the other Conv kernels and MaxPool, never as a second pass.
+ *
+ * the returned fusions never share an operator, and are sorted by the producer.
+ */
+std::vector<OperatorFusion> FindOperatorFusions(std::vector<OperatorIO> ops);
+
+} /* namespace mlfe */
+#endif /* __FUSION_HPP__ */
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include "graph_executor.hpp"
+#include "../device_context/cpu_context.hpp"
+#include "../utils/parallel.hpp"
+
+namespace mlfe{
+
+namespace{
+/*
+ * a tensor an operator reads or writes.
+ */
+struct Access{
+    std::string name;
+    TensorBlob<CPUContext> *tb;
+    bool write;
+};
+
+std::vector<Access> AccessesOf(OperatorBase *op){
+    std::vector<Access> accesses;
+    auto &opio = op->GetOperatorIO();
+    for(int n = 0; n < op->Inputs(); ++n){
+        accesses.push_back({opio.inputs[n], op->Inputs(n)->Get<TensorBlob<CPUContext>>(), false});
+    }
+    for(int n = 0; n < op->Outputs(); ++n){
+        accesses.push_back({opio.outputs[n], op->Outputs(n)->Get<TensorBlob<CPUContext>>(), true});
+    }
+    return accesses;
+}
+
+bool Conflicts(const std::vector<Access> &earlier, const std::vector<Access> &later){
+    for(auto &a : earlier){
+        for(auto &b : later){
+            if(!a.write && !b.write){
+                continue;
+            }
+            if(!a.name.compare(b.name) || a.tb->SharesMemoryWith(*b.tb)){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+} /* namespace */
+
+GraphExecutor::GraphExecutor(std::vector<std::shared_ptr<OperatorBase>> ops)
+    : ops(ops), dependencies(ops.size()), successors(ops.size()), depth(0){
+    const char *env_serial = std::getenv("MLFE_SERIAL_EXECUTOR");
+    serial = env_serial != nullptr && std::string(env_serial).compare("0");
+    
+    std::vector<std::vector<Access>> accesses;
+    for(auto &op : ops){
+        accesses.push_back(AccessesOf(op.get()));
+    }
+    /*
+     * the given order is a topological order, so the chain lengths
+     * are known for every earlier operator.
+     */
+    std::vector<int> chain(ops.size(), 1);
+    for(int n = 0; n < static_cast<int>(ops.size()); ++n){
+        for(int prev = 0; prev < n; ++prev){
+            if(Conflicts(accesses[prev], accesses[n])){
+                dependencies[n].push_back(prev);
+                successors[prev].push_back(n);
+                chain[n] = std::max(chain[n], chain[prev] + 1);
+            }
+        }
+        depth = std::max(depth, chain[n]);
+    }
+}
+
+void GraphExecutor::SetSerial(bool serial){
+    this->serial = serial;
+}
+
+bool GraphExecutor::IsSerial() const{
+    return serial;
+}
+
+void GraphExecutor::Run(){
+    if(serial || ops.size() <= 1 || GetNumThreads() <= 1){
+        RunSerial();
+    }
+    else{
+        RunParallel();
+    }
+}
+
+const std::vector<std::shared_ptr<OperatorBase>> &GraphExecutor::Operators() const{
+    return ops;
+}
+
+const std::vector<int> &GraphExecutor::Dependencies(int n) const{
+    return dependencies[n];
+}
+
+int GraphExecutor::Depth() const{
+    return depth;
+}
+
+void GraphExecutor::RunSerial(){
+    for(auto &op : ops){
+        op->Run();
+    }
+}
+
+void GraphExecutor::RunParallel(){
+    /*
+     * the pool workers do not see the thread count of the calling thread.
+     */
+    const int threads = GetNumThreads();
+    std::vector<std::atomic<int>> remaining(ops.size());
+    std::atomic<bool> failed(false);
+    TaskGroup group(GetSharedThreadPool());
+    std::function<void (int)> launch;
+    
+    for(int n = 0; n < static_cast<int>(ops.size()); ++n){
+        remaining[n] = dependencies[n].size();
+    }
+    /*
+     * a task keeps running the first operator it makes ready,
+     * and launches the others as new tasks.
+     */
+    launch = [&](int first){
+        group.Run([&, first](){
+            NumThreadsScope scope(threads);
+            int n = first;
+            while(n >= 0 && !failed){
+                try{
+                    ops[n]->Run();
+                }
+                catch(...){
+                    failed = true;
+                    throw;
+                }
+                int next = -1;
+                for(int succ : successors[n]){
+                    if(--remaining[succ] > 0){
+                        continue;
+                    }
+                    if(next < 0){
+                        next = succ;
+                    }
+                    else{
+                        launch(succ);
+                    }
+                }
+                n = next;
+            }
+        });
+    };
+    for(int n = 0; n < static_cast<int>(ops.size()); ++n){
+        if(dependencies[n].empty()){
+            launch(n);
+        }
+    }
+    group.Wait();
+}
+
+} /* namespace mlfe */
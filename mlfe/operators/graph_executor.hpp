@@ -0,0 +1,67 @@
+#ifndef __GRAPH_EXECUTOR_HPP__
+#define __GRAPH_EXECUTOR_HPP__
+#include <memory>
+#include <vector>
+#include "operator.hpp"
+
+namespace mlfe{
+
+/*
+ * Runs operators in any order that keeps the result of their given order.
+ * An operator depends on an earlier one, when it reads a tensor the earlier one writes,
+ * or writes a tensor the earlier one reads or writes.
+ * Tensors are matched by name and by their memory,
+ * so in place outputs and views of one arena are ordered as well.
+ *
+ * Run dispatches every operator whose dependencies have finished to the shared pool,
+ * so independent branches, like the gradients of different layers, run concurrently.
+ * In the serial mode, or with one thread, the operators run one by one in the given order.
+ * The serial mode is on by default, when $MLFE_SERIAL_EXECUTOR is set and not 0.
+ * The dependencies are derived once, so the tensors must be allocated before,
+ * and an operator must not move the memory of its outputs afterwards.
+ */
+class GraphExecutor{
+public:
+    explicit GraphExecutor(std::vector<std::shared_ptr<OperatorBase>> ops);
+    
+    /*
+     * a serial executor is deterministic in timing as well, for debugging.
+     */
+    void SetSerial(bool serial);
+    
+    bool IsSerial() const;
+    
+    /*
+     * returns when all operators have finished,
+     * and rethrows the first exception, after which no more operators are started.
+     */
+    void Run();
+    
+    const std::vector<std::shared_ptr<OperatorBase>> &Operators() const;
+    
+    /*
+     * the earlier operators, which ops[n] waits for.
+     */
+    const std::vector<int> &Dependencies(int n) const;
+    
+    /*
+     * operators on the longest dependency chain,
+     * the number of steps an unlimited number of threads would need.
+     */
+    int Depth() const;
+
+protected:
+    void RunSerial();
+    
+    void RunParallel();
+
+private:
+    std::vector<std::shared_ptr<OperatorBase>> ops;
+    std::vector<std::vector<int>> dependencies;
+    std::vector<std::vector<int>> successors;
+    int depth;
+    bool serial;
+};
+
+} /* namespace mlfe */
+#endif /* __GRAPH_EXECUTOR_HPP__ */
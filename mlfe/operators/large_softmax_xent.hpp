@@ -0,0 +1,115 @@
+#ifndef __LARGE_SOFTMAX_XENT_HPP__
+#define __LARGE_SOFTMAX_XENT_HPP__
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "operator.hpp"
+
+namespace mlfe{
+
+/*
+ * softmax cross entropy over the label and a few sampled classes,
+ * fused with the fully connected layer that projects x to the classes.
+ * w{classes, k} and b{classes} have the layout of FC,
+ * and only the rows of the label and of the sampled classes are read.
+ * label holds one unsigned char or int class index per row of x.
+ *
+ * Params :
+ *   Sampled, number of sampled classes, shared by all rows of a batch.
+ *   Sampler, "Uniform" (default) or "LogUniform" for classes sorted by frequency,
+ *            which samples all or at most half of the classes.
+ *   Units, number of classes, to create w and b like FC.
+ *
+ * prob{m, 1 + sampled} holds the label in column 0, sampled holds the class indices.
+ */
+template <class DataType, class DeviceContext>
+class SampledSoftmaxCrossEntropyOp final : public Operator<DeviceContext>{
+public:
+    explicit SampledSoftmaxCrossEntropyOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+
+private:
+    enum InputSchema{x, w, b, label};
+    enum OutputSchema{prob, loss, sampled};
+    
+    void Sample();
+    
+    /*
+     * log of the expected count of the class in the last sample.
+     */
+    DataType LogExpectation(const int c);
+    
+    std::mt19937 rng;
+    bool log_uniform;
+    TensorBlob<DeviceContext> w_sampled;
+    TensorBlob<DeviceContext> b_sampled;
+    TensorBlob<DeviceContext> logits;
+    int m;
+    int k;
+    int classes;
+    int num_sampled;
+    /*
+     * draws of the last sample, and the bound of them.
+     */
+    long long tries;
+    long long max_tries;
+};
+
+/*
+ * the gradients of w and b are row sparse like the one of Embedding,
+ * dw{capacity, k} and db{capacity} hold the rows of the sampled classes and the labels,
+ * and dw_rows, db_rows{capacity} their classes, followed by -1 for unused entries.
+ */
+template <class DataType, class DeviceContext>
+class SampledSoftmaxCrossEntropyGradientOp final : public Operator<DeviceContext>{
+public:
+    explicit SampledSoftmaxCrossEntropyGradientOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+
+private:
+    enum InputSchema{x, w, label, prob, sampled, loss};
+    enum OutputSchema{dw, dw_rows, db, db_rows, dx};
+    TensorBlob<DeviceContext> w_sampled;
+    TensorBlob<DeviceContext> d_logits;
+    /*
+     * entry of dw and db of every class of the step.
+     */
+    std::unordered_map<int, int> slot_of_row;
+    int m;
+    int k;
+    int num_sampled;
+};
+
+/*
+ * exact softmax cross entropy for evaluation, with w and b laid out like FC.
+ * the classes are streamed in blocks, keeping a running max and sum per row,
+ * so neither logits nor prob of all classes are stored.
+ * prediction{m} is the int index of the largest logit of each row.
+ *
+ * Params :
+ *   Block, number of classes per block, sized to stay in cache when not set.
+ */
+template <class DataType, class DeviceContext>
+class BlockedSoftmaxCrossEntropyOp final : public Operator<DeviceContext>{
+public:
+    explicit BlockedSoftmaxCrossEntropyOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+
+private:
+    enum InputSchema{x, w, b, label};
+    enum OutputSchema{loss, prediction};
+    TensorBlob<DeviceContext> logits;
+    std::vector<DataType> rows_max;
+    std::vector<DataType> rows_sum;
+    std::vector<DataType> label_logit;
+    int m;
+    int k;
+    int classes;
+    int block;
+};
+
+} /* namespace mlfe */
+#endif /* __LARGE_SOFTMAX_XENT_HPP__ */
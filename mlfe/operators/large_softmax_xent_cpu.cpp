@@ -0,0 +1,540 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <unordered_set>
+#include <Eigen/Core>
+#include "large_softmax_xent.hpp"
+#include "../device_context/cpu_context.hpp"
+#include "../math/blas.hpp"
+#include "../math/functions.hpp"
+#include "../utils/assert.hpp"
+#include "../utils/parallel.hpp"
+
+namespace mlfe{
+
+namespace{
+template <class DC>
+std::vector<int> ReadLabels(TensorBlob<DC> *label){
+    std::vector<int> labels(label->Size());
+    for(int i = 0; i < label->Size(); ++i){
+        if(label->template MatchType<unsigned char>()){
+            labels[i] = label->template GetPtrConst<unsigned char>()[i];
+        }
+        else{
+            labels[i] = label->template GetPtrConst<int>()[i];
+        }
+    }
+    return labels;
+}
+
+/*
+ * logits of blocked softmax are computed in blocks of about this size.
+ */
+const int blocked_softmax_bytes = 256 * 1024;
+} /* namespace */
+
+template <class DT, class DC>
+SampledSoftmaxCrossEntropyOp<DT, DC>::SampledSoftmaxCrossEntropyOp(
+                                                                   OperatorIO &opio,
+                                                                   ItemHolder *ih
+                                                                   ) : Operator<DC>(opio, ih), rng(math::GetRandomSeed()){
+    runtime_assert(this->inputs.size() == 4,
+                   "[Sampled Softmax Cross Entropy Op] inputs.size() == 4.");
+    runtime_assert(this->outputs.size() == 3,
+                   "[Sampled Softmax Cross Entropy Op] outputs.size() == 3.");
+    runtime_assert(opio.param.HasParam("Sampled"),
+                   "[Sampled Softmax Cross Entropy Op] Sampled param is needed.");
+    log_uniform = false;
+    if(opio.param.HasParam("Sampler")){
+        const auto sampler = opio.param.GetParam<std::string>("Sampler");
+        runtime_assert(!sampler.compare("Uniform") || !sampler.compare("LogUniform"),
+                       "[Sampled Softmax Cross Entropy Op] Sampler is Uniform or LogUniform.");
+        log_uniform = !sampler.compare("LogUniform");
+    }
+    
+    const auto x = this->inputs[InputSchema::x];
+    const auto w = this->inputs[InputSchema::w];
+    const auto b = this->inputs[InputSchema::b];
+    const auto label = this->inputs[InputSchema::label];
+    auto prob = this->outputs[OutputSchema::prob];
+    auto loss = this->outputs[OutputSchema::loss];
+    auto sampled = this->outputs[OutputSchema::sampled];
+    
+    runtime_assert(x->Dims() == 2,
+                   "[Sampled Softmax Cross Entropy Op] x->Dims() == 2.");
+    runtime_assert(label->Size() == x->Dim(0),
+                   "[Sampled Softmax Cross Entropy Op] label->Size() == x->Dim(0).");
+    runtime_assert(label->template MatchType<unsigned char>() || label->template MatchType<int>(),
+                   "[Sampled Softmax Cross Entropy Op] label type must be unsigned char or int.");
+    if(opio.param.HasParam("Units") && w->IsEmpty() && b->IsEmpty()){
+        const int units = opio.param.GetParam<int>("Units");
+        w->template Resize<DT>({units, x->Dim(1)});
+        b->template Resize<DT>({units});
+    }
+    else{
+        runtime_assert(x->Dim(1) == w->Dim(1),
+                       "[Sampled Softmax Cross Entropy Op] x->Dim(1) == w->Dim(1).");
+        runtime_assert(b->Size() == w->Dim(0),
+                       "[Sampled Softmax Cross Entropy Op] b->Size() == w->Dim(0).");
+    }
+    
+    /*
+     * batch size.
+     */
+    m = x->Dim(0);
+    /*
+     * input size.
+     */
+    k = x->Dim(1);
+    classes = w->Dim(0);
+    /*
+     * sampling all classes gives the full softmax.
+     */
+    num_sampled = std::min(opio.param.GetParam<int>("Sampled"), classes);
+    /*
+     * distinct log uniform draws of most of the classes would take very many tries,
+     * since the rare classes are seldom drawn.
+     */
+    runtime_assert(!log_uniform || num_sampled == classes || num_sampled <= classes / 2,
+                   "[Sampled Softmax Cross Entropy Op] LogUniform samples at most half of the classes.");
+    max_tries = 32LL * classes;
+    tries = 0;
+    
+    if(prob->IsEmpty() && loss->IsEmpty() && sampled->IsEmpty()){
+        prob->template Resize<DT>({m, 1 + num_sampled});
+        loss->template Resize<DT>({1});
+        sampled->template Resize<int>({num_sampled});
+    }
+    else{
+        runtime_assert(prob->Dim(0) == m && prob->Dim(1) == 1 + num_sampled,
+                       "[Sampled Softmax Cross Entropy Op] prob->Dims() == {m, 1 + Sampled}.");
+        runtime_assert(loss->Size() == 1,
+                       "[Sampled Softmax Cross Entropy Op] loss->Size() == 1.");
+        runtime_assert(sampled->Size() == num_sampled,
+                       "[Sampled Softmax Cross Entropy Op] sampled->Size() == Sampled.");
+    }
+    w_sampled.template Resize<DT>({num_sampled, k});
+    b_sampled.template Resize<DT>({num_sampled});
+    logits.template Resize<DT>({m, num_sampled});
+}
+
+template <class DT, class DC>
+void SampledSoftmaxCrossEntropyOp<DT, DC>::Sample(){
+    int *ids = this->outputs[OutputSchema::sampled]->template GetPtrMutable<int>();
+    if(num_sampled == classes){
+        for(int s = 0; s < num_sampled; ++s){
+            ids[s] = s;
+        }
+        tries = num_sampled;
+        return;
+    }
+    /*
+     * classes are drawn without replacement, so the sampled rows of dw are disjoint.
+     * the draws are counted, which the correction of the logits needs.
+     */
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    std::unordered_set<int> drawn;
+    int s = 0;
+    tries = 0;
+    while(s < num_sampled){
+        runtime_assert(tries < max_tries,
+                       "[Sampled Softmax Cross Entropy Op] too many draws to sample distinct classes.");
+        ++tries;
+        int c;
+        if(log_uniform){
+            c = static_cast<int>(std::exp(uniform(rng) * std::log(classes + 1.))) - 1;
+        }
+        else{
+            c = static_cast<int>(uniform(rng) * classes);
+        }
+        c = std::max(0, std::min(c, classes - 1));
+        if(drawn.insert(c).second){
+            ids[s++] = c;
+        }
+    }
+}
+
+/*
+ * a class is in the sample, when any of the draws hits it,
+ * so its expected count is 1 - (1 - p)^tries for a draw probability p.
+ */
+template <class DT, class DC>
+DT SampledSoftmaxCrossEntropyOp<DT, DC>::LogExpectation(const int c){
+    if(num_sampled == classes){
+        return DT(0);
+    }
+    double p = 1. / classes;
+    if(log_uniform){
+        p = std::log((c + 2.) / (c + 1.)) / std::log(classes + 1.);
+    }
+    return static_cast<DT>(std::log(-std::expm1(tries * std::log1p(-p))));
+}
+
+template <class DT, class DC>
+void SampledSoftmaxCrossEntropyOp<DT, DC>::Compute(){
+    using Array = Eigen::Array<DT, Eigen::Dynamic, 1>;
+    const auto x = this->inputs[InputSchema::x];
+    const auto w = this->inputs[InputSchema::w];
+    const auto b = this->inputs[InputSchema::b];
+    const auto labels = ReadLabels(this->inputs[InputSchema::label]);
+    auto prob = this->outputs[OutputSchema::prob];
+    auto loss = this->outputs[OutputSchema::loss];
+    const int cols = 1 + num_sampled;
+    
+    Sample();
+    const int *ids = this->outputs[OutputSchema::sampled]->template GetPtrConst<int>();
+    const DT *w_ptr = w->template GetPtrConst<DT>();
+    const DT *b_ptr = b->template GetPtrConst<DT>();
+    const DT *x_ptr = x->template GetPtrConst<DT>();
+    DT *ws_ptr = w_sampled.template GetPtrMutable<DT>();
+    DT *bs_ptr = b_sampled.template GetPtrMutable<DT>();
+    /*
+     * the logits are corrected by the sampling probability,
+     * so the sampled softmax estimates the full one.
+     */
+    for(int s = 0; s < num_sampled; ++s){
+        std::copy(w_ptr + ids[s] * k, w_ptr + (ids[s] + 1) * k, ws_ptr + s * k);
+        bs_ptr[s] = b_ptr[ids[s]] - LogExpectation(ids[s]);
+    }
+    
+    /*
+     * x(m x k) * w_sampled(sampled x k)^T + b_sampled = logits(m x sampled).
+     */
+    math::GemmEpilogue<DT> epilogue;
+    epilogue.col_bias = b_sampled.template GetPtrConst<DT>();
+    math::gemm<DT, DC>(false, true,
+                       m, num_sampled, k,
+                       DT(1), x_ptr, k,
+                       w_sampled.template GetPtrConst<DT>(), k,
+                       DT(0), logits.template GetPtrMutable<DT>(), num_sampled,
+                       epilogue, nullptr);
+    
+    const DT *logits_ptr = logits.template GetPtrConst<DT>();
+    DT *prob_ptr = prob->template GetPtrMutable<DT>();
+    /*
+     * the rows are independent, and their losses are summed by parallel_reduce.
+     */
+    const DT loss_sum = parallel_reduce<DT>(0, m, parallel_grain_of(cols + k), DT(0), [&](int from, int to){
+        DT partial = DT(0);
+        for(int i = from; i < to; ++i){
+            const int c = labels[i];
+            runtime_assert(c >= 0 && c < classes,
+                           "[Sampled Softmax Cross Entropy Op] label is out of the classes.");
+            Eigen::Map<Array> row(prob_ptr + i * cols, cols);
+            row(0) = Eigen::Map<const Array>(x_ptr + i * k, k).matrix().dot(
+                     Eigen::Map<const Array>(w_ptr + c * k, k).matrix()) + b_ptr[c] - LogExpectation(c);
+            row.tail(num_sampled) = Eigen::Map<const Array>(logits_ptr + i * num_sampled, num_sampled);
+            /*
+             * a sampled class, that is the label of the row, is removed.
+             */
+            for(int s = 0; s < num_sampled; ++s){
+                if(ids[s] == c){
+                    row(1 + s) = -std::numeric_limits<DT>::max();
+                }
+            }
+            row = (row - row.maxCoeff()).exp();
+            row /= row.sum();
+            partial -= std::log(std::max(row(0), DT(1e-20)));
+        }
+        return partial;
+    }, [](DT a, DT b){ return a + b; });
+    loss->template GetPtrMutable<DT>()[0] = loss_sum / static_cast<DT>(m);
+}
+
+REGIST_OPERATOR_CPU(SampledSoftmaxXent_float, SampledSoftmaxCrossEntropyOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(SampledSoftmaxXent_double, SampledSoftmaxCrossEntropyOp<double, CPUContext>)
+
+template <class DT, class DC>
+SampledSoftmaxCrossEntropyGradientOp<DT, DC>::SampledSoftmaxCrossEntropyGradientOp(
+                                                                                   OperatorIO &opio,
+                                                                                   ItemHolder *ih
+                                                                                   ) : Operator<DC>(opio, ih){
+    runtime_assert(this->inputs.size() == 6,
+                   "[Sampled Softmax Cross Entropy Gradient Op] inputs.size() == 6.");
+    runtime_assert(this->outputs.size() == 5,
+                   "[Sampled Softmax Cross Entropy Gradient Op] outputs.size() == 5.");
+    
+    const auto x = this->inputs[InputSchema::x];
+    const auto w = this->inputs[InputSchema::w];
+    const auto sampled = this->inputs[InputSchema::sampled];
+    auto dw = this->outputs[OutputSchema::dw];
+    auto dw_rows = this->outputs[OutputSchema::dw_rows];
+    auto db = this->outputs[OutputSchema::db];
+    auto db_rows = this->outputs[OutputSchema::db_rows];
+    auto dx = this->outputs[OutputSchema::dx];
+    
+    /*
+     * batch size.
+     */
+    m = x->Dim(0);
+    /*
+     * input size.
+     */
+    k = x->Dim(1);
+    num_sampled = sampled->Size();
+    /*
+     * a step touches the sampled classes and at most a class per row.
+     */
+    const int capacity = std::min(num_sampled + m, w->Dim(0));
+    if(dw->IsEmpty() && db->IsEmpty() && dx->IsEmpty()){
+        dw->template Resize<DT>({capacity, k});
+        dw_rows->template Resize<int>({capacity});
+        db->template Resize<DT>({capacity});
+        db_rows->template Resize<int>({capacity});
+        dx->template Resize<DT>(*x);
+    }
+    else{
+        runtime_assert(dw->Dim(0) == capacity && dw->Dim(1) == k,
+                       "[Sampled Softmax Cross Entropy Gradient Op] dw->Dims() == {capacity, k}.");
+        runtime_assert(db->Size() == capacity && dw_rows->Size() == capacity && db_rows->Size() == capacity,
+                       "[Sampled Softmax Cross Entropy Gradient Op] db, dw_rows and db_rows have the capacity.");
+        runtime_assert(dx->CompareSizeWith(*x),
+                       "[Sampled Softmax Cross Entropy Gradient Op] dx->CompareSizeWith(x).");
+    }
+    dw_rows->template SetByConst<int>(-1);
+    db_rows->template SetByConst<int>(-1);
+    w_sampled.template Resize<DT>({num_sampled, k});
+    d_logits.template Resize<DT>({m, num_sampled});
+    slot_of_row.reserve(capacity);
+}
+
+template <class DT, class DC>
+void SampledSoftmaxCrossEntropyGradientOp<DT, DC>::Compute(){
+    using Array = Eigen::Array<DT, Eigen::Dynamic, 1>;
+    const auto x = this->inputs[InputSchema::x];
+    const auto w = this->inputs[InputSchema::w];
+    const auto labels = ReadLabels(this->inputs[InputSchema::label]);
+    const auto prob = this->inputs[InputSchema::prob];
+    const int *ids = this->inputs[InputSchema::sampled]->template GetPtrConst<int>();
+    const auto loss = this->inputs[InputSchema::loss];
+    auto dw_rows = this->outputs[OutputSchema::dw_rows];
+    const int cols = 1 + num_sampled;
+    const DT *x_ptr = x->template GetPtrConst<DT>();
+    const DT *w_ptr = w->template GetPtrConst<DT>();
+    const DT *prob_ptr = prob->template GetPtrConst<DT>();
+    DT *dw_ptr = this->outputs[OutputSchema::dw]->template GetPtrMutable<DT>();
+    DT *db_ptr = this->outputs[OutputSchema::db]->template GetPtrMutable<DT>();
+    DT *dx_ptr = this->outputs[OutputSchema::dx]->template GetPtrMutable<DT>();
+    int *rows_ptr = dw_rows->template GetPtrMutable<int>();
+    DT *ws_ptr = w_sampled.template GetPtrMutable<DT>();
+    DT *dl_ptr = d_logits.template GetPtrMutable<DT>();
+    /*
+     * scaled like SoftmaxXentLossWithLabel followed by FC gradient,
+     * the parameters' gradients are divided by the batch size once more.
+     */
+    const DT scale = loss->template GetPtrConst<DT>()[0] / static_cast<DT>(m);
+    const DT param_scale = DT(1) / static_cast<DT>(m);
+    
+    for(int i = 0; i < m; ++i){
+        for(int s = 0; s < num_sampled; ++s){
+            dl_ptr[i * num_sampled + s] = prob_ptr[i * cols + 1 + s] * scale;
+        }
+    }
+    for(int s = 0; s < num_sampled; ++s){
+        std::copy(w_ptr + ids[s] * k, w_ptr + (ids[s] + 1) * k, ws_ptr + s * k);
+    }
+    
+    /*
+     * d_logits(m x sampled) * w_sampled(sampled x k) = dx(m x k).
+     */
+    math::gemm<DT, DC>(false, false,
+                       m, k, num_sampled,
+                       DT(1), d_logits.template GetPtrConst<DT>(), num_sampled,
+                       w_sampled.template GetPtrConst<DT>(), k,
+                       DT(0), dx_ptr, k, nullptr);
+    
+    /*
+     * the sampled classes are distinct, and take the first entries of dw and db.
+     * d_logits(m x sampled)^T * x(m x k) = dw of the sampled rows(sampled x k).
+     */
+    math::gemm<DT, DC>(true, false,
+                       num_sampled, k, m,
+                       param_scale, d_logits.template GetPtrConst<DT>(), num_sampled,
+                       x_ptr, k,
+                       DT(0), dw_ptr, k, nullptr);
+    math::colwise_sum<DT, DC>(m, num_sampled, d_logits.template GetPtrConst<DT>(), DT(0), db_ptr);
+    math::scal<DT, DC>(num_sampled, param_scale, db_ptr, db_ptr);
+    slot_of_row.clear();
+    for(int s = 0; s < num_sampled; ++s){
+        slot_of_row[ids[s]] = s;
+        rows_ptr[s] = ids[s];
+    }
+    
+    /*
+     * the label column is added row by row, labels may repeat in a batch,
+     * and a label, that is not sampled, takes the next entry.
+     */
+    for(int i = 0; i < m; ++i){
+        const int c = labels[i];
+        const DT d_label = (prob_ptr[i * cols] - DT(1)) * scale;
+        auto it = slot_of_row.find(c);
+        int slot;
+        if(it == slot_of_row.end()){
+            slot = slot_of_row.size();
+            slot_of_row[c] = slot;
+            rows_ptr[slot] = c;
+            Eigen::Map<Array>(dw_ptr + slot * k, k).setZero();
+            db_ptr[slot] = DT(0);
+        }
+        else{
+            slot = it->second;
+        }
+        Eigen::Map<Array>(dx_ptr + i * k, k) += d_label * Eigen::Map<const Array>(w_ptr + c * k, k);
+        Eigen::Map<Array>(dw_ptr + slot * k, k) += d_label * param_scale * Eigen::Map<const Array>(x_ptr + i * k, k);
+        db_ptr[slot] += d_label * param_scale;
+    }
+    std::fill(rows_ptr + slot_of_row.size(), rows_ptr + dw_rows->Size(), -1);
+    std::copy(rows_ptr, rows_ptr + dw_rows->Size(), this->outputs[OutputSchema::db_rows]->template GetPtrMutable<int>());
+}
+
+REGIST_OPERATOR_CPU(SampledSoftmaxXent_float_Gradient, SampledSoftmaxCrossEntropyGradientOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(SampledSoftmaxXent_double_Gradient, SampledSoftmaxCrossEntropyGradientOp<double, CPUContext>)
+
+struct SampledSoftmaxXentGradientIO : public GradientIO{
+    OperatorIO GetGradientIO(OperatorIO opio) override{
+        OperatorIO opio_grad;
+        opio_grad.type = opio.type + "_" + opio.data_type + "_Gradient";
+        opio_grad.data_type = opio.data_type;
+        opio_grad.inputs.push_back(opio.inputs[0]);
+        opio_grad.inputs.push_back(opio.inputs[1]);
+        opio_grad.inputs.push_back(opio.inputs[3]);
+        opio_grad.inputs.push_back(opio.outputs[0]);
+        opio_grad.inputs.push_back(opio.outputs[2]);
+        opio_grad.inputs.push_back(opio.outputs[1]);
+        opio_grad.outputs.push_back(opio.inputs[1] + "_grad");
+        opio_grad.outputs.push_back(opio.inputs[1] + "_grad_rows");
+        opio_grad.outputs.push_back(opio.inputs[2] + "_grad");
+        opio_grad.outputs.push_back(opio.inputs[2] + "_grad_rows");
+        opio_grad.outputs.push_back(opio.inputs[0] + "_grad");
+        opio_grad.param = opio.param;
+        
+        return opio_grad;
+    }
+};
+
+REGIST_OPERATOR_GRADIENT_IO(SampledSoftmaxXent, SampledSoftmaxXentGradientIO);
+
+template <class DT, class DC>
+BlockedSoftmaxCrossEntropyOp<DT, DC>::BlockedSoftmaxCrossEntropyOp(
+                                                                   OperatorIO &opio,
+                                                                   ItemHolder *ih
+                                                                   ) : Operator<DC>(opio, ih){
+    runtime_assert(this->inputs.size() == 4,
+                   "[Blocked Softmax Cross Entropy Op] inputs.size() == 4.");
+    runtime_assert(this->outputs.size() == 2,
+                   "[Blocked Softmax Cross Entropy Op] outputs.size() == 2.");
+    
+    const auto x = this->inputs[InputSchema::x];
+    const auto w = this->inputs[InputSchema::w];
+    const auto b = this->inputs[InputSchema::b];
+    const auto label = this->inputs[InputSchema::label];
+    auto loss = this->outputs[OutputSchema::loss];
+    auto prediction = this->outputs[OutputSchema::prediction];
+    
+    runtime_assert(x->Dims() == 2,
+                   "[Blocked Softmax Cross Entropy Op] x->Dims() == 2.");
+    runtime_assert(x->Dim(1) == w->Dim(1),
+                   "[Blocked Softmax Cross Entropy Op] x->Dim(1) == w->Dim(1).");
+    runtime_assert(b->Size() == w->Dim(0),
+                   "[Blocked Softmax Cross Entropy Op] b->Size() == w->Dim(0).");
+    runtime_assert(label->Size() == x->Dim(0),
+                   "[Blocked Softmax Cross Entropy Op] label->Size() == x->Dim(0).");
+    runtime_assert(label->template MatchType<unsigned char>() || label->template MatchType<int>(),
+                   "[Blocked Softmax Cross Entropy Op] label type must be unsigned char or int.");
+    
+    /*
+     * batch size.
+     */
+    m = x->Dim(0);
+    /*
+     * input size.
+     */
+    k = x->Dim(1);
+    classes = w->Dim(0);
+    if(opio.param.HasParam("Block")){
+        block = opio.param.GetParam<int>("Block");
+    }
+    else{
+        block = std::max(16, static_cast<int>(blocked_softmax_bytes / sizeof(DT)) / std::max(m, 1));
+    }
+    block = std::max(1, std::min(block, classes));
+    
+    if(loss->IsEmpty() && prediction->IsEmpty()){
+        loss->template Resize<DT>({1});
+        prediction->template Resize<int>({m});
+    }
+    else{
+        runtime_assert(loss->Size() == 1,
+                       "[Blocked Softmax Cross Entropy Op] loss->Size() == 1.");
+        runtime_assert(prediction->Size() == m,
+                       "[Blocked Softmax Cross Entropy Op] prediction->Size() == m.");
+    }
+    logits.template Resize<DT>({m, block});
+    rows_max.resize(m);
+    rows_sum.resize(m);
+    label_logit.resize(m);
+}
+
+template <class DT, class DC>
+void BlockedSoftmaxCrossEntropyOp<DT, DC>::Compute(){
+    using Array = Eigen::Array<DT, Eigen::Dynamic, 1>;
+    const auto x = this->inputs[InputSchema::x];
+    const auto w = this->inputs[InputSchema::w];
+    const auto b = this->inputs[InputSchema::b];
+    const auto labels = ReadLabels(this->inputs[InputSchema::label]);
+    int *pred_ptr = this->outputs[OutputSchema::prediction]->template GetPtrMutable<int>();
+    const DT *w_ptr = w->template GetPtrConst<DT>();
+    const DT *b_ptr = b->template GetPtrConst<DT>();
+    
+    std::fill(rows_max.begin(), rows_max.end(), -std::numeric_limits<DT>::max());
+    std::fill(rows_sum.begin(), rows_sum.end(), DT(0));
+    const DT *x_ptr = x->template GetPtrConst<DT>();
+    DT *logits_ptr = logits.template GetPtrMutable<DT>();
+    for(int from = 0; from < classes; from += block){
+        const int cols = std::min(block, classes - from);
+        /*
+         * rows [from, from + cols) of w are contiguous in the FC layout.
+         * the samples are independent, so each chunk of them makes its own logits.
+         */
+        math::GemmEpilogue<DT> epilogue;
+        epilogue.col_bias = b_ptr + from;
+        parallel_for(0, m, parallel_grain_of(cols * k), [&](int row_from, int row_to){
+            math::gemm<DT, DC>(false, true,
+                               row_to - row_from, cols, k,
+                               DT(1), x_ptr + row_from * k, k,
+                               w_ptr + from * k, k,
+                               DT(0), logits_ptr + row_from * cols, cols,
+                               epilogue, nullptr);
+            for(int i = row_from; i < row_to; ++i){
+                Eigen::Map<const Array> row(logits_ptr + i * cols, cols);
+                Eigen::Index arg;
+                const DT block_max = row.maxCoeff(&arg);
+                if(block_max > rows_max[i]){
+                    rows_sum[i] *= std::exp(rows_max[i] - block_max);
+                    rows_max[i] = block_max;
+                    pred_ptr[i] = from + arg;
+                }
+                rows_sum[i] += (row - rows_max[i]).exp().sum();
+                if(labels[i] >= from && labels[i] < from + cols){
+                    label_logit[i] = row(labels[i] - from);
+                }
+            }
+        });
+    }
+    
+    const DT loss_sum = parallel_reduce<DT>(0, m, parallel_grain, DT(0), [&](int from, int to){
+        DT partial = DT(0);
+        for(int i = from; i < to; ++i){
+            runtime_assert(labels[i] >= 0 && labels[i] < classes,
+                           "[Blocked Softmax Cross Entropy Op] label is out of the classes.");
+            partial += rows_max[i] + std::log(rows_sum[i]) - label_logit[i];
+        }
+        return partial;
+    }, [](DT a, DT b){ return a + b; });
+    this->outputs[OutputSchema::loss]->template GetPtrMutable<DT>()[0] = loss_sum / static_cast<DT>(m);
+}
+
+REGIST_OPERATOR_CPU(BlockedSoftmaxXent_float, BlockedSoftmaxCrossEntropyOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(BlockedSoftmaxXent_double, BlockedSoftmaxCrossEntropyOp<double, CPUContext>)
+
+} /* namespace mlfe */
@@ -1,7 +1,7 @@
 #ifndef __MAX_POOL_OP_HPP__
 #define __MAX_POOL_OP_HPP__
 
-#include <cfloat>
+#include <cstdint>
 #include "operator.hpp"
 #include "../math/blas.hpp"
 #include "../utils/assert.hpp"
@@ -21,6 +21,11 @@ private:
     std::vector<int> kernel;
     std::vector<int> stride;
     int out_h, out_w;
+    /*
+     * y = maxpool(max(x, 0)), which is the same as max(maxpool(x), 0).
+     */
+    bool fuse_relu;
+    DataLayout layout;
 };
 
 template <class DataType, class DeviceContext>
@@ -31,11 +36,13 @@ public:
     void Compute() override;
     
 private:
-    enum InputSchema{x, idx, dy};
+    enum InputSchema{x, idx, dy, y};
     enum OutputSchema{dx};
     std::vector<int> kernel;
     std::vector<int> stride;
-    int out_h, out_w;
+    TensorBlob<DeviceContext> dy_buf;
+    bool fuse_relu;
+    DataLayout layout;
 };
 
 } /* namespace mlfe */
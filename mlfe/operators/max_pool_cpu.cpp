@@ -1,5 +1,7 @@
 #include <algorithm>
 #include "max_pool.hpp"
+#include "../math/pooling.hpp"
+#include "../math/functions.hpp"
 #include "../device_context/cpu_context.hpp"
 
 namespace mlfe{
@@ -17,22 +19,50 @@ MaxPoolOp<DT, DC>::MaxPoolOp(
     auto y = this->outputs[OutputSchema::y];
     auto idx = this->outputs[OutputSchema::idx];
     
-    if(opio.param.HasParam("Kernel") &&
-       opio.param.HasParam("Stride") &&
-       y->IsEmpty() &&
+    layout = x->Layout();
+    if(opio.param.HasParam("Layout")){
+        layout = LayoutFromString(opio.param.GetParam<std::string>("Layout"));
+    }
+    runtime_assert(opio.param.HasParam("Kernel") && opio.param.HasParam("Stride"),
+                   "[MaxPool Op] Not found Kernel or Stride param.");
+    kernel = opio.param.GetParam<std::vector<int>>("Kernel");
+    stride = opio.param.GetParam<std::vector<int>>("Stride");
+    /*
+     * Activation param is set by the fusion pass,
+     * when the relu in front of the pooling is merged into it.
+     */
+    fuse_relu = false;
+    if(opio.param.HasParam("Activation")){
+        runtime_assert(!opio.param.GetParam<std::string>("Activation").compare("Relu"),
+                       "[MaxPool Op] Activation param only supports Relu.");
+        fuse_relu = true;
+    }
+    
+    if(y->IsEmpty() &&
        idx->IsEmpty() &&
        !x->IsEmpty() &&
        x->Dims() == 4){
-        kernel = opio.param.GetParam<std::vector<int>>("Kernel");
-        stride = opio.param.GetParam<std::vector<int>>("Stride");
-        out_h = (x->Dim(2) - kernel[0]) / stride[0] + 1;
-        out_w = (x->Dim(3) - kernel[1]) / stride[1] + 1;
-        y->template Resize<DT>({x->Dim(0), x->Dim(1), out_h, out_w});
-        idx->template Resize<int>(*y);
+        runtime_assert(kernel[0] * kernel[1] <= 256,
+                       "[MaxPool Op] kernel[0] * kernel[1] <= 256.");
+        if(layout == DataLayout::NHWC){
+            out_h = (x->Dim(1) - kernel[0]) / stride[0] + 1;
+            out_w = (x->Dim(2) - kernel[1]) / stride[1] + 1;
+            y->template Resize<DT>({x->Dim(0), out_h, out_w, x->Dim(3)});
+        }
+        else{
+            out_h = (x->Dim(2) - kernel[0]) / stride[0] + 1;
+            out_w = (x->Dim(3) - kernel[1]) / stride[1] + 1;
+            y->template Resize<DT>({x->Dim(0), x->Dim(1), out_h, out_w});
+        }
+        y->SetLayout(layout);
+        /*
+         * argmax is kept as the offset inside of the window.
+         */
+        idx->template Resize<uint8_t>(*y);
     }
     else{
-        runtime_assert(x->Dims() == 2,
-                       "[MaxPool Op] x->Dims() == 2.");
+        runtime_assert(x->Dims() == 4,
+                       "[MaxPool Op] x->Dims() == 4.");
         runtime_assert(y->CompareSizeWith(*idx),
                        "[MaxPool Op] y->CompareSizeWith(idx).");
     }
@@ -43,35 +73,26 @@ void MaxPoolOp<DT, DC>::Compute(){
     const auto x = this->inputs[InputSchema::x];
     auto idx = this->outputs[OutputSchema::idx];
     auto y = this->outputs[OutputSchema::y];
-    const DT *x_ptr = x->template GetPtrConst<DT>();
-    DT *y_ptr = y->template GetPtrMutable<DT>();
-    int *idx_ptr = idx->template GetPtrMutable<int>();
     
-    y->template SetByConst<DT>(static_cast<DT>(-FLT_MAX));
-    for (int n = 0; n < x->Dim(0); ++n){
-        for (int c = 0; c < x->Dim(1); ++c){
-            for (int ph = 0; ph < out_h; ++ph){
-                for (int pw = 0; pw < out_w; ++pw){
-                    int hstart = ph * stride[0];
-                    int wstart = pw * stride[1];
-                    int hend = std::min<int>(hstart + kernel[0], x->Dim(2));
-                    int wend = std::min<int>(wstart + kernel[1], x->Dim(3));
-                    const int pool_index = ph * out_w + pw;
-                    for (int h = hstart; h < hend; ++h) {
-                        for (int w = wstart; w < wend; ++w) {
-                            const int index = h * x->Dim(3) + w;
-                            if (x_ptr[index] > y_ptr[pool_index]) {
-                                y_ptr[pool_index] = x_ptr[index];
-                                idx_ptr[pool_index] = index;
-                            }
-                        }
-                    }
-                }
-            }
-            x_ptr += x->Dim(2) * x->Dim(3);
-            y_ptr += out_h * out_w;
-            idx_ptr += out_h * out_w;
-        }
+    if(layout == DataLayout::NHWC){
+        math::max_pool_nhwc<DT, DC>(
+                                    x->Dim(0), x->Dim(3), x->Dim(1), x->Dim(2),
+                                    kernel[0], kernel[1],
+                                    stride[0], stride[1], fuse_relu,
+                                    x->template GetPtrConst<DT>(),
+                                    y->template GetPtrMutable<DT>(),
+                                    idx->template GetPtrMutable<uint8_t>()
+                                    );
+    }
+    else{
+        math::max_pool_nchw<DT, DC>(
+                                    x->Dim(0) * x->Dim(1), x->Dim(2), x->Dim(3),
+                                    kernel[0], kernel[1],
+                                    stride[0], stride[1], fuse_relu,
+                                    x->template GetPtrConst<DT>(),
+                                    y->template GetPtrMutable<DT>(),
+                                    idx->template GetPtrMutable<uint8_t>()
+                                    );
     }
 }
 
@@ -83,8 +104,9 @@ MaxPoolGradientOp<DT, DC>::MaxPoolGradientOp(
                                                         OperatorIO &opio,
                                                         ItemHolder *ih
                                                         ) : Operator<DC>(opio, ih) {
-    runtime_assert(this->inputs.size() == 3,
-                   "[MaxPool Gradient Op] inputs.size() == 3.");
+    fuse_relu = opio.param.HasParam("Activation");
+    runtime_assert(this->inputs.size() == (fuse_relu ? 4 : 3),
+                   "[MaxPool Gradient Op] inputs.size() == 3, or 4 with fused relu.");
     runtime_assert(this->outputs.size() == 1,
                    "[MaxPool Gradient Op] outputs.size() == 1.");
     
@@ -92,6 +114,10 @@ MaxPoolGradientOp<DT, DC>::MaxPoolGradientOp(
     const auto idx = this->inputs[InputSchema::idx];
     const auto dy = this->inputs[InputSchema::dy];
     auto dx = this->outputs[OutputSchema::dx];
+    layout = x->Layout();
+    if(opio.param.HasParam("Layout")){
+        layout = LayoutFromString(opio.param.GetParam<std::string>("Layout"));
+    }
     if(opio.param.HasParam("Kernel") &&
        opio.param.HasParam("Stride") &&
        dx->IsEmpty() &&
@@ -103,39 +129,56 @@ MaxPoolGradientOp<DT, DC>::MaxPoolGradientOp(
        ){
         kernel = opio.param.GetParam<std::vector<int>>("Kernel");
         stride = opio.param.GetParam<std::vector<int>>("Stride");
-        out_h = dy->Dim(2);
-        out_w = dy->Dim(3);
         dx->template Resize<DT>(*x);
     }
     else{
         runtime_assert(idx->CompareSizeWith(*dy),
                        "[MaxPool Gradient Op] idx->CompareSizeWith(dy)");
     }
+    if(fuse_relu){
+        dy_buf.template Resize<DT>(*dy);
+    }
 }
 
 template <class DT, class DC>
 void MaxPoolGradientOp<DT, DC>::Compute(){
     const auto idx = this->inputs[InputSchema::idx];
-    const auto dy = this->inputs[InputSchema::dy];
+    auto dy = this->inputs[InputSchema::dy];
     auto dx = this->outputs[OutputSchema::dx];
-    const DT *dy_ptr = dy->template GetPtrConst<DT>();
-    const int *idx_ptr = idx->template GetPtrConst<int>();
-    DT *dx_ptr = dx->template GetPtrMutable<DT>();
     
-    dx->template SetByConst<DT>(static_cast<DT>(0));
-    for (int n = 0; n < dy->Dim(0); ++n) {
-        for (int c = 0; c < dy->Dim(1); ++c) {
-            for (int ph = 0; ph < out_h; ++ph) {
-                for (int pw = 0; pw < out_w; ++pw) {
-                    const int index = ph * out_w + pw;
-                    const int bottom_index = idx_ptr[index];
-                    dx_ptr[bottom_index] += dy_ptr[index];
-                }
-            }
-            dx_ptr += dx->Dim(2) * dx->Dim(3);
-            dy_ptr += dy->Dim(2) * dy->Dim(3);
-            idx_ptr += idx->Dim(2) * idx->Dim(3);
-        }
+    /*
+     * a window clamped by the fused relu has no argmax to pass dy to.
+     */
+    if(fuse_relu){
+        const auto y = this->inputs[InputSchema::y];
+        math::ReluGradientFunction<DT, DC>(
+                                           dy->Size(),
+                                           y->template GetPtrConst<DT>(),
+                                           dy->template GetPtrConst<DT>(),
+                                           dy_buf.template GetPtrMutable<DT>()
+                                           );
+        dy = &dy_buf;
+    }
+    
+    if(layout == DataLayout::NHWC){
+        math::max_pool_nhwc_gradient<DT, DC>(
+                                             dx->Dim(0), dx->Dim(3), dx->Dim(1), dx->Dim(2),
+                                             kernel[0], kernel[1],
+                                             stride[0], stride[1],
+                                             dy->template GetPtrConst<DT>(),
+                                             idx->template GetPtrConst<uint8_t>(),
+                                             dx->template GetPtrMutable<DT>()
+                                             );
+    }
+    else{
+        math::max_pool_nchw_gradient<DT, DC>(
+                                             dx->Dim(0) * dx->Dim(1), dx->Dim(2), dx->Dim(3),
+                                             kernel[0], kernel[1],
+                                             stride[0], stride[1],
+                                             dy->template GetPtrConst<DT>(),
+                                             idx->template GetPtrConst<uint8_t>(),
+                                             dx->template GetPtrMutable<DT>()
+                                             );
     }
 }
 
@@ -150,6 +193,9 @@ struct MaxPoolGradientIO : public GradientIO{
         opio_grad.inputs.push_back(opio.inputs[0]);
         opio_grad.inputs.push_back(opio.outputs[1]);
         opio_grad.inputs.push_back(opio.outputs[0] + "_grad");
+        if(opio.param.HasParam("Activation")){
+            opio_grad.inputs.push_back(opio.outputs[0]);
+        }
         opio_grad.outputs.push_back(opio.inputs[0] + "_grad");
         opio_grad.param = opio.param;
         
@@ -2,6 +2,7 @@
 #include "../device_context/cpu_context.hpp"
 #include "../math/blas.hpp"
 #include "../utils/assert.hpp"
+#include "../utils/parallel.hpp"
 
 namespace mlfe{
 
@@ -34,16 +35,19 @@ template <class DT, class DC>
 void OneHotOp<DT, DC>::Compute(){
     const auto x = this->inputs[InputSchema::x];
     auto y = this->outputs[OutputSchema::y];
-    math::scal<DT, DC>(
-                                  y->Size(),
-                                  static_cast<DT>(0),
-                                  y->template GetPtrConst<DT>(),
-                                  y->template GetPtrMutable<DT>()
-                                  );
-    for(int b = 0; b < x->Dim(0); ++b){
-        int val = x->template GetPtrConst<DT>()[b];
-        y->template GetPtrMutable<DT>()[b * dim + val] = static_cast<DT>(1);
-    }
+    const DT *x_ptr = x->template GetPtrConst<DT>();
+    DT *y_ptr = y->template GetPtrMutable<DT>();
+    const int dim = this->dim;
+    /*
+     * every row of y is cleared and set by the thread owning it.
+     */
+    parallel_for(0, x->Dim(0), parallel_grain_of(dim), [=](int from, int to){
+        math::scal<DT, DC>((to - from) * dim, static_cast<DT>(0), y_ptr + from * dim, y_ptr + from * dim);
+        for(int b = from; b < to; ++b){
+            int val = x_ptr[b];
+            y_ptr[b * dim + val] = static_cast<DT>(1);
+        }
+    });
 }
 
 REGIST_OPERATOR_CPU(OneHot_float, OneHotOp<float, CPUContext>)
@@ -1,4 +1,6 @@
 #include "operator.hpp"
+#include "autotuner.hpp"
+#include "../utils/profiler.hpp"
 
 namespace mlfe{
 
@@ -30,6 +32,25 @@ OperatorIO & OperatorBase::GetOperatorIO(){
     return opio;
 }
 
+void OperatorBase::Run(){
+    if(!IsProfiling()){
+        Compute();
+        return;
+    }
+    /*
+     * an operator without a name is known by its first output.
+     */
+    ProfileEvent event;
+    event.name = !opio.name.empty() || opio.outputs.empty() ? opio.name : opio.outputs[0];
+    event.type = opio.type;
+    event.thread = ProfileThread();
+    GetShapes(event.input_shapes, event.output_shapes);
+    event.begin = ProfileNow();
+    Compute();
+    event.end = ProfileNow();
+    RecordProfileEvent(std::move(event));
+}
+
 DEFINE_REGISTRY(
                  OperatorCPU,
                  std::string,
@@ -50,6 +71,12 @@ CreateOperator(OperatorIO &opio, ItemHolder *ih){
     if (!opio.data_type.empty()) {
         type += "_" + opio.data_type;
     }
+    /*
+     * "Auto" is replaced with the fastest registered accelerator.
+     */
+    if(!opio.accelerator.compare("Auto")){
+        opio.accelerator = Autotuner::Get()->Select(opio, ih);
+    }
     if(!opio.accelerator.empty()){
         type += "_" + opio.accelerator;
     }
@@ -37,7 +37,19 @@ public:
     
     virtual void Compute() = 0;
     
+    /*
+     * runs Compute, timed by the profiler of mlfe/utils/profiler.hpp when it is on.
+     * executors run operators by this.
+     */
+    void Run();
+    
 protected:
+    /*
+     * shapes of the inputs and outputs, for the profiler.
+     */
+    virtual void GetShapes(std::vector<std::vector<int>> &,
+                           std::vector<std::vector<int>> &){}
+    
     OperatorIO opio;
     ItemHolder *ih;
 };
@@ -64,6 +76,24 @@ public:
     virtual void Compute() = 0;
     
 protected:
+    void GetShapes(std::vector<std::vector<int>> &input_shapes,
+                   std::vector<std::vector<int>> &output_shapes) override{
+        for(auto tb : inputs){
+            input_shapes.push_back(ShapeOf(tb));
+        }
+        for(auto tb : outputs){
+            output_shapes.push_back(ShapeOf(tb));
+        }
+    }
+    
+    static std::vector<int> ShapeOf(TensorBlob<DC> *tb){
+        std::vector<int> shape;
+        for(int d = 0; d < tb->Dims(); ++d){
+            shape.push_back(tb->Dim(d));
+        }
+        return shape;
+    }
+    
     std::vector<TensorBlob<DC> *> inputs;
     std::vector<TensorBlob<DC> *> outputs;
 };/* class Operater */
@@ -2,6 +2,7 @@
 #include "../device_context/cpu_context.hpp"
 #include "../math/blas.hpp"
 #include "../utils/assert.hpp"
+#include "../utils/parallel.hpp"
 
 namespace mlfe{
 
@@ -35,12 +36,11 @@ template <class DT, class DC>
 void ScaleOp<DT, DC>::Compute(){
     const auto x = this->inputs[InputSchema::x];
     auto y = this->outputs[OutputSchema::y];
-    math::scal<DT, DC>(
-                                  x->Size(),
-                                  scaler,
-                                  x->template GetPtrConst<DT>(),
-                                  y->template GetPtrMutable<DT>()
-                                  );
+    const DT *x_ptr = x->template GetPtrConst<DT>();
+    DT *y_ptr = y->template GetPtrMutable<DT>();
+    parallel_for(0, x->Size(), parallel_grain, [&](int from, int to){
+        math::scal<DT, DC>(to - from, scaler, x_ptr + from, y_ptr + from);
+    });
 }
 
 
@@ -2,6 +2,7 @@
 #include "../device_context/cpu_context.hpp"
 #include "../math/blas.hpp"
 #include "../utils/assert.hpp"
+#include "../utils/parallel.hpp"
 
 namespace mlfe{
 
@@ -60,46 +61,43 @@ void SoftmaxCrossEntropyWithLabelOp<DT, DC>::Compute(){
     auto prob = this->outputs[OutputSchema::prob];
     auto loss = this->outputs[OutputSchema::loss];
     
-    math::rowwise_max<DT, DC>(
-                                                 m, n,
-                                                 x->template GetPtrConst<DT>(),
-                                                 rows_max.template GetPtrMutable<DT>()
-                                                 );
+    const DT *label_ptr = label->template GetPtrConst<DT>();
+    const DT *x_ptr = x->template GetPtrConst<DT>();
+    const DT *ones_ptr = sum_multiplier.template GetPtrConst<DT>();
+    DT *prob_ptr = prob->template GetPtrMutable<DT>();
+    DT *max_ptr = rows_max.template GetPtrMutable<DT>();
+    DT *scaler_ptr = scaler.template GetPtrMutable<DT>();
     
-    math::scal<DT, DC>(
-                                  m * n, DT(1),
-                                  x->template GetPtrConst<DT>(),
-                                  prob->template GetPtrMutable<DT>()
-                                  );
-    
-    math::gemm<DT, DC>(false, false,
-                                      m, n, 1,
-                                      DT(-1), rows_max.template GetPtrConst<DT>(), 1,
-                                      sum_multiplier.template GetPtrConst<DT>(), n,
-                                      DT(1), prob->template GetPtrMutable<DT>(), n, nullptr);
-    
-    math::exp<DT, DC>(
-                                 prob->Size(),
-                                 prob->template GetPtrConst<DT>(),
-                                 prob->template GetPtrMutable<DT>()
-                                 );
-    
-    math::gemv<DT, DC>(false,
-                                      m, n,
-                                      DT(1), prob->template GetPtrConst<DT>(), n,
-                                      sum_multiplier.template GetPtrConst<DT>(),
-                                      DT(0), scaler.template GetPtrMutable<DT>(), 1, nullptr);
-    
-    math::rowwise_normalize<DT, DC>(m, n,
-                                                           scaler.template GetPtrConst<DT>(),
-                                                           prob->template GetPtrMutable<DT>()
-                                                           );
-    
-    math::cross_entropy<DT, DC>(m, n,
-                                                   prob->template GetPtrConst<DT>(),
-                                                   label->template GetPtrConst<DT>(),
-                                                   rows_max.template GetPtrMutable<DT>()
-                                                   );
+    /*
+     * the rows are independent until the loss is summed,
+     * so every chunk of rows runs the whole softmax.
+     */
+    parallel_for(0, m, parallel_grain_of(n), [&](int from, int to){
+        const int rows = to - from;
+        DT *prob_rows = prob_ptr + from * n;
+        
+        math::rowwise_max<DT, DC>(rows, n, x_ptr + from * n, max_ptr + from);
+        
+        math::scal<DT, DC>(rows * n, DT(1), x_ptr + from * n, prob_rows);
+        
+        math::gemm<DT, DC>(false, false,
+                           rows, n, 1,
+                           DT(-1), max_ptr + from, 1,
+                           ones_ptr, n,
+                           DT(1), prob_rows, n, nullptr);
+        
+        math::exp<DT, DC>(rows * n, prob_rows, prob_rows);
+        
+        math::gemv<DT, DC>(false,
+                           rows, n,
+                           DT(1), prob_rows, n,
+                           ones_ptr,
+                           DT(0), scaler_ptr + from, 1, nullptr);
+        
+        math::rowwise_normalize<DT, DC>(rows, n, scaler_ptr + from, prob_rows);
+        
+        math::cross_entropy<DT, DC>(rows, n, prob_rows, label_ptr + from * n, max_ptr + from);
+    });
     
     math::sum<DT, DC>(
                                     m,
@@ -120,7 +118,7 @@ REGIST_OPERATOR_CPU(SoftmaxXentLossWithLabel_float,
 
 REGIST_OPERATOR_CPU(SoftmaxXentLossWithLabel_double,
                     SoftmaxCrossEntropyWithLabelOp<double, CPUContext>)
-
+    
     template <class DT, class DC>
 SoftmaxCrossEntropyWithLabelGradientOp<DT, DC>
 ::SoftmaxCrossEntropyWithLabelGradientOp(
@@ -169,17 +167,20 @@ void SoftmaxCrossEntropyWithLabelGradientOp<DT, DC>::Compute(){
     const auto loss = this->inputs[InputSchema::loss];
     auto dx = this->outputs[OutputSchema::dx];
     
-    math::cross_entropy_gradients<DT, DC>(m, n,
-                                                             prob->template GetPtrConst<DT>(),
-                                                             label->template GetPtrConst<DT>(),
-                                                             dx->template GetPtrMutable<DT>()
-                                                             );
-    
-    math::scal<DT, DC>(m * n,
-                                  loss->template GetPtrConst<DT>()[0] / static_cast<DT>(m),
-                                  dx->template GetPtrConst<DT>(),
-                                  dx->template GetPtrMutable<DT>()
-                                  );
+    const DT *prob_ptr = prob->template GetPtrConst<DT>();
+    const DT *label_ptr = label->template GetPtrConst<DT>();
+    const DT scale = loss->template GetPtrConst<DT>()[0] / static_cast<DT>(m);
+    DT *dx_ptr = dx->template GetPtrMutable<DT>();
+    
+    parallel_for(0, m, parallel_grain_of(n), [&](int from, int to){
+        math::cross_entropy_gradients<DT, DC>(to - from, n,
+                                              prob_ptr + from * n,
+                                              label_ptr + from * n,
+                                              dx_ptr + from * n
+                                              );
+        
+        math::scal<DT, DC>((to - from) * n, scale, dx_ptr + from * n, dx_ptr + from * n);
+    });
 }
 
 REGIST_OPERATOR_CPU(SoftmaxXentLossWithLabel_float_Gradient, 
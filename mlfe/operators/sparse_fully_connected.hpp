@@ -0,0 +1,63 @@
+#ifndef __SPARSE_FULLY_CONNECTED_OP_HPP__
+#define __SPARSE_FULLY_CONNECTED_OP_HPP__
+#include <vector>
+#include "operator.hpp"
+
+namespace mlfe{
+
+/*
+ * FC over a sparse x{m, k} in CSR format, y{m, units} = x * w + b.
+ * x is given by three blobs,
+ *   indptr int{m + 1}, the row i owns the entries [indptr[i], indptr[i + 1]),
+ *   indices int{capacity}, column of each entry,
+ *   values {capacity}, value of each entry.
+ * w is {k, units}, the transpose of the FC layout, so an entry of x
+ * adds one contiguous row of w to its row of y.
+ * the rows of the batch are split over threads.
+ *
+ * Params :
+ *   Units, Columns (k), to create w{k, units} and b{units}.
+ */
+template <class DataType, class DeviceContext>
+class SparseFullyConnectedOp final : public Operator<DeviceContext>{
+public:
+    explicit SparseFullyConnectedOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+    
+private:
+    enum InputSchema{indptr, indices, values, w, b};
+    enum OutputSchema{y};
+    int m;
+    int n;
+    int k;
+};
+
+/*
+ * dw has the dense layout of w, but a step writes only the rows,
+ * which are active in x, and the rows of the previous step are cleared.
+ * there is no gradient of x. like FC, dw and db are divided by the batch size.
+ * the units of dw are split over threads.
+ */
+template <class DataType, class DeviceContext>
+class SparseFullyConnectedGradientOp final : public Operator<DeviceContext>{
+public:
+    explicit SparseFullyConnectedGradientOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+    
+private:
+    enum InputSchema{indptr, indices, values, w, dy};
+    enum OutputSchema{dw, db};
+    /*
+     * active rows of dw in the previous step, and a mark per row.
+     */
+    std::vector<int> active;
+    std::vector<bool> is_active;
+    int m;
+    int n;
+    int k;
+};
+
+} /* namespace mlfe */
+#endif /* __SPARSE_FULLY_CONNECTED_OP_HPP__ */
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include "sparse_fully_connected.hpp"
+#include "../math/blas.hpp"
+#include "../math/sparse.hpp"
+#include "../device_context/cpu_context.hpp"
+#include "../utils/assert.hpp"
+#include "../utils/parallel.hpp"
+
+namespace mlfe{
+
+namespace{
+/*
+ * checks that indptr and indices describe m rows of k columns.
+ */
+void CheckCSR(const int m, const int k, const int capacity,
+              const int *indptr_ptr, const int *indices_ptr){
+    runtime_assert(indptr_ptr[0] == 0 && indptr_ptr[m] <= capacity,
+                   "[Sparse FC Op] indptr is out of indices.");
+    for(int i = 0; i < m; ++i){
+        runtime_assert(indptr_ptr[i] <= indptr_ptr[i + 1],
+                       "[Sparse FC Op] indptr must be non decreasing.");
+    }
+    for(int p = 0; p < indptr_ptr[m]; ++p){
+        runtime_assert(indices_ptr[p] >= 0 && indices_ptr[p] < k,
+                       "[Sparse FC Op] column index is out of x.");
+    }
+}
+} /* namespace */
+
+template <class DT, class DC>
+SparseFullyConnectedOp<DT, DC>::SparseFullyConnectedOp(
+                                                       OperatorIO &opio,
+                                                       ItemHolder *ih
+                                                       ) : Operator<DC>(opio, ih) {
+    runtime_assert(this->inputs.size() == 5,
+                   "[Sparse FC Op] inputs.size() == 5.");
+    runtime_assert(this->outputs.size() == 1,
+                   "[Sparse FC Op] outputs.size() == 1.");
+    
+    const auto x_indptr = this->inputs[InputSchema::indptr];
+    const auto x_indices = this->inputs[InputSchema::indices];
+    const auto x_values = this->inputs[InputSchema::values];
+    const auto w = this->inputs[InputSchema::w];
+    const auto b = this->inputs[InputSchema::b];
+    auto y = this->outputs[OutputSchema::y];
+    
+    runtime_assert(x_indptr->template MatchType<int>() && x_indices->template MatchType<int>(),
+                   "[Sparse FC Op] indptr and indices type must be int.");
+    runtime_assert(x_indices->Size() == x_values->Size(),
+                   "[Sparse FC Op] indices->Size() == values->Size().");
+    if(opio.param.HasParam("Units") && opio.param.HasParam("Columns") &&
+       w->IsEmpty() && b->IsEmpty()){
+        n = opio.param.GetParam<int>("Units");
+        k = opio.param.GetParam<int>("Columns");
+        w->template Resize<DT>({k, n});
+        b->template Resize<DT>({n});
+    }
+    runtime_assert(w->Dims() == 2,
+                   "[Sparse FC Op] w->Dims() == 2.");
+    m = x_indptr->Size() - 1;
+    k = w->Dim(0);
+    n = w->Dim(1);
+    runtime_assert(m > 0,
+                   "[Sparse FC Op] indptr->Size() > 1.");
+    runtime_assert(b->Size() == n,
+                   "[Sparse FC Op] b->Size() == w->Dim(1).");
+    if(y->IsEmpty()){
+        y->template Resize<DT>({m, n});
+    }
+    else{
+        runtime_assert(y->Dim(0) == m && y->Dim(1) == n,
+                       "[Sparse FC Op] y->Dims() == {m, units}.");
+    }
+}
+
+template <class DT, class DC>
+void SparseFullyConnectedOp<DT, DC>::Compute(){
+    const auto x_indices = this->inputs[InputSchema::indices];
+    const int *indptr_ptr = this->inputs[InputSchema::indptr]->template GetPtrConst<int>();
+    const int *indices_ptr = x_indices->template GetPtrConst<int>();
+    const DT *values_ptr = this->inputs[InputSchema::values]->template GetPtrConst<DT>();
+    const DT *w_ptr = this->inputs[InputSchema::w]->template GetPtrConst<DT>();
+    const DT *b_ptr = this->inputs[InputSchema::b]->template GetPtrConst<DT>();
+    DT *y_ptr = this->outputs[OutputSchema::y]->template GetPtrMutable<DT>();
+    
+    CheckCSR(m, k, x_indices->Size(), indptr_ptr, indices_ptr);
+    /*
+     * a row costs its active columns times the units.
+     */
+    parallel_for(0, m, parallel_grain_of((indptr_ptr[m] / m + 1) * n), [&](int from, int to){
+        math::csr_fc<DT, DC>(from, to, n, k,
+                             indptr_ptr, indices_ptr, values_ptr,
+                             w_ptr, b_ptr, y_ptr);
+    });
+}
+
+REGIST_OPERATOR_CPU(SparseFC_float, SparseFullyConnectedOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(SparseFC_double, SparseFullyConnectedOp<double, CPUContext>)
+
+template <class DT, class DC>
+SparseFullyConnectedGradientOp<DT, DC>::SparseFullyConnectedGradientOp(
+                                                                       OperatorIO &opio,
+                                                                       ItemHolder *ih
+                                                                       ) : Operator<DC>(opio, ih) {
+    runtime_assert(this->inputs.size() == 5,
+                   "[Sparse FC Gradient Op] inputs.size() == 5.");
+    runtime_assert(this->outputs.size() == 2,
+                   "[Sparse FC Gradient Op] outputs.size() == 2.");
+    
+    const auto x_indptr = this->inputs[InputSchema::indptr];
+    const auto w = this->inputs[InputSchema::w];
+    auto dw = this->outputs[OutputSchema::dw];
+    auto db = this->outputs[OutputSchema::db];
+    
+    m = x_indptr->Size() - 1;
+    k = w->Dim(0);
+    n = w->Dim(1);
+    if(dw->IsEmpty() && db->IsEmpty()){
+        dw->template Resize<DT>(*w);
+        db->template Resize<DT>({n});
+    }
+    else{
+        runtime_assert(dw->CompareSizeWith(*w),
+                       "[Sparse FC Gradient Op] dw->Dims() == w->Dims().");
+        runtime_assert(db->Size() == n,
+                       "[Sparse FC Gradient Op] db->Size() == w->Dim(1).");
+    }
+    /*
+     * the first step has no previous columns to clear.
+     */
+    dw->template SetByConst<DT>(DT(0));
+    is_active.assign(k, false);
+    active.reserve(k);
+}
+
+template <class DT, class DC>
+void SparseFullyConnectedGradientOp<DT, DC>::Compute(){
+    const auto x_indices = this->inputs[InputSchema::indices];
+    const int *indptr_ptr = this->inputs[InputSchema::indptr]->template GetPtrConst<int>();
+    const int *indices_ptr = x_indices->template GetPtrConst<int>();
+    const DT *values_ptr = this->inputs[InputSchema::values]->template GetPtrConst<DT>();
+    const DT *dy_ptr = this->inputs[InputSchema::dy]->template GetPtrConst<DT>();
+    auto db = this->outputs[OutputSchema::db];
+    DT *dw_ptr = this->outputs[OutputSchema::dw]->template GetPtrMutable<DT>();
+    const DT scale = DT(1) / static_cast<DT>(m);
+    
+    CheckCSR(m, k, x_indices->Size(), indptr_ptr, indices_ptr);
+    /*
+     * db = sum of dy over the batch.
+     */
+    math::colwise_sum<DT, DC>(m, n, dy_ptr, DT(0), db->template GetPtrMutable<DT>());
+    math::scal<DT, DC>(n, scale, db->template GetPtrConst<DT>(), db->template GetPtrMutable<DT>());
+    
+    /*
+     * every thread owns a range of the units, which is a contiguous part
+     * of every row of dw, so the rows are cleared and accumulated without sharing.
+     */
+    parallel_for(0, n, parallel_grain_of(indptr_ptr[m] + active.size()), [&](int from, int to){
+        for(auto row : active){
+            std::fill(dw_ptr + row * n + from, dw_ptr + row * n + to, DT(0));
+        }
+        math::csr_fc_gradient_w<DT, DC>(from, to, m, n, k,
+                                        indptr_ptr, indices_ptr, values_ptr,
+                                        scale, dy_ptr, dw_ptr);
+    });
+    
+    for(auto col : active){
+        is_active[col] = false;
+    }
+    active.clear();
+    for(int p = 0; p < indptr_ptr[m]; ++p){
+        if(!is_active[indices_ptr[p]]){
+            is_active[indices_ptr[p]] = true;
+            active.push_back(indices_ptr[p]);
+        }
+    }
+}
+
+REGIST_OPERATOR_CPU(SparseFC_float_Gradient, SparseFullyConnectedGradientOp<float, CPUContext>)
+REGIST_OPERATOR_CPU(SparseFC_double_Gradient, SparseFullyConnectedGradientOp<double, CPUContext>)
+
+struct SparseFullyConnectedGradientIO : public GradientIO{
+    OperatorIO GetGradientIO(OperatorIO opio) override{
+        OperatorIO opio_grad;
+        opio_grad.type = opio.type + "_" + opio.data_type + "_Gradient";
+        opio_grad.data_type = opio.data_type;
+        opio_grad.inputs.push_back(opio.inputs[0]);
+        opio_grad.inputs.push_back(opio.inputs[1]);
+        opio_grad.inputs.push_back(opio.inputs[2]);
+        opio_grad.inputs.push_back(opio.inputs[3]);
+        opio_grad.inputs.push_back(opio.outputs[0] + "_grad");
+        opio_grad.outputs.push_back(opio.inputs[3] + "_grad");
+        opio_grad.outputs.push_back(opio.inputs[4] + "_grad");
+        opio_grad.param = opio.param;
+        
+        return opio_grad;
+    }
+};
+
+REGIST_OPERATOR_GRADIENT_IO(SparseFC, SparseFullyConnectedGradientIO);
+
+} /* namespace mlfe */
@@ -0,0 +1,43 @@
+#ifndef __SPARSE_SOFTMAX_XENT_WITH_LABEL_HPP__
+#define __SPARSE_SOFTMAX_XENT_WITH_LABEL_HPP__
+#include "operator.hpp"
+
+namespace mlfe{
+
+/*
+ * softmax cross entropy, with class indices as label instead of one hot vectors.
+ * label holds one unsigned char or int index per row of x, like {m} or {m, 1}.
+ */
+template <class DataType, class DeviceContext>
+class SparseSoftmaxCrossEntropyWithLabelOp final : public Operator<DeviceContext>{
+public:
+    explicit SparseSoftmaxCrossEntropyWithLabelOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+    
+private:
+    enum InputSchema{x, label};
+    enum OutputSchema{prob, loss};
+    TensorBlob<DeviceContext> sum_multiplier;
+    TensorBlob<DeviceContext> rows_max;
+    TensorBlob<DeviceContext> scaler;
+    int m;
+    int n;
+};
+
+template <class DataType, class DeviceContext>
+class SparseSoftmaxCrossEntropyWithLabelGradientOp final : public Operator<DeviceContext>{
+public:
+    explicit SparseSoftmaxCrossEntropyWithLabelGradientOp(OperatorIO &opio, ItemHolder *ih);
+    
+    void Compute() override;
+    
+private:
+    enum InputSchema{x, label, prob, loss};
+    enum OutputSchema{dx};
+    int m;
+    int n;
+};
+
+} /* namespace mlfe */
+#endif /* __SPARSE_SOFTMAX_XENT_WITH_LABEL_HPP__ */
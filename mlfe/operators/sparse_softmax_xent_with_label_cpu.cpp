@@ -0,0 +1,230 @@
+#include "sparse_softmax_xent_with_label.hpp"
+#include "../device_context/cpu_context.hpp"
+#include "../math/blas.hpp"
+#include "../utils/assert.hpp"
+#include "../utils/parallel.hpp"
+
+namespace mlfe{
+
+template <class DT, class DC>
+SparseSoftmaxCrossEntropyWithLabelOp<DT, DC>
+::SparseSoftmaxCrossEntropyWithLabelOp(
+                                       OperatorIO &opio,
+                                       ItemHolder *ih
+                                       ) : Operator<DC>(opio, ih){
+    runtime_assert(this->inputs.size() == 2,
+                   "[Sparse Softmax Cross Entropy With Label Op] inputs.size() == 2");
+    runtime_assert(this->outputs.size() == 2,
+                   "[Sparse Softmax Cross Entropy With Label Op] outputs.size() == 2");
+    
+    const auto x = this->inputs[InputSchema::x];
+    const auto label = this->inputs[InputSchema::label];
+    auto prob = this->outputs[OutputSchema::prob];
+    auto loss = this->outputs[OutputSchema::loss];
+    
+    runtime_assert(x->Dims() == 2,
+                   "[Sparse Softmax Cross Entropy With Label Op] x->Dims() == 2.");
+    runtime_assert(label->Size() == x->Dim(0),
+                   "[Sparse Softmax Cross Entropy With Label Op] label->Size() == x->Dim(0).");
+    runtime_assert(label->template MatchType<unsigned char>() || label->template MatchType<int>(),
+                   "[Sparse Softmax Cross Entropy With Label Op] label type must be unsigned char or int.");
+    if(prob->IsEmpty() && loss->IsEmpty()){
+        prob->template Resize<DT>(*x);
+        loss->template Resize<DT>({1});
+    }
+    else{
+        runtime_assert(x->CompareSizeWith(*prob),
+                       "[Sparse Softmax Cross Entropy With Label Op] x->CompareSizeWith(prob).");
+        runtime_assert(loss->Size() == 1,
+                       "[Sparse Softmax Cross Entropy With Label Op] loss->Size() == 1");
+    }
+    
+    sum_multiplier.template Resize<DT, DC>({prob->Dim(1)});
+    sum_multiplier.template SetByConst<DT>((DT(1)));
+    rows_max.template Resize<DT, DC>({x->Dim(0)});
+    scaler.template Resize<DT, DC>({x->Dim(0)});
+    
+    /*
+     * batch size.
+     */
+    m = x->Dim(0);
+    /*
+     * output size.
+     */
+    n = x->Dim(1);
+}
+
+template <class DT, class DC>
+void SparseSoftmaxCrossEntropyWithLabelOp<DT, DC>::Compute(){
+    const auto x = this->inputs[InputSchema::x];
+    const auto label = this->inputs[InputSchema::label];
+    auto prob = this->outputs[OutputSchema::prob];
+    auto loss = this->outputs[OutputSchema::loss];
+    
+    const DT *x_ptr = x->template GetPtrConst<DT>();
+    const DT *ones_ptr = sum_multiplier.template GetPtrConst<DT>();
+    DT *prob_ptr = prob->template GetPtrMutable<DT>();
+    DT *max_ptr = rows_max.template GetPtrMutable<DT>();
+    DT *scaler_ptr = scaler.template GetPtrMutable<DT>();
+    
+    /*
+     * the rows are independent until the loss is summed,
+     * so every chunk of rows runs the whole softmax.
+     */
+    parallel_for(0, m, parallel_grain_of(n), [&](int from, int to){
+        const int rows = to - from;
+        DT *prob_rows = prob_ptr + from * n;
+        
+        math::rowwise_max<DT, DC>(rows, n, x_ptr + from * n, max_ptr + from);
+        
+        math::scal<DT, DC>(rows * n, DT(1), x_ptr + from * n, prob_rows);
+        
+        math::gemm<DT, DC>(false, false,
+                           rows, n, 1,
+                           DT(-1), max_ptr + from, 1,
+                           ones_ptr, n,
+                           DT(1), prob_rows, n, nullptr);
+        
+        math::exp<DT, DC>(rows * n, prob_rows, prob_rows);
+        
+        math::gemv<DT, DC>(false,
+                           rows, n,
+                           DT(1), prob_rows, n,
+                           ones_ptr,
+                           DT(0), scaler_ptr + from, 1, nullptr);
+        
+        math::rowwise_normalize<DT, DC>(rows, n, scaler_ptr + from, prob_rows);
+        
+        /*
+         * only the probability of the label is read from each row.
+         */
+        if(label->template MatchType<unsigned char>()){
+            math::sparse_cross_entropy<DT, unsigned char, DC>(rows, n, prob_rows,
+                                                              label->template GetPtrConst<unsigned char>() + from,
+                                                              max_ptr + from);
+        }
+        else{
+            math::sparse_cross_entropy<DT, int, DC>(rows, n, prob_rows,
+                                                    label->template GetPtrConst<int>() + from,
+                                                    max_ptr + from);
+        }
+    });
+    
+    math::sum<DT, DC>(m,
+                      rows_max.template GetPtrConst<DT>(),
+                      loss->template GetPtrMutable<DT>()
+                      );
+    
+    math::scal<DT, DC>(1,
+                       static_cast<DT>(1) / static_cast<DT>(m),
+                       loss->template GetPtrConst<DT>(),
+                       loss->template GetPtrMutable<DT>()
+                       );
+}
+
+REGIST_OPERATOR_CPU(SparseSoftmaxXentWithLabel_float,
+                    SparseSoftmaxCrossEntropyWithLabelOp<float, CPUContext>)
+
+REGIST_OPERATOR_CPU(SparseSoftmaxXentWithLabel_double,
+                    SparseSoftmaxCrossEntropyWithLabelOp<double, CPUContext>)
+
+template <class DT, class DC>
+SparseSoftmaxCrossEntropyWithLabelGradientOp<DT, DC>
+::SparseSoftmaxCrossEntropyWithLabelGradientOp(
+                                               OperatorIO &opio,
+                                               ItemHolder *ih
+                                               ) : Operator<DC>(opio, ih) {
+    runtime_assert(this->inputs.size() == 4,
+                   "[Sparse Softmax Cross Entropy With Label Gradient Op] inputs.size() == 4");
+    runtime_assert(this->outputs.size() == 1,
+                   "[Sparse Softmax Cross Entropy With Label Gradient Op] outputs.size() == 1");
+    
+    const auto x = this->inputs[InputSchema::x];
+    const auto label = this->inputs[InputSchema::label];
+    const auto prob = this->inputs[InputSchema::prob];
+    const auto loss = this->inputs[InputSchema::loss];
+    auto dx = this->outputs[OutputSchema::dx];
+    
+    runtime_assert(prob->Dims() == 2,
+                   "[Sparse Softmax Cross Entropy With Label Gradient Op] prob->Dims() == 2.");
+    runtime_assert(loss->Size() == 1,
+                   "[Sparse Softmax Cross Entropy With Label Gradient Op] loss->Size() == 1.");
+    runtime_assert(label->Size() == prob->Dim(0),
+                   "[Sparse Softmax Cross Entropy With Label Gradient Op] label->Size() == prob->Dim(0).");
+    if(dx->IsEmpty()){
+        dx->template Resize<DT>(*x);
+    }
+    else{
+        runtime_assert(dx->CompareSizeWith(*x),
+                       "[Sparse Softmax Cross Entropy With Label Gradient Op] dx->CompareSizeWith(x).");
+    }
+    
+    /*
+     * batch size.
+     */
+    m = dx->Dim(0);
+    /*
+     * output size.
+     */
+    n = dx->Dim(1);
+}
+
+template <class DT, class DC>
+void SparseSoftmaxCrossEntropyWithLabelGradientOp<DT, DC>::Compute(){
+    const auto prob = this->inputs[InputSchema::prob];
+    const auto label = this->inputs[InputSchema::label];
+    const auto loss = this->inputs[InputSchema::loss];
+    auto dx = this->outputs[OutputSchema::dx];
+    
+    const DT *prob_ptr = prob->template GetPtrConst<DT>();
+    /*
+     * scaled like the gradient of SoftmaxXentLossWithLabel.
+     */
+    const DT scale = loss->template GetPtrConst<DT>()[0] / static_cast<DT>(m);
+    DT *dx_ptr = dx->template GetPtrMutable<DT>();
+    
+    parallel_for(0, m, parallel_grain_of(n), [&](int from, int to){
+        if(label->template MatchType<unsigned char>()){
+            math::sparse_cross_entropy_gradients<DT, unsigned char, DC>(to - from, n,
+                                                                        prob_ptr + from * n,
+                                                                        label->template GetPtrConst<unsigned char>() + from,
+                                                                        dx_ptr + from * n
+                                                                        );
+        }
+        else{
+            math::sparse_cross_entropy_gradients<DT, int, DC>(to - from, n,
+                                                              prob_ptr + from * n,
+                                                              label->template GetPtrConst<int>() + from,
+                                                              dx_ptr + from * n
+                                                              );
+        }
+        
+        math::scal<DT, DC>((to - from) * n, scale, dx_ptr + from * n, dx_ptr + from * n);
+    });
+}
+
+REGIST_OPERATOR_CPU(SparseSoftmaxXentWithLabel_float_Gradient,
+                    SparseSoftmaxCrossEntropyWithLabelGradientOp<float, CPUContext>)
+
+REGIST_OPERATOR_CPU(SparseSoftmaxXentWithLabel_double_Gradient,
+                    SparseSoftmaxCrossEntropyWithLabelGradientOp<double, CPUContext>)
+
+struct SparseSoftmaxXentWithLabelGradientIO : public GradientIO{
+    OperatorIO GetGradientIO(OperatorIO opio) override{
+        OperatorIO opio_grad;
+        opio_grad.type = opio.type + "_" + opio.data_type + "_Gradient";
+        opio_grad.data_type = opio.data_type;
+        opio_grad.inputs.push_back(opio.inputs[0]);
+        opio_grad.inputs.push_back(opio.inputs[1]);
+        opio_grad.inputs.push_back(opio.outputs[0]);
+        opio_grad.inputs.push_back(opio.outputs[1]);
+        opio_grad.outputs.push_back(opio.inputs[0] + "_grad");
+        opio_grad.param = opio.param;
+        
+        return opio_grad;
+    }
+};
+
+REGIST_OPERATOR_GRADIENT_IO(SparseSoftmaxXentWithLabel, SparseSoftmaxXentWithLabelGradientIO);
+
+} /* namespace mlfe */
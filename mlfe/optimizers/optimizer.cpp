@@ -0,0 +1,298 @@
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <Eigen/Core>
+#include "optimizer.hpp"
+#include "../utils/assert.hpp"
+#include "../utils/parallel.hpp"
+
+namespace mlfe{
+
+namespace{
+/*
+ * elements of one block, the states of a block stay in L1
+ * between the expressions of the update.
+ */
+const int optimizer_block = 1024;
+/*
+ * a chunk of less elements than this is not handed to another thread.
+ */
+const int optimizer_parallel_min_size = 1 << 16;
+
+template <class DataType>
+DataType GetParamOr(ParamDef &param, std::string name, DataType value){
+    if(param.HasParam(name)){
+        return static_cast<DataType>(param.GetParam<float>(name));
+    }
+    return value;
+}
+} /* namespace */
+
+template <class DataType>
+Optimizer<DataType>::Optimizer(std::string type, ParamDef param)
+: type(type), total_size(0), state_size(0), num_threads(0), step(0){
+    if(!type.compare("SGD")){
+        kind = Kind::SGD;
+    }
+    else if(!type.compare("Momentum")){
+        kind = Kind::Momentum;
+    }
+    else if(!type.compare("Nesterov")){
+        kind = Kind::Nesterov;
+    }
+    else if(!type.compare("Adagrad")){
+        kind = Kind::Adagrad;
+    }
+    else if(!type.compare("Adam")){
+        kind = Kind::Adam;
+    }
+    else if(!type.compare("AdamW")){
+        kind = Kind::AdamW;
+    }
+    else{
+        throw std::string("[Optimizer] Not supported optimizer -> ") + type;
+    }
+    lr = GetParamOr<DataType>(param, "LearningRate", DataType(0.01));
+    momentum = GetParamOr<DataType>(param, "Momentum", DataType(0.9));
+    beta1 = GetParamOr<DataType>(param, "Beta1", DataType(0.9));
+    beta2 = GetParamOr<DataType>(param, "Beta2", DataType(0.999));
+    epsilon = GetParamOr<DataType>(param, "Epsilon", DataType(1e-8));
+    weight_decay = GetParamOr<DataType>(param, "WeightDecay", DataType(0));
+}
+
+template <class DataType>
+void Optimizer<DataType>::AddVariable(TensorBlob<CPUContext> *var, TensorBlob<CPUContext> *grad){
+    runtime_assert(var->CompareSizeWith(*grad),
+                   "[Optimizer] var->CompareSizeWith(grad).");
+    runtime_assert(step == 0,
+                   "[Optimizer] variables must be added before the first update.");
+    Slot slot;
+    slot.var = var;
+    slot.grad = grad;
+    slot.rows = nullptr;
+    slot.size = var->Size();
+    slot.offset = total_size;
+    slot.state_offset = state_size;
+    slots.push_back(slot);
+    total_size += var->Size();
+    state_size += var->Size();
+    if(kind != Kind::SGD){
+        state_m.resize(state_size, DataType(0));
+    }
+    if(kind == Kind::Adam || kind == Kind::AdamW){
+        state_v.resize(state_size, DataType(0));
+    }
+}
+
+template <class DataType>
+void Optimizer<DataType>::AddSparseVariable(TensorBlob<CPUContext> *var, TensorBlob<CPUContext> *grad,
+                                            TensorBlob<CPUContext> *rows){
+    runtime_assert(var->Dims() >= 1 && grad->Dims() >= 1,
+                   "[Optimizer] var and grad must have rows.");
+    runtime_assert(grad->Size() / grad->Dim(0) == var->Size() / var->Dim(0),
+                   "[Optimizer] rows of grad must have the size of rows of var.");
+    runtime_assert(rows->Size() == grad->Dim(0),
+                   "[Optimizer] rows->Size() == grad->Dim(0).");
+    runtime_assert(step == 0,
+                   "[Optimizer] variables must be added before the first update.");
+    Slot slot;
+    slot.var = var;
+    slot.grad = grad;
+    slot.rows = rows;
+    slot.size = var->Size();
+    slot.offset = -1;
+    slot.state_offset = state_size;
+    sparse_slots.push_back(slot);
+    state_size += var->Size();
+    if(kind != Kind::SGD){
+        state_m.resize(state_size, DataType(0));
+    }
+    if(kind == Kind::Adam || kind == Kind::AdamW){
+        state_v.resize(state_size, DataType(0));
+    }
+}
+
+template <class DataType>
+void Optimizer<DataType>::Update(){
+    BeginStep();
+    
+    /*
+     * the pointers are taken here, so that the version of each variable
+     * is increased once, and not from several threads.
+     */
+    for(auto &slot : slots){
+        slot.var_ptr = slot.var->template GetPtrMutable<DataType>();
+        slot.grad_ptr = slot.grad->template GetPtrConst<DataType>();
+    }
+    /*
+     * sparse rows are few, they are updated before the dense range.
+     */
+    for(auto &slot : sparse_slots){
+        slot.var_ptr = slot.var->template GetPtrMutable<DataType>();
+        slot.grad_ptr = slot.grad->template GetPtrConst<DataType>();
+        slot.rows_ptr = slot.rows->template GetPtrConst<int>();
+        UpdateRows(slot);
+    }
+    
+    /*
+     * every chunk is a contiguous range of the flat index space, in whole blocks.
+     */
+    NumThreadsScope scope(num_threads);
+    const int blocks = (total_size + optimizer_block - 1) / optimizer_block;
+    parallel_for(0, blocks, optimizer_parallel_min_size / optimizer_block, [this](int from, int to){
+        UpdateRange(from * optimizer_block, std::min(to * optimizer_block, total_size));
+    });
+}
+
+template <class DataType>
+void Optimizer<DataType>::BeginStep(){
+    ++step;
+    step_size = lr;
+    v_correction = DataType(1);
+    if(kind == Kind::Adam || kind == Kind::AdamW){
+        step_size = lr / (DataType(1) - std::pow(beta1, step));
+        v_correction = DataType(1) / (DataType(1) - std::pow(beta2, step));
+    }
+}
+
+template <class DataType>
+void Optimizer<DataType>::UpdateVariable(TensorBlob<CPUContext> *var){
+    runtime_assert(step > 0, "[Optimizer] BeginStep must be called before UpdateVariable.");
+    /*
+     * the slots are only read here, since other variables may be updated concurrently.
+     */
+    for(auto &slot : sparse_slots){
+        if(slot.var == var){
+            Slot rows_slot = slot;
+            rows_slot.var_ptr = var->template GetPtrMutable<DataType>();
+            rows_slot.grad_ptr = slot.grad->template GetPtrConst<DataType>();
+            rows_slot.rows_ptr = slot.rows->template GetPtrConst<int>();
+            UpdateRows(rows_slot);
+            return;
+        }
+    }
+    std::less<const DataType *> before;
+    const DataType *var_begin = var->template GetPtrConst<DataType>();
+    const int size = var->Size();
+    for(auto &slot : slots){
+        const DataType *begin = slot.var->template GetPtrConst<DataType>();
+        if(before(var_begin, begin) || before(begin + slot.size, var_begin + size)){
+            continue;
+        }
+        const int offset = var_begin - begin;
+        DataType *w_ptr = var->template GetPtrMutable<DataType>();
+        const DataType *g_ptr = slot.grad->template GetPtrConst<DataType>() + offset;
+        const int state_offset = slot.state_offset + offset;
+        NumThreadsScope scope(num_threads);
+        const int blocks = (size + optimizer_block - 1) / optimizer_block;
+        parallel_for(0, blocks, optimizer_parallel_min_size / optimizer_block, [&](int from, int to){
+            for(int n = from * optimizer_block; n < std::min(to * optimizer_block, size); n += optimizer_block){
+                UpdateBlock(w_ptr + n, g_ptr + n, state_offset + n, std::min(optimizer_block, size - n));
+            }
+        });
+        return;
+    }
+    throw std::string("[Optimizer] the variable was not added.");
+}
+
+template <class DataType>
+void Optimizer<DataType>::UpdateRange(const int from, const int to){
+    for(auto &slot : slots){
+        const int begin = std::max(from, slot.offset);
+        const int end = std::min(to, slot.offset + slot.size);
+        for(int n = begin; n < end; n += optimizer_block){
+            UpdateBlock(slot.var_ptr + n - slot.offset,
+                        slot.grad_ptr + n - slot.offset,
+                        slot.state_offset + n - slot.offset,
+                        std::min(optimizer_block, end - n));
+        }
+    }
+}
+
+template <class DataType>
+void Optimizer<DataType>::UpdateRows(const Slot &slot){
+    const int row_size = slot.size / slot.var->Dim(0);
+    for(int r = 0; r < slot.rows->Size(); ++r){
+        const int row = slot.rows_ptr[r];
+        if(row < 0){
+            continue;
+        }
+        runtime_assert(row < slot.var->Dim(0), "[Optimizer] row of sparse gradient is out of var.");
+        UpdateBlock(slot.var_ptr + row * row_size,
+                    slot.grad_ptr + r * row_size,
+                    slot.state_offset + row * row_size,
+                    row_size);
+    }
+}
+
+template <class DataType>
+void Optimizer<DataType>::UpdateBlock(DataType *w_ptr, const DataType *g_ptr, const int state_offset, const int len){
+    using Array = Eigen::Array<DataType, Eigen::Dynamic, 1>;
+    Eigen::Map<Array> w(w_ptr, len);
+    Eigen::Map<const Array> g(g_ptr, len);
+    switch(kind){
+        case Kind::SGD:
+            w -= lr * (g + weight_decay * w);
+            break;
+        case Kind::Momentum:{
+            Eigen::Map<Array> m(state_m.data() + state_offset, len);
+            m = momentum * m + g + weight_decay * w;
+            w -= lr * m;
+            break;
+        }
+        case Kind::Nesterov:{
+            Eigen::Map<Array> m(state_m.data() + state_offset, len);
+            m = momentum * m + g + weight_decay * w;
+            w -= lr * (g + weight_decay * w + momentum * m);
+            break;
+        }
+        case Kind::Adagrad:{
+            Eigen::Map<Array> h(state_m.data() + state_offset, len);
+            h += (g + weight_decay * w).square();
+            w -= lr * (g + weight_decay * w) / (h.sqrt() + epsilon);
+            break;
+        }
+        case Kind::Adam:{
+            Eigen::Map<Array> m(state_m.data() + state_offset, len);
+            Eigen::Map<Array> v(state_v.data() + state_offset, len);
+            m = beta1 * m + (DataType(1) - beta1) * (g + weight_decay * w);
+            v = beta2 * v + (DataType(1) - beta2) * (g + weight_decay * w).square();
+            w -= step_size * m / ((v * v_correction).sqrt() + epsilon);
+            break;
+        }
+        case Kind::AdamW:{
+            Eigen::Map<Array> m(state_m.data() + state_offset, len);
+            Eigen::Map<Array> v(state_v.data() + state_offset, len);
+            m = beta1 * m + (DataType(1) - beta1) * g;
+            v = beta2 * v + (DataType(1) - beta2) * g.square();
+            w = w * (DataType(1) - lr * weight_decay) -
+            step_size * m / ((v * v_correction).sqrt() + epsilon);
+            break;
+        }
+    }
+}
+
+template <class DataType>
+void Optimizer<DataType>::SetLearningRate(DataType lr){
+    this->lr = lr;
+}
+
+template <class DataType>
+DataType Optimizer<DataType>::GetLearningRate(){
+    return lr;
+}
+
+template <class DataType>
+void Optimizer<DataType>::SetNumThreads(int num){
+    num_threads = num;
+}
+
+template <class DataType>
+std::string Optimizer<DataType>::GetType(){
+    return type;
+}
+
+template class Optimizer<float>;
+template class Optimizer<double>;
+
+} /* namespace mlfe */
@@ -0,0 +1,131 @@
+#ifndef __OPTIMIZER_HPP__
+#define __OPTIMIZER_HPP__
+#include <string>
+#include <vector>
+#include "../core/param_def.hpp"
+#include "../core/tensor_blob.hpp"
+#include "../device_context/cpu_context.hpp"
+
+namespace mlfe{
+
+/*
+ * Updates every registered variable with its gradient in one fused pass.
+ * The variables are walked in blocks, and each block of a variable,
+ * its gradient and its optimizer states is read and written only once per step.
+ * Large models split the blocks over the shared pool.
+ *
+ * Type : "SGD", "Momentum", "Nesterov", "Adagrad", "Adam" or "AdamW".
+ * Params, all float :
+ *   LearningRate (0.01),
+ *   Momentum (0.9) for Momentum and Nesterov,
+ *   Beta1 (0.9), Beta2 (0.999) for Adam and AdamW,
+ *   Epsilon (1e-8) for Adagrad, Adam and AdamW,
+ *   WeightDecay (0), added to the gradient as L2 except for AdamW,
+ *   where it is decoupled from the gradient.
+ */
+template <class DataType>
+class Optimizer{
+public:
+    Optimizer(std::string type, ParamDef param);
+    
+    /*
+     * the optimizer states of var are allocated here,
+     * so all variables must be added before the first Update.
+     */
+    void AddVariable(TensorBlob<CPUContext> *var, TensorBlob<CPUContext> *grad);
+    
+    /*
+     * grad holds rows of var, whose indices are in rows, and -1 marks unused entries.
+     * only those rows of var, and of its optimizer states, are updated by a step.
+     */
+    void AddSparseVariable(TensorBlob<CPUContext> *var, TensorBlob<CPUContext> *grad,
+                           TensorBlob<CPUContext> *rows);
+    
+    void Update();
+    
+    /*
+     * Update split in steps, BeginStep starts a step,
+     * then UpdateVariable updates one added variable, or a view of one like a part of an arena.
+     * the variables can be updated concurrently, and each must be updated once per step,
+     * so a variable is updated as soon as its gradient is ready.
+     */
+    void BeginStep();
+    
+    void UpdateVariable(TensorBlob<CPUContext> *var);
+    
+    void SetLearningRate(DataType lr);
+    
+    DataType GetLearningRate();
+    
+    /*
+     * 0 uses the thread count of the parallel loops.
+     */
+    void SetNumThreads(int num);
+    
+    std::string GetType();
+
+protected:
+    enum class Kind{SGD, Momentum, Nesterov, Adagrad, Adam, AdamW};
+    
+    struct Slot{
+        TensorBlob<CPUContext> *var;
+        TensorBlob<CPUContext> *grad;
+        TensorBlob<CPUContext> *rows;
+        DataType *var_ptr;
+        const DataType *grad_ptr;
+        const int *rows_ptr;
+        int size;
+        /*
+         * offset of a dense slot in the flat index space.
+         */
+        int offset;
+        /*
+         * offset of the slot's states in state_m and state_v.
+         */
+        int state_offset;
+    };
+    
+    /*
+     * updates the elements [from, to) of the flat index space over the dense slots.
+     */
+    void UpdateRange(const int from, const int to);
+    
+    /*
+     * updates the touched rows of a sparse slot.
+     */
+    void UpdateRows(const Slot &slot);
+    
+    /*
+     * the fused update of len elements of a variable, its gradient and its states.
+     */
+    void UpdateBlock(DataType *w_ptr, const DataType *g_ptr, const int state_offset, const int len);
+
+private:
+    std::string type;
+    Kind kind;
+    std::vector<Slot> slots;
+    std::vector<Slot> sparse_slots;
+    std::vector<DataType> state_m;
+    std::vector<DataType> state_v;
+    /*
+     * size of the flat index space, and of the states.
+     */
+    int total_size;
+    int state_size;
+    int num_threads;
+    int step;
+    DataType lr;
+    DataType momentum;
+    DataType beta1;
+    DataType beta2;
+    DataType epsilon;
+    DataType weight_decay;
+    /*
+     * per step values, bias corrections of adam.
+     */
+    DataType step_size;
+    DataType v_correction;
+};
+
+} /* namespace mlfe */
+#endif /* __OPTIMIZER_HPP__ */
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "affinity.hpp"
+
+namespace mlfe{
+
+namespace{
+struct Placement{
+    ThreadRole role;
+    int index;
+    std::vector<int> cores;
+    bool applied;
+};
+
+struct AffinityConfig{
+    std::mutex m;
+    std::vector<int> compute;
+    std::vector<int> loader;
+    std::vector<int> reserved;
+    std::vector<Placement> placements;
+};
+
+std::vector<int> CoresFromEnv(const char *name){
+    const char *value = std::getenv(name);
+    if(value == nullptr){
+        return std::vector<int>();
+    }
+    try{
+        return ParseCoreList(value);
+    }
+    catch(std::string &e){
+        throw std::string(name) + " : " + e;
+    }
+}
+
+AffinityConfig &Config(){
+    static AffinityConfig *config = [](){
+        AffinityConfig *config = new AffinityConfig();
+        config->compute = CoresFromEnv("MLFE_COMPUTE_CORES");
+        config->loader = CoresFromEnv("MLFE_LOADER_CORES");
+        config->reserved = CoresFromEnv("MLFE_IO_CORES");
+        return config;
+    }();
+    return *config;
+}
+
+std::vector<int> Subtract(const std::vector<int> &a, const std::vector<int> &b){
+    std::vector<int> result;
+    std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+std::vector<int> Intersect(const std::vector<int> &a, const std::vector<int> &b){
+    std::vector<int> result;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+/*
+ * the config lock must be held.
+ */
+std::vector<int> AffinityOf(AffinityConfig &config, ThreadRole role){
+    const auto available = GetAvailableCores();
+    if(role == ThreadRole::Loader){
+        return Intersect(config.loader.empty() ? config.reserved : config.loader, available);
+    }
+    if(config.compute.empty() && config.reserved.empty()){
+        return std::vector<int>();
+    }
+    const auto &cores = config.compute.empty() ? available : config.compute;
+    return Subtract(Intersect(cores, available), config.reserved);
+}
+
+bool ApplyAffinity(const std::vector<int> &cores){
+#if defined(__linux__)
+    /*
+     * CPU_SET does not check its core, so a core out of the set is skipped.
+     */
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int valid = 0;
+    for(auto core : cores){
+        if(core < 0 || core >= CPU_SETSIZE){
+            std::cerr << "[Affinity] skipped core " << core << ", out of the cpu set." << std::endl;
+            continue;
+        }
+        CPU_SET(core, &set);
+        ++valid;
+    }
+    if(valid == 0){
+        return false;
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+const char *RoleName(ThreadRole role){
+    return role == ThreadRole::Compute ? "Compute" : "Loader";
+}
+} /* namespace */
+
+std::vector<int> ParseCoreList(std::string list){
+    std::vector<int> cores;
+    std::stringstream ss(list);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        int first, last;
+        char dash, rest;
+        std::stringstream range(item);
+        if(!(range >> first)){
+            throw std::string("[Affinity] malformed core list -> ") + list;
+        }
+        last = first;
+        if(range >> dash){
+            if(dash != '-' || !(range >> last)){
+                throw std::string("[Affinity] malformed core list -> ") + list;
+            }
+        }
+        if(range >> rest || first < 0 || last < first){
+            throw std::string("[Affinity] malformed core list -> ") + list;
+        }
+        for(int core = first; core <= last; ++core){
+            cores.push_back(core);
+        }
+    }
+    std::sort(cores.begin(), cores.end());
+    cores.erase(std::unique(cores.begin(), cores.end()), cores.end());
+    return cores;
+}
+
+std::string CoreListToString(const std::vector<int> &cores){
+    std::ostringstream ss;
+    for(int n = 0; n < static_cast<int>(cores.size()); ){
+        int last = n;
+        while(last + 1 < static_cast<int>(cores.size()) && cores[last + 1] == cores[last] + 1){
+            ++last;
+        }
+        ss << (n > 0 ? "," : "") << cores[n];
+        if(last > n){
+            ss << "-" << cores[last];
+        }
+        n = last + 1;
+    }
+    return ss.str();
+}
+
+std::vector<int> GetAvailableCores(){
+    std::vector<int> cores;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0){
+        for(int core = 0; core < CPU_SETSIZE; ++core){
+            if(CPU_ISSET(core, &set)){
+                cores.push_back(core);
+            }
+        }
+        return cores;
+    }
+#endif
+    for(int core = 0; core < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++core){
+        cores.push_back(core);
+    }
+    return cores;
+}
+
+void SetAffinity(ThreadRole role, std::vector<int> cores){
+    auto &config = Config();
+    std::unique_lock<std::mutex> lock(config.m);
+    std::sort(cores.begin(), cores.end());
+    (role == ThreadRole::Compute ? config.compute : config.loader) = cores;
+}
+
+void SetReservedCores(std::vector<int> cores){
+    auto &config = Config();
+    std::unique_lock<std::mutex> lock(config.m);
+    std::sort(cores.begin(), cores.end());
+    config.reserved = cores;
+}
+
+std::vector<int> GetReservedCores(){
+    auto &config = Config();
+    std::unique_lock<std::mutex> lock(config.m);
+    return config.reserved;
+}
+
+std::vector<int> GetAffinity(ThreadRole role){
+    auto &config = Config();
+    std::unique_lock<std::mutex> lock(config.m);
+    return AffinityOf(config, role);
+}
+
+bool PinCurrentThread(ThreadRole role, int index){
+    auto &config = Config();
+    std::unique_lock<std::mutex> lock(config.m);
+    auto cores = AffinityOf(config, role);
+    if(cores.empty()){
+        return false;
+    }
+    /*
+     * compute workers get a core each, only when the compute cores are given.
+     */
+    if(role == ThreadRole::Compute && !config.compute.empty()){
+        cores = std::vector<int>{cores[index % cores.size()]};
+    }
+    const bool applied = ApplyAffinity(cores);
+    config.placements.push_back({role, index, cores, applied});
+    return applied;
+}
+
+std::string AffinityReport(){
+    auto &config = Config();
+    std::unique_lock<std::mutex> lock(config.m);
+    std::ostringstream ss;
+    auto describe = [](const std::vector<int> &cores){
+        return cores.empty() ? std::string("any") : CoreListToString(cores);
+    };
+    ss << "- Affinity" << std::endl;
+    ss << "    " << "Available : " << describe(GetAvailableCores()) << std::endl;
+    ss << "    " << "Reserved for I/O : " << (config.reserved.empty() ? "none" : CoreListToString(config.reserved)) << std::endl;
+    ss << "    " << "Compute : " << describe(AffinityOf(config, ThreadRole::Compute)) << std::endl;
+    ss << "    " << "Loader : " << describe(AffinityOf(config, ThreadRole::Loader)) << std::endl;
+    for(auto &placement : config.placements){
+        ss << "    " << RoleName(placement.role) << " " << placement.index << " -> ";
+        ss << (placement.applied ? CoreListToString(placement.cores) : std::string("not applied")) << std::endl;
+    }
+    return ss.str();
+}
+
+} /* namespace mlfe */
@@ -0,0 +1,66 @@
+#ifndef __AFFINITY_HPP__
+#define __AFFINITY_HPP__
+#include <string>
+#include <vector>
+
+namespace mlfe{
+
+/*
+ * Kinds of threads, that are placed on their own cores.
+ * Compute are the workers of the shared pool, which run the operators,
+ * and the gemm of them as well, since it runs on the calling thread.
+ * Loader are the background threads of DBReader.
+ */
+enum class ThreadRole{Compute, Loader};
+
+/*
+ * parses a core list like "0-3,8,10-11", and returns sorted unique cores.
+ * throws on a malformed list.
+ */
+std::vector<int> ParseCoreList(std::string list);
+
+std::string CoreListToString(const std::vector<int> &cores);
+
+/*
+ * cores the process may run on.
+ */
+std::vector<int> GetAvailableCores();
+
+/*
+ * Affinity is read from the environment on the first use,
+ * and can be changed by the functions below.
+ *   MLFE_COMPUTE_CORES : cores of the compute workers,
+ *   MLFE_LOADER_CORES : cores of the loader threads,
+ *   MLFE_IO_CORES : cores reserved for I/O.
+ * Reserved cores are never used by compute workers,
+ * and loader threads run on them when no loader cores are given.
+ * An empty list leaves the threads of the role unpinned.
+ *
+ * A thread is pinned when it starts, so the shared pool must be configured before
+ * the first parallel operator runs, and the loaders before the DBReader is created.
+ */
+void SetAffinity(ThreadRole role, std::vector<int> cores);
+
+void SetReservedCores(std::vector<int> cores);
+
+std::vector<int> GetReservedCores();
+
+/*
+ * the cores threads of role run on, after removing the reserved and unavailable cores.
+ */
+std::vector<int> GetAffinity(ThreadRole role);
+
+/*
+ * pins the calling thread, a compute worker to the core of its index,
+ * and a loader to all loader cores, since it mostly waits for I/O.
+ * the result is recorded for the report, and false is returned when nothing is applied.
+ */
+bool PinCurrentThread(ThreadRole role, int index);
+
+/*
+ * the configured cores and the placement applied to every pinned thread.
+ */
+std::string AffinityReport();
+
+} /* namespace mlfe */
+#endif /* __AFFINITY_HPP__ */
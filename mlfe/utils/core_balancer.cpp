@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <string>
+#include "core_balancer.hpp"
+
+namespace mlfe{
+
+constexpr double CoreBalancer::stall_tolerance_ms;
+
+CoreBalancer::CoreBalancer(int total, int min_loaders, int max_loaders, int window)
+    : total(total), min_loaders(min_loaders), max_loaders(max_loaders), window(window){
+    if(min_loaders < 1 || max_loaders < min_loaders || total <= min_loaders || window < 1){
+        throw std::string("CoreBalancer : needs 1 <= min_loaders <= max_loaders, a window, and a thread left to compute.");
+    }
+    this->max_loaders = std::min(max_loaders, total - 1);
+    loaders = min_loaders;
+    steps = 0;
+    stalled_steps = 0;
+    always_full = true;
+    calm = 0;
+    calm_needed = 1;
+    last_given_back = 0;
+}
+
+bool CoreBalancer::Step(double stall_ms, double occupancy){
+    ++steps;
+    if(stall_ms > stall_tolerance_ms){
+        ++stalled_steps;
+    }
+    if(occupancy < 1.){
+        always_full = false;
+    }
+    if(steps < window){
+        return false;
+    }
+    const int before = loaders;
+    if(stalled_steps > 0){
+        calm = 0;
+        /*
+         * stalled again at the split a thread was given back from.
+         */
+        if(loaders + 1 == last_given_back){
+            calm_needed = std::min(calm_needed * 2, max_calm_windows);
+        }
+        loaders = std::min(loaders + 1, max_loaders);
+    }
+    else if(always_full && ++calm >= calm_needed && loaders > min_loaders){
+        calm = 0;
+        last_given_back = loaders;
+        --loaders;
+    }
+    else if(!always_full){
+        calm = 0;
+    }
+    steps = 0;
+    stalled_steps = 0;
+    always_full = true;
+    return loaders != before;
+}
+
+int CoreBalancer::Loaders() const{
+    return loaders;
+}
+
+int CoreBalancer::ComputeThreads() const{
+    return total - loaders;
+}
+
+} /* namespace mlfe */
@@ -0,0 +1,60 @@
+#ifndef __CORE_BALANCER_HPP__
+#define __CORE_BALANCER_HPP__
+
+namespace mlfe{
+
+/*
+ * Splits a number of threads between data loading and compute,
+ * from what every step reports: the time compute waited for its input,
+ * and the part of the prefetched batches that was ready when it was taken.
+ *
+ * The split is decided every window of steps. A window with a stalled step
+ * moves a thread to the loaders, and windows whose prefetch was always full
+ * move one back to compute, so the loaders end at the fewest threads without stalls.
+ * Giving back a thread, that stalls again, doubles the full windows needed
+ * for the next try, so the split does not swing between two values.
+ */
+class CoreBalancer{
+public:
+    /*
+     * total threads, of which min_loaders to max_loaders load the data,
+     * and at least one computes. it starts at min_loaders.
+     */
+    CoreBalancer(int total, int min_loaders, int max_loaders, int window = 20);
+    
+    /*
+     * returns true when the split has changed.
+     */
+    bool Step(double stall_ms, double occupancy);
+    
+    int Loaders() const;
+    
+    int ComputeThreads() const;
+
+private:
+    /*
+     * a wait shorter than this is the cost of the hand-off, not a stall.
+     */
+    static constexpr double stall_tolerance_ms = 0.05;
+    static const int max_calm_windows = 64;
+    int total;
+    int min_loaders;
+    int max_loaders;
+    int window;
+    int loaders;
+    int steps;
+    int stalled_steps;
+    bool always_full;
+    /*
+     * full windows in a row, and how many are needed to give back a thread.
+     */
+    int calm;
+    int calm_needed;
+    /*
+     * loaders before the last thread was given back.
+     */
+    int last_given_back;
+};
+
+} /* namespace mlfe */
+#endif /* __CORE_BALANCER_HPP__ */
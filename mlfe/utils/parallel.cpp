@@ -0,0 +1,68 @@
+#include <atomic>
+#include "parallel.hpp"
+#include "affinity.hpp"
+
+namespace mlfe{
+
+namespace{
+std::atomic<int> global_num_threads(0);
+/*
+ * -1 while the calling thread has no NumThreadsScope.
+ */
+thread_local int scoped_num_threads = -1;
+} /* namespace */
+
+ThreadPool *GetSharedThreadPool(){
+    static ThreadPool pool(GetAffinity(ThreadRole::Compute).size(), [](int index){
+        PinCurrentThread(ThreadRole::Compute, index);
+    });
+    return &pool;
+}
+
+void SetNumThreads(const int num){
+    global_num_threads = std::max(num, 0);
+}
+
+int GetNumThreads(){
+    const int num = scoped_num_threads >= 0 ? scoped_num_threads : global_num_threads.load();
+    if(num > 0){
+        return num;
+    }
+    return GetSharedThreadPool()->Size();
+}
+
+NumThreadsScope::NumThreadsScope(const int num) : previous(scoped_num_threads){
+    if(num > 0){
+        scoped_num_threads = num;
+    }
+}
+
+NumThreadsScope::~NumThreadsScope(){
+    scoped_num_threads = previous;
+}
+
+void parallel_for(const int begin, const int end, const int grain,
+                  const std::function<void (int, int)> &f){
+    const int size = end - begin;
+    if(size <= 0){
+        return;
+    }
+    /*
+     * one chunk per thread, and no chunk smaller than grain.
+     */
+    const int chunks = std::min(GetNumThreads(), size / std::max(grain, 1));
+    if(chunks <= 1){
+        f(begin, end);
+        return;
+    }
+    const int per_chunk = (size + chunks - 1) / chunks;
+    TaskGroup group(GetSharedThreadPool());
+    for(int from = begin + per_chunk; from < end; from += per_chunk){
+        const int to = std::min(from + per_chunk, end);
+        group.Run([&f, from, to](){ f(from, to); });
+    }
+    f(begin, std::min(begin + per_chunk, end));
+    group.Wait();
+}
+
+} /* namespace mlfe */
@@ -0,0 +1,88 @@
+#ifndef __PARALLEL_HPP__
+#define __PARALLEL_HPP__
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "thread_pool.hpp"
+
+namespace mlfe{
+
+/*
+ * elements of a chunk, that are worth handing to another thread.
+ */
+const int parallel_grain = 1 << 15;
+
+/*
+ * grain of a loop, whose items cost about work elements each.
+ */
+inline int parallel_grain_of(const int work){
+    return std::max(1, parallel_grain / std::max(work, 1));
+}
+
+/*
+ * the pool shared by the operators, a worker per compute core of mlfe/utils/affinity.hpp,
+ * or per hardware thread when the compute threads are not pinned.
+ */
+ThreadPool *GetSharedThreadPool();
+
+/*
+ * number of threads the parallel loops may use, 0 uses the size of the shared pool.
+ * SetNumThreads sets it for every thread without a NumThreadsScope.
+ */
+void SetNumThreads(const int num);
+
+int GetNumThreads();
+
+/*
+ * overrides the number of threads on the calling thread while it is alive,
+ * 0 keeps the current number. a net runs its operators inside of one,
+ * to have its own thread count.
+ */
+class NumThreadsScope{
+public:
+    explicit NumThreadsScope(const int num);
+    
+    ~NumThreadsScope();
+    
+private:
+    int previous;
+};
+
+/*
+ * runs f(from, to) over contiguous chunks of [begin, end) on the shared pool,
+ * and returns when all of them are done. a chunk has at least grain elements,
+ * so a range of no more than grain elements runs on the calling thread alone.
+ */
+void parallel_for(const int begin, const int end, const int grain,
+                  const std::function<void (int, int)> &f);
+
+/*
+ * reduces [begin, end) like parallel_for, every chunk makes a partial result f(from, to),
+ * and the partial results are combined in the order of the chunks,
+ * so the result does not depend on the thread count for a given grain.
+ */
+template <class T>
+T parallel_reduce(const int begin, const int end, const int grain, const T identity,
+                  const std::function<T (int, int)> &f,
+                  const std::function<T (T, T)> &combine){
+    const int size = end - begin;
+    if(size <= 0){
+        return identity;
+    }
+    const int chunk = std::max(grain, 1);
+    const int chunks = (size + chunk - 1) / chunk;
+    std::vector<T> partials(chunks, identity);
+    parallel_for(0, chunks, 1, [&](int from, int to){
+        for(int c = from; c < to; ++c){
+            partials[c] = f(begin + c * chunk, std::min(begin + (c + 1) * chunk, end));
+        }
+    });
+    T result = identity;
+    for(auto &partial : partials){
+        result = combine(result, partial);
+    }
+    return result;
+}
+
+} /* namespace mlfe */
+#endif /* __PARALLEL_HPP__ */
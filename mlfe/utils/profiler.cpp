@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include "profiler.hpp"
+
+namespace mlfe{
+
+namespace{
+struct ProfileState{
+    std::atomic<bool> enabled;
+    std::atomic<int> threads;
+    std::chrono::steady_clock::time_point origin;
+    std::mutex m;
+    std::vector<ProfileEvent> events;
+};
+
+ProfileState &State(){
+    static ProfileState *state = [](){
+        ProfileState *state = new ProfileState();
+        state->enabled = false;
+        state->threads = 0;
+        state->origin = std::chrono::steady_clock::now();
+        return state;
+    }();
+    return *state;
+}
+
+std::string EscapeJson(const std::string &s){
+    std::ostringstream ss;
+    for(char c : s){
+        if(c == '"' || c == '\\'){
+            ss<<'\\'<<c;
+        }
+        else if(static_cast<unsigned char>(c) < 0x20){
+            ss<<"\\u"<<std::hex<<std::setw(4)<<std::setfill('0')<<static_cast<int>(c)<<std::dec;
+        }
+        else{
+            ss<<c;
+        }
+    }
+    return ss.str();
+}
+
+std::string ShapesToString(const std::vector<std::vector<int>> &shapes){
+    std::ostringstream ss;
+    for(size_t n = 0; n < shapes.size(); ++n){
+        ss<<(n > 0 ? " " : "")<<"[";
+        for(size_t d = 0; d < shapes[n].size(); ++d){
+            ss<<(d > 0 ? "," : "")<<shapes[n][d];
+        }
+        ss<<"]";
+    }
+    return ss.str();
+}
+} /* namespace */
+
+void SetProfiling(bool enable){
+    State().enabled = enable;
+}
+
+bool IsProfiling(){
+    return State().enabled.load(std::memory_order_relaxed);
+}
+
+void ClearProfile(){
+    ProfileState &state = State();
+    std::unique_lock<std::mutex> lock(state.m);
+    state.events.clear();
+}
+
+void RecordProfileEvent(ProfileEvent event){
+    ProfileState &state = State();
+    std::unique_lock<std::mutex> lock(state.m);
+    state.events.push_back(std::move(event));
+}
+
+std::vector<ProfileEvent> GetProfileEvents(){
+    ProfileState &state = State();
+    std::unique_lock<std::mutex> lock(state.m);
+    return state.events;
+}
+
+double ProfileNow(){
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - State().origin).count();
+}
+
+int ProfileThread(){
+    thread_local int thread = State().threads++;
+    return thread;
+}
+
+std::string ProfileToChromeTrace(){
+    std::vector<ProfileEvent> events = GetProfileEvents();
+    std::ostringstream ss;
+    ss<<std::fixed<<std::setprecision(3);
+    ss<<"{\"traceEvents\":[";
+    for(size_t n = 0; n < events.size(); ++n){
+        const ProfileEvent &e = events[n];
+        ss<<(n > 0 ? "," : "")<<"\n";
+        ss<<"{\"name\":\""<<EscapeJson(e.name)<<"\",";
+        ss<<"\"cat\":\""<<EscapeJson(e.type)<<"\",";
+        ss<<"\"ph\":\"X\",\"pid\":0,";
+        ss<<"\"tid\":"<<e.thread<<",";
+        ss<<"\"ts\":"<<e.begin<<",";
+        ss<<"\"dur\":"<<e.end - e.begin<<",";
+        ss<<"\"args\":{\"inputs\":\""<<ShapesToString(e.input_shapes)<<"\",";
+        ss<<"\"outputs\":\""<<ShapesToString(e.output_shapes)<<"\"}}";
+    }
+    ss<<"\n],\"displayTimeUnit\":\"ms\"}\n";
+    return ss.str();
+}
+
+void SaveChromeTrace(std::string path){
+    std::ofstream file(path);
+    if(!file.is_open()){
+        throw std::string("SaveChromeTrace : can not open ") + path;
+    }
+    file<<ProfileToChromeTrace();
+    if(!file.good()){
+        throw std::string("SaveChromeTrace : can not write ") + path;
+    }
+}
+
+std::string ProfileSummary(){
+    struct Total{
+        std::string name;
+        std::string type;
+        int calls;
+        double time;
+    };
+    std::vector<ProfileEvent> events = GetProfileEvents();
+    std::map<std::pair<std::string, std::string>, Total> totals;
+    double all = 0.;
+    for(auto &e : events){
+        Total &total = totals[std::make_pair(e.name, e.type)];
+        total.name = e.name;
+        total.type = e.type;
+        total.calls += 1;
+        total.time += e.end - e.begin;
+        all += e.end - e.begin;
+    }
+    std::vector<Total> sorted;
+    for(auto &total : totals){
+        sorted.push_back(total.second);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Total &a, const Total &b){
+        return a.time > b.time;
+    });
+    std::ostringstream ss;
+    ss<<std::fixed<<std::setprecision(3);
+    ss<<std::left<<std::setw(32)<<"operator"<<std::setw(20)<<"type";
+    ss<<std::right<<std::setw(8)<<"calls"<<std::setw(14)<<"total (ms)";
+    ss<<std::setw(14)<<"mean (ms)"<<std::setw(8)<<"%"<<std::endl;
+    for(auto &total : sorted){
+        ss<<std::left<<std::setw(32)<<total.name<<std::setw(20)<<total.type;
+        ss<<std::right<<std::setw(8)<<total.calls<<std::setw(14)<<total.time / 1e3;
+        ss<<std::setw(14)<<total.time / 1e3 / total.calls;
+        ss<<std::setw(8)<<std::setprecision(1)<<(all > 0. ? 100. * total.time / all : 0.);
+        ss<<std::setprecision(3)<<std::endl;
+    }
+    return ss.str();
+}
+
+} /* namespace mlfe */
@@ -0,0 +1,64 @@
+#ifndef __PROFILER_HPP__
+#define __PROFILER_HPP__
+#include <string>
+#include <vector>
+
+namespace mlfe{
+
+/*
+ * One run of an operator.
+ * times are microseconds since the profiler was first used,
+ * and thread is a small number given to every thread in the order it first records.
+ */
+struct ProfileEvent{
+    std::string name;
+    std::string type;
+    int thread;
+    double begin;
+    double end;
+    std::vector<std::vector<int>> input_shapes;
+    std::vector<std::vector<int>> output_shapes;
+};
+
+/*
+ * Records every operator run by OperatorBase::Run while it is on.
+ * It is off by default, and turning it on and off around some steps profiles only those.
+ * When off, a run costs a check of one flag.
+ */
+void SetProfiling(bool enable);
+
+bool IsProfiling();
+
+/*
+ * drops the recorded events.
+ */
+void ClearProfile();
+
+void RecordProfileEvent(ProfileEvent event);
+
+std::vector<ProfileEvent> GetProfileEvents();
+
+/*
+ * microseconds since the profiler was first used.
+ */
+double ProfileNow();
+
+int ProfileThread();
+
+/*
+ * the events in the Chrome trace event format, for chrome://tracing or Perfetto.
+ */
+std::string ProfileToChromeTrace();
+
+/*
+ * writes ProfileToChromeTrace to path, throws when it can not be written.
+ */
+void SaveChromeTrace(std::string path);
+
+/*
+ * calls, total and mean time of every operator, the most expensive first.
+ */
+std::string ProfileSummary();
+
+} /* namespace mlfe */
+#endif /* __PROFILER_HPP__ */
@@ -0,0 +1,138 @@
+#ifndef __RING_BUFFER_HPP__
+#define __RING_BUFFER_HPP__
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace mlfe{
+
+/*
+ * Fixed number of preallocated slots passed from one producer thread to one consumer thread.
+ * The producer fills the slot returned by BeginWrite and publishes it with EndWrite,
+ * the consumer reads the slot returned by BeginRead and gives it back with EndRead.
+ * Slots are handed over in order, by two atomic counters and without a lock.
+ *
+ * A side that has to wait spins for a while, since the other side is usually close,
+ * and then parks on a condition variable, which the other side only signals
+ * when someone is parked.
+ */
+template <class T>
+class SPSCRing{
+public:
+    explicit SPSCRing(const int capacity)
+        : capacity(capacity), slots(new T[capacity]), head(0), tail(0), parked(0), closed(false){}
+    
+    SPSCRing(const SPSCRing &) = delete;
+    
+    SPSCRing &operator=(const SPSCRing &) = delete;
+    
+    int Capacity() const{
+        return capacity;
+    }
+    
+    /*
+     * filled slots, not yet read. either side may ask,
+     * the other side changes it meanwhile.
+     */
+    int Size() const{
+        const long long read = head.load();
+        return static_cast<int>(std::min<long long>(tail.load() - read, capacity));
+    }
+    
+    /*
+     * the n-th slot, to preallocate the slots before the threads start.
+     */
+    T &Slot(const int n){
+        return slots[n];
+    }
+    
+    /*
+     * returns the next free slot, or nullptr when the ring is closed.
+     */
+    T *BeginWrite(){
+        const long long at = tail.load(std::memory_order_relaxed);
+        Wait([this, at](){ return at - head.load() < capacity; });
+        if(closed){
+            return nullptr;
+        }
+        return &slots[at % capacity];
+    }
+    
+    void EndWrite(){
+        tail.fetch_add(1, std::memory_order_seq_cst);
+        Wake();
+    }
+    
+    /*
+     * returns the oldest filled slot, or nullptr when the ring is closed.
+     */
+    T *BeginRead(){
+        const long long at = head.load(std::memory_order_relaxed);
+        Wait([this, at](){ return tail.load() > at; });
+        if(closed){
+            return nullptr;
+        }
+        return &slots[at % capacity];
+    }
+    
+    void EndRead(){
+        head.fetch_add(1, std::memory_order_seq_cst);
+        Wake();
+    }
+    
+    /*
+     * wakes both sides, and makes every later Begin return nullptr.
+     */
+    void Close(){
+        {
+            std::unique_lock<std::mutex> lock(park_m);
+            closed = true;
+        }
+        park_cv.notify_all();
+    }
+
+protected:
+    template <class Ready>
+    void Wait(Ready ready){
+        for(int n = 0; n < spin_count; ++n){
+            if(ready() || closed){
+                return;
+            }
+            if(n >= spin_count / 2){
+                std::this_thread::yield();
+            }
+        }
+        std::unique_lock<std::mutex> lock(park_m);
+        ++parked;
+        park_cv.wait(lock, [this, &ready](){ return ready() || closed; });
+        --parked;
+    }
+    
+    /*
+     * the counter is published before parked is read, and a parking side
+     * counts itself before it checks the counter, so no wake up is lost.
+     */
+    void Wake(){
+        if(parked.load(std::memory_order_seq_cst) > 0){
+            std::unique_lock<std::mutex> lock(park_m);
+            park_cv.notify_all();
+        }
+    }
+
+private:
+    static const int spin_count = 2048;
+    const int capacity;
+    std::unique_ptr<T[]> slots;
+    std::atomic<long long> head;
+    std::atomic<long long> tail;
+    std::atomic<int> parked;
+    std::atomic<bool> closed;
+    std::mutex park_m;
+    std::condition_variable park_cv;
+};
+
+} /* namespace mlfe */
+#endif /* __RING_BUFFER_HPP__ */
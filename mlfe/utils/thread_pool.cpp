@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <chrono>
+#include "thread_pool.hpp"
+#include "assert.hpp"
+
+namespace mlfe{
+
+namespace{
+/*
+ * the pool, and the index of the worker, that runs the current thread.
+ */
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local int current_index = -1;
+} /* namespace */
+
+ThreadPool::ThreadPool(unsigned int size) : ThreadPool(size, nullptr){}
+
+ThreadPool::ThreadPool(unsigned int size, std::function<void (int)> on_start)
+    : pending(0), on_start(on_start), started(0), is_stop(false){
+    if(size == 0){
+        size = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for(unsigned int n = 0; n < size; ++n){
+        queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    }
+    for(unsigned int n = 0; n < size; ++n){
+        threads.push_back(std::thread(&ThreadPool::InternalExecutor, this, static_cast<int>(n)));
+    }
+    std::unique_lock<std::mutex> lock(sleep_m);
+    sleep_cv.wait(lock, [this](){ return started == threads.size(); });
+}
+
+ThreadPool::~ThreadPool(){
+    Shutdown();
+}
+
+void ThreadPool::Shutdown(){
+    {
+        std::unique_lock<std::mutex> lock(sleep_m);
+        if(is_stop){
+            return;
+        }
+        is_stop = true;
+    }
+    sleep_cv.notify_all();
+    for(auto &thread : threads){
+        thread.join();
+    }
+}
+
+unsigned int ThreadPool::Size() const{
+    return threads.size();
+}
+
+bool ThreadPool::InWorker() const{
+    return current_pool == this;
+}
+
+void ThreadPool::Push(std::function<void ()> task){
+    WorkerQueue &queue = InWorker() ? *queues[current_index] : shared_queue;
+    {
+        std::unique_lock<std::mutex> lock(sleep_m);
+        /*
+         * the tasks of a draining pool may still submit their subtasks.
+         */
+        runtime_assert(!is_stop || InWorker(),
+                       "[Thread Pool] a task is submitted after shutdown.");
+        {
+            std::unique_lock<std::mutex> queue_lock(queue.m);
+            queue.tasks.push_back(std::move(task));
+        }
+        ++pending;
+    }
+    sleep_cv.notify_one();
+}
+
+bool ThreadPool::Pop(int index, std::function<void ()> &task){
+    if(index >= 0){
+        WorkerQueue &own = *queues[index];
+        std::unique_lock<std::mutex> lock(own.m);
+        if(!own.tasks.empty()){
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    std::unique_lock<std::mutex> lock(shared_queue.m);
+    if(!shared_queue.tasks.empty()){
+        task = std::move(shared_queue.tasks.front());
+        shared_queue.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::Steal(int index, std::function<void ()> &task){
+    const int size = queues.size();
+    for(int n = 0; n < size; ++n){
+        const int victim_index = (std::max(index, 0) + n) % size;
+        if(victim_index == index){
+            continue;
+        }
+        WorkerQueue &victim = *queues[victim_index];
+        std::unique_lock<std::mutex> lock(victim.m);
+        if(!victim.tasks.empty()){
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::RunPendingTask(){
+    const int index = InWorker() ? current_index : -1;
+    std::function<void ()> task;
+    if(!Pop(index, task) && !Steal(index, task)){
+        return false;
+    }
+    --pending;
+    task();
+    return true;
+}
+
+void ThreadPool::InternalExecutor(int index){
+    current_pool = this;
+    current_index = index;
+    if(on_start){
+        on_start(index);
+    }
+    {
+        std::unique_lock<std::mutex> lock(sleep_m);
+        ++started;
+    }
+    sleep_cv.notify_all();
+    while(true){
+        std::function<void ()> task;
+        if(Pop(index, task) || Steal(index, task)){
+            --pending;
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_m);
+        sleep_cv.wait(lock, [this](){ return pending > 0 || is_stop; });
+        /*
+         * a stopped pool keeps running, until every queued task is taken.
+         */
+        if(is_stop && pending == 0){
+            break;
+        }
+    }
+}
+
+TaskGroup::TaskGroup(ThreadPool *pool) : pool(pool), state(std::make_shared<State>()){
+    state->unfinished = 0;
+}
+
+TaskGroup::~TaskGroup(){
+    try{
+        Wait();
+    }
+    catch(...){}
+}
+
+void TaskGroup::Run(std::function<void ()> task){
+    {
+        std::unique_lock<std::mutex> lock(state->m);
+        ++state->unfinished;
+    }
+    std::shared_ptr<State> group = state;
+    pool->Submit([group, task](){
+        std::exception_ptr error;
+        try{
+            task();
+        }
+        catch(...){
+            error = std::current_exception();
+        }
+        std::unique_lock<std::mutex> lock(group->m);
+        if(error && !group->error){
+            group->error = error;
+        }
+        if(--group->unfinished == 0){
+            group->cv.notify_all();
+        }
+    });
+}
+
+void TaskGroup::Wait(){
+    const bool in_worker = pool->InWorker();
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(state->m);
+            if(state->unfinished == 0){
+                break;
+            }
+            /*
+             * a thread outside of the pool only sleeps,
+             * a worker sleeps briefly, since its own tasks may be queued behind it.
+             */
+            if(!in_worker){
+                state->cv.wait(lock, [this](){ return state->unfinished == 0; });
+                break;
+            }
+        }
+        if(!pool->RunPendingTask()){
+            std::unique_lock<std::mutex> lock(state->m);
+            state->cv.wait_for(lock, std::chrono::milliseconds(1),
+                               [this](){ return state->unfinished == 0; });
+        }
+    }
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(state->m);
+        std::swap(error, state->error);
+    }
+    if(error){
+        std::rethrow_exception(error);
+    }
+}
+
+} /* namespace mlfe */
@@ -1,75 +1,143 @@
 #ifndef __THREAD_POOL_HPP__
 #define __THREAD_POOL_HPP__
-#include <string>
-#include <thread>
+#include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
-#include "assert.hpp"
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace mlfe{
+
+/*
+ * Runs tasks on a fixed number of worker threads.
+ * Every worker owns a deque, a task submitted from a worker is pushed to its own deque
+ * and the worker takes its newest task first, while idle workers steal the oldest tasks
+ * of the other deques. Tasks submitted from outside of the pool go to a shared queue,
+ * and are started in the order of submission.
+ *
+ * Shutdown, or the destructor, runs every queued task before the workers are joined.
+ */
 class ThreadPool{
 public:
-    explicit ThreadPool(unsigned int size){
-        runtime_assert(size == 1, "thread size must be 1.(in current version, supported upto 1)");
-        is_stop = false;
-        for(int n = 0; n < size; ++n){
-            threads.push_back(std::thread(std::bind(&ThreadPool::InternalExecutor, this)));
-        }
-    }
+    /*
+     * 0 uses the number of hardware threads.
+     */
+    explicit ThreadPool(unsigned int size);
     
-    ~ThreadPool(){
-        is_stop = true;
-        cv.notify_all();
-        for(int n = 0; n < threads.size(); ++n){
-            threads[n].join();
-        }
-    }
+    /*
+     * every worker runs on_start with its index before it takes a task,
+     * like pinning itself to a core, and the constructor returns after all have run it.
+     */
+    ThreadPool(unsigned int size, std::function<void (int)> on_start);
     
-    void AddTask(const std::function<void ()> &task, int id){
-        std::unique_lock<std::mutex> lock(m);
-        tasks.push(std::make_pair(task, id));
-        task_state[id] = false;
-        cv.notify_one();
-    }
+    ~ThreadPool();
     
-    void Wait(int id){
-        std::unique_lock<std::mutex> lock(m);
-        while(!task_state[id]){
-            state_noti.wait(lock);
-        }
-    }
+    ThreadPool(const ThreadPool &) = delete;
+    
+    ThreadPool &operator=(const ThreadPool &) = delete;
     
-    bool IsFinished(int id){
-        return task_state[id];
+    /*
+     * the future holds the result of task, or the exception thrown by it.
+     */
+    template <class Task>
+    std::future<typename std::result_of<Task()>::type> Submit(Task task){
+        using Result = typename std::result_of<Task()>::type;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> result = packaged->get_future();
+        Push([packaged](){ (*packaged)(); });
+        return result;
     }
     
+    /*
+     * runs a queued task on the calling thread, so a thread waiting for tasks
+     * helps instead of blocking a worker. returns false when nothing is queued.
+     */
+    bool RunPendingTask();
+    
+    /*
+     * waits until the queued tasks have run, and joins the workers.
+     * submitting from outside of the pool after Shutdown throws.
+     */
+    void Shutdown();
+    
+    unsigned int Size() const;
+    
+    /*
+     * true when the calling thread is a worker of this pool.
+     */
+    bool InWorker() const;
+
+protected:
+    struct WorkerQueue{
+        std::mutex m;
+        std::deque<std::function<void ()>> tasks;
+    };
+    
+    void Push(std::function<void ()> task);
+    
+    bool Pop(int index, std::function<void ()> &task);
+    
+    bool Steal(int index, std::function<void ()> &task);
+    
+    void InternalExecutor(int index);
+
 private:
-    void InternalExecutor(){
-        while(true){
-            std::unique_lock<std::mutex> lock(m);
-            while(tasks.empty() && !is_stop){
-                cv.wait(lock);
-            }
-            if(is_stop){
-                break;
-            }
-            auto task = tasks.front();
-            tasks.pop();
-            lock.unlock();
-            task.first();
-            lock.lock();
-            task_state[task.second] = true;
-            state_noti.notify_one();
-        }
-    }
-    std::condition_variable cv;
-    std::condition_variable state_noti;
-    std::mutex m;
-    std::queue<std::pair<std::function<void ()>, int>> tasks;
     std::vector<std::thread> threads;
-    std::map<int, bool> task_state;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    WorkerQueue shared_queue;
+    /*
+     * pending counts the queued tasks, workers sleep on sleep_cv while it is 0.
+     */
+    std::atomic<int> pending;
+    std::mutex sleep_m;
+    std::condition_variable sleep_cv;
+    std::function<void (int)> on_start;
+    unsigned int started;
     bool is_stop;
 };
+
+/*
+ * Tasks run on a pool, that are waited together.
+ * Wait returns when every task of the group has finished,
+ * and rethrows the first exception thrown by them.
+ * a worker calling Wait runs queued tasks meanwhile, so groups can be nested.
+ */
+class TaskGroup{
+public:
+    explicit TaskGroup(ThreadPool *pool);
+    
+    /*
+     * waits for the tasks, but drops their exception.
+     */
+    ~TaskGroup();
+    
+    TaskGroup(const TaskGroup &) = delete;
+    
+    TaskGroup &operator=(const TaskGroup &) = delete;
+    
+    void Run(std::function<void ()> task);
+    
+    void Wait();
+
+private:
+    /*
+     * shared with the running tasks, which may outlive a thrown Wait.
+     */
+    struct State{
+        std::mutex m;
+        std::condition_variable cv;
+        int unfinished;
+        std::exception_ptr error;
+    };
+    ThreadPool *pool;
+    std::shared_ptr<State> state;
+};
+
 } /* namespace mlfe */
 #endif /* __THREAD_POOL_HPP__ */
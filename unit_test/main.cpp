@@ -3,6 +3,25 @@
 #include "test_softmax_xent.hpp"
 #include "test_simpledb.hpp"
 #include "test_conv.hpp"
+#include "test_max_pool.hpp"
+#include "test_transform.hpp"
+#include "test_autotuner.hpp"
+#include "test_fusion.hpp"
+#include "test_gemm.hpp"
+#include "test_optimizer.hpp"
+#include "test_large_softmax.hpp"
+#include "test_embedding.hpp"
+#include "test_sparse_fc.hpp"
+#include "test_block_sparse.hpp"
+#include "test_thread_pool.hpp"
+#include "test_parallel.hpp"
+#include "test_graph_executor.hpp"
+#include "test_affinity.hpp"
+#include "test_ring_buffer.hpp"
+#include "test_cpu_stream.hpp"
+#include "test_core_balancer.hpp"
+#include "test_profiler.hpp"
+#include "test_async_forward.hpp"
 
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <mlfe/utils/affinity.hpp>
+#include <mlfe/utils/thread_pool.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(AffinityTest, VerifyCoreLists) {
+    EXPECT_EQ(ParseCoreList("0-3,8,10-11"), std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(ParseCoreList("5,1,2-3,2"), std::vector<int>({1, 2, 3, 5}));
+    EXPECT_TRUE(ParseCoreList("").empty());
+    EXPECT_EQ(CoreListToString({0, 1, 2, 3, 8, 10, 11}), "0-3,8,10-11");
+    EXPECT_EQ(CoreListToString({4}), "4");
+    for(auto malformed : {"a", "1-", "3-1", "1-2-3", "-1", "2;3"}){
+        EXPECT_THROW(ParseCoreList(malformed), std::string) << malformed;
+    }
+}
+
+TEST(AffinityTest, VerifyPlacement) {
+    const auto available = GetAvailableCores();
+    ASSERT_FALSE(available.empty());
+    
+    /*
+     * loaders run on the reserved cores, when no loader cores are given,
+     * and compute workers never do.
+     */
+    SetReservedCores({available.back()});
+    EXPECT_EQ(GetAffinity(ThreadRole::Loader), std::vector<int>({available.back()}));
+    for(auto core : GetAffinity(ThreadRole::Compute)){
+        EXPECT_NE(core, available.back());
+    }
+    
+    std::vector<int> pinned;
+    {
+        ThreadPool loader(1, [](int index){ PinCurrentThread(ThreadRole::Loader, index); });
+        pinned = loader.Submit([](){ return GetAvailableCores(); }).get();
+    }
+    EXPECT_EQ(pinned, std::vector<int>({available.back()}));
+    
+    SetAffinity(ThreadRole::Compute, {available.front()});
+    std::thread worker([&pinned](){
+        PinCurrentThread(ThreadRole::Compute, 3);
+        pinned = GetAvailableCores();
+    });
+    worker.join();
+    if(available.size() > 1){
+        EXPECT_EQ(pinned, std::vector<int>({available.front()}));
+    }
+    
+    const auto report = AffinityReport();
+    EXPECT_NE(report.find("Loader 0 -> " + CoreListToString({available.back()})), std::string::npos) << report;
+    
+    SetAffinity(ThreadRole::Compute, {});
+    SetReservedCores({});
+    EXPECT_TRUE(GetAffinity(ThreadRole::Compute).empty());
+    EXPECT_TRUE(GetAffinity(ThreadRole::Loader).empty());
+}
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/operators/operator.hpp>
+#include <mlfe/operators/async_forward.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+namespace{
+/*
+ * a scale and a relu of x into y, and the function running them.
+ */
+std::function<void ()> MakeAsyncForwardNet(ItemHolder &ih, std::vector<std::shared_ptr<OperatorBase>> &ops){
+    ih.AddItem<TensorBlob<CPUContext>>("x");
+    ih.GetItem<TensorBlob<CPUContext>>("x")->Resize<double>({4, 8});
+    auto scale_io = MakeOperatorIO("Scale", {"x"}, {"a"});
+    scale_io.param.Add("Scale", -1.5);
+    ops.push_back(CreateOperator(scale_io, &ih));
+    auto relu_io = MakeOperatorIO("Relu", {"a"}, {"y"});
+    ops.push_back(CreateOperator(relu_io, &ih));
+    return [&ops](){
+        for(auto &op : ops){
+            op->Run();
+        }
+    };
+}
+
+void FillAsyncInput(TensorBlob<CPUContext> *x, int step){
+    for(int i = 0; i < x->Size(); ++i){
+        x->GetPtrMutable<double>()[i] = std::sin(0.1 * i + step);
+    }
+}
+} /* namespace */
+
+TEST(AsyncForwardTest, VerifyOrderAndResults) {
+    const int steps = 7;
+    ItemHolder ih;
+    std::vector<std::shared_ptr<OperatorBase>> ops;
+    auto run = MakeAsyncForwardNet(ih, ops);
+    auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+    auto y = ih.GetItem<TensorBlob<CPUContext>>("y");
+    
+    /*
+     * the outputs of the synchronous forward.
+     */
+    std::vector<std::vector<double>> expected;
+    for(int step = 0; step < steps; ++step){
+        FillAsyncInput(x, step);
+        run();
+        expected.push_back(std::vector<double>(y->GetPtrConst<double>(), y->GetPtrConst<double>() + y->Size()));
+    }
+    
+    AsyncForward forward(&ih, run);
+    forward.BindInput("x");
+    forward.BindOutput("y");
+    std::vector<int> order;
+    std::vector<std::vector<double>> outputs(steps);
+    std::vector<std::future<void>> futures;
+    for(int step = 0; step < steps; ++step){
+        FillAsyncInput(forward.NextInput("x"), step);
+        futures.push_back(forward.Queue([&](int done){
+            auto out = forward.GetOutput("y", done);
+            order.push_back(done);
+            outputs[done].assign(out->GetPtrConst<double>(), out->GetPtrConst<double>() + out->Size());
+        }));
+    }
+    for(auto &future : futures){
+        future.get();
+    }
+    forward.Synchronize();
+    ASSERT_EQ(order.size(), steps);
+    for(int step = 0; step < steps; ++step){
+        EXPECT_EQ(order[step], step);
+        EXPECT_EQ(outputs[step], expected[step]) << "at step " << step;
+    }
+}
+
+TEST(AsyncForwardTest, VerifyCallbackQueuesNext) {
+    /*
+     * a callback queues the next step itself, which must not wait for its own step.
+     */
+    const int steps = 9;
+    ItemHolder ih;
+    std::vector<std::shared_ptr<OperatorBase>> ops;
+    auto run = MakeAsyncForwardNet(ih, ops);
+    AsyncForward forward(&ih, run);
+    forward.BindInput("x");
+    forward.BindOutput("y");
+    std::vector<int> order;
+    std::function<void (int)> chain = [&](int done){
+        order.push_back(done);
+        if(done + 1 < steps){
+            FillAsyncInput(forward.NextInput("x"), done + 1);
+            forward.Queue(chain);
+        }
+    };
+    FillAsyncInput(forward.NextInput("x"), 0);
+    forward.Queue(chain);
+    forward.Synchronize();
+    ASSERT_EQ(order.size(), steps);
+    for(int step = 0; step < steps; ++step){
+        EXPECT_EQ(order[step], step);
+    }
+    
+    auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+    auto y = ih.GetItem<TensorBlob<CPUContext>>("y");
+    const std::vector<double> last(forward.GetOutput("y", steps - 1)->GetPtrConst<double>(),
+                                   forward.GetOutput("y", steps - 1)->GetPtrConst<double>() + y->Size());
+    FillAsyncInput(x, steps - 1);
+    run();
+    EXPECT_EQ(last, std::vector<double>(y->GetPtrConst<double>(), y->GetPtrConst<double>() + y->Size()));
+}
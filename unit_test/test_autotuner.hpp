@@ -0,0 +1,264 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/operators/autotuner.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+namespace{
+/*
+ * a fresh tuner, as a later run of the program creates it.
+ */
+class FreshAutotuner : public Autotuner{
+public:
+    FreshAutotuner(){}
+};
+
+/*
+ * sets an environment variable, or unsets it for nullptr,
+ * and restores the previous value when it goes out of scope.
+ */
+class EnvScope{
+public:
+    EnvScope(std::string name, const char *value) : name(name){
+        const char *old = std::getenv(name.c_str());
+        had_value = old != nullptr;
+        if(had_value){
+            old_value = old;
+        }
+        Set(value);
+    }
+    
+    ~EnvScope(){
+        Set(had_value ? old_value.c_str() : nullptr);
+    }
+
+private:
+    void Set(const char *value){
+        if(value != nullptr){
+            setenv(name.c_str(), value, 1);
+        }
+        else{
+            unsetenv(name.c_str());
+        }
+    }
+    
+    std::string name;
+    std::string old_value;
+    bool had_value;
+};
+} /* namespace */
+
+TEST(ConvolutionAutotunerTest, VerifyCPUResults) {
+    const std::string cache_file = "autotune_test.cache";
+    const std::vector<std::string> layouts = {"NCHW", "NHWC"};
+    std::remove(cache_file.c_str());
+    Autotuner::Get()->SetCachePath(cache_file);
+    
+    auto accels = Autotuner::Accelerators("Conv", "float");
+    ASSERT_GE(accels.size(), 2);
+    
+    /*
+     * every registered accelerator which accepts the shape must agree.
+     */
+    for(auto &layout : layouts){
+        std::vector<std::vector<float>> results;
+        for(auto &accel : accels){
+            ItemHolder ih;
+            OperatorIO opio;
+            opio.type = "Conv";
+            opio.accelerator = accel;
+            opio.inputs = {"x", "w", "b"};
+            opio.outputs = {"y"};
+            opio.param.Add("Filters", 3);
+            opio.param.Add("Kernel", std::vector<int>{3, 2});
+            opio.param.Add("Stride", std::vector<int>{2, 1});
+            opio.param.Add("Padding", 1);
+            opio.param.Add("Layout", layout);
+            ih.AddItem<TensorBlob<CPUContext>>("x");
+            auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+            if(!layout.compare("NHWC")){
+                x->Resize<float>({2, 7, 5, 2});
+            }
+            else{
+                x->Resize<float>({2, 2, 7, 5});
+            }
+            std::shared_ptr<OperatorBase> conv;
+            try{
+                conv = CreateOperator(opio, &ih);
+            }
+            catch(std::string &e){
+                continue;
+            }
+            auto w = ih.GetItem<TensorBlob<CPUContext>>("w");
+            auto b = ih.GetItem<TensorBlob<CPUContext>>("b");
+            auto y = ih.GetItem<TensorBlob<CPUContext>>("y");
+            for(int i = 0; i < x->Size(); ++i){
+                x->GetPtrMutable<float>()[i] = std::sin(0.3f * i);
+            }
+            for(int i = 0; i < w->Size(); ++i){
+                w->GetPtrMutable<float>()[i] = std::cos(0.7f * i);
+            }
+            for(int i = 0; i < b->Size(); ++i){
+                b->GetPtrMutable<float>()[i] = 0.1f * i;
+            }
+            conv->Compute();
+            results.push_back(std::vector<float>(y->GetPtrConst<float>(), y->GetPtrConst<float>() + y->Size()));
+        }
+        for(int n = 1; n < results.size(); ++n){
+            ASSERT_EQ(results[0].size(), results[n].size());
+            for(int i = 0; i < results[0].size(); ++i){
+                EXPECT_NEAR(results[0][i], results[n][i], 1e-4);
+            }
+        }
+    }
+    
+    /*
+     * the first "Auto" benchmarks and stores the choice,
+     * the next one for the same shape reads it back from the cache file.
+     */
+    auto create_auto = [](){
+        ItemHolder ih;
+        OperatorIO opio;
+        opio.type = "Conv";
+        opio.accelerator = "Auto";
+        opio.inputs = {"x", "w", "b"};
+        opio.outputs = {"y"};
+        opio.param.Add("Filters", 4);
+        opio.param.Add("Kernel", std::vector<int>{3, 3});
+        opio.param.Add("Stride", std::vector<int>{1, 1});
+        opio.param.Add("Padding", 0);
+        ih.AddItem<TensorBlob<CPUContext>>("x");
+        ih.GetItem<TensorBlob<CPUContext>>("x")->Resize<float>({2, 3, 8, 8});
+        CreateOperator(opio, &ih);
+        return opio.accelerator;
+    };
+    
+    auto tuned = create_auto();
+    EXPECT_NE(std::find(accels.begin(), accels.end(), tuned), accels.end());
+    
+    std::string line;
+    {
+        std::ifstream file(cache_file);
+        ASSERT_TRUE(std::getline(file, line).good());
+    }
+    ASSERT_EQ(line.substr(line.rfind('\t') + 1), tuned);
+    
+    const std::string other = tuned.compare("Eigen") ? "Eigen" : "Im2Col";
+    {
+        std::ofstream file(cache_file);
+        file << line.substr(0, line.rfind('\t') + 1) << other << std::endl;
+    }
+    Autotuner::Get()->SetCachePath(cache_file);
+    EXPECT_EQ(create_auto(), other);
+    std::remove(cache_file.c_str());
+}
+
+TEST(ConvolutionAutotunerTest, VerifyConcurrentSelect) {
+    /*
+     * without a cache path nothing is written, and threads tuning at once agree.
+     */
+    Autotuner::Get()->SetCachePath("");
+    std::vector<std::string> chosen(4);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < chosen.size(); ++t){
+        threads.emplace_back([&chosen, t](){
+            ItemHolder ih;
+            OperatorIO opio;
+            opio.type = "Conv";
+            opio.accelerator = "Auto";
+            opio.inputs = {"x", "w", "b"};
+            opio.outputs = {"y"};
+            opio.param.Add("Filters", 5);
+            opio.param.Add("Kernel", std::vector<int>{3, 3});
+            opio.param.Add("Stride", std::vector<int>{1, 1});
+            opio.param.Add("Padding", 1);
+            ih.AddItem<TensorBlob<CPUContext>>("x");
+            ih.GetItem<TensorBlob<CPUContext>>("x")->Resize<float>({2, 3, 9, 9});
+            CreateOperator(opio, &ih);
+            chosen[t] = opio.accelerator;
+        });
+    }
+    for(auto &thread : threads){
+        thread.join();
+    }
+    for(auto &accel : chosen){
+        EXPECT_FALSE(accel.empty());
+        EXPECT_EQ(accel, chosen[0]);
+    }
+    EXPECT_EQ(Autotuner::Get()->GetCachePath(), "");
+}
+
+TEST(ConvolutionAutotunerTest, VerifyDefaultCache) {
+    const std::string cache_home = "autotune_test_home";
+    const std::string cache_file = cache_home + "/mlfe/autotune";
+    std::remove(cache_file.c_str());
+    EnvScope no_override("MLFE_AUTOTUNE_CACHE", nullptr);
+    
+    /*
+     * $HOME/.cache is the fallback of $XDG_CACHE_HOME,
+     * and an empty $MLFE_AUTOTUNE_CACHE opts out.
+     */
+    {
+        EnvScope no_xdg("XDG_CACHE_HOME", nullptr);
+        EnvScope home("HOME", "/home/mlfe");
+        EXPECT_EQ(FreshAutotuner().GetCachePath(), "/home/mlfe/.cache/mlfe/autotune");
+        EnvScope opt_out("MLFE_AUTOTUNE_CACHE", "");
+        EXPECT_EQ(FreshAutotuner().GetCachePath(), "");
+    }
+    EnvScope xdg("XDG_CACHE_HOME", cache_home.c_str());
+    
+    auto select = [](Autotuner &tuner){
+        ItemHolder ih;
+        OperatorIO opio;
+        opio.type = "Conv";
+        opio.data_type = "float";
+        opio.inputs = {"x", "w", "b"};
+        opio.outputs = {"y"};
+        opio.param.Add("Filters", 6);
+        opio.param.Add("Kernel", std::vector<int>{3, 3});
+        opio.param.Add("Stride", std::vector<int>{1, 1});
+        opio.param.Add("Padding", 1);
+        ih.AddItem<TensorBlob<CPUContext>>("x");
+        ih.GetItem<TensorBlob<CPUContext>>("x")->Resize<float>({2, 3, 10, 10});
+        return tuner.Select(opio, &ih);
+    };
+    
+    /*
+     * the first run creates the directories of the default path and stores its choice,
+     * a second instance starts with it.
+     */
+    FreshAutotuner first;
+    ASSERT_EQ(first.GetCachePath(), cache_file);
+    const auto tuned = select(first);
+    std::string line;
+    {
+        std::ifstream file(cache_file);
+        ASSERT_TRUE(std::getline(file, line).good());
+    }
+    ASSERT_EQ(line.substr(line.rfind('\t') + 1), tuned);
+    FreshAutotuner second;
+    EXPECT_EQ(select(second), tuned);
+    
+    /*
+     * the choice comes from the file, not from tuning again.
+     */
+    const std::string other = tuned.compare("Eigen") ? "Eigen" : "Im2Col";
+    {
+        std::ofstream file(cache_file);
+        file << line.substr(0, line.rfind('\t') + 1) << other << std::endl;
+    }
+    FreshAutotuner third;
+    EXPECT_EQ(select(third), other);
+    std::remove(cache_file.c_str());
+    std::remove((cache_home + "/mlfe").c_str());
+    std::remove(cache_home.c_str());
+}
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/operators/block_sparse.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+namespace{
+/*
+ * a pruned w{n, k}, where most of the elements are zero.
+ * n and k are not multiples of the blocks, to cover the padded blocks.
+ */
+void FillPrunedWeight(TensorBlob<CPUContext> *w){
+    const int n = w->Dim(0), k = w->Size() / w->Dim(0);
+    for(int i = 0; i < n; ++i){
+        for(int j = 0; j < k; ++j){
+            const double val = std::sin(0.37 * (i * k + j) + 0.2);
+            w->GetPtrMutable<double>()[i * k + j] = (i * 7 + j * 3) % 11 < 2 ? val : 0.;
+        }
+    }
+}
+
+void ConvertWeight(ItemHolder *ih, TensorBlob<CPUContext> *w, const std::vector<int> &block){
+    for(auto &name : {"w_indptr", "w_indices", "w_values"}){
+        ih->AddItem<TensorBlob<CPUContext>>(name);
+    }
+    const double density = ConvertToBlockSparse<double>(w, block[0], block[1], 0.,
+                                                        ih->GetItem<TensorBlob<CPUContext>>("w_indptr"),
+                                                        ih->GetItem<TensorBlob<CPUContext>>("w_indices"),
+                                                        ih->GetItem<TensorBlob<CPUContext>>("w_values"));
+    EXPECT_GT(density, 0.);
+    EXPECT_LE(density, 1.);
+}
+} /* namespace */
+
+TEST(BlockSparseOperatorTest, VerifyFCResults) {
+    const int m = 5, k = 19, units = 10;
+    const std::vector<std::vector<int>> blocks = {{1, 4}, {4, 4}, {2, 3}};
+    
+    for(auto &block : blocks){
+        for(float dense_above : {1.f, 0.f}){
+            SCOPED_TRACE(std::to_string(block[0]) + "x" + std::to_string(block[1]) +
+                         (dense_above > 0.f ? " sparse" : " dense"));
+            ItemHolder ih;
+            TensorBlob<CPUContext> w;
+            w.Resize<double>({units, k});
+            FillPrunedWeight(&w);
+            ConvertWeight(&ih, &w, block);
+            ih.AddItem<TensorBlob<CPUContext>>("x");
+            ih.AddItem<TensorBlob<CPUContext>>("b");
+            auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+            auto b = ih.GetItem<TensorBlob<CPUContext>>("b");
+            x->Resize<double>({m, k});
+            b->Resize<double>({units});
+            for(int i = 0; i < x->Size(); ++i){ x->GetPtrMutable<double>()[i] = std::cos(0.7 * i); }
+            for(int i = 0; i < units; ++i){ b->GetPtrMutable<double>()[i] = 0.1 * i; }
+            
+            OperatorIO opio;
+            opio.type = "BlockSparseFC";
+            opio.data_type = "double";
+            opio.inputs = {"x", "w_indptr", "w_indices", "w_values", "b"};
+            opio.outputs = {"y"};
+            opio.param.Add("BlockRows", block[0]);
+            opio.param.Add("BlockCols", block[1]);
+            opio.param.Add("DenseAbove", dense_above);
+            auto fc = CreateOperator(opio, &ih);
+            auto y = ih.GetItem<TensorBlob<CPUContext>>("y");
+            fc->Compute();
+            
+            for(int i = 0; i < m; ++i){
+                for(int j = 0; j < units; ++j){
+                    double y_ref = b->GetPtrConst<double>()[j];
+                    for(int c = 0; c < k; ++c){
+                        y_ref += x->GetPtrConst<double>()[i * k + c] * w.GetPtrConst<double>()[j * k + c];
+                    }
+                    ASSERT_NEAR(y->GetPtrConst<double>()[i * units + j], y_ref, 1e-12);
+                }
+            }
+        }
+    }
+}
+
+TEST(BlockSparseOperatorTest, VerifyConvResults) {
+    const int batch = 2, channels = 9, h = 3, w_size = 5, filters = 6;
+    
+    for(auto layout : {DataLayout::NCHW, DataLayout::NHWC}){
+        for(float dense_above : {1.f, 0.f}){
+            SCOPED_TRACE(std::string(layout == DataLayout::NHWC ? "NHWC" : "NCHW") +
+                         (dense_above > 0.f ? " sparse" : " dense"));
+            ItemHolder ih;
+            TensorBlob<CPUContext> w;
+            w.Resize<double>({filters, channels, 1, 1});
+            FillPrunedWeight(&w);
+            ConvertWeight(&ih, &w, {4, 4});
+            ih.AddItem<TensorBlob<CPUContext>>("x");
+            ih.AddItem<TensorBlob<CPUContext>>("b");
+            auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+            auto b = ih.GetItem<TensorBlob<CPUContext>>("b");
+            if(layout == DataLayout::NHWC){
+                x->Resize<double>({batch, h, w_size, channels});
+            }
+            else{
+                x->Resize<double>({batch, channels, h, w_size});
+            }
+            x->SetLayout(layout);
+            b->Resize<double>({filters});
+            for(int i = 0; i < x->Size(); ++i){ x->GetPtrMutable<double>()[i] = std::cos(0.3 * i); }
+            for(int i = 0; i < filters; ++i){ b->GetPtrMutable<double>()[i] = -0.2 * i; }
+            
+            OperatorIO opio;
+            opio.type = "BlockSparseConv";
+            opio.data_type = "double";
+            opio.inputs = {"x", "w_indptr", "w_indices", "w_values", "b"};
+            opio.outputs = {"y"};
+            opio.param.Add("BlockRows", 4);
+            opio.param.Add("BlockCols", 4);
+            opio.param.Add("DenseAbove", dense_above);
+            opio.param.Add("Kernel", std::vector<int>{1, 1});
+            auto conv = CreateOperator(opio, &ih);
+            auto y = ih.GetItem<TensorBlob<CPUContext>>("y");
+            conv->Compute();
+            
+            const int plane = h * w_size;
+            for(int i = 0; i < batch; ++i){
+                for(int f = 0; f < filters; ++f){
+                    for(int s = 0; s < plane; ++s){
+                        double y_ref = b->GetPtrConst<double>()[f];
+                        for(int c = 0; c < channels; ++c){
+                            const int x_at = layout == DataLayout::NHWC ?
+                            (i * plane + s) * channels + c : (i * channels + c) * plane + s;
+                            y_ref += x->GetPtrConst<double>()[x_at] * w.GetPtrConst<double>()[f * channels + c];
+                        }
+                        const int y_at = layout == DataLayout::NHWC ?
+                        (i * plane + s) * filters + f : (i * filters + f) * plane + s;
+                        ASSERT_NEAR(y->GetPtrConst<double>()[y_at], y_ref, 1e-12);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <random>
 #include <chrono>
+#include <cmath>
+#include <algorithm>
 #include <mlfe/device_context/cpu_context.hpp>
 #include <mlfe/core/param_def.hpp>
 #include <gtest/gtest.h>
@@ -110,3 +112,355 @@ TEST(ConvolutionOperatorTest, VerifyCPUResults) {
         std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "ms" << std::endl;
     }
 }
+
+TEST(ConvolutionOperatorTest, VerifyNHWCResults) {
+    ItemHolder ih;
+    OperatorIO opio, opio_nhwc;
+    std::shared_ptr<OperatorBase> conv, conv_nhwc, conv_nhwc_grad;
+    TensorBlob<CPUContext> *x, *w, *b, *y;
+    TensorBlob<CPUContext> *x_nhwc, *w_nhwc, *b_nhwc, *y_nhwc, *dy, *dw, *db, *dx;
+    const std::vector<int> kernel_shape = {3, 2};
+    const std::vector<int> stride_shape = {1, 1};
+    const int batch = 2;
+    const int channels = 3;
+    const int height = 5;
+    const int width = 4;
+    const int out_filters = 2;
+    const int padding = 1;
+    const double acceptable_gradient_check_val = 1e-7;
+    
+    opio.type = "Conv";
+    opio.data_type = "double";
+    opio.accelerator = "Eigen";
+    opio.inputs.push_back("x");
+    opio.inputs.push_back("w");
+    opio.inputs.push_back("b");
+    opio.outputs.push_back("y");
+    opio.param.Add("Filters", out_filters);
+    opio.param.Add("Kernel", kernel_shape);
+    opio.param.Add("Stride", stride_shape);
+    opio.param.Add("Padding", padding);
+    
+    opio_nhwc = opio;
+    opio_nhwc.inputs = {"x_nhwc", "w_nhwc", "b_nhwc"};
+    opio_nhwc.outputs = {"y_nhwc"};
+    
+    ih.AddItem<TensorBlob<CPUContext>>("x");
+    ih.AddItem<TensorBlob<CPUContext>>("x_nhwc");
+    x = ih.GetItem<TensorBlob<CPUContext>>("x");
+    x_nhwc = ih.GetItem<TensorBlob<CPUContext>>("x_nhwc");
+    x->Resize<double>({batch, channels, height, width});
+    x_nhwc->Resize<double>({batch, height, width, channels});
+    x_nhwc->SetLayout(DataLayout::NHWC);
+    conv = CreateOperator(opio, &ih);
+    conv_nhwc = CreateOperator(opio_nhwc, &ih);
+    w = ih.GetItem<TensorBlob<CPUContext>>("w");
+    b = ih.GetItem<TensorBlob<CPUContext>>("b");
+    y = ih.GetItem<TensorBlob<CPUContext>>("y");
+    w_nhwc = ih.GetItem<TensorBlob<CPUContext>>("w_nhwc");
+    b_nhwc = ih.GetItem<TensorBlob<CPUContext>>("b_nhwc");
+    y_nhwc = ih.GetItem<TensorBlob<CPUContext>>("y_nhwc");
+    EXPECT_TRUE(y_nhwc->Layout() == DataLayout::NHWC);
+    
+    ih.AddItem<TensorBlob<CPUContext>>("y_nhwc_grad");
+    dy = ih.GetItem<TensorBlob<CPUContext>>("y_nhwc_grad");
+    dy->Resize<double>(*y_nhwc);
+    conv_nhwc_grad = CreateOperatorGradient(opio_nhwc, &ih);
+    dw = ih.GetItem<TensorBlob<CPUContext>>("w_nhwc_grad");
+    db = ih.GetItem<TensorBlob<CPUContext>>("b_nhwc_grad");
+    dx = ih.GetItem<TensorBlob<CPUContext>>("x_nhwc_grad");
+    
+    for(int n = 0; n < batch; ++n){
+        for(int c = 0; c < channels; ++c){
+            for(int h = 0; h < height; ++h){
+                for(int i = 0; i < width; ++i){
+                    const double val = std::sin(0.3 * (((n * channels + c) * height + h) * width + i));
+                    x->GetPtrMutable<double>()[((n * channels + c) * height + h) * width + i] = val;
+                    x_nhwc->GetPtrMutable<double>()[((n * height + h) * width + i) * channels + c] = val;
+                }
+            }
+        }
+    }
+    for(int f = 0; f < out_filters; ++f){
+        for(int c = 0; c < channels; ++c){
+            for(int h = 0; h < kernel_shape[0]; ++h){
+                for(int i = 0; i < kernel_shape[1]; ++i){
+                    const double val = std::cos(0.7 * (((f * channels + c) * kernel_shape[0] + h) * kernel_shape[1] + i));
+                    w->GetPtrMutable<double>()[((f * channels + c) * kernel_shape[0] + h) * kernel_shape[1] + i] = val;
+                    w_nhwc->GetPtrMutable<double>()[((f * kernel_shape[0] + h) * kernel_shape[1] + i) * channels + c] = val;
+                }
+            }
+        }
+        b->GetPtrMutable<double>()[f] = 0.5 * f;
+        b_nhwc->GetPtrMutable<double>()[f] = 0.5 * f;
+    }
+    dy->SetByConst<double>(1.);
+    
+    conv->Compute();
+    conv_nhwc->Compute();
+    for(int n = 0; n < y->Dim(0); ++n){
+        for(int f = 0; f < y->Dim(1); ++f){
+            for(int h = 0; h < y->Dim(2); ++h){
+                for(int i = 0; i < y->Dim(3); ++i){
+                    const double expect = y->GetPtrConst<double>()[((n * y->Dim(1) + f) * y->Dim(2) + h) * y->Dim(3) + i];
+                    const double out = y_nhwc->GetPtrConst<double>()[((n * y->Dim(2) + h) * y->Dim(3) + i) * y->Dim(1) + f];
+                    EXPECT_NEAR(out, expect, 1e-10);
+                }
+            }
+        }
+    }
+    
+    {
+        GradientChecker<double, CPUContext> gc(0.00001);
+        conv_nhwc_grad->Compute();
+        std::shared_ptr<TensorBlob<CPUContext>> gc_val;
+        
+        gc_val = gc.Run(conv_nhwc, w_nhwc, y_nhwc, dw, 1. / batch);
+        for(int n = 0; n < gc_val->Size(); ++n){
+            EXPECT_LT(gc_val->GetPtrConst<double>()[n], acceptable_gradient_check_val);
+        }
+        
+        gc_val = gc.Run(conv_nhwc, b_nhwc, y_nhwc, db, 1. / batch);
+        for(int n = 0; n < gc_val->Size(); ++n){
+            EXPECT_LT(gc_val->GetPtrConst<double>()[n], acceptable_gradient_check_val);
+        }
+        
+        gc_val = gc.Run(conv_nhwc, x_nhwc, y_nhwc, dx, 1.);
+        for(int n = 0; n < gc_val->Size(); ++n){
+            EXPECT_LT(gc_val->GetPtrConst<double>()[n], acceptable_gradient_check_val);
+        }
+    }
+}
+
+TEST(ConvolutionOperatorTest, VerifyGroupResults) {
+    struct Case{ std::string layout, accel; int channels, group, filters; };
+    const std::vector<Case> cases = {
+        {"NCHW", "Depthwise", 3, 3, 6},
+        {"NHWC", "Depthwise", 3, 3, 6},
+        {"NHWC", "Depthwise", 4, 4, 4},
+        {"NCHW", "Im2Col", 3, 3, 3},
+        {"NCHW", "Im2Col", 4, 2, 6},
+    };
+    const std::vector<int> kernel_shape = {3, 2};
+    const std::vector<int> stride_shape = {2, 1};
+    const int batch = 2;
+    const int height = 5;
+    const int width = 6;
+    const int padding = 1;
+    const double acceptable_gradient_check_val = 1e-7;
+    
+    for(auto &cs : cases){
+        ItemHolder ih;
+        OperatorIO opio;
+        const bool nhwc = !cs.layout.compare("NHWC");
+        opio.type = "Conv";
+        opio.data_type = "double";
+        opio.accelerator = cs.accel;
+        opio.inputs = {"x", "w", "b"};
+        opio.outputs = {"y"};
+        opio.param.Add("Filters", cs.filters);
+        opio.param.Add("Kernel", kernel_shape);
+        opio.param.Add("Stride", stride_shape);
+        opio.param.Add("Padding", padding);
+        opio.param.Add("Group", cs.group);
+        opio.param.Add("Layout", cs.layout);
+        
+        ih.AddItem<TensorBlob<CPUContext>>("x");
+        auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+        if(nhwc){
+            x->Resize<double>({batch, height, width, cs.channels});
+        }
+        else{
+            x->Resize<double>({batch, cs.channels, height, width});
+        }
+        auto conv = CreateOperator(opio, &ih);
+        auto w = ih.GetItem<TensorBlob<CPUContext>>("w");
+        auto b = ih.GetItem<TensorBlob<CPUContext>>("b");
+        auto y = ih.GetItem<TensorBlob<CPUContext>>("y");
+        ih.AddItem<TensorBlob<CPUContext>>("y_grad");
+        auto dy = ih.GetItem<TensorBlob<CPUContext>>("y_grad");
+        dy->Resize<double>(*y);
+        dy->SetByConst<double>(1.);
+        auto conv_grad = CreateOperatorGradient(opio, &ih);
+        auto dw = ih.GetItem<TensorBlob<CPUContext>>("w_grad");
+        auto db = ih.GetItem<TensorBlob<CPUContext>>("b_grad");
+        auto dx = ih.GetItem<TensorBlob<CPUContext>>("x_grad");
+        
+        for(int i = 0; i < x->Size(); ++i){
+            x->GetPtrMutable<double>()[i] = std::sin(0.3 * i);
+        }
+        for(int i = 0; i < w->Size(); ++i){
+            w->GetPtrMutable<double>()[i] = std::cos(0.7 * i);
+        }
+        for(int i = 0; i < b->Size(); ++i){
+            b->GetPtrMutable<double>()[i] = 0.5 * i;
+        }
+        conv->Compute();
+        
+        /*
+         * direct convolution as the reference.
+         */
+        const int in_c = cs.channels / cs.group;
+        const int out_c = cs.filters / cs.group;
+        const int out_h = nhwc ? y->Dim(1) : y->Dim(2);
+        const int out_w = nhwc ? y->Dim(2) : y->Dim(3);
+        auto x_at = [&](int n, int c, int h, int i){
+            return nhwc ? ((n * height + h) * width + i) * cs.channels + c :
+            ((n * cs.channels + c) * height + h) * width + i;
+        };
+        auto w_at = [&](int f, int c, int h, int i){
+            return nhwc ? ((f * kernel_shape[0] + h) * kernel_shape[1] + i) * in_c + c :
+            ((f * in_c + c) * kernel_shape[0] + h) * kernel_shape[1] + i;
+        };
+        for(int n = 0; n < batch; ++n){
+            for(int f = 0; f < cs.filters; ++f){
+                for(int oh = 0; oh < out_h; ++oh){
+                    for(int ow = 0; ow < out_w; ++ow){
+                        double expect = b->GetPtrConst<double>()[f];
+                        for(int c = 0; c < in_c; ++c){
+                            for(int kh = 0; kh < kernel_shape[0]; ++kh){
+                                for(int kw = 0; kw < kernel_shape[1]; ++kw){
+                                    const int ih_ = oh * stride_shape[0] - padding + kh;
+                                    const int iw_ = ow * stride_shape[1] - padding + kw;
+                                    if(ih_ < 0 || ih_ >= height || iw_ < 0 || iw_ >= width){
+                                        continue;
+                                    }
+                                    expect += x->GetPtrConst<double>()[x_at(n, f / out_c * in_c + c, ih_, iw_)] *
+                                    w->GetPtrConst<double>()[w_at(f, c, kh, kw)];
+                                }
+                            }
+                        }
+                        const int y_at = nhwc ? ((n * out_h + oh) * out_w + ow) * cs.filters + f :
+                        ((n * cs.filters + f) * out_h + oh) * out_w + ow;
+                        EXPECT_NEAR(y->GetPtrConst<double>()[y_at], expect, 1e-10);
+                    }
+                }
+            }
+        }
+        
+        GradientChecker<double, CPUContext> gc(0.00001);
+        conv_grad->Compute();
+        std::shared_ptr<TensorBlob<CPUContext>> gc_val;
+        
+        gc_val = gc.Run(conv, w, y, dw, 1. / batch);
+        for(int n = 0; n < gc_val->Size(); ++n){
+            EXPECT_LT(gc_val->GetPtrConst<double>()[n], acceptable_gradient_check_val);
+        }
+        
+        gc_val = gc.Run(conv, b, y, db, 1. / batch);
+        for(int n = 0; n < gc_val->Size(); ++n){
+            EXPECT_LT(gc_val->GetPtrConst<double>()[n], acceptable_gradient_check_val);
+        }
+        
+        gc_val = gc.Run(conv, x, y, dx, 1.);
+        for(int n = 0; n < gc_val->Size(); ++n){
+            EXPECT_LT(gc_val->GetPtrConst<double>()[n], acceptable_gradient_check_val);
+        }
+    }
+}
+
+TEST(ConvolutionOperatorTest, VerifyFilterCache) {
+    /*
+     * the accelerators, which keep the reordered filters while w->Version() is unchanged.
+     */
+    struct Case{ std::string layout, accel; int channels, group, filters; };
+    const std::vector<Case> cases = {
+        {"NCHW", "Eigen", 2, 1, 3},
+        {"NHWC", "Depthwise", 3, 3, 3},
+    };
+    const int batch = 2;
+    const int height = 5;
+    const int width = 6;
+    
+    for(auto &cs : cases){
+        const bool nhwc = !cs.layout.compare("NHWC");
+        auto make_conv = [&](ItemHolder &ih){
+            OperatorIO opio;
+            opio.type = "Conv";
+            opio.data_type = "double";
+            opio.accelerator = cs.accel;
+            opio.inputs = {"x", "w", "b"};
+            opio.outputs = {"y"};
+            opio.param.Add("Filters", cs.filters);
+            opio.param.Add("Kernel", std::vector<int>{3, 2});
+            opio.param.Add("Stride", std::vector<int>{1, 1});
+            opio.param.Add("Padding", 1);
+            opio.param.Add("Group", cs.group);
+            opio.param.Add("Layout", cs.layout);
+            ih.AddItem<TensorBlob<CPUContext>>("x");
+            auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+            if(nhwc){
+                x->Resize<double>({batch, height, width, cs.channels});
+            }
+            else{
+                x->Resize<double>({batch, cs.channels, height, width});
+            }
+            for(int i = 0; i < x->Size(); ++i){
+                x->GetPtrMutable<double>()[i] = std::sin(0.3 * i);
+            }
+            auto conv = CreateOperator(opio, &ih);
+            auto b = ih.GetItem<TensorBlob<CPUContext>>("b");
+            for(int i = 0; i < b->Size(); ++i){
+                b->GetPtrMutable<double>()[i] = 0.5 * i;
+            }
+            return conv;
+        };
+        
+        /*
+         * y of a new operator, which has no cached filters.
+         */
+        auto reference = [&](const std::vector<double> &weights){
+            ItemHolder ih;
+            auto conv = make_conv(ih);
+            auto w = ih.GetItem<TensorBlob<CPUContext>>("w");
+            auto y = ih.GetItem<TensorBlob<CPUContext>>("y");
+            std::copy(weights.begin(), weights.end(), w->GetPtrMutable<double>());
+            conv->Compute();
+            return std::vector<double>(y->GetPtrConst<double>(), y->GetPtrConst<double>() + y->Size());
+        };
+        
+        ItemHolder ih;
+        auto conv = make_conv(ih);
+        auto w = ih.GetItem<TensorBlob<CPUContext>>("w");
+        auto y = ih.GetItem<TensorBlob<CPUContext>>("y");
+        auto y_vec = [y](){
+            return std::vector<double>(y->GetPtrConst<double>(), y->GetPtrConst<double>() + y->Size());
+        };
+        std::vector<double> first(w->Size()), second(w->Size());
+        for(int i = 0; i < w->Size(); ++i){
+            first[i] = std::cos(0.7 * i);
+            second[i] = std::sin(1.3 * i) - 0.2;
+        }
+        double *w_ptr = w->GetPtrMutable<double>();
+        std::copy(first.begin(), first.end(), w_ptr);
+        conv->Compute();
+        const auto y_first = y_vec();
+        const auto y_expected = reference(first);
+        for(int i = 0; i < y->Size(); ++i){
+            ASSERT_NEAR(y_first[i], y_expected[i], 1e-10) << cs.accel;
+        }
+        
+        /*
+         * a write through the pointer taken before does not change the version,
+         * so the next Compute still uses the cached filters of the first weights.
+         */
+        const auto version = w->Version();
+        std::copy(second.begin(), second.end(), w_ptr);
+        conv->Compute();
+        EXPECT_EQ(w->Version(), version);
+        EXPECT_EQ(y_vec(), y_first) << cs.accel;
+        
+        /*
+         * GetPtrMutable marks the weights as modified, and the filters are reordered again.
+         */
+        std::copy(second.begin(), second.end(), w->GetPtrMutable<double>());
+        EXPECT_NE(w->Version(), version);
+        conv->Compute();
+        const auto y_second = y_vec();
+        const auto y_second_expected = reference(second);
+        EXPECT_NE(y_second, y_first) << cs.accel;
+        for(int i = 0; i < y->Size(); ++i){
+            ASSERT_NEAR(y_second[i], y_second_expected[i], 1e-10) << cs.accel;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <string>
+#include <mlfe/utils/core_balancer.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(CoreBalancerTest, VerifyConvergesToFewestLoaders) {
+    /*
+     * the input stalls below 3 loaders, and the prefetch stays full from 3.
+     */
+    const int needed = 3;
+    const int steps = 20000;
+    CoreBalancer balancer(8, 1, 6, 10);
+    int stalled = 0;
+    int at_needed = 0;
+    for(int step = 0; step < steps; ++step){
+        const int loaders = balancer.Loaders();
+        ASSERT_GE(loaders, 1);
+        ASSERT_LE(loaders, 6);
+        ASSERT_EQ(balancer.ComputeThreads(), 8 - loaders);
+        const bool starved = loaders < needed;
+        stalled += starved ? 1 : 0;
+        at_needed += loaders == needed ? 1 : 0;
+        balancer.Step(starved ? 2. : 0., starved ? 0. : 1.);
+    }
+    /*
+     * it keeps trying to give back a thread, but every failed try
+     * doubles the wait for the next one, up to a limit.
+     */
+    EXPECT_LT(stalled, steps / 50);
+    EXPECT_GT(at_needed, steps * 97 / 100);
+}
+
+TEST(CoreBalancerTest, VerifyBounds) {
+    CoreBalancer balancer(4, 2, 8, 1);
+    EXPECT_EQ(balancer.Loaders(), 2);
+    for(int step = 0; step < 10; ++step){
+        balancer.Step(5., 0.);
+    }
+    /*
+     * a thread is always left to compute.
+     */
+    EXPECT_EQ(balancer.Loaders(), 3);
+    EXPECT_EQ(balancer.ComputeThreads(), 1);
+    for(int step = 0; step < 1000; ++step){
+        balancer.Step(0., 1.);
+    }
+    EXPECT_EQ(balancer.Loaders(), 2);
+    /*
+     * a short wait or a part full prefetch keeps the split.
+     */
+    CoreBalancer steady(8, 1, 4, 1);
+    for(int step = 0; step < 100; ++step){
+        EXPECT_FALSE(steady.Step(0.01, 0.5));
+    }
+    EXPECT_THROW(CoreBalancer(2, 2, 3), std::string);
+    EXPECT_THROW(CoreBalancer(8, 0, 3), std::string);
+    EXPECT_THROW(CoreBalancer(8, 3, 2), std::string);
+}
@@ -0,0 +1,97 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/device_context/cpu_stream.hpp>
+#include <mlfe/utils/parallel.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(CPUStreamTest, VerifyOrderAndEvents) {
+    CPUContext::Stream copy, compute;
+    std::vector<int> order;
+    for(int n = 0; n < 1000; ++n){
+        copy.Enqueue([&order, n](){ order.push_back(n); });
+    }
+    CPUContext::Event copied = copy.Record();
+    
+    /*
+     * compute holds its work until copy has reached the event.
+     */
+    std::atomic<bool> released(false);
+    std::atomic<int> checked(0);
+    compute.Wait(copied);
+    compute.Enqueue([&](){
+        EXPECT_TRUE(copied.Query());
+        EXPECT_EQ(order.size(), 1000);
+        ++checked;
+    });
+    std::atomic<bool> then_ran(false);
+    compute.Record().Then([&then_ran](){ then_ran = true; });
+    
+    CPUContext::Event gate_event;
+    {
+        CPUStream gate;
+        gate.Enqueue([&released](){
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            released = true;
+        });
+        gate_event = gate.Record();
+        copy.Wait(gate_event);
+        copy.Enqueue([&released](){ EXPECT_TRUE(released.load()); });
+    }
+    EXPECT_TRUE(gate_event.Query());
+    
+    compute.Synchronize();
+    copy.Synchronize();
+    EXPECT_EQ(checked.load(), 1);
+    EXPECT_TRUE(then_ran.load());
+    for(int n = 0; n < 1000; ++n){
+        ASSERT_EQ(order[n], n);
+    }
+    EXPECT_TRUE(CPUEvent().Query());
+}
+
+TEST(CPUStreamTest, VerifyErrors) {
+    CPUStream stream, waiting;
+    bool skipped = true;
+    stream.Enqueue([](){ throw std::string("failed task"); });
+    stream.Enqueue([&skipped](){ skipped = false; });
+    CPUEvent failed = stream.Record();
+    waiting.Wait(failed);
+    
+    EXPECT_THROW(stream.Synchronize(), std::string);
+    EXPECT_TRUE(skipped);
+    EXPECT_THROW(failed.Synchronize(), std::string);
+    EXPECT_THROW(waiting.Synchronize(), std::string);
+    
+    /*
+     * the error stays until it is reset, and the work meanwhile is skipped.
+     */
+    bool ran = false;
+    stream.Enqueue([&ran](){ ran = true; });
+    EXPECT_THROW(stream.Synchronize(), std::string);
+    EXPECT_THROW(stream.Synchronize(), std::string);
+    EXPECT_FALSE(ran);
+    stream.ResetError();
+    stream.Synchronize();
+    stream.Enqueue([&ran](){ ran = true; });
+    stream.Synchronize();
+    EXPECT_TRUE(ran);
+    
+    /*
+     * a pool worker synchronizing a stream runs the stream's work meanwhile.
+     */
+    auto result = GetSharedThreadPool()->Submit([](){
+        CPUStream inner;
+        int value = 0;
+        inner.Enqueue([&value](){ value = 7; });
+        inner.Synchronize();
+        return value;
+    });
+    EXPECT_EQ(result.get(), 7);
+}
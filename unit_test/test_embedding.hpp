@@ -0,0 +1,142 @@
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/operators/embedding.hpp>
+#include <mlfe/optimizers/optimizer.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(EmbeddingOperatorTest, VerifyCPUResults) {
+    const int m = 3, n = 4, rows = 11, dim = 5;
+    const std::vector<int> ids_val = {2, 7, 2, 0, 10, 10, 10, 3, 7, 1, 4, 2};
+    
+    for(auto &mode : {"", "Sum", "Mean"}){
+        SCOPED_TRACE(mode);
+        const bool bag = std::string(mode).size() > 0;
+        const bool mean = !std::string(mode).compare("Mean");
+        ItemHolder ih;
+        OperatorIO opio;
+        opio.type = bag ? "EmbeddingBag" : "Embedding";
+        opio.data_type = "double";
+        opio.inputs = {"ids", "w"};
+        opio.outputs = {"y"};
+        opio.param.Add("Rows", rows);
+        opio.param.Add("Dim", dim);
+        if(bag){
+            opio.param.Add("Mode", std::string(mode));
+        }
+        ih.AddItem<TensorBlob<CPUContext>>("ids");
+        auto ids = ih.GetItem<TensorBlob<CPUContext>>("ids");
+        ids->Resize<int>({m, n});
+        std::copy(ids_val.begin(), ids_val.end(), ids->GetPtrMutable<int>());
+        
+        auto embedding = CreateOperator(opio, &ih);
+        auto embedding_grad = CreateOperatorGradient(opio, &ih);
+        auto w = ih.GetItem<TensorBlob<CPUContext>>("w");
+        auto y = ih.GetItem<TensorBlob<CPUContext>>("y");
+        ih.AddItem<TensorBlob<CPUContext>>("y_grad");
+        auto dy = ih.GetItem<TensorBlob<CPUContext>>("y_grad");
+        dy->Resize<double>(*y);
+        for(int i = 0; i < w->Size(); ++i){ w->GetPtrMutable<double>()[i] = std::sin(0.3 * i); }
+        for(int i = 0; i < dy->Size(); ++i){ dy->GetPtrMutable<double>()[i] = std::cos(0.7 * i); }
+        ASSERT_EQ(y->Size(), (bag ? m : m * n) * dim);
+        embedding->Compute();
+        embedding_grad->Compute();
+        
+        /*
+         * dense references of y and of the table gradient.
+         */
+        std::vector<double> y_ref(y->Size(), 0.), dw_ref(w->Size(), 0.);
+        const double pool = mean ? 1. / n : 1.;
+        for(int p = 0; p < m * n; ++p){
+            const int out = bag ? p / n : p;
+            for(int d = 0; d < dim; ++d){
+                y_ref[out * dim + d] += (bag ? pool : 1.) * w->GetPtrConst<double>()[ids_val[p] * dim + d];
+                dw_ref[ids_val[p] * dim + d] += (bag ? pool : 1.) * dy->GetPtrConst<double>()[out * dim + d] / m;
+            }
+        }
+        for(int i = 0; i < y->Size(); ++i){
+            EXPECT_NEAR(y->GetPtrConst<double>()[i], y_ref[i], 1e-12);
+        }
+        
+        auto dw = ih.GetItem<TensorBlob<CPUContext>>("w_grad");
+        auto dw_rows = ih.GetItem<TensorBlob<CPUContext>>("w_grad_rows");
+        std::vector<double> dw_dense(w->Size(), 0.);
+        int touched = 0;
+        for(int r = 0; r < dw_rows->Size(); ++r){
+            const int row = dw_rows->GetPtrConst<int>()[r];
+            if(row < 0){ continue; }
+            ++touched;
+            for(int d = 0; d < dim; ++d){
+                dw_dense[row * dim + d] += dw->GetPtrConst<double>()[r * dim + d];
+            }
+        }
+        /*
+         * 2, 7, 0, 10, 3, 1 and 4 are touched.
+         */
+        EXPECT_EQ(touched, 7);
+        for(int i = 0; i < w->Size(); ++i){
+            EXPECT_NEAR(dw_dense[i], dw_ref[i], 1e-12);
+        }
+    }
+}
+
+TEST(EmbeddingOperatorTest, VerifySparseUpdate) {
+    const int rows = 9, dim = 3;
+    const std::vector<int> touched = {4, 0, 7, -1};
+    
+    for(auto &type : {"SGD", "Adagrad", "Momentum"}){
+        SCOPED_TRACE(type);
+        ParamDef param;
+        param.Add("LearningRate", 0.1f);
+        Optimizer<double> sparse_opt(type, param), dense_opt(type, param);
+        TensorBlob<CPUContext> w, dw, dw_rows, ref_w, ref_dw;
+        w.Resize<double>({rows, dim});
+        ref_w.Resize<double>({rows, dim});
+        ref_dw.Resize<double>({rows, dim});
+        dw.Resize<double>({static_cast<int>(touched.size()), dim});
+        dw_rows.Resize<int>({static_cast<int>(touched.size())});
+        std::copy(touched.begin(), touched.end(), dw_rows.GetPtrMutable<int>());
+        for(int i = 0; i < w.Size(); ++i){
+            w.GetPtrMutable<double>()[i] = std::sin(0.4 * i);
+            ref_w.GetPtrMutable<double>()[i] = std::sin(0.4 * i);
+        }
+        sparse_opt.AddSparseVariable(&w, &dw, &dw_rows);
+        dense_opt.AddVariable(&ref_w, &ref_dw);
+        
+        for(int step = 0; step < 3; ++step){
+            ref_dw.SetByConst<double>(0.);
+            for(int r = 0; r < touched.size(); ++r){
+                for(int d = 0; d < dim; ++d){
+                    const double g = std::cos(0.9 * (r * dim + d) + step);
+                    dw.GetPtrMutable<double>()[r * dim + d] = g;
+                    if(touched[r] >= 0){
+                        ref_dw.GetPtrMutable<double>()[touched[r] * dim + d] = g;
+                    }
+                }
+            }
+            sparse_opt.Update();
+            dense_opt.Update();
+        }
+        /*
+         * without momentum, a zero gradient leaves a dense row unchanged,
+         * with momentum only the touched rows are the same.
+         */
+        const bool lazy = !std::string(type).compare("Momentum");
+        for(int row = 0; row < rows; ++row){
+            if(lazy && std::find(touched.begin(), touched.end(), row) == touched.end()){
+                for(int d = 0; d < dim; ++d){
+                    EXPECT_EQ(w.GetPtrConst<double>()[row * dim + d], std::sin(0.4 * (row * dim + d)));
+                }
+                continue;
+            }
+            for(int d = 0; d < dim; ++d){
+                EXPECT_NEAR(w.GetPtrConst<double>()[row * dim + d], ref_w.GetPtrConst<double>()[row * dim + d], 1e-12);
+            }
+        }
+    }
+}
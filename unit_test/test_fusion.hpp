@@ -0,0 +1,225 @@
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/operators/fusion.hpp>
+#include <mlfe/core/param_def.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+namespace{
+/*
+ * builds ops on its own workspace, optionally fused,
+ * and runs the forward and the backward with a fixed output gradient.
+ */
+struct FusionTestNet{
+    void Build(std::vector<OperatorIO> opios, std::vector<int> x_dims, bool fuse, bool gradient){
+        ih.AddItem<TensorBlob<CPUContext>>("x");
+        auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+        if(!opios[0].type.compare("Cast")){
+            x->Resize<uint8_t>(x_dims);
+            for(int i = 0; i < x->Size(); ++i){
+                x->GetPtrMutable<uint8_t>()[i] = static_cast<uint8_t>(i * 37);
+            }
+        }
+        else{
+            x->Resize<double>(x_dims);
+            for(int i = 0; i < x->Size(); ++i){
+                x->GetPtrMutable<double>()[i] = std::sin(0.37 * i) + 1e-4 * i;
+            }
+        }
+        
+        std::vector<OperatorIO> created;
+        for(auto &opio : opios){
+            ops.push_back(CreateOperator(opio, &ih));
+            created.push_back(ops.back()->GetOperatorIO());
+        }
+        if(fuse){
+            auto fusions = FindOperatorFusions(created);
+            num_fused = fusions.size();
+            for(int n = fusions.size() - 1; n >= 0; --n){
+                ops[fusions[n].producer] = CreateOperator(fusions[n].fused, &ih);
+                ops.erase(ops.begin() + fusions[n].consumer);
+            }
+        }
+        for(auto &name : {"w", "b"}){
+            if(ih.HasItem(name)){
+                auto tb = ih.GetItem<TensorBlob<CPUContext>>(name);
+                for(int i = 0; i < tb->Size(); ++i){
+                    tb->GetPtrMutable<double>()[i] = std::cos(0.91 * i) * 0.3;
+                }
+            }
+        }
+        
+        output = opios.back().outputs[0];
+        if(gradient){
+            ih.AddItem<TensorBlob<CPUContext>>(output + "_grad");
+            auto dy = ih.GetItem<TensorBlob<CPUContext>>(output + "_grad");
+            dy->Resize<double>(*ih.GetItem<TensorBlob<CPUContext>>(output));
+            for(int i = 0; i < dy->Size(); ++i){
+                dy->GetPtrMutable<double>()[i] = std::sin(1.3 * i);
+            }
+            for(int n = ops.size() - 1; n >= 0; --n){
+                grads.push_back(CreateOperatorGradient(ops[n]->GetOperatorIO(), &ih));
+            }
+        }
+    }
+    
+    void Run(){
+        for(auto &op : ops){
+            op->Compute();
+        }
+        for(auto &op : grads){
+            op->Compute();
+        }
+    }
+    
+    TensorBlob<CPUContext> *Get(std::string name){
+        return ih.GetItem<TensorBlob<CPUContext>>(name);
+    }
+    
+    ItemHolder ih;
+    std::vector<std::shared_ptr<OperatorBase>> ops, grads;
+    std::string output;
+    int num_fused;
+};
+
+void ExpectSameBlob(TensorBlob<CPUContext> *a, TensorBlob<CPUContext> *b){
+    ASSERT_EQ(a->Size(), b->Size());
+    for(int i = 0; i < a->Size(); ++i){
+        EXPECT_NEAR(a->GetPtrConst<double>()[i], b->GetPtrConst<double>()[i], 1e-10);
+    }
+}
+
+OperatorIO MakeOperatorIO(std::string type, std::vector<std::string> inputs, std::vector<std::string> outputs){
+    OperatorIO opio;
+    opio.type = type;
+    opio.data_type = "double";
+    opio.inputs = inputs;
+    opio.outputs = outputs;
+    return opio;
+}
+} /* namespace */
+
+TEST(OperatorFusionTest, VerifyPatterns) {
+    std::vector<OperatorIO> ops;
+    ops.push_back(MakeOperatorIO("Cast", {"data"}, {"data_f"}));
+    ops.back().data_type.clear();
+    ops.back().param.Add("Cast", std::string("float"));
+    ops.push_back(MakeOperatorIO("Cast", {"label"}, {"label_f"}));
+    ops.back().data_type.clear();
+    ops.back().param.Add("Cast", std::string("float"));
+    ops.push_back(MakeOperatorIO("Scale", {"data_f"}, {"data_s"}));
+    ops.back().data_type = "float";
+    ops.back().param.Add("Scale", 0.5f);
+    ops.push_back(MakeOperatorIO("Conv", {"data_s", "c1_w", "c1_b"}, {"c1"}));
+    ops.push_back(MakeOperatorIO("Relu", {"c1"}, {"r1"}));
+    ops.push_back(MakeOperatorIO("MaxPool", {"r1"}, {"p1", "p1_idx"}));
+    ops.push_back(MakeOperatorIO("Relu", {"p1"}, {"r2"}));
+    ops.push_back(MakeOperatorIO("MaxPool", {"r2"}, {"p2", "p2_idx"}));
+    ops.push_back(MakeOperatorIO("FC", {"p2", "f1_w", "f1_b"}, {"f1"}));
+    ops.push_back(MakeOperatorIO("Relu", {"f1"}, {"r3"}));
+    ops.push_back(MakeOperatorIO("FC", {"r3", "f2_w", "f2_b"}, {"f2"}));
+    /*
+     * f2 has two readers, so it is not fused.
+     */
+    ops.push_back(MakeOperatorIO("Relu", {"f2"}, {"r4"}));
+    ops.push_back(MakeOperatorIO("SoftmaxXent", {"f2", "label_f"}, {"prob", "loss"}));
+    
+    auto fusions = FindOperatorFusions(ops);
+    ASSERT_EQ(fusions.size(), 4);
+    
+    EXPECT_EQ(fusions[0].producer, 0);
+    EXPECT_EQ(fusions[0].consumer, 2);
+    EXPECT_EQ(fusions[0].fused.type, "Cast");
+    EXPECT_EQ(fusions[0].fused.inputs[0], "data");
+    EXPECT_EQ(fusions[0].fused.outputs[0], "data_s");
+    EXPECT_EQ(fusions[0].fused.param.GetParam<float>("Scale"), 0.5f);
+    
+    EXPECT_EQ(fusions[1].producer, 3);
+    EXPECT_EQ(fusions[1].consumer, 4);
+    EXPECT_EQ(fusions[1].fused.type, "Conv");
+    EXPECT_EQ(fusions[1].fused.outputs[0], "r1");
+    EXPECT_EQ(fusions[1].fused.param.GetParam<std::string>("Activation"), "Relu");
+    
+    EXPECT_EQ(fusions[2].producer, 6);
+    EXPECT_EQ(fusions[2].consumer, 7);
+    EXPECT_EQ(fusions[2].fused.type, "MaxPool");
+    EXPECT_EQ(fusions[2].fused.inputs[0], "p1");
+    EXPECT_EQ(fusions[2].fused.outputs[0], "p2");
+    
+    EXPECT_EQ(fusions[3].producer, 8);
+    EXPECT_EQ(fusions[3].consumer, 9);
+    EXPECT_EQ(fusions[3].fused.type, "FC");
+    EXPECT_EQ(fusions[3].fused.outputs[0], "r3");
+}
+
+TEST(OperatorFusionTest, VerifyCPUResults) {
+    struct Case{ std::string name; std::vector<OperatorIO> ops; std::vector<int> x_dims; std::vector<std::string> compare; };
+    std::vector<Case> cases;
+    
+    for(auto &accel : {"Eigen", "Im2Col", "Depthwise"}){
+        for(auto &layout : {"NCHW", "NHWC"}){
+            const bool depthwise = !std::string(accel).compare("Depthwise");
+            const bool nhwc = !std::string(layout).compare("NHWC");
+            OperatorIO conv = MakeOperatorIO("Conv", {"x", "w", "b"}, {"c"});
+            conv.accelerator = accel;
+            conv.param.Add("Filters", 6);
+            conv.param.Add("Kernel", std::vector<int>{3, 3});
+            conv.param.Add("Stride", std::vector<int>{1, 1});
+            conv.param.Add("Padding", 1);
+            conv.param.Add("Layout", std::string(layout));
+            if(depthwise){
+                conv.param.Add("Group", 3);
+            }
+            OperatorIO relu = MakeOperatorIO("Relu", {"c"}, {"r"});
+            cases.push_back({std::string("Conv Relu ") + accel + " " + layout, {conv, relu},
+                nhwc ? std::vector<int>{2, 7, 6, 3} : std::vector<int>{2, 3, 7, 6},
+                {"r", "x_grad", "w_grad", "b_grad"}});
+        }
+    }
+    
+    {
+        OperatorIO fc = MakeOperatorIO("FC", {"x", "w", "b"}, {"f"});
+        fc.param.Add("Units", 5);
+        OperatorIO relu = MakeOperatorIO("Relu", {"f"}, {"r"});
+        relu.param.Add("Inplace", true);
+        cases.push_back({"FC Relu", {fc, relu}, {3, 8}, {"r", "x_grad", "w_grad", "b_grad"}});
+    }
+    
+    for(auto &layout : {"NCHW", "NHWC"}){
+        OperatorIO relu = MakeOperatorIO("Relu", {"x"}, {"r"});
+        OperatorIO mp = MakeOperatorIO("MaxPool", {"r"}, {"p", "p_idx"});
+        mp.param.Add("Kernel", std::vector<int>{2, 2});
+        mp.param.Add("Stride", std::vector<int>{2, 2});
+        mp.param.Add("Layout", std::string(layout));
+        cases.push_back({std::string("Relu MaxPool ") + layout, {relu, mp}, {2, 3, 6, 8}, {"p", "x_grad"}});
+    }
+    
+    {
+        OperatorIO cast = MakeOperatorIO("Cast", {"x"}, {"c"});
+        cast.data_type.clear();
+        cast.param.Add("Cast", std::string("double"));
+        OperatorIO scale = MakeOperatorIO("Scale", {"c"}, {"s"});
+        scale.param.Add("Scale", 1. / 256.);
+        cases.push_back({"Cast Scale", {cast, scale}, {2, 10}, {"s"}});
+    }
+    
+    for(auto &cs : cases){
+        SCOPED_TRACE(cs.name);
+        const bool gradient = cs.compare.size() > 1;
+        FusionTestNet plain, fused;
+        plain.Build(cs.ops, cs.x_dims, false, gradient);
+        fused.Build(cs.ops, cs.x_dims, true, gradient);
+        EXPECT_EQ(fused.num_fused, 1);
+        EXPECT_EQ(fused.ops.size(), 1);
+        plain.Run();
+        fused.Run();
+        for(auto &name : cs.compare){
+            SCOPED_TRACE(name);
+            ExpectSameBlob(plain.Get(name), fused.Get(name));
+        }
+    }
+}
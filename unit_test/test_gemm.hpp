@@ -0,0 +1,75 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/math/blas.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(GemmEpilogueTest, VerifyCPUResults) {
+    /*
+     * n is wide enough, that c is computed in several panels of rows.
+     */
+    const int m = 70;
+    const int n = 600;
+    const int k = 9;
+    std::vector<float> a(m * k), b(k * n), c(m * n), expect(m * n);
+    std::vector<float> row_bias(m), col_bias(n), residual(m * n);
+    for(int i = 0; i < a.size(); ++i){ a[i] = std::sin(0.3f * i); }
+    for(int i = 0; i < b.size(); ++i){ b[i] = std::cos(0.7f * i); }
+    for(int i = 0; i < m; ++i){ row_bias[i] = 0.1f * (i % 7) - 0.3f; }
+    for(int j = 0; j < n; ++j){ col_bias[j] = 0.05f * (j % 11) - 0.25f; }
+    for(int i = 0; i < residual.size(); ++i){ residual[i] = std::sin(1.1f * i); }
+    
+    for(int trans = 0; trans < 4; ++trans){
+        const bool trans_a = trans & 1;
+        const bool trans_b = trans & 2;
+        for(int option = 0; option < 4; ++option){
+            math::GemmEpilogue<float> epilogue;
+            if(option == 1){
+                epilogue.col_bias = col_bias.data();
+                epilogue.relu = true;
+            }
+            else if(option == 2){
+                epilogue.row_bias = row_bias.data();
+                epilogue.scale = 0.5f;
+            }
+            else if(option == 3){
+                epilogue.row_bias = row_bias.data();
+                epilogue.col_bias = col_bias.data();
+                epilogue.residual = residual.data();
+                epilogue.relu = true;
+                epilogue.scale = 2.f;
+            }
+            
+            /*
+             * a is {m, k} or {k, m} when transposed, b is {k, n} or {n, k}.
+             */
+            for(int i = 0; i < m; ++i){
+                for(int j = 0; j < n; ++j){
+                    float val = 0.f;
+                    for(int l = 0; l < k; ++l){
+                        val += (trans_a ? a[l * m + i] : a[i * k + l]) *
+                        (trans_b ? b[j * k + l] : b[l * n + j]);
+                    }
+                    val = 2.f * val + 0.5f * c[i * n + j];
+                    if(epilogue.row_bias != nullptr){ val += row_bias[i]; }
+                    if(epilogue.col_bias != nullptr){ val += col_bias[j]; }
+                    if(epilogue.residual != nullptr){ val += residual[i * n + j]; }
+                    if(epilogue.relu){ val = val > 0.f ? val : 0.f; }
+                    expect[i * n + j] = val * epilogue.scale;
+                }
+            }
+            math::gemm<float, CPUContext>(trans_a, trans_b, m, n, k,
+                                          2.f, a.data(), trans_a ? m : k,
+                                          b.data(), trans_b ? k : n,
+                                          0.5f, c.data(), n,
+                                          epilogue, nullptr);
+            for(int i = 0; i < m * n; ++i){
+                ASSERT_NEAR(c[i], expect[i], 1e-4) << "trans " << trans << ", option " << option;
+            }
+        }
+    }
+}
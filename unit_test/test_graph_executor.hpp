@@ -0,0 +1,86 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/operators/operator.hpp>
+#include <mlfe/operators/graph_executor.hpp>
+#include <mlfe/utils/parallel.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+namespace{
+OperatorIO ScaleIO(std::string x, std::string y, float scale){
+    OperatorIO opio;
+    opio.type = "Scale";
+    opio.inputs = {x};
+    opio.outputs = {y};
+    opio.param.Add("Scale", scale);
+    return opio;
+}
+} /* namespace */
+
+TEST(GraphExecutorTest, VerifyDependenciesAndResults) {
+    const int size = 1 << 17;
+    std::vector<std::vector<float>> results;
+    for(bool serial : {true, false}){
+        NumThreadsScope scope(4);
+        ItemHolder ih;
+        ih.AddItem<TensorBlob<CPUContext>>("x");
+        auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+        x->Resize<float>({size, 1});
+        for(int n = 0; n < size; ++n){
+            x->GetPtrMutable<float>()[n] = std::sin(0.01f * n);
+        }
+        
+        /*
+         * d reads a before the in place relu overwrites it,
+         * and e only depends on b.
+         */
+        std::vector<OperatorIO> opios = {
+            ScaleIO("x", "a", 2.f),
+            ScaleIO("x", "b", 3.f),
+            ScaleIO("a", "d", 2.f),
+            OperatorIO(),
+            ScaleIO("b", "e", -1.f)
+        };
+        opios[3].type = "Relu";
+        opios[3].inputs = {"a"};
+        opios[3].outputs = {"r"};
+        opios[3].param.Add("Inplace", true);
+        std::vector<std::shared_ptr<OperatorBase>> ops;
+        for(auto &opio : opios){
+            ops.push_back(CreateOperator(opio, &ih));
+        }
+        
+        GraphExecutor executor(ops);
+        executor.SetSerial(serial);
+        EXPECT_TRUE(executor.Dependencies(0).empty());
+        EXPECT_TRUE(executor.Dependencies(1).empty());
+        EXPECT_EQ(executor.Dependencies(2), std::vector<int>({0}));
+        EXPECT_EQ(executor.Dependencies(3), std::vector<int>({0, 2}));
+        EXPECT_EQ(executor.Dependencies(4), std::vector<int>({1}));
+        EXPECT_EQ(executor.Depth(), 3);
+        
+        std::vector<float> result;
+        for(int iter = 0; iter < 20; ++iter){
+            executor.Run();
+            result.clear();
+            for(auto &name : {"a", "d", "r", "e"}){
+                auto tb = ih.GetItem<TensorBlob<CPUContext>>(name);
+                result.insert(result.end(), tb->GetPtrConst<float>(), tb->GetPtrConst<float>() + tb->Size());
+            }
+            if(!results.empty()){
+                ASSERT_EQ(result, results[0]) << "at iteration " << iter;
+            }
+        }
+        results.push_back(result);
+    }
+    for(int n = 0; n < size; ++n){
+        const float x = std::sin(0.01f * n);
+        ASSERT_FLOAT_EQ(results[0][size + n], 4.f * x);
+        ASSERT_FLOAT_EQ(results[0][2 * size + n], std::max(2.f * x, 0.f));
+        ASSERT_FLOAT_EQ(results[0][3 * size + n], -3.f * x);
+    }
+}
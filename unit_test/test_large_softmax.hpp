@@ -0,0 +1,285 @@
+#include <iostream>
+#include <cmath>
+#include <set>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/operators/large_softmax_xent.hpp>
+#include <mlfe/optimizers/optimizer.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+/*
+ * the operators are described by MakeOperatorIO of test_fusion.hpp.
+ */
+namespace{
+/*
+ * x{m, k}, w{classes, k}, b{classes} and int label{m} on their own workspace.
+ */
+void FillLargeSoftmaxInputs(ItemHolder &ih, int m, int k, int classes){
+    for(auto &name : {"x", "w", "b", "label"}){
+        ih.AddItem<TensorBlob<CPUContext>>(name);
+    }
+    auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+    auto w = ih.GetItem<TensorBlob<CPUContext>>("w");
+    auto b = ih.GetItem<TensorBlob<CPUContext>>("b");
+    auto label = ih.GetItem<TensorBlob<CPUContext>>("label");
+    x->Resize<double>({m, k});
+    w->Resize<double>({classes, k});
+    b->Resize<double>({classes});
+    label->Resize<int>({m});
+    for(int i = 0; i < x->Size(); ++i){ x->GetPtrMutable<double>()[i] = std::sin(0.37 * i); }
+    for(int i = 0; i < w->Size(); ++i){ w->GetPtrMutable<double>()[i] = std::cos(0.91 * i) * 0.5; }
+    for(int i = 0; i < b->Size(); ++i){ b->GetPtrMutable<double>()[i] = 0.1 * (i % 5) - 0.2; }
+    for(int i = 0; i < m; ++i){ label->GetPtrMutable<int>()[i] = (i * 7 + 3) % classes; }
+}
+
+/*
+ * the row sparse gradient grad of name_rows as a dense {rows, ...} table.
+ */
+std::vector<double> DenseGradient(ItemHolder &ih, std::string name, int rows){
+    auto grad = ih.GetItem<TensorBlob<CPUContext>>(name);
+    const int *grad_rows = ih.GetItem<TensorBlob<CPUContext>>(name + "_rows")->GetPtrConst<int>();
+    const int row_size = grad->Size() / grad->Dim(0);
+    std::vector<double> dense(rows * row_size, 0.);
+    for(int r = 0; r < grad->Dim(0); ++r){
+        if(grad_rows[r] < 0){
+            continue;
+        }
+        for(int j = 0; j < row_size; ++j){
+            dense[grad_rows[r] * row_size + j] += grad->GetPtrConst<double>()[r * row_size + j];
+        }
+    }
+    return dense;
+}
+
+} /* namespace */
+
+TEST(LargeSoftmaxTest, VerifySampledAllClasses) {
+    const int m = 6, k = 5, classes = 9;
+    ItemHolder ref_ih;
+    FillLargeSoftmaxInputs(ref_ih, m, k, classes);
+    
+    /*
+     * sampling all classes is the full softmax.
+     */
+    auto fc_io = MakeOperatorIO("FC", {"x", "w", "b"}, {"f"});
+    fc_io.param.Add("Units", classes);
+    ref_ih.AddItem<TensorBlob<CPUContext>>("f");
+    ref_ih.GetItem<TensorBlob<CPUContext>>("f")->Resize<double>({m, classes});
+    auto xent_io = MakeOperatorIO("SparseSoftmaxXentWithLabel", {"f", "label"}, {"prob", "loss"});
+    auto fc = CreateOperator(fc_io, &ref_ih);
+    auto xent = CreateOperator(xent_io, &ref_ih);
+    auto xent_grad = CreateOperatorGradient(xent_io, &ref_ih);
+    auto fc_grad = CreateOperatorGradient(fc_io, &ref_ih);
+    fc->Compute();
+    xent->Compute();
+    xent_grad->Compute();
+    fc_grad->Compute();
+    
+    /*
+     * every class is in the sample, so no sampler correction applies.
+     */
+    for(std::string sampler : {"Uniform", "LogUniform"}){
+        SCOPED_TRACE(sampler);
+        ItemHolder ih;
+        FillLargeSoftmaxInputs(ih, m, k, classes);
+        auto sampled_io = MakeOperatorIO("SampledSoftmaxXent", {"x", "w", "b", "label"}, {"prob", "loss", "sampled"});
+        sampled_io.param.Add("Sampled", classes + 3);
+        sampled_io.param.Add("Sampler", sampler);
+        auto sampled = CreateOperator(sampled_io, &ih);
+        auto sampled_grad = CreateOperatorGradient(sampled_io, &ih);
+        sampled->Compute();
+        sampled_grad->Compute();
+        
+        EXPECT_NEAR(ih.GetItem<TensorBlob<CPUContext>>("loss")->GetPtrConst<double>()[0],
+                    ref_ih.GetItem<TensorBlob<CPUContext>>("loss")->GetPtrConst<double>()[0], 1e-10);
+        auto dx = ih.GetItem<TensorBlob<CPUContext>>("x_grad");
+        std::vector<std::vector<double>> grads = {
+            std::vector<double>(dx->GetPtrConst<double>(), dx->GetPtrConst<double>() + dx->Size()),
+            DenseGradient(ih, "w_grad", classes),
+            DenseGradient(ih, "b_grad", classes)
+        };
+        int n = 0;
+        for(auto &name : {"x_grad", "w_grad", "b_grad"}){
+            SCOPED_TRACE(name);
+            auto e = ref_ih.GetItem<TensorBlob<CPUContext>>(name);
+            auto &a = grads[n++];
+            ASSERT_EQ(a.size(), e->Size());
+            for(int i = 0; i < e->Size(); ++i){
+                EXPECT_NEAR(a[i], e->GetPtrConst<double>()[i], 1e-10);
+            }
+        }
+    }
+}
+
+TEST(LargeSoftmaxTest, VerifySampledCorrection) {
+    /*
+     * with zero weights and biases, every logit is minus the log expected count
+     * of its class, 1 - (1 - p)^tries, in a sample of distinct classes.
+     */
+    const int m = 2, k = 3, classes = 50, num_sampled = 20;
+    ItemHolder ih;
+    FillLargeSoftmaxInputs(ih, m, k, classes);
+    ih.GetItem<TensorBlob<CPUContext>>("w")->SetByConst<double>(0.);
+    ih.GetItem<TensorBlob<CPUContext>>("b")->SetByConst<double>(0.);
+    auto sampled_io = MakeOperatorIO("SampledSoftmaxXent", {"x", "w", "b", "label"}, {"prob", "loss", "sampled"});
+    sampled_io.param.Add("Sampled", num_sampled);
+    sampled_io.param.Add("Sampler", std::string("LogUniform"));
+    auto sampled = CreateOperator(sampled_io, &ih);
+    sampled->Compute();
+    auto prob = ih.GetItem<TensorBlob<CPUContext>>("prob");
+    auto ids = ih.GetItem<TensorBlob<CPUContext>>("sampled");
+    auto label = ih.GetItem<TensorBlob<CPUContext>>("label");
+    auto expected_count = [classes](int c, double tries){
+        const double p = std::log((c + 2.) / (c + 1.)) / std::log(classes + 1.);
+        return 1. - std::pow(1. - p, tries);
+    };
+    /*
+     * the number of draws is found from the probabilities of the first row,
+     * which must then hold for the label and every sampled class.
+     * a sampled class, that is the label, is removed from the row.
+     */
+    const double *row = prob->GetPtrConst<double>();
+    const int c = label->GetPtrConst<int>()[0];
+    double best_tries = 0., best_error = 1e9;
+    for(int tries = num_sampled; tries <= 32 * classes; ++tries){
+        double z = 1. / expected_count(c, tries);
+        for(int s = 0; s < num_sampled; ++s){
+            if(ids->GetPtrConst<int>()[s] != c){
+                z += 1. / expected_count(ids->GetPtrConst<int>()[s], tries);
+            }
+        }
+        double error = std::abs(row[0] - 1. / expected_count(c, tries) / z);
+        for(int s = 0; s < num_sampled; ++s){
+            const int id = ids->GetPtrConst<int>()[s];
+            error += std::abs(row[1 + s] - (id != c ? 1. / expected_count(id, tries) / z : 0.));
+        }
+        if(error < best_error){
+            best_error = error;
+            best_tries = tries;
+        }
+    }
+    EXPECT_GE(best_tries, num_sampled);
+    EXPECT_LT(best_error, 1e-9);
+    
+    /*
+     * most of the classes can not be drawn distinct from a log uniform sampler.
+     */
+    auto most_io = MakeOperatorIO("SampledSoftmaxXent", {"x", "w", "b", "label"}, {"prob", "loss", "sampled"});
+    most_io.param.Add("Sampled", classes / 2 + 1);
+    most_io.param.Add("Sampler", std::string("LogUniform"));
+    ItemHolder other;
+    FillLargeSoftmaxInputs(other, m, k, classes);
+    EXPECT_THROW(CreateOperator(most_io, &other), std::string);
+}
+
+TEST(LargeSoftmaxTest, VerifySampledRows) {
+    const int m = 4, k = 3, classes = 200, num_sampled = 8;
+    ItemHolder ih;
+    FillLargeSoftmaxInputs(ih, m, k, classes);
+    auto sampled_io = MakeOperatorIO("SampledSoftmaxXent", {"x", "w", "b", "label"}, {"prob", "loss", "sampled"});
+    sampled_io.param.Add("Sampled", num_sampled);
+    sampled_io.param.Add("Sampler", std::string("LogUniform"));
+    auto sampled = CreateOperator(sampled_io, &ih);
+    auto sampled_grad = CreateOperatorGradient(sampled_io, &ih);
+    auto prob = ih.GetItem<TensorBlob<CPUContext>>("prob");
+    auto ids = ih.GetItem<TensorBlob<CPUContext>>("sampled");
+    auto label = ih.GetItem<TensorBlob<CPUContext>>("label");
+    auto dw = ih.GetItem<TensorBlob<CPUContext>>("w_grad");
+    ASSERT_EQ(prob->Dim(1), 1 + num_sampled);
+    /*
+     * the gradients hold the sampled classes and the labels, not the table.
+     */
+    ASSERT_EQ(dw->Dim(0), num_sampled + m);
+    ASSERT_EQ(dw->Dim(1), k);
+    ParamDef param;
+    param.Add("LearningRate", 0.5f);
+    Optimizer<double> opt("SGD", param);
+    auto w = ih.GetItem<TensorBlob<CPUContext>>("w");
+    auto b = ih.GetItem<TensorBlob<CPUContext>>("b");
+    opt.AddSparseVariable(w, dw, ih.GetItem<TensorBlob<CPUContext>>("w_grad_rows"));
+    opt.AddSparseVariable(b, ih.GetItem<TensorBlob<CPUContext>>("b_grad"),
+                          ih.GetItem<TensorBlob<CPUContext>>("b_grad_rows"));
+    
+    for(int step = 0; step < 3; ++step){
+        sampled->Compute();
+        sampled_grad->Compute();
+        std::set<int> rows;
+        for(int s = 0; s < num_sampled; ++s){
+            const int c = ids->GetPtrConst<int>()[s];
+            ASSERT_TRUE(c >= 0 && c < classes);
+            EXPECT_TRUE(rows.insert(c).second);
+        }
+        for(int i = 0; i < m; ++i){
+            double sum = 0.;
+            for(int j = 0; j < 1 + num_sampled; ++j){
+                sum += prob->GetPtrConst<double>()[i * (1 + num_sampled) + j];
+            }
+            EXPECT_NEAR(sum, 1., 1e-12);
+            rows.insert(label->GetPtrConst<int>()[i]);
+        }
+        /*
+         * the entries name every class of this step once, and only those.
+         */
+        for(auto &name : {"w_grad_rows", "b_grad_rows"}){
+            SCOPED_TRACE(name);
+            const int *grad_rows = ih.GetItem<TensorBlob<CPUContext>>(name)->GetPtrConst<int>();
+            std::set<int> named;
+            for(int r = 0; r < num_sampled + m; ++r){
+                if(grad_rows[r] >= 0){
+                    EXPECT_TRUE(named.insert(grad_rows[r]).second);
+                }
+            }
+            EXPECT_EQ(named, rows);
+        }
+        
+        /*
+         * the optimizer moves the rows of the step by their gradient, and no other row.
+         */
+        const std::vector<double> w_before(w->GetPtrConst<double>(), w->GetPtrConst<double>() + w->Size());
+        const std::vector<double> b_before(b->GetPtrConst<double>(), b->GetPtrConst<double>() + b->Size());
+        const auto dense_dw = DenseGradient(ih, "w_grad", classes);
+        const auto dense_db = DenseGradient(ih, "b_grad", classes);
+        opt.Update();
+        for(int c = 0; c < classes; ++c){
+            EXPECT_NEAR(b->GetPtrConst<double>()[c], b_before[c] - 0.5 * dense_db[c], 1e-12);
+            for(int j = 0; j < k; ++j){
+                ASSERT_NEAR(w->GetPtrConst<double>()[c * k + j], w_before[c * k + j] - 0.5 * dense_dw[c * k + j], 1e-12);
+            }
+            if(rows.count(c) == 0){
+                EXPECT_EQ(b->GetPtrConst<double>()[c], b_before[c]);
+            }
+        }
+    }
+}
+
+TEST(LargeSoftmaxTest, VerifyBlocked) {
+    const int m = 5, k = 4, classes = 10;
+    ItemHolder ih;
+    FillLargeSoftmaxInputs(ih, m, k, classes);
+    auto fc_io = MakeOperatorIO("FC", {"x", "w", "b"}, {"f"});
+    auto xent_io = MakeOperatorIO("SparseSoftmaxXentWithLabel", {"f", "label"}, {"prob", "loss"});
+    auto blocked_io = MakeOperatorIO("BlockedSoftmaxXent", {"x", "w", "b", "label"}, {"blocked_loss", "prediction"});
+    ih.AddItem<TensorBlob<CPUContext>>("f");
+    ih.GetItem<TensorBlob<CPUContext>>("f")->Resize<double>({m, classes});
+    /*
+     * the last block is smaller than the others.
+     */
+    blocked_io.param.Add("Block", 3);
+    auto fc = CreateOperator(fc_io, &ih);
+    auto xent = CreateOperator(xent_io, &ih);
+    auto blocked = CreateOperator(blocked_io, &ih);
+    fc->Compute();
+    xent->Compute();
+    blocked->Compute();
+    
+    EXPECT_NEAR(ih.GetItem<TensorBlob<CPUContext>>("blocked_loss")->GetPtrConst<double>()[0],
+                ih.GetItem<TensorBlob<CPUContext>>("loss")->GetPtrConst<double>()[0], 1e-10);
+    auto f = ih.GetItem<TensorBlob<CPUContext>>("f")->GetPtrConst<double>();
+    for(int i = 0; i < m; ++i){
+        const int expect = std::max_element(f + i * classes, f + (i + 1) * classes) - (f + i * classes);
+        EXPECT_EQ(ih.GetItem<TensorBlob<CPUContext>>("prediction")->GetPtrConst<int>()[i], expect);
+    }
+}
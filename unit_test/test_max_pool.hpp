@@ -1,95 +1,129 @@
 #include <iostream>
 #include <random>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <mlfe/device_context/cpu_context.hpp>
 #include <mlfe/operators/max_pool.hpp>
 #include <mlfe/core/param_def.hpp>
 #include <gtest/gtest.h>
 #include <mlfe/utils/gradient_checker.hpp>
-#include <iomanip>
-#include <random>
 
 using namespace std;
 using namespace mlfe;
 
 TEST(MaxPoolOperatorTest, VerifyCPUResults) {
-    ItemHolder ih;
-    OperatorIO opio, opio_grad;
-    std::shared_ptr<OperatorBase> mp, mp_grad;
-    TensorBlob<CPUContext> *x, *y, *idx, *dy, *dx;
-    const std::vector<int> kernel_shape = {2, 2};
-    const std::vector<int> stride_shape = {2, 2};
+    struct Case{ std::string layout; std::vector<int> kernel, stride; };
+    const std::vector<Case> cases = {
+        {"NCHW", {2, 2}, {2, 2}},
+        {"NCHW", {3, 3}, {2, 2}},
+        {"NCHW", {3, 2}, {1, 2}},
+        {"NHWC", {2, 2}, {2, 2}},
+        {"NHWC", {3, 3}, {2, 2}},
+    };
     const int batch = 2;
+    const int channels = 3;
+    const int height = 7;
+    const int width = 9;
     const double acceptable_gradient_check_val = 1e-7;
-    auto set = [](double *ptr, int from, int to, double val, double inc){
-        for(int i = from; i < to; ++i){
-            ptr[i] = val;
-            val += inc;
-        }
-    };
-    
-    opio.type = "MaxPool";
-    opio.data_type = "double";
-    opio.inputs.push_back("x");
-    opio.outputs.push_back("y");
-    opio.outputs.push_back("idx");
-    opio.param.Add("Kernel", kernel_shape);
-    opio.param.Add("Stride", stride_shape);
-    
-    opio_grad.type = "MaxPool_Gradient";
-    opio_grad.inputs.push_back("x");
-    opio_grad.inputs.push_back("idx");
-    opio_grad.inputs.push_back("dy");
-    opio_grad.outputs.push_back("dx");
-    opio_grad.param = opio.param;
-    
-    ih.AddItem<TensorBlob<CPUContext>>("x");
-    ih.AddItem<TensorBlob<CPUContext>>("dy");
-    x = ih.GetItem<TensorBlob<CPUContext>>("x");
-    dy = ih.GetItem<TensorBlob<CPUContext>>("dy");
-    x->Resize<double>({batch, 2, 6, 6});
-    dy->Resize<double>(
-                       {
-                           x->Dim(0),
-                           2,
-                           (x->Dim(2) - kernel_shape[0]) / stride_shape[0] + 1,
-                           (x->Dim(3) - kernel_shape[1]) / stride_shape[1] + 1
-                       });
-    mp = CreateOperator(opio, &ih);
-    mp_grad = CreateOperator(opio_grad, &ih);
-    y = ih.GetItem<TensorBlob<CPUContext>>("y");
-    idx = ih.GetItem<TensorBlob<CPUContext>>("idx");
-    dx = ih.GetItem<TensorBlob<CPUContext>>("dx");
-    
-    
-    set(x->GetPtrMutable<double>(), 0, x->Size(), 1., 1.);
-    set(dy->GetPtrMutable<double>(), 0, dy->Size(), 1., 0.);
-    
-    {
-        cout<<"-- Convolution Operator Run"<<endl;
-        auto begin = std::chrono::high_resolution_clock::now();
-        mp->Compute();
-        auto end = std::chrono::high_resolution_clock::now();
-        cout<<"-- Total Calcaulation time : ";
-        std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "ms" << std::endl;
-    }
     
-    {
-        cout<<"-- Convolution Operator Gradient Check"<<endl;
-        auto begin = std::chrono::high_resolution_clock::now();
-        GradientChecker<double, CPUContext> gc(0.00001);
-        mp_grad->Compute();
-        std::shared_ptr<TensorBlob<CPUContext>> gc_val;
+    for(auto &cs : cases){
+        ItemHolder ih;
+        OperatorIO opio;
+        std::shared_ptr<OperatorBase> mp, mp_grad;
+        TensorBlob<CPUContext> *x, *y, *idx, *dy, *dx;
+        const bool nhwc = !cs.layout.compare("NHWC");
+        
+        opio.type = "MaxPool";
+        opio.data_type = "double";
+        opio.inputs.push_back("x");
+        opio.outputs.push_back("y");
+        opio.outputs.push_back("idx");
+        opio.param.Add("Kernel", cs.kernel);
+        opio.param.Add("Stride", cs.stride);
+        opio.param.Add("Layout", cs.layout);
+        
+        ih.AddItem<TensorBlob<CPUContext>>("x");
+        x = ih.GetItem<TensorBlob<CPUContext>>("x");
+        if(nhwc){
+            x->Resize<double>({batch, height, width, channels});
+        }
+        else{
+            x->Resize<double>({batch, channels, height, width});
+        }
+        mp = CreateOperator(opio, &ih);
+        y = ih.GetItem<TensorBlob<CPUContext>>("y");
+        idx = ih.GetItem<TensorBlob<CPUContext>>("idx");
+        EXPECT_TRUE(idx->MatchType<uint8_t>());
+        
+        ih.AddItem<TensorBlob<CPUContext>>("y_grad");
+        dy = ih.GetItem<TensorBlob<CPUContext>>("y_grad");
+        dy->Resize<double>(*y);
+        dy->SetByConst<double>(1.);
+        mp_grad = CreateOperatorGradient(opio, &ih);
+        dx = ih.GetItem<TensorBlob<CPUContext>>("x_grad");
         
         /*
-         * check gradient w.r.t. input.
+         * distinct values, so that the argmax is unique.
          */
-        gc_val = gc.Run(mp, x, y, dx, 1.);
-        for(int n = 0; n < gc_val->Size(); ++n){
-            EXPECT_LT(gc_val->GetPtrConst<double>()[n], acceptable_gradient_check_val);
+        for(int i = 0; i < x->Size(); ++i){
+            x->GetPtrMutable<double>()[i] = std::sin(0.37 * i) + 1e-4 * i;
+        }
+        mp->Compute();
+        
+        const int out_h = (height - cs.kernel[0]) / cs.stride[0] + 1;
+        const int out_w = (width - cs.kernel[1]) / cs.stride[1] + 1;
+        auto x_at = [&](int n, int c, int h, int w){
+            return nhwc ? ((n * height + h) * width + w) * channels + c :
+            ((n * channels + c) * height + h) * width + w;
+        };
+        auto y_at = [&](int n, int c, int h, int w){
+            return nhwc ? ((n * out_h + h) * out_w + w) * channels + c :
+            ((n * channels + c) * out_h + h) * out_w + w;
+        };
+        for(int n = 0; n < batch; ++n){
+            for(int c = 0; c < channels; ++c){
+                for(int oh = 0; oh < out_h; ++oh){
+                    for(int ow = 0; ow < out_w; ++ow){
+                        double expect = -1e+10;
+                        int expect_idx = 0;
+                        for(int kh = 0; kh < cs.kernel[0]; ++kh){
+                            for(int kw = 0; kw < cs.kernel[1]; ++kw){
+                                const double val = x->GetPtrConst<double>()[x_at(n, c, oh * cs.stride[0] + kh, ow * cs.stride[1] + kw)];
+                                if(val > expect){
+                                    expect = val;
+                                    expect_idx = kh * cs.kernel[1] + kw;
+                                }
+                            }
+                        }
+                        EXPECT_EQ(y->GetPtrConst<double>()[y_at(n, c, oh, ow)], expect);
+                        EXPECT_EQ(idx->GetPtrConst<uint8_t>()[y_at(n, c, oh, ow)], expect_idx);
+                    }
+                }
+            }
+        }
+        
+        {
+            GradientChecker<double, CPUContext> gc(0.00001);
+            mp_grad->Compute();
+            std::shared_ptr<TensorBlob<CPUContext>> gc_val;
+            
+            /*
+             * check gradient w.r.t. input.
+             */
+            gc_val = gc.Run(mp, x, y, dx, 1.);
+            for(int n = 0; n < gc_val->Size(); ++n){
+                /*
+                 * off the argmax both gradients are zero,
+                 * which the checker reports as 0 / 0.
+                 */
+                if(dx->GetPtrConst<double>()[n] == 0.){
+                    EXPECT_TRUE(std::isnan(gc_val->GetPtrConst<double>()[n]));
+                }
+                else{
+                    EXPECT_LT(gc_val->GetPtrConst<double>()[n], acceptable_gradient_check_val);
+                }
+            }
         }
-        auto end = std::chrono::high_resolution_clock::now();
-        cout<<"-- Total Calcaulation time : ";
-        std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "ms" << std::endl;
     }
 }
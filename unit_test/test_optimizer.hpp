@@ -0,0 +1,229 @@
+#include <iostream>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/optimizers/optimizer.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(OptimizerTest, VerifyCPUResults) {
+    const std::vector<std::string> types = {"SGD", "Momentum", "Nesterov", "Adam", "AdamW"};
+    /*
+     * the sizes are large enough, that the update is split over two threads,
+     * and the split falls inside of the second variable.
+     */
+    const std::vector<int> sizes = {5, 140000, 3001};
+    const double lr = static_cast<double>(0.05f);
+    const double mu = static_cast<double>(0.8f);
+    const double beta1 = static_cast<double>(0.9f);
+    const double beta2 = static_cast<double>(0.99f);
+    const double eps = static_cast<double>(1e-6f);
+    const double wd = static_cast<double>(0.01f);
+    const int steps = 3;
+    
+    for(auto &type : types){
+        ParamDef param;
+        param.Add("LearningRate", 0.05f);
+        param.Add("Momentum", 0.8f);
+        param.Add("Beta1", 0.9f);
+        param.Add("Beta2", 0.99f);
+        param.Add("Epsilon", 1e-6f);
+        param.Add("WeightDecay", 0.01f);
+        Optimizer<double> opt(type, param);
+        opt.SetNumThreads(4);
+        
+        std::vector<TensorBlob<CPUContext>> vars(sizes.size()), grads(sizes.size());
+        std::vector<std::vector<double>> ref_w(sizes.size()), ref_m(sizes.size()), ref_v(sizes.size());
+        for(int i = 0; i < sizes.size(); ++i){
+            vars[i].Resize<double>({sizes[i]});
+            grads[i].Resize<double>({sizes[i]});
+            for(int n = 0; n < sizes[i]; ++n){
+                vars[i].GetPtrMutable<double>()[n] = std::sin(0.1 * n + i);
+            }
+            ref_w[i].assign(vars[i].GetPtrConst<double>(), vars[i].GetPtrConst<double>() + sizes[i]);
+            ref_m[i].assign(sizes[i], 0.);
+            ref_v[i].assign(sizes[i], 0.);
+            opt.AddVariable(&vars[i], &grads[i]);
+        }
+        
+        for(int t = 1; t <= steps; ++t){
+            for(int i = 0; i < sizes.size(); ++i){
+                double *g = grads[i].GetPtrMutable<double>();
+                for(int n = 0; n < sizes[i]; ++n){
+                    g[n] = std::cos(0.37 * n + t * 1.3 + i);
+                    double &w = ref_w[i][n], &m = ref_m[i][n], &v = ref_v[i][n];
+                    const double gd = g[n] + wd * w;
+                    if(!type.compare("SGD")){
+                        w -= lr * gd;
+                    }
+                    else if(!type.compare("Momentum")){
+                        m = mu * m + gd;
+                        w -= lr * m;
+                    }
+                    else if(!type.compare("Nesterov")){
+                        m = mu * m + gd;
+                        w -= lr * (gd + mu * m);
+                    }
+                    else{
+                        const double grad = !type.compare("Adam") ? gd : g[n];
+                        m = beta1 * m + (1. - beta1) * grad;
+                        v = beta2 * v + (1. - beta2) * grad * grad;
+                        const double m_hat = m / (1. - std::pow(beta1, t));
+                        const double v_hat = v / (1. - std::pow(beta2, t));
+                        if(!type.compare("AdamW")){
+                            w -= lr * wd * w;
+                        }
+                        w -= lr * m_hat / (std::sqrt(v_hat) + eps);
+                    }
+                }
+            }
+            opt.Update();
+            for(int i = 0; i < sizes.size(); ++i){
+                for(int n = 0; n < sizes[i]; ++n){
+                    ASSERT_NEAR(vars[i].GetPtrConst<double>()[n], ref_w[i][n], 1e-9)
+                    << type << ", step " << t << ", var " << i << ", at " << n;
+                }
+            }
+        }
+    }
+}
+
+TEST(OptimizerTest, VerifyArenaViews) {
+    const std::vector<std::vector<int>> dims = {{3, 4}, {5}, {2, 3, 2}};
+    TensorBlob<CPUContext> params, grads;
+    std::vector<TensorBlob<CPUContext>> vars(dims.size()), var_grads(dims.size());
+    std::vector<TensorBlob<CPUContext>> ref_vars(dims.size()), ref_grads(dims.size());
+    params.Resize<double>({48});
+    grads.Resize<double>({48});
+    params.SetByConst<double>(0.);
+    grads.SetByConst<double>(0.);
+    
+    ParamDef param;
+    param.Add("LearningRate", 0.1f);
+    Optimizer<double> arena_opt("Momentum", param), ref_opt("Momentum", param);
+    int offset = 0;
+    for(int i = 0; i < dims.size(); ++i){
+        vars[i].ShareFrom<double>(params, offset, dims[i]);
+        var_grads[i].ShareFrom<double>(grads, offset, dims[i]);
+        ref_vars[i].Resize<double>(dims[i]);
+        ref_grads[i].Resize<double>(dims[i]);
+        ASSERT_TRUE(vars[i].CompareSizeWith(ref_vars[i]));
+        for(int n = 0; n < vars[i].Size(); ++n){
+            vars[i].GetPtrMutable<double>()[n] = std::sin(0.3 * n + i);
+            ref_vars[i].GetPtrMutable<double>()[n] = std::sin(0.3 * n + i);
+        }
+        ref_opt.AddVariable(&ref_vars[i], &ref_grads[i]);
+        offset += 16;
+    }
+    arena_opt.AddVariable(&params, &grads);
+    
+    /*
+     * a write to the arena is seen by the versions of its views.
+     */
+    const unsigned int version = vars[1].Version();
+    for(int t = 0; t < 3; ++t){
+        for(int i = 0; i < dims.size(); ++i){
+            for(int n = 0; n < vars[i].Size(); ++n){
+                var_grads[i].GetPtrMutable<double>()[n] = std::cos(0.7 * n + t + i);
+                ref_grads[i].GetPtrMutable<double>()[n] = std::cos(0.7 * n + t + i);
+            }
+        }
+        arena_opt.Update();
+        ref_opt.Update();
+    }
+    EXPECT_NE(vars[1].Version(), version);
+    EXPECT_EQ(vars[1].Version(), params.Version());
+    
+    for(int i = 0; i < dims.size(); ++i){
+        for(int n = 0; n < vars[i].Size(); ++n){
+            ASSERT_NEAR(vars[i].GetPtrConst<double>()[n], ref_vars[i].GetPtrConst<double>()[n], 1e-12);
+            ASSERT_EQ(vars[i].GetPtrConst<double>() + n, params.GetPtrConst<double>() + 16 * i + n);
+        }
+    }
+    /*
+     * padding between the views stays untouched.
+     */
+    EXPECT_EQ(params.GetPtrConst<double>()[15], 0.);
+    
+    /*
+     * the arena keeps its memory while views of it are alive,
+     * a view resized over its shared size gets its own memory.
+     */
+    EXPECT_THROW(params.Resize<double>({96}), std::string);
+    EXPECT_NO_THROW(params.Resize<double>({48}));
+    for(auto &var : vars){
+        var.Resize<double>({64});
+        EXPECT_FALSE(var.SharesMemoryWith(params));
+    }
+    EXPECT_NO_THROW(params.Resize<double>({96}));
+}
+
+TEST(OptimizerTest, VerifyPerVariableUpdate) {
+    /*
+     * views of an arena and a plain variable, updated one by one from threads,
+     * must match the fused update.
+     */
+    const std::vector<int> sizes = {7, 100000, 33};
+    const int arena_size = 7 + 100000;
+    TensorBlob<CPUContext> params, grads, plain, plain_grad;
+    std::vector<TensorBlob<CPUContext>> vars(2), var_grads(2);
+    std::vector<TensorBlob<CPUContext>> ref_vars(sizes.size()), ref_grads(sizes.size());
+    params.Resize<double>({arena_size});
+    grads.Resize<double>({arena_size});
+    plain.Resize<double>({sizes[2]});
+    plain_grad.Resize<double>({sizes[2]});
+    vars[0].ShareFrom<double>(params, 0, {sizes[0]});
+    vars[1].ShareFrom<double>(params, sizes[0], {sizes[1]});
+    var_grads[0].ShareFrom<double>(grads, 0, {sizes[0]});
+    var_grads[1].ShareFrom<double>(grads, sizes[0], {sizes[1]});
+    std::vector<TensorBlob<CPUContext> *> updated = {&vars[0], &vars[1], &plain};
+    std::vector<TensorBlob<CPUContext> *> updated_grads = {&var_grads[0], &var_grads[1], &plain_grad};
+    
+    ParamDef param;
+    param.Add("LearningRate", 0.01f);
+    param.Add("WeightDecay", 0.1f);
+    Optimizer<double> opt("Adam", param), ref_opt("Adam", param);
+    opt.SetNumThreads(4);
+    for(int i = 0; i < sizes.size(); ++i){
+        ref_vars[i].Resize<double>({sizes[i]});
+        ref_grads[i].Resize<double>({sizes[i]});
+        for(int n = 0; n < sizes[i]; ++n){
+            updated[i]->GetPtrMutable<double>()[n] = std::sin(0.3 * n + i);
+            ref_vars[i].GetPtrMutable<double>()[n] = std::sin(0.3 * n + i);
+        }
+        ref_opt.AddVariable(&ref_vars[i], &ref_grads[i]);
+    }
+    opt.AddVariable(&params, &grads);
+    opt.AddVariable(&plain, &plain_grad);
+    
+    for(int t = 0; t < 3; ++t){
+        for(int i = 0; i < sizes.size(); ++i){
+            for(int n = 0; n < sizes[i]; ++n){
+                updated_grads[i]->GetPtrMutable<double>()[n] = std::cos(0.7 * n + t + i);
+                ref_grads[i].GetPtrMutable<double>()[n] = std::cos(0.7 * n + t + i);
+            }
+        }
+        opt.BeginStep();
+        std::vector<std::thread> threads;
+        for(auto var : updated){
+            threads.push_back(std::thread([&opt, var](){ opt.UpdateVariable(var); }));
+        }
+        for(auto &thread : threads){
+            thread.join();
+        }
+        ref_opt.Update();
+    }
+    for(int i = 0; i < sizes.size(); ++i){
+        for(int n = 0; n < sizes[i]; ++n){
+            ASSERT_EQ(updated[i]->GetPtrConst<double>()[n], ref_vars[i].GetPtrConst<double>()[n])
+            << "var " << i << ", at " << n;
+        }
+    }
+    
+    TensorBlob<CPUContext> unknown;
+    unknown.Resize<double>({4});
+    EXPECT_THROW(opt.UpdateVariable(&unknown), std::string);
+}
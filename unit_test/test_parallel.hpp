@@ -0,0 +1,190 @@
+#include <iostream>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/operators/operator.hpp>
+#include <mlfe/math/blas.hpp>
+#include <mlfe/math/depthwise_conv.hpp>
+#include <mlfe/utils/parallel.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(ParallelTest, VerifyParallelFor) {
+    const int size = 100003;
+    for(int threads : {1, 3, 8}){
+        NumThreadsScope scope(threads);
+        ASSERT_EQ(GetNumThreads(), threads);
+        std::vector<int> hits(size, 0);
+        std::atomic<int> chunks(0);
+        parallel_for(0, size, 1000, [&](int from, int to){
+            EXPECT_GE(to - from, std::min(1000, size));
+            for(int n = from; n < to; ++n){
+                ++hits[n];
+            }
+            ++chunks;
+        });
+        EXPECT_LE(chunks.load(), threads);
+        for(int n = 0; n < size; ++n){
+            ASSERT_EQ(hits[n], 1) << "at " << n;
+        }
+        
+        /*
+         * the partial sums are combined in the same order for any thread count.
+         */
+        const double sum = parallel_reduce<double>(0, size, 777, 0.,
+                                                   [](int from, int to){
+                                                       double partial = 0.;
+                                                       for(int n = from; n < to; ++n){
+                                                           partial += std::sin(0.1 * n);
+                                                       }
+                                                       return partial;
+                                                   },
+                                                   [](double a, double b){ return a + b; });
+        double ref = 0.;
+        for(int from = 0; from < size; from += 777){
+            double partial = 0.;
+            for(int n = from; n < std::min(from + 777, size); ++n){
+                partial += std::sin(0.1 * n);
+            }
+            ref += partial;
+        }
+        EXPECT_EQ(sum, ref);
+    }
+    
+    /*
+     * a range of no more than the grain stays on the calling thread.
+     */
+    const auto caller = std::this_thread::get_id();
+    parallel_for(0, 500, 500, [&](int from, int to){
+        EXPECT_EQ(std::this_thread::get_id(), caller);
+        EXPECT_EQ(from, 0);
+        EXPECT_EQ(to, 500);
+    });
+}
+
+TEST(ParallelTest, VerifyOperatorsMatchSerial) {
+    /*
+     * large enough to be split, the results must not depend on the thread count.
+     */
+    const int m = 1024, n = 100;
+    std::vector<std::vector<double>> results;
+    for(int threads : {1, 4}){
+        NumThreadsScope scope(threads);
+        ItemHolder ih;
+        ih.AddItem<TensorBlob<CPUContext>>("x");
+        ih.AddItem<TensorBlob<CPUContext>>("label");
+        auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+        auto label = ih.GetItem<TensorBlob<CPUContext>>("label");
+        x->Resize<double>({m, n});
+        label->Resize<double>({m, n});
+        label->SetByConst<double>(0.);
+        for(int i = 0; i < m; ++i){
+            for(int j = 0; j < n; ++j){
+                x->GetPtrMutable<double>()[i * n + j] = std::sin(0.37 * (i * n + j));
+            }
+            label->GetPtrMutable<double>()[i * n + i % n] = 1.;
+        }
+        
+        OperatorIO xent_io, relu_io;
+        xent_io.type = "SoftmaxXentLossWithLabel";
+        xent_io.data_type = "double";
+        xent_io.inputs = {"x", "label"};
+        xent_io.outputs = {"prob", "loss"};
+        relu_io.type = "Relu";
+        relu_io.data_type = "double";
+        relu_io.inputs = {"x"};
+        relu_io.outputs = {"relu"};
+        auto xent = CreateOperator(xent_io, &ih);
+        auto relu = CreateOperator(relu_io, &ih);
+        xent->Compute();
+        relu->Compute();
+        
+        std::vector<double> result;
+        for(auto &name : {"prob", "loss", "relu"}){
+            auto tb = ih.GetItem<TensorBlob<CPUContext>>(name);
+            result.insert(result.end(), tb->GetPtrConst<double>(), tb->GetPtrConst<double>() + tb->Size());
+        }
+        results.push_back(result);
+    }
+    ASSERT_EQ(results[0].size(), results[1].size());
+    for(int i = 0; i < results[0].size(); ++i){
+        ASSERT_EQ(results[0][i], results[1][i]) << "at " << i;
+    }
+}
+
+TEST(ParallelTest, VerifyDepthwiseNHWCGradientMatchesSerial) {
+    /*
+     * every channel range owns its part of dw, db and dx,
+     * so the split must give exactly the serial result.
+     */
+    const int batch = 2, channels = 256, multiplier = 2, height = 8, width = 8;
+    const int filters = channels * multiplier;
+    std::vector<double> x(batch * height * width * channels);
+    std::vector<double> w(3 * 3 * filters);
+    std::vector<double> dy(batch * height * width * filters);
+    for(int i = 0; i < x.size(); ++i){
+        x[i] = std::sin(0.13 * i);
+    }
+    for(int i = 0; i < w.size(); ++i){
+        w[i] = std::cos(0.29 * i);
+    }
+    for(int i = 0; i < dy.size(); ++i){
+        dy[i] = std::sin(0.07 * i + 1.);
+    }
+    std::vector<std::vector<double>> results;
+    for(int threads : {1, 4}){
+        NumThreadsScope scope(threads);
+        std::vector<double> dw(w.size(), 0.), db(filters, 0.), dx(x.size(), 0.);
+        math::depthwise_conv_nhwc_gradient<double, CPUContext>(batch, channels, multiplier,
+                                                               height, width, 3, 3, 1, 1, 1, 1,
+                                                               x.data(), w.data(), dy.data(),
+                                                               dw.data(), db.data(), dx.data());
+        std::vector<double> result(dw);
+        result.insert(result.end(), db.begin(), db.end());
+        result.insert(result.end(), dx.begin(), dx.end());
+        results.push_back(result);
+    }
+    ASSERT_EQ(results[0].size(), results[1].size());
+    for(int i = 0; i < results[0].size(); ++i){
+        ASSERT_EQ(results[0][i], results[1][i]) << "at " << i;
+    }
+}
+
+TEST(ParallelTest, VerifyReducedSumsMatchSerial) {
+    /*
+     * the bias gradients and the losses are reduced in chunks of a fixed grain,
+     * so they must be the same for any thread count, and close to a plain sum.
+     */
+    const int m = 4099, n = 33;
+    std::vector<double> a(m * n);
+    for(int i = 0; i < a.size(); ++i){
+        a[i] = std::sin(0.11 * i);
+    }
+    std::vector<std::vector<double>> results;
+    for(int threads : {1, 4}){
+        NumThreadsScope scope(threads);
+        std::vector<double> result(n + 1, 1.);
+        math::colwise_sum<double, CPUContext>(m, n, a.data(), 0.5, result.data());
+        math::sum<double, CPUContext>(a.size(), a.data(), result.data() + n);
+        results.push_back(result);
+    }
+    for(int j = 0; j < n; ++j){
+        double ref = 0.5;
+        for(int i = 0; i < m; ++i){
+            ref += a[i * n + j];
+        }
+        EXPECT_NEAR(results[0][j], ref, 1e-9) << "at " << j;
+    }
+    double ref = 0.;
+    for(auto v : a){
+        ref += v;
+    }
+    EXPECT_NEAR(results[0][n], ref, 1e-9);
+    for(int i = 0; i < results[0].size(); ++i){
+        ASSERT_EQ(results[0][i], results[1][i]) << "at " << i;
+    }
+}
@@ -0,0 +1,84 @@
+#include <iostream>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/operators/operator.hpp>
+#include <mlfe/operators/graph_executor.hpp>
+#include <mlfe/utils/parallel.hpp>
+#include <mlfe/utils/profiler.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(ProfilerTest, VerifyRecordsOperatorRuns) {
+    NumThreadsScope scope(4);
+    ItemHolder ih;
+    ih.AddItem<TensorBlob<CPUContext>>("x");
+    ih.GetItem<TensorBlob<CPUContext>>("x")->Resize<float>({64, 3});
+    std::vector<std::shared_ptr<OperatorBase>> ops;
+    for(std::string y : {"a", "b"}){
+        OperatorIO opio;
+        opio.type = "Scale";
+        opio.inputs = {"x"};
+        opio.outputs = {y};
+        opio.param.Add("Scale", 2.f);
+        ops.push_back(CreateOperator(opio, &ih));
+    }
+    ops[1]->GetOperatorIO().name = "scale \"b\"";
+    GraphExecutor executor(ops);
+    
+    /*
+     * only the steps run while it is on are recorded.
+     */
+    ClearProfile();
+    executor.Run();
+    SetProfiling(true);
+    for(int step = 0; step < 3; ++step){
+        executor.Run();
+    }
+    SetProfiling(false);
+    executor.Run();
+    
+    auto events = GetProfileEvents();
+    ASSERT_EQ(events.size(), 6);
+    int a_runs = 0;
+    for(auto &e : events){
+        EXPECT_EQ(e.type, "Scale");
+        EXPECT_LE(e.begin, e.end);
+        EXPECT_GE(e.thread, 0);
+        ASSERT_EQ(e.input_shapes.size(), 1);
+        ASSERT_EQ(e.output_shapes.size(), 1);
+        EXPECT_EQ(e.input_shapes[0], std::vector<int>({64, 3}));
+        EXPECT_EQ(e.output_shapes[0], std::vector<int>({64, 3}));
+        a_runs += e.name == "a" ? 1 : 0;
+    }
+    EXPECT_EQ(a_runs, 3);
+    
+    std::string trace = ProfileToChromeTrace();
+    EXPECT_NE(trace.find("\"traceEvents\""), std::string::npos);
+    EXPECT_NE(trace.find("\"name\":\"scale \\\"b\\\"\""), std::string::npos);
+    EXPECT_NE(trace.find("\"inputs\":\"[64,3]\""), std::string::npos);
+    const std::string path = "profiler_test_trace.json";
+    SaveChromeTrace(path);
+    std::ifstream file(path);
+    std::stringstream saved;
+    saved<<file.rdbuf();
+    EXPECT_EQ(saved.str(), trace);
+    std::remove(path.c_str());
+    EXPECT_THROW(SaveChromeTrace("no_such_dir/trace.json"), std::string);
+    
+    std::string summary = ProfileSummary();
+    std::string line;
+    std::istringstream lines(summary);
+    int rows = 0;
+    while(std::getline(lines, line)){
+        ++rows;
+    }
+    EXPECT_EQ(rows, 3);
+    EXPECT_NE(summary.find("scale \"b\""), std::string::npos);
+    ClearProfile();
+    EXPECT_TRUE(GetProfileEvents().empty());
+}
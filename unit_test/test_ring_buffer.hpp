@@ -0,0 +1,68 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <mlfe/utils/ring_buffer.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(RingBufferTest, VerifyOrderedHandOff) {
+    /*
+     * the consumer is sometimes slower, and sometimes faster than the producer,
+     * so both sides spin and park.
+     */
+    const int count = 20000;
+    SPSCRing<std::vector<int>> ring(3);
+    for(int n = 0; n < ring.Capacity(); ++n){
+        ring.Slot(n).resize(8);
+    }
+    std::thread producer([&ring, count](){
+        for(int n = 0; n < count; ++n){
+            std::vector<int> *slot = ring.BeginWrite();
+            ASSERT_NE(slot, nullptr);
+            ASSERT_EQ(slot->size(), 8);
+            for(auto &v : *slot){
+                v = n;
+            }
+            ring.EndWrite();
+            if(n % 5000 == 0){
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+    });
+    for(int n = 0; n < count; ++n){
+        std::vector<int> *slot = ring.BeginRead();
+        ASSERT_NE(slot, nullptr);
+        for(auto v : *slot){
+            ASSERT_EQ(v, n);
+        }
+        ring.EndRead();
+        if(n % 7000 == 0){
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    producer.join();
+}
+
+TEST(RingBufferTest, VerifyClose) {
+    SPSCRing<int> ring(2);
+    /*
+     * a producer parked on a full ring is woken by Close.
+     */
+    std::thread producer([&ring](){
+        int *slot;
+        while((slot = ring.BeginWrite()) != nullptr){
+            *slot = 1;
+            ring.EndWrite();
+        }
+    });
+    ASSERT_NE(ring.BeginRead(), nullptr);
+    ring.EndRead();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ring.Close();
+    producer.join();
+    EXPECT_EQ(ring.Size(), 2);
+    EXPECT_EQ(ring.BeginRead(), nullptr);
+}
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <mlfe/device_context/cpu_context.hpp>
 #include <mlfe/operators/softmax_xent_with_label.hpp>
+#include <mlfe/operators/sparse_softmax_xent_with_label.hpp>
 #include <gtest/gtest.h>
 #include <mlfe/utils/gradient_checker.hpp>
 
@@ -93,3 +94,73 @@ TEST(SoftmaxXentWithLabelOperatorTest, VerifyCPUResults) {
         cout << chrono::duration_cast<chrono::milliseconds>(end - begin).count() << "ms" << std::endl;
     }
 }
+
+TEST(SparseSoftmaxXentWithLabelOperatorTest, VerifyCPUResults) {
+    const int batch_size = 4;
+    const int x_size = 7;
+    const std::vector<int> labels = {3, 0, 6, 3};
+    
+    for(auto &label_type : {"uchar", "int"}){
+        SCOPED_TRACE(label_type);
+        ItemHolder ih;
+        OperatorIO dense_opio, sparse_opio;
+        ih.AddItem<TensorBlob<CPUContext>>("x");
+        ih.AddItem<TensorBlob<CPUContext>>("label_one_hot");
+        ih.AddItem<TensorBlob<CPUContext>>("label");
+        auto x = ih.GetItem<TensorBlob<CPUContext>>("x");
+        auto one_hot = ih.GetItem<TensorBlob<CPUContext>>("label_one_hot");
+        auto label = ih.GetItem<TensorBlob<CPUContext>>("label");
+        x->Resize<double>({batch_size, x_size});
+        one_hot->Resize<double>({batch_size, x_size});
+        one_hot->SetByConst<double>(0.);
+        if(!std::string(label_type).compare("uchar")){
+            label->Resize<unsigned char>({batch_size, 1});
+        }
+        else{
+            label->Resize<int>({batch_size});
+        }
+        for(int i = 0; i < x->Size(); ++i){
+            x->GetPtrMutable<double>()[i] = std::sin(0.7 * i) * 3.;
+        }
+        for(int i = 0; i < batch_size; ++i){
+            one_hot->GetPtrMutable<double>()[i * x_size + labels[i]] = 1.;
+            if(label->MatchType<int>()){
+                label->GetPtrMutable<int>()[i] = labels[i];
+            }
+            else{
+                label->GetPtrMutable<unsigned char>()[i] = labels[i];
+            }
+        }
+        
+        dense_opio.type = "SoftmaxXentLossWithLabel";
+        dense_opio.data_type = "double";
+        dense_opio.inputs = {"x", "label_one_hot"};
+        dense_opio.outputs = {"dense_prob", "dense_loss"};
+        sparse_opio = dense_opio;
+        sparse_opio.type = "SparseSoftmaxXentWithLabel";
+        sparse_opio.inputs = {"x", "label"};
+        sparse_opio.outputs = {"prob", "loss"};
+        
+        auto dense = CreateOperator(dense_opio, &ih);
+        auto dense_grad = CreateOperatorGradient(dense_opio, &ih);
+        dense->Compute();
+        dense_grad->Compute();
+        std::vector<double> dense_dx(ih.GetItem<TensorBlob<CPUContext>>("x_grad")->GetPtrConst<double>(),
+                                     ih.GetItem<TensorBlob<CPUContext>>("x_grad")->GetPtrConst<double>() + x->Size());
+        
+        auto sparse = CreateOperator(sparse_opio, &ih);
+        auto sparse_grad = CreateOperatorGradient(sparse_opio, &ih);
+        sparse->Compute();
+        sparse_grad->Compute();
+        
+        auto dense_prob = ih.GetItem<TensorBlob<CPUContext>>("dense_prob");
+        auto prob = ih.GetItem<TensorBlob<CPUContext>>("prob");
+        auto dx = ih.GetItem<TensorBlob<CPUContext>>("x_grad");
+        EXPECT_NEAR(ih.GetItem<TensorBlob<CPUContext>>("loss")->GetPtrConst<double>()[0],
+                    ih.GetItem<TensorBlob<CPUContext>>("dense_loss")->GetPtrConst<double>()[0], 1e-12);
+        for(int i = 0; i < x->Size(); ++i){
+            EXPECT_NEAR(prob->GetPtrConst<double>()[i], dense_prob->GetPtrConst<double>()[i], 1e-12);
+            EXPECT_NEAR(dx->GetPtrConst<double>()[i], dense_dx[i], 1e-12);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/operators/sparse_fully_connected.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(SparseFCOperatorTest, VerifyCPUResults) {
+    /*
+     * large enough, that the rows and the units are split over threads.
+     */
+    const int m = 64, k = 500, units = 32, nnz = 40;
+    ItemHolder ih;
+    OperatorIO opio;
+    opio.type = "SparseFC";
+    opio.data_type = "double";
+    opio.inputs = {"x_indptr", "x_indices", "x_values", "w", "b"};
+    opio.outputs = {"y"};
+    opio.param.Add("Units", units);
+    opio.param.Add("Columns", k);
+    for(auto &name : {"x_indptr", "x_indices", "x_values"}){
+        ih.AddItem<TensorBlob<CPUContext>>(name);
+    }
+    auto indptr = ih.GetItem<TensorBlob<CPUContext>>("x_indptr");
+    auto indices = ih.GetItem<TensorBlob<CPUContext>>("x_indices");
+    auto values = ih.GetItem<TensorBlob<CPUContext>>("x_values");
+    indptr->Resize<int>({m + 1});
+    indices->Resize<int>({m * nnz});
+    values->Resize<double>({m * nnz});
+    
+    auto fc = CreateOperator(opio, &ih);
+    auto fc_grad = CreateOperatorGradient(opio, &ih);
+    auto w = ih.GetItem<TensorBlob<CPUContext>>("w");
+    auto b = ih.GetItem<TensorBlob<CPUContext>>("b");
+    auto y = ih.GetItem<TensorBlob<CPUContext>>("y");
+    auto dw = ih.GetItem<TensorBlob<CPUContext>>("w_grad");
+    auto db = ih.GetItem<TensorBlob<CPUContext>>("b_grad");
+    ih.AddItem<TensorBlob<CPUContext>>("y_grad");
+    auto dy = ih.GetItem<TensorBlob<CPUContext>>("y_grad");
+    dy->Resize<double>(*y);
+    ASSERT_EQ(y->Dim(0), m);
+    ASSERT_EQ(y->Dim(1), units);
+    ASSERT_EQ(w->Dim(0), k);
+    ASSERT_EQ(w->Dim(1), units);
+    ASSERT_TRUE(dw->CompareSizeWith(*w));
+    for(int i = 0; i < w->Size(); ++i){ w->GetPtrMutable<double>()[i] = std::sin(0.3 * i); }
+    for(int i = 0; i < units; ++i){ b->GetPtrMutable<double>()[i] = std::cos(0.5 * i); }
+    
+    /*
+     * the second step uses other columns, and rows of different length,
+     * so the rows of the first step must be cleared from dw.
+     */
+    for(int step = 0; step < 2; ++step){
+        SCOPED_TRACE(step);
+        std::vector<double> x(m * k, 0.);
+        int *indptr_ptr = indptr->GetPtrMutable<int>();
+        indptr_ptr[0] = 0;
+        for(int i = 0; i < m; ++i){
+            const int row_nnz = step == 0 ? nnz : i % 5;
+            for(int p = 0; p < row_nnz; ++p){
+                const int pos = indptr_ptr[i] + p;
+                const int col = step == 0 ? (i * 7 + p * 11) % k : (i * 3 + p * 13) % 50 + 250;
+                indices->GetPtrMutable<int>()[pos] = col;
+                values->GetPtrMutable<double>()[pos] = std::cos(0.9 * pos + step);
+                x[i * k + col] += std::cos(0.9 * pos + step);
+            }
+            indptr_ptr[i + 1] = indptr_ptr[i] + row_nnz;
+        }
+        for(int i = 0; i < dy->Size(); ++i){ dy->GetPtrMutable<double>()[i] = std::sin(0.7 * i + step); }
+        fc->Compute();
+        fc_grad->Compute();
+        
+        for(int i = 0; i < m; ++i){
+            for(int j = 0; j < units; ++j){
+                double y_ref = b->GetPtrConst<double>()[j];
+                for(int c = 0; c < k; ++c){
+                    y_ref += x[i * k + c] * w->GetPtrConst<double>()[c * units + j];
+                }
+                ASSERT_NEAR(y->GetPtrConst<double>()[i * units + j], y_ref, 1e-9);
+            }
+        }
+        for(int j = 0; j < units; ++j){
+            double db_ref = 0.;
+            for(int i = 0; i < m; ++i){
+                db_ref += dy->GetPtrConst<double>()[i * units + j] / m;
+            }
+            ASSERT_NEAR(db->GetPtrConst<double>()[j], db_ref, 1e-12);
+            for(int c = 0; c < k; ++c){
+                double dw_ref = 0.;
+                for(int i = 0; i < m; ++i){
+                    dw_ref += dy->GetPtrConst<double>()[i * units + j] * x[i * k + c] / m;
+                }
+                ASSERT_NEAR(dw->GetPtrConst<double>()[c * units + j], dw_ref, 1e-12) << "at " << j << ", " << c;
+            }
+        }
+    }
+}
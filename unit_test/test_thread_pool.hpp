@@ -0,0 +1,75 @@
+#include <iostream>
+#include <atomic>
+#include <vector>
+#include <mlfe/utils/thread_pool.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+namespace{
+/*
+ * sums [from, to) by splitting it in nested task groups.
+ */
+long long ParallelSum(ThreadPool *pool, const int from, const int to){
+    if(to - from <= 64){
+        long long sum = 0;
+        for(int n = from; n < to; ++n){
+            sum += n;
+        }
+        return sum;
+    }
+    long long left = 0, right = 0;
+    const int mid = (from + to) / 2;
+    TaskGroup group(pool);
+    group.Run([&](){ left = ParallelSum(pool, from, mid); });
+    group.Run([&](){ right = ParallelSum(pool, mid, to); });
+    group.Wait();
+    return left + right;
+}
+} /* namespace */
+
+TEST(ThreadPoolTest, VerifyFuturesAndGroups) {
+    ThreadPool pool(4);
+    ASSERT_EQ(pool.Size(), 4u);
+    
+    std::vector<std::future<int>> results;
+    for(int n = 0; n < 100; ++n){
+        results.push_back(pool.Submit([n](){ return n * n; }));
+    }
+    for(int n = 0; n < 100; ++n){
+        EXPECT_EQ(results[n].get(), n * n);
+    }
+    
+    auto failed = pool.Submit([](){ throw std::string("task error"); });
+    EXPECT_THROW(failed.get(), std::string);
+    
+    /*
+     * every worker waits on its own group, and still the nested tasks run.
+     */
+    EXPECT_EQ(ParallelSum(&pool, 0, 100000), 100000LL * 99999 / 2);
+    
+    TaskGroup group(&pool);
+    for(int n = 0; n < 10; ++n){
+        group.Run([n](){
+            if(n == 7){
+                throw std::string("group error");
+            }
+        });
+    }
+    EXPECT_THROW(group.Wait(), std::string);
+}
+
+TEST(ThreadPoolTest, VerifyDrainingShutdown) {
+    std::atomic<int> done(0);
+    ThreadPool pool(2);
+    for(int n = 0; n < 200; ++n){
+        pool.Submit([&done](){
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            ++done;
+        });
+    }
+    pool.Shutdown();
+    EXPECT_EQ(done.load(), 200);
+    EXPECT_THROW(pool.Submit([](){}), std::string);
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <mlfe/device_context/cpu_context.hpp>
+#include <mlfe/math/transform.hpp>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace mlfe;
+
+TEST(Im2ColTest, VerifyCPUResults) {
+    struct Shape{ int c, h, w, kh, kw, sh, sw, ph, pw; };
+    const std::vector<Shape> shapes = {
+        {2, 6, 6, 3, 3, 1, 1, 0, 0},
+        {3, 7, 5, 3, 2, 2, 1, 1, 0},
+        {2, 5, 8, 2, 3, 1, 3, 0, 2},
+        {1, 4, 4, 5, 5, 1, 1, 2, 2},
+    };
+    
+    for(auto &s : shapes){
+        const int out_h = (s.h + 2 * s.ph - s.kh) / s.sh + 1;
+        const int out_w = (s.w + 2 * s.pw - s.kw) / s.sw + 1;
+        std::vector<double> im(s.c * s.h * s.w), col(s.c * s.kh * s.kw * out_h * out_w);
+        std::vector<double> dcol(col.size()), dim(im.size(), 0.);
+        for(int i = 0; i < im.size(); ++i){
+            im[i] = std::sin(0.37 * i);
+        }
+        for(int i = 0; i < dcol.size(); ++i){
+            dcol[i] = std::cos(0.11 * i);
+        }
+        
+        math::im2col<double, CPUContext>(s.c, s.h, s.w, s.kh, s.kw,
+                                         s.sh, s.sw, s.ph, s.pw,
+                                         im.data(), col.data());
+        
+        /*
+         * compare with the definition.
+         */
+        for(int c = 0; c < s.c; ++c){
+            for(int kh = 0; kh < s.kh; ++kh){
+                for(int kw = 0; kw < s.kw; ++kw){
+                    for(int h = 0; h < out_h; ++h){
+                        for(int w = 0; w < out_w; ++w){
+                            const int row = h * s.sh - s.ph + kh;
+                            const int col_idx = w * s.sw - s.pw + kw;
+                            double expect = 0.;
+                            if(row >= 0 && row < s.h && col_idx >= 0 && col_idx < s.w){
+                                expect = im[(c * s.h + row) * s.w + col_idx];
+                            }
+                            EXPECT_EQ(col[(((c * s.kh + kh) * s.kw + kw) * out_h + h) * out_w + w], expect);
+                        }
+                    }
+                }
+            }
+        }
+        
+        /*
+         * col2im is the adjoint of im2col,
+         * <im2col(im), dcol> == <im, col2im(dcol)>.
+         */
+        math::col2im<double, CPUContext>(dcol.data(), s.c, s.h, s.w, s.kh, s.kw,
+                                         s.sh, s.sw, s.ph, s.pw,
+                                         dim.data());
+        double lhs = 0., rhs = 0.;
+        for(int i = 0; i < col.size(); ++i){
+            lhs += col[i] * dcol[i];
+        }
+        for(int i = 0; i < im.size(); ++i){
+            rhs += im[i] * dim[i];
+        }
+        EXPECT_NEAR(lhs, rhs, 1e-9);
+    }
+}